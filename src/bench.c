@@ -0,0 +1,633 @@
+/***************************************************************************//**
+
+  @file         bench.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Benchmarks of the lexer, grammars, recognizers and search.
+
+  Every suite runs on generated input from fixed seeds, so runs are
+  comparable across builds and machines, and each time is the median of
+  several runs.  The results can be written as CSV and read back as the
+  baseline of a later run, which reports each change and fails on a slowdown.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+
+#include "libstephen/base.h"
+#include "libstephen/ad.h"
+#include "libstephen/al.h"
+#include "libstephen/cb.h"
+#include "libstephen/regex.h"
+#include "cky.h"
+#include "cnf.h"
+#include "dfa.h"
+#include "gram.h"
+#include "lex.h"
+#include "valiant.h"
+
+/**
+   @brief One measurement: the median time of a case, and its throughput.
+ */
+typedef struct {
+  char suite[16];
+  char name[48];
+  long size;
+  double ms;
+  double rate;     // units per second, if the case has a throughput
+  char unit[16];
+} bench_result;
+
+/**
+   @brief The results of a run, and the options every suite shares.
+ */
+typedef struct {
+  bench_result *rows;
+  int count, capacity;
+  int repeat;
+  bool quiet;      // true when the results go to stdout as CSV or JSON
+} bench_log;
+
+/**
+   @brief Print the help message for the benchmark program.
+ */
+void help(char *name)
+{
+  printf("Usage: %s [OPTIONS]\n", name);
+  puts("Times the lexer, grammar building, recognizers and regex search on");
+  puts("generated input, keeping the median of several runs.");
+  puts("");
+  puts("Options:");
+  puts("  -s, --suite [NAME]      lex, grammar, cky, regex, crossover or all");
+  puts("  -r, --repeat [N]        runs of each, keeping the median (5)");
+  puts("  -c, --corpus [KB]       size of the text lexed and searched (1024)");
+  puts("  -f, --format [FORMAT]   text, csv or json (text)");
+  puts("  -b, --baseline [FILE]   compare with the CSV output of a past run");
+  puts("  -t, --tolerance [PCT]   slowdown over the baseline allowed (10)");
+  puts("  -n, --nonterminals [N]  crossover: nonterminals of the grammar (32)");
+  puts("  -m, --max [N]           crossover: longest sentence to time (512)");
+  puts("  -h, --help              display this help message and exit");
+  puts("");
+  puts("With a baseline, the comparison goes to stderr, and the exit code is");
+  puts("1 if any case slowed down by more than the tolerance.");
+}
+
+/**
+   @brief Return a flag's parameter, by its short or long name.
+ */
+static char *parameter(smb_ad *data, char flag, char *name, char *def)
+{
+  char *value = get_flag_parameter(data, flag);
+  if (value == NULL) {
+    value = get_long_flag_parameter(data, name);
+  }
+  return value == NULL ? def : value;
+}
+
+static unsigned int next_random(unsigned int *seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+/*
+  Make a random grammar with three binary rules for each nonterminal, and four
+  terminals, each derived by a few nonterminals.  Random grammars are very
+  ambiguous, so nearly every cell of the chart is full.
+ */
+static cnf *random_grammar(int nnon, unsigned int seed)
+{
+  cnf *gram = cnf_create_arena();
+  int i, a;
+  char *name;
+  for (i = 0; i < nnon + 4; i++) {
+    name = smb_new(char, 16);
+    sprintf(name, "%c%d", i < nnon ? 'N' : 't', i);
+    cnf_add_symbol(gram, name, i >= nnon);
+  }
+  for (a = 0; a < nnon; a++) {
+    for (i = 0; i < 3; i++) {
+      cnf_new_rule(gram, a, next_random(&seed) % nnon,
+                   next_random(&seed) % nnon);
+    }
+    if (a % 2 == 0) {
+      cnf_new_rule(gram, a, next_random(&seed) % 4, CFG_SYMBOL_NONE);
+    }
+  }
+  gram->start = 0;
+  cnf_build_index(gram);
+  return gram;
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+/*
+  Return the median of some times, in seconds, as milliseconds.
+ */
+static double median_ms(double *times, int n)
+{
+  qsort(times, n, sizeof(double), &compare_double);
+  return times[n / 2] * 1000;
+}
+
+/*
+  Record a result, and print it unless the results are printed at the end.
+  The rate is per second, for amount units of work in the case.
+ */
+static void record(bench_log *log, const char *suite, const char *name,
+                   long size, double ms, double amount, const char *unit)
+{
+  bench_result *r;
+
+  if (log->count == log->capacity) {
+    log->capacity = log->capacity == 0 ? 64 : 2 * log->capacity;
+    log->rows = smb_renew(bench_result, log->rows, log->capacity);
+  }
+  r = &log->rows[log->count++];
+  snprintf(r->suite, sizeof(r->suite), "%s", suite);
+  snprintf(r->name, sizeof(r->name), "%s", name);
+  r->size = size;
+  r->ms = ms;
+  r->rate = unit == NULL || ms <= 0 ? 0 : amount / (ms / 1000);
+  snprintf(r->unit, sizeof(r->unit), "%s", unit == NULL ? "" : unit);
+  if (!log->quiet) {
+    printf("%-10s %-24s %8ld %12.3f", r->suite, r->name, r->size, r->ms);
+    if (unit != NULL) {
+      printf(" %14.1f %s", r->rate, r->unit);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+}
+
+/*
+  Make the text that the lex and regex suites run on: keywords, identifiers,
+  numbers and punctuation, with spaces and newlines between them.
+ */
+static char *corpus(size_t size, int nkeywords, unsigned int seed)
+{
+  char *text = smb_new(char, size + 16);
+  size_t pos = 0;
+  unsigned int r;
+  int i, n;
+
+  while (pos < size) {
+    r = next_random(&seed) % 10;
+    if (r < 4) {
+      i = next_random(&seed) % nkeywords;
+      pos += sprintf(text + pos, "kw%c%c", 'a' + i / 26 % 26, 'a' + i % 26);
+    } else if (r < 7) {
+      n = 3 + next_random(&seed) % 6;
+      for (i = 0; i < n; i++) {
+        text[pos++] = 'a' + next_random(&seed) % 26;
+      }
+    } else if (r < 9) {
+      pos += sprintf(text + pos, "%u", next_random(&seed) % 100000);
+    } else {
+      text[pos++] = "+-*/(){};"[next_random(&seed) % 9];
+    }
+    text[pos++] = next_random(&seed) % 12 == 0 ? '\n' : ' ';
+  }
+  text[size] = '\0';
+  return text;
+}
+
+/*
+  Lexer throughput as the number of patterns grows.  Each lexer has keyword
+  patterns ahead of identifiers and numbers, like a programming language.
+ */
+static void bench_lex(bench_log *log, size_t size)
+{
+  int counts[] = {4, 32, 256}, k, i, r;
+  smb_status status = SMB_SUCCESS;
+  double *times = smb_new(double, log->repeat), start;
+  wchar_t line[32];
+  lex_tokens tokens;
+  smb_lex lex;
+  wcbuf desc;
+  char *text, name[32];
+
+  lex_tokens_init(&tokens);
+  for (k = 0; k < 3; k++) {
+    wcb_init(&desc, 1024);
+    for (i = 0; i < counts[k]; i++) {
+      swprintf(line, 32, L"kw%lc%lc\tkw%d\n", (wint_t) (L'a' + i / 26 % 26),
+               (wint_t) (L'a' + i % 26), i);
+      wcb_concat(&desc, line);
+    }
+    wcb_concat(&desc, L"[a-z]+\tid\n[0-9]+\tnum\n[-+*/(){};]\tpunct\n"
+               L"\\s+\tspace\tskip\n");
+    lex_init(&lex);
+    lex_load(&lex, desc.buf, &status);
+    lex_compile(&lex);
+    text = corpus(size, counts[k], 7);
+
+    for (r = 0; r < log->repeat; r++) {
+      start = now();
+      lex_tokenize_all(&lex, text, size, &tokens);
+      times[r] = now() - start;
+    }
+    sprintf(name, "bytes/%d", counts[k]);
+    record(log, "lex", name, size, median_ms(times, log->repeat),
+           size / 1e6, "MB/s");
+    sprintf(name, "tokens/%d", counts[k]);
+    record(log, "lex", name, size, log->rows[log->count - 1].ms,
+           tokens.count, "tokens/s");
+
+    smb_free(text);
+    lex_destroy(&lex);
+    wcb_destroy(&desc);
+  }
+  lex_tokens_destroy(&tokens);
+  smb_free(times);
+}
+
+/*
+  Adding symbols to a grammar, and converting a random grammar to CNF, as the
+  number of symbols grows.
+ */
+static void bench_grammar(bench_log *log)
+{
+  int counts[] = {1000, 4000, 16000}, k, i, j, r, n, len;
+  smb_status status = SMB_SUCCESS;
+  double *times = smb_new(double, log->repeat), start;
+  unsigned int seed = 3;
+  char **names;
+  cfg_rule *rule;
+  cfg gram;
+  cnf normal;
+
+  for (k = 0; k < 3; k++) {
+    n = counts[k];
+    names = smb_new(char *, n + 8);
+    for (i = 0; i < n + 8; i++) {
+      names[i] = smb_new(char, 16);
+      sprintf(names[i], i < n ? "N%d" : "t%d", i);
+    }
+
+    for (r = 0; r < log->repeat; r++) {
+      cfg_init_arena(&gram);
+      start = now();
+      for (i = 0; i < n; i++) {
+        cfg_add_symbol(&gram, names[i], false);
+      }
+      times[r] = now() - start;
+      cfg_destroy(&gram, false);
+    }
+    record(log, "grammar", "add_symbol", n, median_ms(times, log->repeat),
+           n, "symbols/s");
+
+    // Two rules for each nonterminal, of one to three symbols, and a rule to
+    // a terminal for every fourth one.
+    cfg_init_arena(&gram);
+    for (i = 0; i < n + 8; i++) {
+      cfg_add_symbol(&gram, names[i], i >= n);
+    }
+    for (i = 0; i < n; i++) {
+      for (j = 0; j < 2; j++) {
+        len = 1 + next_random(&seed) % 3;
+        rule = cfg_new_rule(&gram, i, len);
+        while (len-- > 0) {
+          rule->rhs[len] = next_random(&seed) % n;
+        }
+      }
+      if (i % 4 == 0) {
+        cfg_new_rule(&gram, i, 1)->rhs[0] = n + next_random(&seed) % 8;
+      }
+    }
+    gram.start = 0;
+    for (r = 0; r < log->repeat; r++) {
+      cnf_init(&normal);
+      start = now();
+      cfg_to_cnf(&gram, &normal, &status);
+      times[r] = now() - start;
+      cnf_destroy(&normal, true);
+    }
+    record(log, "grammar", "to_cnf", n, median_ms(times, log->repeat),
+           cfg_num_rules(&gram), "rules/s");
+    cfg_destroy(&gram, false);
+
+    for (i = 0; i < n + 8; i++) {
+      smb_free(names[i]);
+    }
+    smb_free(names);
+  }
+  smb_free(times);
+}
+
+/*
+  Filling the CKY chart, as sentences and grammars grow.
+ */
+static void bench_cky(bench_log *log)
+{
+  int sizes[] = {8, 32, 128, 512}, lengths[] = {16, 64, 128}, g, l, i, r;
+  double *times = smb_new(double, log->repeat), start;
+  unsigned int seed = 5;
+  int tokens[128];
+  cky_grammar compiled;
+  cky_chart chart;
+  char name[32];
+  cnf *gram;
+
+  for (i = 0; i < 128; i++) {
+    tokens[i] = next_random(&seed) % 4;
+  }
+  for (g = 0; g < 4; g++) {
+    gram = random_grammar(sizes[g], 1);
+    cky_grammar_init(&compiled, gram);
+    cky_chart_init(&chart, &compiled, 128);
+    for (l = 0; l < 3; l++) {
+      for (r = 0; r < log->repeat; r++) {
+        start = now();
+        cky_chart_fill(&chart, tokens, lengths[l]);
+        times[r] = now() - start;
+      }
+      sprintf(name, "fill/%d", sizes[g]);
+      record(log, "cky", name, lengths[l], median_ms(times, log->repeat),
+             lengths[l], "tokens/s");
+    }
+    cky_chart_destroy(&chart);
+    cky_grammar_destroy(&compiled);
+    cnf_delete(gram, true);
+  }
+  smb_free(times);
+}
+
+/*
+  Regex search throughput, for patterns with and without a required literal.
+ */
+static void bench_regex(bench_log *log, size_t size)
+{
+  wchar_t *patterns[] = {L"kwab[a-z]*", L"[0-9][0-9][0-9][0-9][0-9]+",
+                         L"[a-z]+q[a-z]+"};
+  const char *names[] = {"literal", "digits", "letters"};
+  smb_status status = SMB_SUCCESS;
+  double *times = smb_new(double, log->repeat), start;
+  char *text = corpus(size, 256, 11);
+  dfa_prefilter filter;
+  dfa *chars, *bytes;
+  smb_al *hits;
+  fsm *f;
+  int p, r, i;
+
+  for (p = 0; p < 3; p++) {
+    f = regex_parse(patterns[p]);
+    chars = dfa_create(&f, 1);
+    bytes = dfa_create_utf8(chars);
+    dfa_prefilter_init(&filter, bytes);
+    for (r = 0; r < log->repeat; r++) {
+      start = now();
+      hits = dfa_search_filtered(bytes, &filter, text, size, true, false);
+      times[r] = now() - start;
+      for (i = 0; i < al_length(hits); i++) {
+        regex_hit_delete(al_get(hits, i, &status).data_ptr);
+      }
+      al_delete(hits);
+    }
+    record(log, "regex", names[p], size, median_ms(times, log->repeat),
+           size / 1e6, "MB/s");
+    dfa_delete(chars);
+    dfa_delete(bytes);
+    fsm_delete(f, true);
+  }
+  smb_free(text);
+  smb_free(times);
+}
+
+/*
+  Time each recognizer on sentences of doubling length, to find where matrix
+  products overtake classic CKY.
+ */
+static void bench_crossover(bench_log *log, int nnon, int max)
+{
+  cnf *gram = random_grammar(nnon, 1);
+  cky_grammar compiled;
+  cky_chart chart;
+  cky_valiant valiant;
+  unsigned int seed = 2;
+  int *tokens = smb_new(int, max);
+  double *classic = smb_new(double, log->repeat);
+  double *product = smb_new(double, log->repeat);
+  double start;
+  char name[32];
+  int n, i, r;
+
+  cky_grammar_init(&compiled, gram);
+  cky_chart_init(&chart, &compiled, max);
+  cky_valiant_init(&valiant, &compiled);
+  for (i = 0; i < max; i++) {
+    tokens[i] = next_random(&seed) % 4;
+  }
+
+  for (n = 16; n <= max; n = n < max && 2 * n > max ? max : 2 * n) {
+    for (r = 0; r < log->repeat; r++) {
+      start = now();
+      cky_chart_fill(&chart, tokens, n);
+      classic[r] = now() - start;
+      start = now();
+      cky_valiant_fill(&valiant, tokens, n);
+      product[r] = now() - start;
+    }
+    sprintf(name, "classic/%d", nnon);
+    record(log, "crossover", name, n, median_ms(classic, log->repeat), n,
+           "tokens/s");
+    sprintf(name, "product/%d", nnon);
+    record(log, "crossover", name, n, median_ms(product, log->repeat), n,
+           "tokens/s");
+    if (n == max) {
+      break;
+    }
+  }
+
+  smb_free(classic);
+  smb_free(product);
+  smb_free(tokens);
+  cky_valiant_destroy(&valiant);
+  cky_chart_destroy(&chart);
+  cky_grammar_destroy(&compiled);
+  cnf_delete(gram, true);
+}
+
+static void print_csv(const bench_log *log, FILE *f)
+{
+  const bench_result *r;
+  int i;
+
+  fprintf(f, "suite,name,size,median_ms,rate,unit\n");
+  for (i = 0; i < log->count; i++) {
+    r = &log->rows[i];
+    fprintf(f, "%s,%s,%ld,%.6f,%.3f,%s\n", r->suite, r->name, r->size, r->ms,
+            r->rate, r->unit);
+  }
+}
+
+static void print_json(const bench_log *log, FILE *f)
+{
+  const bench_result *r;
+  int i;
+
+  // Names are made here, and never need escaping.
+  fprintf(f, "[\n");
+  for (i = 0; i < log->count; i++) {
+    r = &log->rows[i];
+    fprintf(f, "  {\"suite\": \"%s\", \"name\": \"%s\", \"size\": %ld, "
+            "\"median_ms\": %.6f, \"rate\": %.3f, \"unit\": \"%s\"}%s\n",
+            r->suite, r->name, r->size, r->ms, r->rate, r->unit,
+            i + 1 < log->count ? "," : "");
+  }
+  fprintf(f, "]\n");
+}
+
+/*
+  Compare each result with the same case of a baseline in CSV, reporting on
+  stderr.  Returns the number of cases slower than the tolerance allows, or
+  -1 if the baseline can't be read.
+ */
+static int compare(const bench_log *log, const char *filename,
+                   double tolerance)
+{
+  FILE *f = fopen(filename, "r");
+  bench_log base = {NULL, 0, 0, 0, true};
+  char line[256], suite[16], name[48];
+  const bench_result *r, *b;
+  double ms, change;
+  int i, j, slower = 0;
+  long size;
+
+  if (f == NULL) {
+    perror(filename);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "%15[^,],%47[^,],%ld,%lf", suite, name, &size,
+               &ms) == 4) {
+      record(&base, suite, name, size, ms, 0, NULL);
+    }
+  }
+  fclose(f);
+
+  fprintf(stderr, "%-10s %-24s %8s %12s %12s %8s\n", "suite", "name", "size",
+          "base ms", "ms", "change");
+  for (i = 0; i < log->count; i++) {
+    r = &log->rows[i];
+    for (j = 0, b = NULL; j < base.count && b == NULL; j++) {
+      if (strcmp(base.rows[j].suite, r->suite) == 0 &&
+          strcmp(base.rows[j].name, r->name) == 0 &&
+          base.rows[j].size == r->size) {
+        b = &base.rows[j];
+      }
+    }
+    if (b == NULL || b->ms <= 0) {
+      continue;
+    }
+    change = (r->ms - b->ms) / b->ms * 100;
+    fprintf(stderr, "%-10s %-24s %8ld %12.3f %12.3f %+7.1f%%%s\n", r->suite,
+            r->name, r->size, b->ms, r->ms, change,
+            change > tolerance ? "  slower" : "");
+    slower += change > tolerance;
+  }
+  fprintf(stderr, "%d of %d cases slower than the baseline by over %.1f%%\n",
+          slower, log->count, tolerance);
+  smb_free(base.rows);
+  return slower;
+}
+
+/**
+   @brief Main entry point of the benchmark program.
+   @param argc Number of command line arguments
+   @param argv Array of command line arguments
+   @return The program's exit code.
+ */
+int main(int argc, char **argv)
+{
+  smb_ad data;
+  bench_log log = {NULL, 0, 0, 0, false};
+  char *suite, *format, *baseline;
+  double tolerance;
+  size_t size;
+  int nnon, max, slower = 0;
+  bool all;
+
+  arg_data_init(&data);
+  process_args(&data, argc - 1, argv + 1);
+  if (check_flag(&data, 'h') || check_long_flag(&data, "help")) {
+    help(argv[0]);
+    arg_data_destroy(&data);
+    return 0;
+  }
+  suite = parameter(&data, 's', "suite", "all");
+  log.repeat = atoi(parameter(&data, 'r', "repeat", "5"));
+  size = atol(parameter(&data, 'c', "corpus", "1024")) * 1024;
+  format = parameter(&data, 'f', "format", "text");
+  baseline = parameter(&data, 'b', "baseline", NULL);
+  tolerance = atof(parameter(&data, 't', "tolerance", "10"));
+  nnon = atoi(parameter(&data, 'n', "nonterminals", "32"));
+  max = atoi(parameter(&data, 'm', "max", "512"));
+  all = strcmp(suite, "all") == 0;
+  if (nnon < 1 || max < 16 || log.repeat < 1 || size < 1 ||
+      (strcmp(format, "text") != 0 && strcmp(format, "csv") != 0 &&
+       strcmp(format, "json") != 0) ||
+      (!all && strcmp(suite, "lex") != 0 && strcmp(suite, "grammar") != 0 &&
+       strcmp(suite, "cky") != 0 && strcmp(suite, "regex") != 0 &&
+       strcmp(suite, "crossover") != 0)) {
+    help(argv[0]);
+    arg_data_destroy(&data);
+    return 1;
+  }
+
+  log.quiet = strcmp(format, "text") != 0;
+  if (!log.quiet) {
+    printf("%-10s %-24s %8s %12s %14s\n", "suite", "name", "size",
+           "median ms", "rate");
+  }
+  if (all || strcmp(suite, "lex") == 0) {
+    bench_lex(&log, size);
+  }
+  if (all || strcmp(suite, "grammar") == 0) {
+    bench_grammar(&log);
+  }
+  if (all || strcmp(suite, "cky") == 0) {
+    bench_cky(&log);
+  }
+  if (all || strcmp(suite, "regex") == 0) {
+    bench_regex(&log, size);
+  }
+  if (all || strcmp(suite, "crossover") == 0) {
+    bench_crossover(&log, nnon, max);
+  }
+
+  if (strcmp(format, "csv") == 0) {
+    print_csv(&log, stdout);
+  } else if (strcmp(format, "json") == 0) {
+    print_json(&log, stdout);
+  }
+  if (baseline != NULL) {
+    slower = compare(&log, baseline, tolerance);
+  }
+  smb_free(log.rows);
+  arg_data_destroy(&data);
+  return slower != 0;
+}
@@ -0,0 +1,706 @@
+/***************************************************************************//**
+
+  @file         cky.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        CKY recognizer over bitset charts.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/base.h"
+#include "libstephen/al.h"
+#include "cky.h"
+#include "gram.h"
+
+/*
+  Return true if two bitsets have a member in common.  The loop has no early
+  exit, so that it compiles to vector instructions.
+ */
+static inline bool cky_intersects(const cky_word *restrict a,
+                                  const cky_word *restrict b, int nwords)
+{
+  cky_word acc = 0;
+  int i;
+  for (i = 0; i < nwords; i++) {
+    acc |= a[i] & b[i];
+  }
+  return acc != 0;
+}
+
+static inline bool cky_empty(const cky_word *a, int nwords)
+{
+  cky_word acc = 0;
+  int i;
+  for (i = 0; i < nwords; i++) {
+    acc |= a[i];
+  }
+  return acc == 0;
+}
+
+/*
+  Add to out every A with a rule A -> B C, where B is in left and C in right.
+  It is always inlined, so that each kernel below is a copy with nwords
+  fixed, where the loops over a bitset are unrolled into registers.
+ */
+static inline __attribute__((always_inline))
+void cky_combine_words(const cky_grammar *g, const cky_word *left,
+                       const cky_word *right, cky_word *out, int nwords)
+{
+  cky_word bits;
+  int w, b, e, a;
+
+  if (cky_empty(right, nwords)) {
+    return;
+  }
+  for (w = 0; w < nwords; w++) {
+    for (bits = left[w]; bits != 0; bits &= bits - 1) {
+      b = w * CKY_WORD_BITS + __builtin_ctzll(bits);
+      for (e = g->pair_first[b]; e < g->pair_first[b + 1]; e++) {
+        a = g->pair_lhs[e];
+        if (!cky_bit_test(out, a) &&
+            cky_intersects(g->pair_mask + e * nwords, right, nwords)) {
+          cky_bit_set(out, a);
+        }
+      }
+    }
+  }
+}
+
+static void cky_combine(const cky_grammar *g, const cky_word *left,
+                        const cky_word *right, cky_word *out)
+{
+  cky_combine_words(g, left, right, out, g->nwords);
+}
+
+#define CKY_KERNEL(name, target, nwords)                                \
+  target static void name(const cky_grammar *g, const cky_word *left,   \
+                          const cky_word *right, cky_word *out)         \
+  {                                                                     \
+    cky_combine_words(g, left, right, out, nwords);                     \
+  }
+
+CKY_KERNEL(cky_combine_1, , 1)
+CKY_KERNEL(cky_combine_2, , 2)
+CKY_KERNEL(cky_combine_4, , 4)
+CKY_KERNEL(cky_combine_8, , 8)
+
+// Wider vectors need a check that the processor has them, as well as a
+// compiler that can target them on their own.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CKY_KERNELS_X86 1
+CKY_KERNEL(cky_combine_4_avx2, __attribute__((target("avx2"))), 4)
+CKY_KERNEL(cky_combine_8_avx2, __attribute__((target("avx2"))), 8)
+CKY_KERNEL(cky_combine_8_avx512, __attribute__((target("avx512f"))), 8)
+#else
+#define CKY_KERNELS_X86 0
+#endif
+
+/*
+  Choose the combine kernel for a number of words per bitset, and the
+  processor we are running on.
+ */
+static cky_combine_fn *cky_combine_kernel(int nwords)
+{
+#if CKY_KERNELS_X86
+  __builtin_cpu_init();
+  if (nwords == 8 && __builtin_cpu_supports("avx512f")) {
+    return cky_combine_8_avx512;
+  } else if (nwords == 8 && __builtin_cpu_supports("avx2")) {
+    return cky_combine_8_avx2;
+  } else if (nwords == 4 && __builtin_cpu_supports("avx2")) {
+    return cky_combine_4_avx2;
+  }
+#endif
+  switch (nwords) {
+  case 1:
+    return cky_combine_1;
+  case 2:
+    return cky_combine_2;
+  case 4:
+    return cky_combine_4;
+  case 8:
+    return cky_combine_8;
+  default:
+    return cky_combine;
+  }
+}
+
+/**
+   @brief Compile a CNF grammar into bitset tables.
+
+   The grammar's rule index must have been built (cfg_to_cnf() does this).
+
+   @param obj Memory to initialize
+   @param gram The grammar to compile
+ */
+void cky_grammar_init(cky_grammar *obj, const cnf *gram)
+{
+  int nnon = al_length(&gram->nonterminals);
+  int nterm = al_length(&gram->terminals);
+  int b, r, a, t, ngroups = 0;
+  int *group;
+
+  obj->nnonterminals = nnon;
+  obj->nterminals = nterm;
+  obj->nwords = (nnon + CKY_WORD_BITS - 1) / CKY_WORD_BITS;
+  obj->start = gram->start;
+  obj->accepts_empty = gram->accepts_empty;
+  obj->combine = cky_combine_kernel(obj->nwords);
+
+  obj->leaf = smb_new(cky_word, nterm * obj->nwords + 1);
+  memset(obj->leaf, 0, sizeof(cky_word) * (nterm * obj->nwords + 1));
+  for (t = 0; t < nterm; t++) {
+    for (r = gram->one_first[t]; r < gram->one_first[t + 1]; r++) {
+      cky_bit_set(obj->leaf + t * obj->nwords, gram->one_lhs[r]);
+    }
+  }
+
+  // There are at most as many groups as binary rules.
+  r = gram->two_first[nnon];
+  obj->pair_first = smb_new(int, nnon + 1);
+  obj->pair_lhs = smb_new(int, r + 1);
+  obj->pair_mask = smb_new(cky_word, (r + 1) * obj->nwords);
+  memset(obj->pair_mask, 0, sizeof(cky_word) * (r + 1) * obj->nwords);
+  group = smb_new(int, nnon + 1);
+  for (a = 0; a < nnon; a++) {
+    group[a] = -1;
+  }
+
+  for (b = 0; b < nnon; b++) {
+    obj->pair_first[b] = ngroups;
+    for (r = gram->two_first[b]; r < gram->two_first[b + 1]; r++) {
+      a = gram->two_lhs[r];
+      if (group[a] < obj->pair_first[b]) {
+        group[a] = ngroups++;
+        obj->pair_lhs[group[a]] = a;
+      }
+      cky_bit_set(obj->pair_mask + group[a] * obj->nwords,
+                  gram->two_right[r]);
+    }
+  }
+  obj->pair_first[nnon] = ngroups;
+  smb_free(group);
+}
+
+/**
+   @brief Allocate and compile a CNF grammar into bitset tables.
+   @param gram The grammar to compile
+   @return The compiled grammar
+ */
+cky_grammar *cky_grammar_create(const cnf *gram)
+{
+  cky_grammar *obj = smb_new(cky_grammar, 1);
+  cky_grammar_init(obj, gram);
+  return obj;
+}
+
+/**
+   @brief Free the tables of a compiled grammar, but not the grammar itself.
+   @param obj The grammar to clean up
+ */
+void cky_grammar_destroy(cky_grammar *obj)
+{
+  smb_free(obj->leaf);
+  smb_free(obj->pair_first);
+  smb_free(obj->pair_lhs);
+  smb_free(obj->pair_mask);
+}
+
+/**
+   @brief Free a compiled grammar and its tables.
+   @param obj The grammar to delete
+ */
+void cky_grammar_delete(cky_grammar *obj)
+{
+  cky_grammar_destroy(obj);
+  smb_free(obj);
+}
+
+/*
+  Build the edges from each symbol to the others, in compressed rows: the
+  targets of s are target[first[s]] up to target[first[s+1]].  Returns first.
+ */
+static int *cky_filter_graph(int n, int nedges, const int *from,
+                             const int *to, int **target)
+{
+  int *first = smb_new(int, n + 1);
+  int i, s;
+  *target = smb_new(int, nedges + 1);
+  memset(first, 0, sizeof(int) * (n + 1));
+  for (i = 0; i < nedges; i++) {
+    first[from[i] + 1]++;
+  }
+  for (s = 0; s < n; s++) {
+    first[s + 1] += first[s];
+  }
+  for (i = 0; i < nedges; i++) {
+    (*target)[first[from[i]]++] = to[i];
+  }
+  for (s = n; s > 0; s--) {
+    first[s] = first[s - 1];
+  }
+  first[0] = 0;
+  return first;
+}
+
+/*
+  Add to a set everything reachable from it along the edges of a graph.
+ */
+static void cky_filter_close(cky_word *set, int n, const int *first,
+                             const int *target, int *queue)
+{
+  int head = 0, tail = 0, s, e;
+  for (s = 0; s < n; s++) {
+    if (cky_bit_test(set, s)) {
+      queue[tail++] = s;
+    }
+  }
+  while (head < tail) {
+    s = queue[head++];
+    for (e = first[s]; e < first[s + 1]; e++) {
+      if (!cky_bit_test(set, target[e])) {
+        cky_bit_set(set, target[e]);
+        queue[tail++] = target[e];
+      }
+    }
+  }
+}
+
+/*
+  Fill one side of a filter.  Taking the end side, where `near` is the right
+  child C of each rule A -> B C and `far` the left child B: the symbols that
+  begin with terminal t are its leaves and, going up through far children,
+  their parents.  Each rule whose near child begins with t lets its far child
+  end before t, and then so can every near child down from that.  The begin
+  side is the mirror image.  The sentence's edge is next to the start symbol
+  and everything down from it.
+ */
+static void cky_filter_side(const cky_grammar *gram, cky_word *rows,
+                            int nrules, const int *lhs, const int *near,
+                            const int *far, int *queue)
+{
+  int nnon = gram->nnonterminals, nw = gram->nwords, t, r;
+  int *up_target, *down_target;
+  int *up = cky_filter_graph(nnon, nrules, far, lhs, &up_target);
+  int *down = cky_filter_graph(nnon, nrules, lhs, near, &down_target);
+  cky_word *corner = smb_new(cky_word, nw), *row;
+
+  for (t = 0; t < gram->nterminals; t++) {
+    memcpy(corner, gram->leaf + t * nw, sizeof(cky_word) * nw);
+    cky_filter_close(corner, nnon, up, up_target, queue);
+    row = rows + t * nw;
+    for (r = 0; r < nrules; r++) {
+      if (cky_bit_test(corner, near[r])) {
+        cky_bit_set(row, far[r]);
+      }
+    }
+    cky_filter_close(row, nnon, down, down_target, queue);
+  }
+  if (gram->start >= 0) {
+    row = rows + gram->nterminals * nw;
+    cky_bit_set(row, gram->start);
+    cky_filter_close(row, nnon, down, down_target, queue);
+  }
+
+  smb_free(up);
+  smb_free(up_target);
+  smb_free(down);
+  smb_free(down_target);
+  smb_free(corner);
+}
+
+/**
+   @brief Compute the filter of a compiled grammar.
+   @param obj Memory to initialize
+   @param gram The compiled grammar
+ */
+void cky_filter_init(cky_filter *obj, const cky_grammar *gram)
+{
+  int nnon = gram->nnonterminals, nw = gram->nwords, nrules = 0, b, e, w, r;
+  size_t size = (size_t) (gram->nterminals + 2) * nw;
+  int *lhs, *left, *right, *queue;
+  cky_word bits;
+
+  obj->nterminals = gram->nterminals;
+  obj->nwords = nw;
+  obj->begin = smb_new(cky_word, size);
+  obj->end = smb_new(cky_word, size);
+  memset(obj->begin, 0, sizeof(cky_word) * size);
+  memset(obj->end, 0, sizeof(cky_word) * size);
+
+  // Every rule A -> B C, one at a time.
+  for (e = 0; e < gram->pair_first[nnon]; e++) {
+    for (w = 0; w < nw; w++) {
+      nrules += __builtin_popcountll(gram->pair_mask[e * nw + w]);
+    }
+  }
+  lhs = smb_new(int, nrules + 1);
+  left = smb_new(int, nrules + 1);
+  right = smb_new(int, nrules + 1);
+  for (b = 0, r = 0; b < nnon; b++) {
+    for (e = gram->pair_first[b]; e < gram->pair_first[b + 1]; e++) {
+      for (w = 0; w < nw; w++) {
+        for (bits = gram->pair_mask[e * nw + w]; bits != 0;
+             bits &= bits - 1) {
+          lhs[r] = gram->pair_lhs[e];
+          left[r] = b;
+          right[r] = w * CKY_WORD_BITS + __builtin_ctzll(bits);
+          r++;
+        }
+      }
+    }
+  }
+
+  // B ends before whatever C begins with, and C begins after whatever B ends
+  // with.
+  queue = smb_new(int, nnon + 1);
+  cky_filter_side(gram, obj->end, nrules, lhs, right, left, queue);
+  cky_filter_side(gram, obj->begin, nrules, lhs, left, right, queue);
+
+  smb_free(lhs);
+  smb_free(left);
+  smb_free(right);
+  smb_free(queue);
+}
+
+/**
+   @brief Allocate and compute the filter of a compiled grammar.
+   @param gram The compiled grammar
+   @return The new filter
+ */
+cky_filter *cky_filter_create(const cky_grammar *gram)
+{
+  cky_filter *obj = smb_new(cky_filter, 1);
+  cky_filter_init(obj, gram);
+  return obj;
+}
+
+/**
+   @brief Free a filter's rows, but not the filter itself.
+   @param obj The filter to clean up
+ */
+void cky_filter_destroy(cky_filter *obj)
+{
+  smb_free(obj->begin);
+  smb_free(obj->end);
+}
+
+/**
+   @brief Free a filter and its rows.
+   @param obj The filter to delete
+ */
+void cky_filter_delete(cky_filter *obj)
+{
+  cky_filter_destroy(obj);
+  smb_free(obj);
+}
+
+/**
+   @brief Initialize a chart with room for input up to a given length.
+   @param obj Memory to initialize
+   @param gram The compiled grammar to parse with
+   @param capacity The longest input to make room for
+ */
+void cky_chart_init(cky_chart *obj, const cky_grammar *gram, int capacity)
+{
+  obj->gram = gram;
+  obj->length = 0;
+  obj->capacity = 0;
+  obj->cells = NULL;
+  obj->filter = NULL;
+  obj->around = NULL;
+  cky_chart_reserve(obj, capacity);
+}
+
+/**
+   @brief Allocate and initialize a chart.
+   @param gram The compiled grammar to parse with
+   @param capacity The longest input to make room for
+   @return The new chart
+ */
+cky_chart *cky_chart_create(const cky_grammar *gram, int capacity)
+{
+  cky_chart *obj = smb_new(cky_chart, 1);
+  cky_chart_init(obj, gram, capacity);
+  return obj;
+}
+
+/**
+   @brief Free a chart's cells, but not the chart itself.
+   @param obj The chart to clean up
+ */
+void cky_chart_destroy(cky_chart *obj)
+{
+  smb_free(obj->cells);
+  smb_free(obj->around);
+}
+
+/**
+   @brief Free a chart and its cells.
+   @param obj The chart to delete
+ */
+void cky_chart_delete(cky_chart *obj)
+{
+  cky_chart_destroy(obj);
+  smb_free(obj);
+}
+
+/**
+   @brief Make sure a chart has room for input of a given length.
+
+   The layout depends on the capacity, so growing a chart discards its cells.
+   Capacity grows at least by doubling, so a stream of ever longer inputs only
+   reallocates a logarithmic number of times.
+
+   @param obj The chart
+   @param capacity The longest input to make room for
+ */
+void cky_chart_reserve(cky_chart *obj, int capacity)
+{
+  size_t ncells;
+  if (capacity <= obj->capacity && obj->cells != NULL) {
+    return;
+  }
+  if (capacity < 2 * obj->capacity) {
+    capacity = 2 * obj->capacity;
+  }
+  ncells = cky_chart_offset(capacity, capacity) + 1;
+  smb_free(obj->cells);
+  obj->cells = smb_new(cky_word, ncells * obj->gram->nwords + 1);
+  obj->around = smb_renew(int, obj->around, capacity + 2);
+  obj->capacity = capacity;
+  obj->length = 0;
+}
+
+/**
+   @brief Filter the cells of a chart as they are filled, or stop filtering.
+
+   A filtered cell keeps only the nonterminals that can be next to the tokens
+   on either side of its span, so the chart accepts the same sentences and
+   holds the same parses, with fewer dead ends for longer spans to combine.
+   The setting applies from the next sentence filled in.
+
+   @param obj The chart
+   @param filter The filter of the chart's grammar, which must outlive the
+   chart, or NULL
+ */
+void cky_chart_set_filter(cky_chart *obj, const cky_filter *filter)
+{
+  obj->filter = filter;
+}
+
+/*
+  Find the two filter rows a cell of a filtered chart is masked with.
+ */
+static inline void cky_chart_allowed(const cky_chart *obj, int start,
+                                     int length, const cky_word **begin,
+                                     const cky_word **end)
+{
+  const cky_filter *f = obj->filter;
+  *begin = f->begin + obj->around[start] * f->nwords;
+  *end = f->end + obj->around[start + length + 1] * f->nwords;
+}
+
+/**
+   @brief Start filling a chart: store a sentence's length and its leaves.
+
+   The chart grows if the sentence is longer than its capacity.  Afterwards,
+   every longer span can be filled with cky_chart_span(), diagonal by diagonal.
+
+   @param obj The chart
+   @param tokens The terminal index of each token.  Negative values stand for
+   tokens that aren't terminals of the grammar, which nothing derives.
+   @param length Number of tokens
+ */
+void cky_chart_leaves(cky_chart *obj, const int *tokens, int length)
+{
+  const cky_grammar *g = obj->gram;
+  const cky_word *begin, *end;
+  cky_word *cell;
+  int i, w;
+  bool known;
+
+  cky_chart_reserve(obj, length);
+  obj->length = length;
+  obj->around[0] = obj->around[length + 1] = g->nterminals;
+  for (i = 0; i < length; i++) {
+    known = tokens[i] >= 0 && tokens[i] < g->nterminals;
+    obj->around[i + 1] = known ? tokens[i] : g->nterminals + 1;
+  }
+  for (i = 0; i < length; i++) {
+    cell = cky_chart_cell(obj, i, 1);
+    if (tokens[i] >= 0 && tokens[i] < g->nterminals) {
+      memcpy(cell, g->leaf + tokens[i] * g->nwords,
+             sizeof(cky_word) * g->nwords);
+    } else {
+      memset(cell, 0, sizeof(cky_word) * g->nwords);
+    }
+    if (obj->filter != NULL) {
+      cky_chart_allowed(obj, i, 1, &begin, &end);
+      for (w = 0; w < g->nwords; w++) {
+        cell[w] &= begin[w] & end[w];
+      }
+    }
+  }
+}
+
+/**
+   @brief Fill one cell of a chart from the shorter spans within it.
+
+   Only cells of shorter spans are read, and only this cell is written, so the
+   cells of one diagonal may be filled in any order, or at the same time.
+
+   @param obj The chart
+   @param start Index of the first token of the span
+   @param length Number of tokens in the span, at least two
+ */
+void cky_chart_span(cky_chart *obj, int start, int length)
+{
+  const cky_grammar *g = obj->gram;
+  cky_word *cell = cky_chart_cell(obj, start, length);
+  const cky_word *begin = NULL, *end = NULL;
+  cky_word none = 0;
+  int k, w;
+
+  if (obj->filter == NULL) {
+    memset(cell, 0, sizeof(cky_word) * g->nwords);
+  } else {
+    // Nonterminals the filter drops start out as if already derived, so that
+    // their rules are never tried.
+    cky_chart_allowed(obj, start, length, &begin, &end);
+    for (w = 0; w < g->nwords; w++) {
+      cell[w] = ~(begin[w] & end[w]);
+      none |= ~cell[w];
+    }
+    if (none == 0) {
+      memset(cell, 0, sizeof(cky_word) * g->nwords);
+      return;
+    }
+  }
+  for (k = 1; k < length; k++) {
+    g->combine(g, cky_chart_cell(obj, start, k),
+                cky_chart_cell(obj, start + k, length - k), cell);
+  }
+  if (obj->filter != NULL) {
+    for (w = 0; w < g->nwords; w++) {
+      cell[w] &= begin[w] & end[w];
+    }
+  }
+}
+
+/**
+   @brief Return true if the grammar derives the whole of a filled chart.
+   @param obj The filled chart
+ */
+bool cky_chart_accepts(const cky_chart *obj)
+{
+  const cky_grammar *g = obj->gram;
+  if (obj->length == 0) {
+    return g->accepts_empty;
+  }
+  return g->start >= 0 &&
+    cky_bit_test(cky_chart_cell(obj, 0, obj->length), g->start);
+}
+
+/**
+   @brief Fill a chart from a sentence of terminals.
+   @param obj The chart
+   @param tokens The terminal index of each token
+   @param length Number of tokens
+   @return True if the grammar's start symbol derives the sentence.
+   @see cky_chart_leaves
+ */
+bool cky_chart_fill(cky_chart *obj, const int *tokens, int length)
+{
+  int len, i;
+
+  cky_chart_leaves(obj, tokens, length);
+  for (len = 2; len <= length; len++) {
+    for (i = 0; i + len <= length; i++) {
+      cky_chart_span(obj, i, len);
+    }
+  }
+  return cky_chart_accepts(obj);
+}
+
+/**
+   @brief Fill a chart for an edited sentence, reusing the cells of the old one.
+
+   The new sentence is the old one with `removed` tokens at `first` replaced
+   by `added` others.  A span that lies wholly before or wholly after the
+   replaced tokens covers the same terminals as before, so its cell is copied
+   from the old chart, shifted to its new start.  In a filtered chart a cell
+   also depends on the tokens on either side of it, so the spans next to the
+   replacement are filled again too.  Only the cells of spans that
+   overlap the replacement are filled again, which for a small edit of a long
+   sentence is a thin band of the triangle rather than all of it.
+
+   @param obj The chart to fill, which must not be old
+   @param old A chart filled with the sentence before the edit
+   @param tokens The terminal index of each token of the new sentence
+   @param length Number of tokens in the new sentence
+   @param first Index of the first token replaced
+   @param removed Number of tokens of the old sentence replaced
+   @param added Number of tokens that replace them
+   @return True if the grammar's start symbol derives the new sentence.
+ */
+bool cky_chart_edit(cky_chart *obj, const cky_chart *old, const int *tokens,
+                    int length, int first, int removed, int added)
+{
+  const cky_grammar *g = obj->gram;
+  size_t size = sizeof(cky_word) * g->nwords;
+  int len, i, before, after, shift = removed - added;
+  int margin = obj->filter != NULL;
+
+  assert(old != obj && old->length == length + shift);
+  assert(old->filter == obj->filter);
+  cky_chart_leaves(obj, tokens, length);
+  for (len = 2; len <= length; len++) {
+    // Spans starting before `before` end by `first`, and spans starting at
+    // `after` or later begin after the added tokens.
+    before = first - len + 1 - margin;
+    before = before < 0 ? 0 : before;
+    after = first + added + margin;
+    if (before > 0) {
+      memcpy(cky_chart_cell(obj, 0, len), cky_chart_cell(old, 0, len),
+             size * before);
+    }
+    if (after + len > length) {
+      after = length - len + 1;
+    } else {
+      memcpy(cky_chart_cell(obj, after, len),
+             cky_chart_cell(old, after + shift, len),
+             size * (length - len + 1 - after));
+    }
+    for (i = before; i < after; i++) {
+      cky_chart_span(obj, i, len);
+    }
+  }
+  return cky_chart_accepts(obj);
+}
+
+/**
+   @brief Return true if a grammar derives a sentence of terminals.
+   @param gram The compiled grammar
+   @param tokens The terminal index of each token
+   @param length Number of tokens
+ */
+bool cky_recognize(const cky_grammar *gram, const int *tokens, int length)
+{
+  cky_chart chart;
+  bool result;
+  cky_chart_init(&chart, gram, length);
+  result = cky_chart_fill(&chart, tokens, length);
+  cky_chart_destroy(&chart);
+  return result;
+}
@@ -0,0 +1,278 @@
+/***************************************************************************//**
+
+  @file         cky.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        CKY recognizer over bitset charts.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_CKY_H
+#define SMB_CKY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gram.h"
+
+/**
+   @brief One word of a bitset of nonterminals.
+ */
+typedef uint64_t cky_word;
+
+/**
+   @brief Number of nonterminals in one cky_word.
+ */
+#define CKY_WORD_BITS 64
+
+struct cky_grammar;
+
+/**
+   @brief A kernel adding to `out` every `A` with a rule `A -> B C`, where `B`
+   is in `left` and `C` is in `right`.
+ */
+typedef void cky_combine_fn(const struct cky_grammar *g, const cky_word *left,
+                            const cky_word *right, cky_word *out);
+
+/**
+   @brief A CNF grammar, compiled into tables of bitsets for the recognizer.
+
+   Every set of nonterminals is a bitset of cky_grammar.nwords words.  The
+   binary rules are grouped by their first symbol `B`, and then by their left
+   hand side `A`: each group has a mask of every `C` with a rule `A -> B C`.
+   So a cell derives `A` from children `L` and `R` when some `B` in `L` has a
+   group for `A` whose mask intersects `R`.
+
+   @see cky_grammar_create
+ */
+typedef struct cky_grammar {
+
+  /**
+     @brief Number of nonterminals.
+   */
+  int nnonterminals;
+
+  /**
+     @brief Number of terminals.
+   */
+  int nterminals;
+
+  /**
+     @brief Number of words in each bitset.
+   */
+  int nwords;
+
+  /**
+     @brief The start symbol.
+   */
+  int start;
+
+  /**
+     @brief True if the grammar generates the empty string.
+   */
+  bool accepts_empty;
+
+  /**
+     @brief For each terminal, the bitset of nonterminals that derive it.
+   */
+  cky_word *leaf;
+
+  /**
+     @brief The groups for `B` are `pair_first[B]` up to `pair_first[B+1]`.
+   */
+  int *pair_first;
+
+  /**
+     @brief The left hand side `A` of each group.
+   */
+  int *pair_lhs;
+
+  /**
+     @brief The mask of right symbols `C` of each group, nwords per group.
+   */
+  cky_word *pair_mask;
+
+  /**
+     @brief The kernel that combines two children into a cell.
+
+     Chosen by cky_grammar_init() for nwords and the processor: there are
+     kernels for one, two, four and eight words, and a loop for any other.
+   */
+  cky_combine_fn *combine;
+
+} cky_grammar;
+
+/**
+   @brief Which nonterminals can be found next to each terminal, in any
+   derivation of the start symbol.
+
+   A nonterminal can only be part of a parse of the whole sentence in the
+   cells whose neighbours it can be next to.  The cell of a span from `i` up to
+   `j` only needs the nonterminals that can begin after token `i - 1` and end
+   before token `j`, where the sentence's two ends count as a terminal of
+   their own.  Every part of a nonterminal's derivation passes this test
+   whenever the nonterminal does, so filtering each cell as it is filled keeps
+   every parse, and leaves the chart sparser for the spans built on it.
+
+   The relations come from the grammar's left and right corners: a
+   nonterminal `B` of a rule `A -> B C` can end before the first terminal of
+   anything `C` derives, and whatever can end `A` can end `C`.  Likewise for
+   what can begin `C`, from the last terminals of `B`.
+
+   Each row is a bitset of cky_grammar.nwords words.  Row
+   cky_filter.nterminals is the end of the sentence, and the row after it is
+   empty, for tokens that aren't terminals of the grammar.
+
+   @see cky_filter_init
+   @see cky_chart_set_filter
+ */
+typedef struct {
+
+  /**
+     @brief Number of terminals of the grammar.
+   */
+  int nterminals;
+
+  /**
+     @brief Number of words in each bitset.
+   */
+  int nwords;
+
+  /**
+     @brief For each terminal, the nonterminals that can begin right after it.
+   */
+  cky_word *begin;
+
+  /**
+     @brief For each terminal, the nonterminals that can end right before it.
+   */
+  cky_word *end;
+
+} cky_filter;
+
+/**
+   @brief A CKY chart: the set of nonterminals deriving each span of input.
+
+   The cells are one triangular array, ordered by span length and then by
+   start: all the spans of length one, then all the spans of length two, and
+   so on.  Filling a diagonal therefore writes one contiguous run of memory,
+   and reads the shorter diagonals as contiguous runs too.  The layout is
+   sized for cky_chart.capacity tokens, so a chart can be reused for any
+   input up to that length without reallocating.
+
+   @see cky_chart_init
+   @see cky_chart_cell
+ */
+typedef struct {
+
+  /**
+     @brief The grammar the chart is filled with.
+   */
+  const cky_grammar *gram;
+
+  /**
+     @brief Number of tokens of the input most recently filled in.
+   */
+  int length;
+
+  /**
+     @brief The longest input the cells have room for.
+   */
+  int capacity;
+
+  /**
+     @brief The bitsets of every cell.
+   */
+  cky_word *cells;
+
+  /**
+     @brief The filter applied to each cell as it is filled, or NULL.
+   */
+  const cky_filter *filter;
+
+  /**
+     @brief The filter row of each token, with the sentence's ends on either
+     side: token `i` is at `i + 1`.
+   */
+  int *around;
+
+} cky_chart;
+
+void cky_grammar_init(cky_grammar *obj, const cnf *gram);
+cky_grammar *cky_grammar_create(const cnf *gram);
+void cky_grammar_destroy(cky_grammar *obj);
+void cky_grammar_delete(cky_grammar *obj);
+
+void cky_filter_init(cky_filter *obj, const cky_grammar *gram);
+cky_filter *cky_filter_create(const cky_grammar *gram);
+void cky_filter_destroy(cky_filter *obj);
+void cky_filter_delete(cky_filter *obj);
+
+void cky_chart_init(cky_chart *obj, const cky_grammar *gram, int capacity);
+cky_chart *cky_chart_create(const cky_grammar *gram, int capacity);
+void cky_chart_destroy(cky_chart *obj);
+void cky_chart_delete(cky_chart *obj);
+
+void cky_chart_reserve(cky_chart *obj, int capacity);
+void cky_chart_set_filter(cky_chart *obj, const cky_filter *filter);
+void cky_chart_leaves(cky_chart *obj, const int *tokens, int length);
+void cky_chart_span(cky_chart *obj, int start, int length);
+bool cky_chart_accepts(const cky_chart *obj);
+bool cky_chart_fill(cky_chart *obj, const int *tokens, int length);
+bool cky_chart_edit(cky_chart *obj, const cky_chart *old, const int *tokens,
+                    int length, int first, int removed, int added);
+bool cky_recognize(const cky_grammar *gram, const int *tokens, int length);
+
+/**
+   @brief Return true if a bitset contains a nonterminal.
+   @param set The bitset
+   @param symbol The nonterminal
+ */
+static inline bool cky_bit_test(const cky_word *set, int symbol)
+{
+  return (set[symbol / CKY_WORD_BITS] >> (symbol % CKY_WORD_BITS)) & 1;
+}
+
+/**
+   @brief Add a nonterminal to a bitset.
+   @param set The bitset
+   @param symbol The nonterminal
+ */
+static inline void cky_bit_set(cky_word *set, int symbol)
+{
+  set[symbol / CKY_WORD_BITS] |= (cky_word) 1 << (symbol % CKY_WORD_BITS);
+}
+
+/**
+   @brief Return the number of cells before the spans of a given length.
+   @param capacity The chart's capacity
+   @param length A span length, at least one
+ */
+static inline size_t cky_chart_offset(int capacity, int length)
+{
+  size_t l = length - 1;
+  return l * capacity - l * (l - 1) / 2;
+}
+
+/**
+   @brief Return the bitset of nonterminals deriving a span of the input.
+   @param obj The chart
+   @param start Index of the first token of the span
+   @param length Number of tokens in the span, at least one
+   @return The cell's bitset, of cky_grammar.nwords words.
+ */
+static inline cky_word *cky_chart_cell(const cky_chart *obj, int start,
+                                       int length)
+{
+  size_t index = cky_chart_offset(obj->capacity, length) + start;
+  return obj->cells + index * obj->gram->nwords;
+}
+
+#endif//SMB_CKY_H
@@ -0,0 +1,1163 @@
+/***************************************************************************//**
+
+  @file         cnf.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Conversion of context-free grammars to Chomsky normal form.
+
+  The conversion is the usual sequence of transformations:
+
+  - START: add a new start symbol, which derives the old one.
+  - TERM: replace terminals in long right hand sides with new nonterminals.
+  - BIN: split long right hand sides into chains of binary rules.
+  - DEL: remove epsilon rules, adding copies of rules without nullable symbols.
+  - UNIT: remove A->B rules, giving A copies of B's rules instead.
+
+  The result is then made smaller:
+
+  - PRUNE: remove symbols that derive no string, or that the start symbol
+    never reaches.
+  - MERGE: replace each nonterminal added by the conversion with an earlier
+    one that derives the same strings by the same rules.
+  - ORDER: number the nonterminals so that ones deriving the same right hand
+    sides, which fill the same chart cells, are next to each other.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libstephen/base.h"
+#include "libstephen/al.h"
+#include "libstephen/ht.h"
+#include "cnf.h"
+#include "dfa.h"
+#include "gram.h"
+
+/*
+  A rule during conversion.  After BIN, no rule has more than two symbols.
+ */
+typedef struct {
+  int lhs;
+  int len;
+  int rhs[2];
+  double weight;
+} cnf_work_rule;
+
+/*
+  The grammar during conversion.  Symbols are numbered as in the source
+  grammar, and new symbols are added after them.
+ */
+typedef struct {
+  smb_al names;      // char*, borrowed from the source or in new_names
+  smb_al new_names;  // char*, allocated here
+  smb_ht index;      // name -> symbol number
+  bool *terminal;
+  int nsymbols;
+  int capacity;
+  int counter;       // for numbering new symbols
+  cnf_work_rule *rules;
+  int nrules;
+  int rule_cap;
+} cnf_builder;
+
+static int cnf_builder_symbol(cnf_builder *b, char *name, bool terminal)
+{
+  if (b->nsymbols == b->capacity) {
+    b->capacity *= 2;
+    b->terminal = smb_renew(bool, b->terminal, b->capacity);
+  }
+  b->terminal[b->nsymbols] = terminal;
+  al_append(&b->names, (DATA){.data_ptr=name});
+  ht_insert(&b->index, (DATA){.data_ptr=name}, (DATA){.data_llint=b->nsymbols});
+  return b->nsymbols++;
+}
+
+/*
+  Add a new nonterminal named after an existing symbol.  Primes are added to
+  the name until it is different from every other symbol's.
+ */
+static int cnf_builder_fresh(cnf_builder *b, int base, const char *suffix)
+{
+  smb_status status = SMB_SUCCESS;
+  const char *name = al_get(&b->names, base, &status).data_ptr;
+  char number[16] = "";
+  size_t length;
+  char *fresh;
+
+  if (suffix == NULL) {
+    sprintf(number, "_%d", ++b->counter);
+    suffix = number;
+  }
+  length = strlen(name) + strlen(suffix);
+  fresh = smb_new(char, length + 1);
+  sprintf(fresh, "%s%s", name, suffix);
+  while (ht_contains(&b->index, (DATA){.data_ptr=fresh})) {
+    fresh = smb_renew(char, fresh, ++length + 1);
+    strcat(fresh, "'");
+  }
+  al_append(&b->new_names, (DATA){.data_ptr=fresh});
+  return cnf_builder_symbol(b, fresh, false);
+}
+
+static void cnf_builder_rule(cnf_builder *b, int lhs, int len, int r0, int r1,
+                             double weight)
+{
+  cnf_work_rule *rule;
+  if (b->nrules == b->rule_cap) {
+    b->rule_cap *= 2;
+    b->rules = smb_renew(cnf_work_rule, b->rules, b->rule_cap);
+  }
+  rule = &b->rules[b->nrules++];
+  rule->lhs = lhs;
+  rule->len = len;
+  rule->rhs[0] = r0;
+  rule->rhs[1] = r1;
+  rule->weight = weight;
+}
+
+static void cnf_builder_destroy(cnf_builder *b)
+{
+  smb_status status = SMB_SUCCESS;
+  int i;
+  for (i = 0; i < al_length(&b->new_names); i++) {
+    smb_free(al_get(&b->new_names, i, &status).data_ptr);
+  }
+  al_destroy(&b->names);
+  al_destroy(&b->new_names);
+  ht_destroy(&b->index);
+  smb_free(b->terminal);
+  smb_free(b->rules);
+}
+
+/*
+  TERM and BIN: copy the source rules, making every rule's right hand side
+  either one symbol, two nonterminals, or empty.
+ */
+static void cnf_split_rules(cnf_builder *b, cfg *src, smb_status *status)
+{
+  int nsource = b->nsymbols, i, j, prev, next;
+  int *wrap = smb_new(int, nsource);
+  int *rhs = NULL;
+  cfg_rule *rule;
+
+  for (i = 0; i < nsource; i++) {
+    wrap[i] = CFG_SYMBOL_NONE;
+  }
+
+  for (i = 0; i < cfg_num_rules(src); i++) {
+    rule = cfg_get_rule(src, i);
+    if (b->terminal[rule->lhs]) {
+      *status = SMB_INDEX_ERROR;
+      break;
+    }
+    if (rule->rhs_len <= 1) {
+      cnf_builder_rule(b, rule->lhs, rule->rhs_len,
+                       rule->rhs_len ? rule->rhs[0] : CFG_SYMBOL_NONE,
+                       CFG_SYMBOL_NONE, rule->weight);
+      continue;
+    }
+
+    // TERM: a terminal in a long rule is derived from a new nonterminal.
+    rhs = smb_renew(int, rhs, rule->rhs_len);
+    for (j = 0; j < rule->rhs_len; j++) {
+      rhs[j] = rule->rhs[j];
+      if (b->terminal[rhs[j]]) {
+        if (wrap[rhs[j]] == CFG_SYMBOL_NONE) {
+          wrap[rhs[j]] = cnf_builder_fresh(b, rhs[j], "'");
+          cnf_builder_rule(b, wrap[rhs[j]], 1, rhs[j], CFG_SYMBOL_NONE, 0);
+        }
+        rhs[j] = wrap[rhs[j]];
+      }
+    }
+
+    // BIN: A -> X1 X2 ... Xn becomes A -> X1 A_1, A_1 -> X2 A_2, and so on.
+    // The first rule of the chain carries the weight.
+    prev = rule->lhs;
+    for (j = 0; j < rule->rhs_len - 2; j++) {
+      next = cnf_builder_fresh(b, rule->lhs, NULL);
+      cnf_builder_rule(b, prev, 2, rhs[j], next, j == 0 ? rule->weight : 0);
+      prev = next;
+    }
+    cnf_builder_rule(b, prev, 2, rhs[j], rhs[j + 1], j == 0 ? rule->weight : 0);
+  }
+
+  smb_free(rhs);
+  smb_free(wrap);
+}
+
+/*
+  DEL: find the nullable symbols, and replace each rule with the versions of
+  it that leave out nullable symbols.  Returns the weight of each symbol's best
+  derivation of the empty string, or -HUGE_VAL for symbols that aren't
+  nullable.  A version that leaves out a symbol adds that symbol's weight.
+ */
+static double *cnf_remove_empty(cnf_builder *b)
+{
+  double *empty = smb_new(double, b->nsymbols);
+  bool changed = true;
+  cnf_work_rule *old = b->rules, *r;
+  int i, round, nold = b->nrules;
+  double w;
+
+  for (i = 0; i < b->nsymbols; i++) {
+    empty[i] = -HUGE_VAL;
+  }
+  // Weights are log probabilities, so no derivation improves by repeating a
+  // symbol, and every best derivation is found within nsymbols rounds.
+  for (round = 0; changed && round <= b->nsymbols; round++) {
+    changed = false;
+    for (i = 0; i < nold; i++) {
+      r = &old[i];
+      w = r->weight;
+      if (r->len >= 1) {
+        w += empty[r->rhs[0]];
+      }
+      if (r->len == 2) {
+        w += empty[r->rhs[1]];
+      }
+      if (w > empty[r->lhs]) {
+        empty[r->lhs] = w;
+        changed = true;
+      }
+    }
+  }
+
+  b->nrules = 0;
+  b->rule_cap = nold + 16;
+  b->rules = smb_new(cnf_work_rule, b->rule_cap);
+  for (i = 0; i < nold; i++) {
+    r = &old[i];
+    if (r->len == 0) {
+      continue;
+    }
+    cnf_builder_rule(b, r->lhs, r->len, r->rhs[0], r->rhs[1], r->weight);
+    if (r->len == 2 && empty[r->rhs[0]] > -HUGE_VAL) {
+      cnf_builder_rule(b, r->lhs, 1, r->rhs[1], CFG_SYMBOL_NONE,
+                       r->weight + empty[r->rhs[0]]);
+    }
+    if (r->len == 2 && empty[r->rhs[1]] > -HUGE_VAL) {
+      cnf_builder_rule(b, r->lhs, 1, r->rhs[0], CFG_SYMBOL_NONE,
+                       r->weight + empty[r->rhs[1]]);
+    }
+  }
+  smb_free(old);
+  return empty;
+}
+
+static bool cnf_is_unit(const cnf_builder *b, const cnf_work_rule *r)
+{
+  return r->len == 1 && !b->terminal[r->rhs[0]];
+}
+
+/*
+  UNIT: for every A, and every B that A derives through unit rules alone, give
+  A each non-unit rule of B, weighted by the best chain of unit rules from A to
+  B.  The unit rules are then dropped.
+ */
+static void cnf_remove_units(cnf_builder *b)
+{
+  int n = b->nsymbols, i, k, a, s, t, top, nreached;
+  int *first = smb_new(int, n + 1);
+  int *order = smb_new(int, b->nrules + 1);
+  int *mark = smb_new(int, n);
+  int *stack = smb_new(int, n);
+  int *pending = smb_new(int, n);
+  int *reached = smb_new(int, n);
+  double *best = smb_new(double, n);
+  cnf_work_rule *old = b->rules, *r;
+  int nold = b->nrules;
+  double w;
+
+  // Group the rules by left hand side.
+  memset(first, 0, sizeof(int) * (n + 1));
+  for (i = 0; i < nold; i++) {
+    first[old[i].lhs + 1]++;
+  }
+  for (i = 0; i < n; i++) {
+    first[i + 1] += first[i];
+  }
+  for (i = 0; i < n; i++) {
+    mark[i] = first[i];
+  }
+  for (i = 0; i < nold; i++) {
+    order[mark[old[i].lhs]++] = i;
+  }
+
+  b->nrules = 0;
+  b->rule_cap = nold + 16;
+  b->rules = smb_new(cnf_work_rule, b->rule_cap);
+  for (i = 0; i < n; i++) {
+    mark[i] = -1;
+    pending[i] = -1;
+  }
+  for (a = 0; a < n; a++) {
+    if (b->terminal[a] || first[a] == first[a + 1]) {
+      continue;
+    }
+    // Search the unit rules from a, revisiting a symbol whenever a better
+    // chain to it is found.  Weights are never positive, so this ends.
+    stack[0] = a;
+    mark[a] = a;
+    pending[a] = a;
+    best[a] = 0;
+    reached[0] = a;
+    nreached = 1;
+    top = 1;
+    while (top > 0) {
+      s = stack[--top];
+      pending[s] = -1;
+      for (k = first[s]; k < first[s + 1]; k++) {
+        r = &old[order[k]];
+        if (!cnf_is_unit(b, r)) {
+          continue;
+        }
+        t = r->rhs[0];
+        w = best[s] + r->weight;
+        if (mark[t] != a) {
+          mark[t] = a;
+          reached[nreached++] = t;
+        } else if (w <= best[t]) {
+          continue;
+        }
+        best[t] = w;
+        if (pending[t] != a) {
+          pending[t] = a;
+          stack[top++] = t;
+        }
+      }
+    }
+    for (i = 0; i < nreached; i++) {
+      s = reached[i];
+      for (k = first[s]; k < first[s + 1]; k++) {
+        r = &old[order[k]];
+        if (!cnf_is_unit(b, r)) {
+          cnf_builder_rule(b, a, r->len, r->rhs[0], r->rhs[1],
+                           best[s] + r->weight);
+        }
+      }
+    }
+  }
+
+  smb_free(old);
+  smb_free(first);
+  smb_free(order);
+  smb_free(mark);
+  smb_free(stack);
+  smb_free(pending);
+  smb_free(reached);
+  smb_free(best);
+}
+
+static int cnf_work_compare(const void *a, const void *b)
+{
+  const cnf_work_rule *r1 = a, *r2 = b;
+  if (r1->lhs != r2->lhs) {
+    return r1->lhs < r2->lhs ? -1 : 1;
+  } else if (r1->len != r2->len) {
+    return r1->len < r2->len ? -1 : 1;
+  } else if (r1->rhs[0] != r2->rhs[0]) {
+    return r1->rhs[0] < r2->rhs[0] ? -1 : 1;
+  }
+  return r1->rhs[1] < r2->rhs[1] ? -1 : r1->rhs[1] > r2->rhs[1];
+}
+
+/*
+  Sort the rules, and merge copies of the same rule, keeping the best weight.
+  Unit removal can copy the same rule to a symbol more than once.
+ */
+static void cnf_dedup(cnf_builder *b)
+{
+  int i, n = 0;
+  qsort(b->rules, b->nrules, sizeof(cnf_work_rule), &cnf_work_compare);
+  for (i = 0; i < b->nrules; i++) {
+    if (n > 0 && cnf_work_compare(&b->rules[i], &b->rules[n - 1]) == 0) {
+      if (b->rules[i].weight > b->rules[n - 1].weight) {
+        b->rules[n - 1].weight = b->rules[i].weight;
+      }
+    } else {
+      b->rules[n++] = b->rules[i];
+    }
+  }
+  b->nrules = n;
+}
+
+/*
+  Return the number of nonterminals used by the rules, counting the start
+  symbol even if it has none.
+ */
+static int cnf_count_nonterminals(const cnf_builder *b, int start)
+{
+  bool *used = smb_new(bool, b->nsymbols);
+  int i, j, s, count = 1;
+  memset(used, 0, sizeof(bool) * b->nsymbols);
+  used[start] = true;
+  for (i = 0; i < b->nrules; i++) {
+    for (j = -1; j < b->rules[i].len; j++) {
+      s = j < 0 ? b->rules[i].lhs : b->rules[i].rhs[j];
+      if (!b->terminal[s] && !used[s]) {
+        used[s] = true;
+        count++;
+      }
+    }
+  }
+  smb_free(used);
+  return count;
+}
+
+/*
+  Drop the rules for which keep is false.
+ */
+static void cnf_keep_rules(cnf_builder *b, const bool *keep)
+{
+  int i, n = 0;
+  for (i = 0; i < b->nrules; i++) {
+    if (keep[i]) {
+      b->rules[n++] = b->rules[i];
+    }
+  }
+  b->nrules = n;
+}
+
+/*
+  PRUNE: remove every rule that uses a symbol which derives no string, and
+  then every rule of a symbol that the start symbol can't reach.  The rules
+  are sorted by left hand side, and stay that way.
+ */
+static void cnf_prune(cnf_builder *b, int start)
+{
+  int n = b->nsymbols, i, j, s, head = 0, tail = 0;
+  int *first = smb_new(int, n + 1);   // rules using each symbol on the right
+  int *uses = smb_new(int, 2 * b->nrules + 1);
+  int *missing = smb_new(int, b->nrules + 1);
+  int *queue = smb_new(int, n);
+  bool *done = smb_new(bool, n);
+  bool *keep = smb_new(bool, b->nrules + 1);
+  cnf_work_rule *r;
+
+  // A symbol derives a string once one of its rules has only such symbols.
+  memset(first, 0, sizeof(int) * (n + 1));
+  for (i = 0; i < b->nrules; i++) {
+    for (j = 0; j < b->rules[i].len; j++) {
+      first[b->rules[i].rhs[j] + 1]++;
+    }
+  }
+  for (s = 0; s < n; s++) {
+    first[s + 1] += first[s];
+  }
+  for (i = 0; i < b->nrules; i++) {
+    r = &b->rules[i];
+    missing[i] = r->len;
+    for (j = 0; j < r->len; j++) {
+      uses[first[r->rhs[j]]++] = i;
+    }
+  }
+  for (s = n; s > 0; s--) {
+    first[s] = first[s - 1];
+  }
+  first[0] = 0;
+  for (s = 0; s < n; s++) {
+    done[s] = b->terminal[s];
+    if (done[s]) {
+      queue[tail++] = s;
+    }
+  }
+  while (head < tail) {
+    s = queue[head++];
+    for (j = first[s]; j < first[s + 1]; j++) {
+      r = &b->rules[uses[j]];
+      if (--missing[uses[j]] == 0 && !done[r->lhs]) {
+        done[r->lhs] = true;
+        queue[tail++] = r->lhs;
+      }
+    }
+  }
+  for (i = 0; i < b->nrules; i++) {
+    keep[i] = missing[i] == 0;
+  }
+  cnf_keep_rules(b, keep);
+
+  // The rules of each symbol are contiguous, so search from the start.
+  for (s = 0; s <= n; s++) {
+    first[s] = b->nrules;
+  }
+  for (i = b->nrules - 1; i >= 0; i--) {
+    first[b->rules[i].lhs] = i;
+  }
+  memset(done, 0, sizeof(bool) * n);
+  head = tail = 0;
+  done[start] = true;
+  queue[tail++] = start;
+  while (head < tail) {
+    s = queue[head++];
+    for (i = first[s]; i < b->nrules && b->rules[i].lhs == s; i++) {
+      for (j = 0; j < b->rules[i].len; j++) {
+        if (!done[b->rules[i].rhs[j]]) {
+          done[b->rules[i].rhs[j]] = true;
+          queue[tail++] = b->rules[i].rhs[j];
+        }
+      }
+    }
+  }
+  for (i = 0; i < b->nrules; i++) {
+    keep[i] = done[b->rules[i].lhs];
+  }
+  cnf_keep_rules(b, keep);
+
+  smb_free(first);
+  smb_free(uses);
+  smb_free(missing);
+  smb_free(queue);
+  smb_free(done);
+  smb_free(keep);
+}
+
+/*
+  A nonterminal during MERGE, with its rules rewritten in terms of classes.
+ */
+typedef struct {
+  int symbol;
+  int cls;
+  const cnf_work_rule *rules;
+  int nrules;
+} cnf_merge_symbol;
+
+static int cnf_merge_compare(const void *a, const void *b)
+{
+  const cnf_merge_symbol *s1 = a, *s2 = b;
+  const cnf_work_rule *r1, *r2;
+  int i;
+  if (s1->cls != s2->cls) {
+    return s1->cls < s2->cls ? -1 : 1;
+  }
+  for (i = 0; i < s1->nrules && i < s2->nrules; i++) {
+    r1 = &s1->rules[i];
+    r2 = &s2->rules[i];
+    if (r1->len != r2->len) {
+      return r1->len < r2->len ? -1 : 1;
+    } else if (r1->rhs[0] != r2->rhs[0]) {
+      return r1->rhs[0] < r2->rhs[0] ? -1 : 1;
+    } else if (r1->rhs[1] != r2->rhs[1]) {
+      return r1->rhs[1] < r2->rhs[1] ? -1 : 1;
+    } else if (r1->weight != r2->weight) {
+      return r1->weight < r2->weight ? -1 : 1;
+    }
+  }
+  return s1->nrules < s2->nrules ? -1 : s1->nrules > s2->nrules;
+}
+
+/*
+  MERGE: find the classes of nonterminals whose rules are the same, up to the
+  classes of the symbols in them, by refining one class until it is stable.
+  Symbols in a class derive the same strings, with the same weights, so each
+  nonterminal added by the conversion is replaced by the first symbol of its
+  class.  The source grammar's symbols are all kept.
+ */
+static void cnf_merge(cnf_builder *b, int nsource, int *start)
+{
+  int n = b->nsymbols, i, j, s, nclasses = 1, last;
+  int *cls = smb_new(int, n), *first = smb_new(int, n), *rep = smb_new(int, n);
+  cnf_work_rule *mapped = smb_new(cnf_work_rule, b->nrules + 1), *r;
+  cnf_merge_symbol *symbols = smb_new(cnf_merge_symbol, n);
+  bool *keep = smb_new(bool, b->nrules + 1);
+  double w;
+
+  // Terminals are each in a class of their own, numbered after nonterminals.
+  for (s = 0; s < n; s++) {
+    cls[s] = b->terminal[s] ? n + s : 0;
+  }
+  while (true) {
+    // Rewrite the rules in terms of classes, keeping the left hand sides.
+    for (i = 0; i < b->nrules; i++) {
+      mapped[i] = b->rules[i];
+      mapped[i].rhs[0] = cls[mapped[i].rhs[0]];
+      if (mapped[i].len == 2) {
+        mapped[i].rhs[1] = cls[mapped[i].rhs[1]];
+      }
+    }
+    qsort(mapped, b->nrules, sizeof(cnf_work_rule), &cnf_work_compare);
+    // Copies differing only in weight are distinct rules, but a symbol's
+    // best derivations only depend on the best of them.
+    for (i = j = 0; i < b->nrules; i++) {
+      if (j > 0 && cnf_work_compare(&mapped[i], &mapped[j - 1]) == 0) {
+        w = mapped[i].weight;
+        mapped[j - 1].weight = w > mapped[j - 1].weight ? w :
+          mapped[j - 1].weight;
+      } else {
+        mapped[j++] = mapped[i];
+      }
+    }
+
+    for (s = 0; s < n; s++) {
+      symbols[s].symbol = s;
+      symbols[s].cls = cls[s];
+      symbols[s].rules = NULL;
+      symbols[s].nrules = 0;
+    }
+    for (i = 0; i < j; i++) {
+      if (symbols[mapped[i].lhs].rules == NULL) {
+        symbols[mapped[i].lhs].rules = &mapped[i];
+      }
+      symbols[mapped[i].lhs].nrules++;
+    }
+    qsort(symbols, n, sizeof(cnf_merge_symbol), &cnf_merge_compare);
+
+    last = nclasses;
+    nclasses = 0;
+    for (s = 0; s < n; s++) {
+      if (b->terminal[symbols[s].symbol]) {
+        continue;
+      }
+      if (s > 0 && !b->terminal[symbols[s - 1].symbol] &&
+          cnf_merge_compare(&symbols[s], &symbols[s - 1]) == 0) {
+        cls[symbols[s].symbol] = nclasses - 1;
+      } else {
+        cls[symbols[s].symbol] = nclasses++;
+      }
+    }
+    if (nclasses == last) {
+      break;
+    }
+  }
+
+  // Replace each added nonterminal by the first symbol of its class, and
+  // drop its rules, which are the same as that symbol's.
+  for (s = 0; s < n; s++) {
+    first[s] = -1;
+  }
+  for (s = 0; s < n; s++) {
+    if (!b->terminal[s] && first[cls[s]] < 0) {
+      first[cls[s]] = s;
+    }
+    rep[s] = b->terminal[s] || s < nsource ? s : first[cls[s]];
+  }
+  for (i = 0; i < b->nrules; i++) {
+    r = &b->rules[i];
+    keep[i] = rep[r->lhs] == r->lhs;
+    r->rhs[0] = rep[r->rhs[0]];
+    if (r->len == 2) {
+      r->rhs[1] = rep[r->rhs[1]];
+    }
+  }
+  cnf_keep_rules(b, keep);
+  *start = rep[*start];
+  cnf_dedup(b);
+
+  smb_free(cls);
+  smb_free(first);
+  smb_free(rep);
+  smb_free(mapped);
+  smb_free(symbols);
+  smb_free(keep);
+}
+
+/*
+  Return the number of a symbol in the CNF grammar, adding a copy of its name
+  to the grammar the first time it's used.
+ */
+static int cnf_output_symbol(cnf_builder *b, cnf *dst, int *map, int symbol)
+{
+  smb_status status = SMB_SUCCESS;
+  const char *name;
+  char *copy;
+  if (map[symbol] == CFG_SYMBOL_NONE) {
+    name = al_get(&b->names, symbol, &status).data_ptr;
+    copy = smb_new(char, strlen(name) + 1);
+    strcpy(copy, name);
+    map[symbol] = cnf_add_symbol(dst, copy, b->terminal[symbol]);
+  }
+  return map[symbol];
+}
+static int cnf_order_compare(const void *a, const void *b)
+{
+  const cnf_work_rule *r1 = *(cnf_work_rule *const *) a;
+  const cnf_work_rule *r2 = *(cnf_work_rule *const *) b;
+  if (r1->len != r2->len) {
+    return r1->len < r2->len ? -1 : 1;
+  } else if (r1->rhs[0] != r2->rhs[0]) {
+    return r1->rhs[0] < r2->rhs[0] ? -1 : 1;
+  } else if (r1->rhs[1] != r2->rhs[1]) {
+    return r1->rhs[1] < r2->rhs[1] ? -1 : 1;
+  }
+  return r1->lhs < r2->lhs ? -1 : r1->lhs > r2->lhs;
+}
+
+/*
+  ORDER: add the nonterminals to the CNF grammar in order of their rules'
+  right hand sides, terminal rules first.  The nonterminals deriving the same
+  terminal, or the same pair, are in the same cells whenever one of them is,
+  so this puts them in the same words of the chart's bitsets.
+ */
+static void cnf_order(cnf_builder *b, cnf *dst, int *map, int start)
+{
+  cnf_work_rule **sorted = smb_new(cnf_work_rule *, b->nrules + 1);
+  int i;
+  for (i = 0; i < b->nrules; i++) {
+    sorted[i] = &b->rules[i];
+  }
+  qsort(sorted, b->nrules, sizeof(cnf_work_rule *), &cnf_order_compare);
+  for (i = 0; i < b->nrules; i++) {
+    cnf_output_symbol(b, dst, map, sorted[i]->lhs);
+  }
+  cnf_output_symbol(b, dst, map, start);
+  smb_free(sorted);
+}
+
+/*
+  Count the nonterminals and rules of the source grammar.
+ */
+static void cnf_report_source(const cfg *src, cnf_report *report)
+{
+  report->source_nonterminals = al_length(&src->symbols) -
+    al_length(&src->terminals);
+  report->source_rules = cfg_num_rules(src);
+}
+
+/**
+   @brief Convert a context-free grammar into Chomsky normal form.
+
+   The CNF grammar generates the same strings as the source grammar, except
+   that the empty string is recorded in cnf.accepts_empty instead of by a rule.
+   Nonterminals added by the conversion are named after the symbols they stand
+   for.  The rule index is built, so the grammar is ready to parse with.
+
+   The converted grammar is made smaller before it is stored: useless symbols
+   are removed, equivalent nonterminals added by the conversion are merged,
+   and nonterminals are numbered so that ones found in the same cells are
+   near each other.  So the start symbol may be a symbol of the source
+   grammar, and the numbering of symbols doesn't follow the source grammar.
+
+   Rule weights are carried over so that every string's best derivation keeps
+   its weight: where the conversion merges several derivations into one rule,
+   the rule gets the best of their weights.  Weights must not be positive.
+
+   Symbol names are copied, so the CNF grammar should be cleaned up with
+   `cnf_destroy(dst, true)`.  The source grammar is unchanged.
+
+   @param src The grammar to convert
+   @param dst An initialized, empty CNF grammar to store the result in.  It
+   may be in either storage mode.
+   @param[out] report If not NULL, the size of the grammar at each stage
+   @param status Set to SMB_INDEX_ERROR if the grammar has no start symbol, or
+   a rule with a terminal on its left hand side.
+ */
+void cfg_to_cnf_report(cfg *src, cnf *dst, cnf_report *report,
+                       smb_status *status)
+{
+  smb_status st = SMB_SUCCESS;
+  cnf_builder b;
+  cnf_rule *rule;
+  double *empty;
+  int *map;
+  int i, start, nsource, lhs, one, two;
+  cnf_work_rule *r;
+
+  al_init(&b.names);
+  al_init(&b.new_names);
+  ht_init(&b.index, &ht_string_hash, &data_compare_string);
+  b.nsymbols = 0;
+  b.capacity = al_length(&src->symbols) + 16;
+  b.terminal = smb_new(bool, b.capacity);
+  b.counter = 0;
+  b.nrules = 0;
+  b.rule_cap = cfg_num_rules(src) + 16;
+  b.rules = smb_new(cnf_work_rule, b.rule_cap);
+  for (i = 0; i < al_length(&src->symbols); i++) {
+    cnf_builder_symbol(&b, al_get(&src->symbols, i, &st).data_ptr, false);
+  }
+  for (i = 0; i < al_length(&src->terminals); i++) {
+    b.terminal[al_get(&src->terminals, i, &st).data_llint] = true;
+  }
+  nsource = b.nsymbols;
+
+  if (src->start == CFG_SYMBOL_NONE || b.terminal[src->start]) {
+    *status = SMB_INDEX_ERROR;
+    cnf_builder_destroy(&b);
+    return;
+  }
+
+  // START: the new start symbol never appears on a right hand side.
+  start = cnf_builder_fresh(&b, src->start, "'");
+  cnf_builder_rule(&b, start, 1, src->start, CFG_SYMBOL_NONE, 0);
+
+  cnf_split_rules(&b, src, status);
+  if (*status != SMB_SUCCESS) {
+    cnf_builder_destroy(&b);
+    return;
+  }
+  empty = cnf_remove_empty(&b);
+  dst->accepts_empty = empty[start] > -HUGE_VAL;
+  dst->empty_weight = dst->accepts_empty ? empty[start] : 0;
+  smb_free(empty);
+  cnf_remove_units(&b);
+  cnf_dedup(&b);
+  if (report != NULL) {
+    cnf_report_source(src, report);
+    report->converted_nonterminals = cnf_count_nonterminals(&b, start);
+    report->converted_rules = b.nrules;
+  }
+
+  cnf_prune(&b, start);
+  cnf_merge(&b, nsource, &start);
+  // Merging can leave a source symbol with nothing to reach it.
+  cnf_prune(&b, start);
+  if (report != NULL) {
+    report->nonterminals = cnf_count_nonterminals(&b, start);
+    report->rules = b.nrules;
+  }
+
+  map = smb_new(int, b.nsymbols);
+  for (i = 0; i < b.nsymbols; i++) {
+    map[i] = CFG_SYMBOL_NONE;
+  }
+  cnf_order(&b, dst, map, start);
+  dst->start = map[start];
+  for (i = 0; i < b.nrules; i++) {
+    r = &b.rules[i];
+    lhs = cnf_output_symbol(&b, dst, map, r->lhs);
+    one = cnf_output_symbol(&b, dst, map, r->rhs[0]);
+    two = r->len == 2 ? cnf_output_symbol(&b, dst, map, r->rhs[1]) :
+      CFG_SYMBOL_NONE;
+    rule = cnf_new_rule(dst, lhs, one, two);
+    rule->weight = r->weight;
+  }
+  cnf_build_index(dst);
+
+  smb_free(map);
+  cnf_builder_destroy(&b);
+}
+
+/**
+   @brief Convert a context-free grammar into Chomsky normal form.
+   @param src The grammar to convert
+   @param dst An initialized, empty CNF grammar to store the result in
+   @param status Set to SMB_INDEX_ERROR for a grammar that can't be converted
+   @see cfg_to_cnf_report
+ */
+void cfg_to_cnf(cfg *src, cnf *dst, smb_status *status)
+{
+  cfg_to_cnf_report(src, dst, NULL, status);
+}
+
+/*
+  A compiled grammar file is a cnf_image_header, followed by the A->a and the
+  A->BC rules, the rule index in the order of the cnf fields, the offset of
+  each symbol name (terminals first), and the names.  Tables are padded as by
+  dfa_write_table().  Everything is in native byte order, so the header
+  records enough to reject a file from some other machine.
+ */
+#define CNF_IMAGE_MAGIC "CKYCNF\0"
+#define CNF_IMAGE_VERSION 1
+#define CNF_IMAGE_ORDER 0x01020304u
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t int_size;
+  uint32_t double_size;
+  uint32_t rule_size;
+  int32_t nterminals;
+  int32_t nnonterminals;
+  int32_t none;
+  int32_t ntwo;
+  int32_t start;
+  int32_t accepts_empty;
+  int32_t names;   // characters of symbol names, terminators included
+  double empty_weight;
+  cnf_report report;
+  uint64_t hash;   // hash of the grammar's source
+  uint64_t size;   // size of the whole file
+} cnf_image_header;
+
+static void cnf_image_header_init(cnf_image_header *h, uint64_t hash)
+{
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, CNF_IMAGE_MAGIC, sizeof(h->magic));
+  h->version = CNF_IMAGE_VERSION;
+  h->byte_order = CNF_IMAGE_ORDER;
+  h->int_size = sizeof(int);
+  h->double_size = sizeof(double);
+  h->rule_size = sizeof(cnf_rule);
+  h->hash = hash;
+}
+
+/*
+  Return a grammar's rules of one kind as an array, which the caller frees
+  unless it is the grammar's own arena.
+ */
+static cnf_rule *cnf_rule_array(const cnf *gram, bool binary, int n)
+{
+  cnf_rule *rules;
+  int i;
+  if (gram->arena) {
+    return binary ? gram->two_arena : gram->one_arena;
+  }
+  rules = smb_new(cnf_rule, n + 1);
+  for (i = 0; i < n; i++) {
+    rules[i] = *cnf_get_rule(gram, binary, i);
+  }
+  return rules;
+}
+
+/**
+   @brief Write a converted grammar to a file, which cnf_load_compiled() can
+   map back in without converting or indexing anything.
+
+   The hash should identify the grammar's source, so that loading can tell
+   when the file is out of date.  The grammar must have its rule index, as it
+   does after cfg_to_cnf().
+
+   @param gram The grammar to write
+   @param filename The file to write
+   @param hash Hash of the grammar's source, such as from lex_hash()
+   @param report Sizes of the conversion to store with it, or NULL
+   @param status Set to SMB_NOT_FOUND_ERROR if the file can't be written.
+ */
+void cnf_save(const cnf *gram, const char *filename, uint64_t hash,
+              const cnf_report *report, smb_status *status)
+{
+  smb_status st = SMB_SUCCESS;
+  int nterm = al_length(&gram->terminals);
+  int nnon = al_length(&gram->nonterminals);
+  int none = cnf_num_rules(gram, false), ntwo = cnf_num_rules(gram, true);
+  int *offsets = smb_new(int, nterm + nnon + 1);
+  cnf_rule *one, *two;
+  cnf_image_header h;
+  char *name, *names;
+  bool ok;
+  long size;
+  int i;
+  FILE *f;
+
+  assert(gram->one_first != NULL);
+  f = fopen(filename, "wb");
+  if (f == NULL) {
+    *status = SMB_NOT_FOUND_ERROR;
+    smb_free(offsets);
+    return;
+  }
+
+  offsets[0] = 0;
+  for (i = 0; i < nterm + nnon; i++) {
+    name = al_get(i < nterm ? &gram->terminals : &gram->nonterminals,
+                  i < nterm ? i : i - nterm, &st).data_ptr;
+    offsets[i + 1] = offsets[i] + strlen(name) + 1;
+  }
+  names = smb_new(char, offsets[nterm + nnon] + 1);
+  for (i = 0; i < nterm + nnon; i++) {
+    name = al_get(i < nterm ? &gram->terminals : &gram->nonterminals,
+                  i < nterm ? i : i - nterm, &st).data_ptr;
+    strcpy(names + offsets[i], name);
+  }
+  one = cnf_rule_array(gram, false, none);
+  two = cnf_rule_array(gram, true, ntwo);
+
+  // The header is written again at the end, once the size is known.
+  cnf_image_header_init(&h, hash);
+  h.nterminals = nterm;
+  h.nnonterminals = nnon;
+  h.none = none;
+  h.ntwo = ntwo;
+  h.start = gram->start;
+  h.accepts_empty = gram->accepts_empty;
+  h.names = offsets[nterm + nnon];
+  h.empty_weight = gram->empty_weight;
+  if (report != NULL) {
+    h.report = *report;
+  }
+  ok = dfa_write_table(&h, sizeof(h), f) &&
+    dfa_write_table(one, sizeof(cnf_rule) * none, f) &&
+    dfa_write_table(two, sizeof(cnf_rule) * ntwo, f) &&
+    dfa_write_table(gram->one_first, sizeof(int) * (nterm + 1), f) &&
+    dfa_write_table(gram->one_lhs, sizeof(int) * (none + 1), f) &&
+    dfa_write_table(gram->one_weight, sizeof(double) * (none + 1), f) &&
+    dfa_write_table(gram->two_first, sizeof(int) * (nnon + 1), f) &&
+    dfa_write_table(gram->two_right, sizeof(int) * (ntwo + 1), f) &&
+    dfa_write_table(gram->two_lhs, sizeof(int) * (ntwo + 1), f) &&
+    dfa_write_table(gram->two_weight, sizeof(double) * (ntwo + 1), f) &&
+    dfa_write_table(offsets, sizeof(int) * (nterm + nnon), f) &&
+    dfa_write_table(names, h.names, f);
+  size = ftell(f);
+  h.size = size;
+  ok = ok && size >= 0 && fseek(f, 0, SEEK_SET) == 0 &&
+    fwrite(&h, sizeof(h), 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+  if (!gram->arena) {
+    smb_free(one);
+    smb_free(two);
+  }
+  smb_free(offsets);
+  smb_free(names);
+
+  if (!ok) {
+    remove(filename);
+    *status = SMB_NOT_FOUND_ERROR;
+  }
+}
+
+/*
+  Check the header of a compiled grammar file against the machine, the hash
+  and the file's size.
+ */
+static bool cnf_image_valid(const cnf_image_header *h, uint64_t hash,
+                            size_t size)
+{
+  cnf_image_header expect;
+  cnf_image_header_init(&expect, hash);
+  return memcmp(h->magic, expect.magic, sizeof(h->magic)) == 0 &&
+    h->version == expect.version && h->byte_order == expect.byte_order &&
+    h->int_size == expect.int_size && h->double_size == expect.double_size &&
+    h->rule_size == expect.rule_size && h->hash == hash && h->size == size &&
+    h->nterminals >= 0 && h->nnonterminals > 0 && h->none >= 0 &&
+    h->ntwo >= 0 && h->names > 0 && h->start >= 0 &&
+    h->start < h->nnonterminals;
+}
+
+/**
+   @brief Load a grammar from a file written by cnf_save(), by mapping the
+   file into memory and pointing the grammar's rules, index and symbol names
+   straight at it.
+
+   Only the symbol lists and their hash tables are built, one entry per
+   symbol: nothing is done for each rule.  The grammar is in arena mode, and
+   can't have rules added afterwards.  It is cleaned up with cnf_destroy() as
+   usual, which unmaps the file.
+
+   @param gram A grammar freshly initialized with cnf_init() or
+   cnf_init_arena()
+   @param filename The file to load
+   @param hash Hash of the grammar's source, which the file must match
+   @param[out] report If not NULL, the sizes stored with the grammar
+   @param status Set to SMB_NOT_FOUND_ERROR, leaving the grammar empty, if the
+   file is missing, was written by a different version or machine, or
+   doesn't match the hash.
+ */
+void cnf_load_compiled(cnf *gram, const char *filename, uint64_t hash,
+                       cnf_report *report, smb_status *status)
+{
+  const cnf_image_header *h;
+  const char *pos, *end, *names;
+  const cnf_rule *one, *two;
+  const int *offsets;
+  struct stat st;
+  void *image;
+  int i, n, fd;
+  DATA d;
+
+  assert(gram->image == NULL && al_length(&gram->nonterminals) == 0);
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    *status = SMB_NOT_FOUND_ERROR;
+    return;
+  }
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(*h)) {
+    close(fd);
+    *status = SMB_NOT_FOUND_ERROR;
+    return;
+  }
+  image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) {
+    *status = SMB_NOT_FOUND_ERROR;
+    return;
+  }
+
+  pos = image;
+  end = pos + st.st_size;
+  h = dfa_map_table(&pos, end, sizeof(*h));
+  if (!cnf_image_valid(h, hash, st.st_size)) {
+    goto invalid;
+  }
+  n = h->nterminals + h->nnonterminals;
+  one = dfa_map_table(&pos, end, sizeof(cnf_rule) * h->none);
+  two = dfa_map_table(&pos, end, sizeof(cnf_rule) * h->ntwo);
+  gram->one_first = (int *) dfa_map_table(
+      &pos, end, sizeof(int) * (h->nterminals + 1));
+  gram->one_lhs = (int *) dfa_map_table(&pos, end,
+                                        sizeof(int) * (h->none + 1));
+  gram->one_weight = (double *) dfa_map_table(
+      &pos, end, sizeof(double) * (h->none + 1));
+  gram->two_first = (int *) dfa_map_table(
+      &pos, end, sizeof(int) * (h->nnonterminals + 1));
+  gram->two_right = (int *) dfa_map_table(&pos, end,
+                                          sizeof(int) * (h->ntwo + 1));
+  gram->two_lhs = (int *) dfa_map_table(&pos, end,
+                                        sizeof(int) * (h->ntwo + 1));
+  gram->two_weight = (double *) dfa_map_table(
+      &pos, end, sizeof(double) * (h->ntwo + 1));
+  offsets = dfa_map_table(&pos, end, sizeof(int) * n);
+  names = dfa_map_table(&pos, end, h->names);
+  if (one == NULL || two == NULL || gram->one_first == NULL ||
+      gram->one_lhs == NULL || gram->one_weight == NULL ||
+      gram->two_first == NULL || gram->two_right == NULL ||
+      gram->two_lhs == NULL || gram->two_weight == NULL || offsets == NULL ||
+      names == NULL || names[h->names - 1] != '\0' ||
+      gram->one_first[h->nterminals] != h->none ||
+      gram->two_first[h->nnonterminals] != h->ntwo) {
+    goto invalid_index;
+  }
+  for (i = 0; i < n; i++) {
+    if (offsets[i] < 0 || offsets[i] >= h->names) {
+      goto invalid_index;
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    d.data_ptr = (void *) (names + offsets[i]);
+    if (i < h->nterminals) {
+      al_append(&gram->terminals, d);
+      ht_insert(&gram->terminal_index, d, (DATA){.data_llint=i});
+    } else {
+      al_append(&gram->nonterminals, d);
+      ht_insert(&gram->nonterminal_index, d,
+                (DATA){.data_llint=i - h->nterminals});
+    }
+  }
+  // The arena points into the mapping, so an arena of its own isn't needed.
+  smb_free(gram->one_arena);
+  smb_free(gram->two_arena);
+  gram->arena = true;
+  gram->one_arena = (cnf_rule *) one;
+  gram->none = gram->one_capacity = h->none;
+  gram->two_arena = (cnf_rule *) two;
+  gram->ntwo = gram->two_capacity = h->ntwo;
+  gram->start = h->start;
+  gram->accepts_empty = h->accepts_empty;
+  gram->empty_weight = h->empty_weight;
+  if (report != NULL) {
+    *report = h->report;
+  }
+  gram->image = image;
+  gram->image_size = st.st_size;
+  return;
+
+ invalid_index:
+  gram->one_first = NULL;
+  gram->one_lhs = NULL;
+  gram->one_weight = NULL;
+  gram->two_first = NULL;
+  gram->two_right = NULL;
+  gram->two_lhs = NULL;
+  gram->two_weight = NULL;
+ invalid:
+  munmap(image, st.st_size);
+  *status = SMB_NOT_FOUND_ERROR;
+}
@@ -0,0 +1,73 @@
+/***************************************************************************//**
+
+  @file         cnf.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Conversion of context-free grammars to Chomsky normal form.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_CNF_H
+#define SMB_CNF_H
+
+#include <stdint.h>
+
+#include "libstephen/base.h"
+#include "gram.h"
+
+/**
+   @brief The size of a grammar before, during and after conversion to CNF.
+
+   @see cfg_to_cnf_report
+ */
+typedef struct {
+
+  /**
+     @brief Nonterminals of the source grammar.
+   */
+  int source_nonterminals;
+
+  /**
+     @brief Rules of the source grammar.
+   */
+  int source_rules;
+
+  /**
+     @brief Nonterminals in CNF, before the grammar was made smaller.
+   */
+  int converted_nonterminals;
+
+  /**
+     @brief Rules in CNF, before the grammar was made smaller.
+   */
+  int converted_rules;
+
+  /**
+     @brief Nonterminals of the CNF grammar.
+   */
+  int nonterminals;
+
+  /**
+     @brief Rules of the CNF grammar.
+   */
+  int rules;
+
+} cnf_report;
+
+void cfg_to_cnf(cfg *src, cnf *dst, smb_status *status);
+void cfg_to_cnf_report(cfg *src, cnf *dst, cnf_report *report,
+                       smb_status *status);
+
+// Compiled grammar files.
+void cnf_save(const cnf *gram, const char *filename, uint64_t hash,
+              const cnf_report *report, smb_status *status);
+void cnf_load_compiled(cnf *gram, const char *filename, uint64_t hash,
+                       cnf_report *report, smb_status *status);
+
+#endif//SMB_CNF_H
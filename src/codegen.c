@@ -0,0 +1,311 @@
+/***************************************************************************//**
+
+  @file         codegen.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Generate standalone C scanners from lexers.
+
+  The generated scanner is the lexer's UTF-8 DFA as static const tables, and a
+  matching loop specialized to them.  It needs nothing but the C standard
+  library, and it matches exactly what lex_tokenize_all() would.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "libstephen/base.h"
+#include "libstephen/al.h"
+#include "dfa.h"
+#include "lex.h"
+#include "codegen.h"
+
+// Tables are wrapped to fit within this many columns.
+#define CODEGEN_WIDTH 79
+
+/*
+  Write a string with every letter upper cased, and everything that can't be
+  part of a C identifier replaced by an underscore.
+ */
+static void codegen_upper(FILE *out, const char *s)
+{
+  for (; *s != '\0'; s++) {
+    fputc(isalnum((unsigned char) *s) ? toupper((unsigned char) *s) : '_',
+          out);
+  }
+}
+
+/*
+  Make the enum constant name of a token, minus the prefix, into buf.
+ */
+static void codegen_token_ident(smb_lex *obj, int token, char *buf,
+                                size_t size)
+{
+  const wchar_t *name = lex_token_name(obj, token);
+  size_t i;
+  for (i = 0; i + 1 < size && name[i] != L'\0'; i++) {
+    buf[i] = name[i] < 128 && isalnum(name[i]) ? toupper(name[i]) : '_';
+  }
+  buf[i] = '\0';
+}
+
+/*
+  Return true if an earlier token (or a constant of the generated code itself)
+  has the same enum constant as token, in which case the token's index is
+  added to its constant to tell them apart.
+ */
+static bool codegen_token_clash(smb_lex *obj, int token)
+{
+  char mine[64], theirs[64];
+  int i;
+  codegen_token_ident(obj, token, mine, sizeof(mine));
+  if (strcmp(mine, "NO_TOKEN") == 0 || strcmp(mine, "NUM_TOKENS") == 0) {
+    return true;
+  }
+  for (i = 0; i < token; i++) {
+    codegen_token_ident(obj, i, theirs, sizeof(theirs));
+    if (strcmp(mine, theirs) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void codegen_token_enum(smb_lex *obj, FILE *out, const char *prefix,
+                               int token)
+{
+  char ident[64];
+  codegen_token_ident(obj, token, ident, sizeof(ident));
+  codegen_upper(out, prefix);
+  fprintf(out, "_%s", ident);
+  if (codegen_token_clash(obj, token)) {
+    fprintf(out, "_%d", token);
+  }
+}
+
+/*
+  Write a token name as a C string literal of UTF-8 text.
+ */
+static void codegen_string(FILE *out, const wchar_t *s)
+{
+  unsigned long c;
+  fputc('"', out);
+  for (; *s != L'\0'; s++) {
+    c = (unsigned long) *s;
+    if (c == '"' || c == '\\') {
+      fprintf(out, "\\%c", (char) c);
+    } else if (c >= 0x20 && c < 0x7F) {
+      fputc((char) c, out);
+    } else if (c < 0x80) {
+      fprintf(out, "\\%03lo", c);
+    } else if (c < 0x800) {
+      fprintf(out, "\\%03lo\\%03lo", 0xC0 | (c >> 6), 0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+      fprintf(out, "\\%03lo\\%03lo\\%03lo", 0xE0 | (c >> 12),
+              0x80 | ((c >> 6) & 0x3F), 0x80 | (c & 0x3F));
+    } else {
+      fprintf(out, "\\%03lo\\%03lo\\%03lo\\%03lo", 0xF0 | (c >> 18),
+              0x80 | ((c >> 12) & 0x3F), 0x80 | ((c >> 6) & 0x3F),
+              0x80 | (c & 0x3F));
+    }
+  }
+  fputc('"', out);
+}
+
+/*
+  The smallest C integer type able to hold every value from lo to hi.
+ */
+static const char *codegen_type(int lo, int hi)
+{
+  if (lo >= -128 && hi <= 127) {
+    return "signed char";
+  } else if (lo >= -32768 && hi <= 32767) {
+    return "short";
+  }
+  return "int";
+}
+
+/*
+  Write the body of an array initializer, wrapped onto lines indented by
+  indent spaces.
+ */
+static void codegen_numbers(FILE *out, const int *values, int n, int indent)
+{
+  char buf[16];
+  int i, column = 0, length;
+  for (i = 0; i < n; i++) {
+    length = sprintf(buf, "%d,", values[i]);
+    if (column == 0 || column + 1 + length > CODEGEN_WIDTH) {
+      fprintf(out, "%s%*s", column == 0 ? "" : "\n", indent, "");
+      column = indent;
+    } else {
+      fputc(' ', out);
+      column++;
+    }
+    fputs(buf, out);
+    column += length;
+  }
+  fputc('\n', out);
+}
+
+/**
+   @brief Write the header of a generated scanner.
+
+   The header declares an enum constant for each token (`PREFIX_NAME`, with
+   the index appended when two names would clash), the token name and skip
+   tables, and the scanner function `prefix_next()`.
+
+   @param obj The lexer to generate a scanner for
+   @param out The file to write to
+   @param prefix Prefix of every identifier in the generated code
+ */
+void lex_generate_header(smb_lex *obj, FILE *out, const char *prefix)
+{
+  int i, n = al_length(&obj->tokens);
+
+  fprintf(out, "/* Scanner generated by lexgen.  Do not edit. */\n\n");
+  fputs("#ifndef ", out);
+  codegen_upper(out, prefix);
+  fputs("_LEX_H\n#define ", out);
+  codegen_upper(out, prefix);
+  fputs("_LEX_H\n\n#include <stddef.h>\n\nenum {\n  ", out);
+  codegen_upper(out, prefix);
+  fputs("_NO_TOKEN = -1,\n", out);
+  for (i = 0; i < n; i++) {
+    fputs("  ", out);
+    codegen_token_enum(obj, out, prefix, i);
+    fprintf(out, " = %d,\n", i);
+  }
+  fputs("  ", out);
+  codegen_upper(out, prefix);
+  fprintf(out, "_NUM_TOKENS = %d\n};\n\n", n);
+
+  fprintf(out, "extern const char *const %s_names[];\n", prefix);
+  fprintf(out, "extern const unsigned char %s_skip[];\n\n", prefix);
+  fprintf(out, "int %s_next(const char *input, size_t length, "
+          "size_t *token_length);\n\n", prefix);
+  fputs("#endif\n", out);
+}
+
+/**
+   @brief Write the source of a generated scanner.
+
+   `prefix_next()` matches one token at the start of a buffer of UTF-8 text,
+   and returns its token, storing its length in bytes.  When nothing matches,
+   it returns `PREFIX_NO_TOKEN`, and the length of the first character.
+
+   @param obj The lexer to generate a scanner for
+   @param out The file to write to
+   @param prefix Prefix of every identifier in the generated code
+   @param header The name to include the generated header by
+ */
+void lex_generate_source(smb_lex *obj, FILE *out, const char *prefix,
+                         const char *header)
+{
+  const dfa *d;
+  int i, n = al_length(&obj->tokens), lo = DFA_MID_CHAR, hi = n;
+  int *values;
+
+  lex_compile(obj);
+  d = obj->utf8;
+  for (i = 0; i < d->nstates * d->nclasses; i++) {
+    hi = d->trans[i] > hi ? d->trans[i] : hi;
+  }
+
+  fprintf(out, "/* Scanner generated by lexgen.  Do not edit. */\n\n");
+  fprintf(out, "#include \"%s\"\n\n", header);
+
+  fprintf(out, "const char *const %s_names[] = {\n", prefix);
+  for (i = 0; i < n; i++) {
+    fputs("  ", out);
+    codegen_string(out, lex_token_name(obj, i));
+    fputs(",\n", out);
+  }
+  fputs("  0\n};\n\n", out);
+
+  values = smb_new(int, n + 1);
+  for (i = 0; i < n; i++) {
+    values[i] = lex_token_skip(obj, i);
+  }
+  values[n] = 0;
+  fprintf(out, "const unsigned char %s_skip[] = {\n", prefix);
+  codegen_numbers(out, values, n + 1, 2);
+  fputs("};\n\n", out);
+  smb_free(values);
+
+  if (d->start == DFA_DEAD) {
+    // No pattern matches anything, so there are no tables to write.
+    fprintf(out, "int %s_next(const char *input, size_t length, "
+            "size_t *token_length)\n{\n", prefix);
+    fputs("  (void) input;\n"
+          "  *token_length = length > 0;\n"
+          "  return -1;\n"
+          "}\n", out);
+    return;
+  }
+
+  fprintf(out, "static const %s %s_class[256] = {\n",
+          codegen_type(0, d->nclasses), prefix);
+  codegen_numbers(out, d->direct, DFA_DIRECT, 2);
+  fputs("};\n\n", out);
+
+  fprintf(out, "static const %s %s_accept[%d] = {\n", codegen_type(lo, hi),
+          prefix, d->nstates);
+  codegen_numbers(out, d->accept, d->nstates, 2);
+  fputs("};\n\n", out);
+
+  fprintf(out, "static const %s %s_trans[%d][%d] = {\n",
+          codegen_type(DFA_DEAD, hi), prefix, d->nstates, d->nclasses);
+  for (i = 0; i < d->nstates; i++) {
+    fputs("  {\n", out);
+    codegen_numbers(out, d->trans + i * d->nclasses, d->nclasses, 4);
+    fputs("  },\n", out);
+  }
+  fputs("};\n\n", out);
+
+  fprintf(out, "int %s_next(const char *input, size_t length, "
+          "size_t *token_length)\n{\n", prefix);
+  fprintf(out,
+          "  size_t i, best_length = 0;\n"
+          "  int state = %d, tag, best = -1;\n"
+          "  unsigned char b;\n\n"
+          "  for (i = 0; i < length; i++) {\n"
+          "    state = %s_trans[state][%s_class[(unsigned char) input[i]]];\n"
+          "    if (state < 0) {\n"
+          "      break;\n"
+          "    }\n"
+          "    tag = %s_accept[state];\n"
+          "    if (tag >= 0) {\n"
+          "      best = tag;\n"
+          "      best_length = i + 1;\n"
+          "    } else if (tag == -1) {\n"
+          "      break;\n"
+          "    }\n"
+          "  }\n\n",
+          d->start, prefix, prefix, prefix);
+  fputs("  if (best < 0 && length > 0) {\n"
+        "    // Skip one UTF-8 character.\n"
+        "    b = (unsigned char) input[0];\n"
+        "    if (b >= 0xF0 && b < 0xF8) {\n"
+        "      best_length = 4;\n"
+        "    } else if (b >= 0xE0 && b < 0xF0) {\n"
+        "      best_length = 3;\n"
+        "    } else if (b >= 0xC0 && b < 0xE0) {\n"
+        "      best_length = 2;\n"
+        "    } else {\n"
+        "      best_length = 1;\n"
+        "    }\n"
+        "    best_length = best_length < length ? best_length : length;\n"
+        "  }\n"
+        "  *token_length = best_length;\n"
+        "  return best;\n"
+        "}\n", out);
+}
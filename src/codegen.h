@@ -0,0 +1,27 @@
+/***************************************************************************//**
+
+  @file         codegen.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Generate standalone C scanners from lexers.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#ifndef SMB_CODEGEN_H
+#define SMB_CODEGEN_H
+
+#include <stdio.h>
+
+#include "lex.h"
+
+void lex_generate_header(smb_lex *obj, FILE *out, const char *prefix);
+void lex_generate_source(smb_lex *obj, FILE *out, const char *prefix,
+                         const char *header);
+
+#endif//SMB_CODEGEN_H
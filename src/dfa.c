@@ -0,0 +1,1420 @@
+/***************************************************************************//**
+
+  @file         dfa.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Deterministic automata compiled from libstephen FSMs.
+
+  The DFA is built by subset construction over the union of the source FSMs,
+  so the automaton in each state tracks every source pattern at once.  The
+  necessary epsilon closures use the same epsilon test as libstephen's own
+  nondeterministic simulation, so a DFA accepts exactly what fsm_sim_nondet()
+  would.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstephen/al.h"
+#include "libstephen/ht.h"
+#include "libstephen/fsm.h"
+#include "libstephen/regex.h"
+#include "dfa.h"
+
+/**
+   @brief A variable length array of ints, used as a hash table key.
+ */
+typedef struct {
+  int length;
+  int *data;
+} dfa_key;
+
+/**
+   @brief The source FSMs, flattened into one NFA with global state numbers.
+ */
+typedef struct dfa_nfa {
+  int nstates;
+  int ntrans;
+  int *first;       // transitions of state s are [first[s], first[s+1])
+  const fsm_trans **trans;
+  int *dest;
+  bool *epsilon;
+  int *accept;      // pattern index, DFA_NO_PATTERN or DFA_MID_CHAR
+  int nstarts;
+  int *starts;      // start state of each pattern
+  bool owns_trans;  // true if the transitions were made for this NFA
+} dfa_nfa;
+
+static unsigned int dfa_key_hash(DATA d)
+{
+  const dfa_key *key = d.data_ptr;
+  unsigned int hash = 2166136261u;
+  int i;
+  for (i = 0; i < key->length; i++) {
+    hash = (hash ^ (unsigned int) key->data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static int dfa_key_compare(DATA d1, DATA d2)
+{
+  const dfa_key *k1 = d1.data_ptr, *k2 = d2.data_ptr;
+  if (k1->length != k2->length) {
+    return k1->length - k2->length;
+  }
+  return memcmp(k1->data, k2->data, sizeof(int) * k1->length);
+}
+
+static dfa_key *dfa_key_create(const int *data, int length)
+{
+  dfa_key *key = smb_new(dfa_key, 1);
+  key->length = length;
+  key->data = smb_new(int, length > 0 ? length : 1);
+  memcpy(key->data, data, sizeof(int) * length);
+  return key;
+}
+
+static void dfa_key_delete(dfa_key *key)
+{
+  smb_free(key->data);
+  smb_free(key);
+}
+
+static int dfa_int_compare(const void *a, const void *b)
+{
+  int x = *(const int *)a, y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+static int dfa_wchar_compare(const void *a, const void *b)
+{
+  wchar_t x = *(const wchar_t *)a, y = *(const wchar_t *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+  Flatten each FSM into one NFA, renumbering states so that pattern i's states
+  follow pattern i-1's.
+ */
+static void dfa_nfa_init(dfa_nfa *nfa, fsm **patterns, int npatterns)
+{
+  int p, s, t, offset = 0, idx = 0;
+  smb_status status = SMB_SUCCESS;
+  smb_al *list;
+  fsm_trans *ft;
+
+  nfa->nstates = 0;
+  nfa->ntrans = 0;
+  nfa->nstarts = npatterns;
+  nfa->owns_trans = false;
+  for (p = 0; p < npatterns; p++) {
+    nfa->nstates += al_length(&patterns[p]->transitions);
+    for (s = 0; s < al_length(&patterns[p]->transitions); s++) {
+      list = al_get(&patterns[p]->transitions, s, &status).data_ptr;
+      assert(status == SMB_SUCCESS);
+      nfa->ntrans += al_length(list);
+    }
+  }
+
+  nfa->first = smb_new(int, nfa->nstates + 1);
+  nfa->trans = smb_new(const fsm_trans *, nfa->ntrans + 1);
+  nfa->dest = smb_new(int, nfa->ntrans + 1);
+  nfa->epsilon = smb_new(bool, nfa->ntrans + 1);
+  nfa->accept = smb_new(int, nfa->nstates + 1);
+  nfa->starts = smb_new(int, npatterns + 1);
+
+  for (p = 0; p < npatterns; p++) {
+    nfa->starts[p] = offset + patterns[p]->start;
+    for (s = 0; s < al_length(&patterns[p]->transitions); s++) {
+      nfa->first[offset + s] = idx;
+      nfa->accept[offset + s] = DFA_NO_PATTERN;
+      list = al_get(&patterns[p]->transitions, s, &status).data_ptr;
+      for (t = 0; t < al_length(list); t++) {
+        ft = al_get(list, t, &status).data_ptr;
+        nfa->trans[idx] = ft;
+        nfa->dest[idx] = offset + ft->dest;
+        nfa->epsilon[idx] = fsm_trans_check(ft, EPSILON);
+        idx++;
+      }
+    }
+    for (s = 0; s < al_length(&patterns[p]->accepting); s++) {
+      t = (int) al_get(&patterns[p]->accepting, s, &status).data_llint;
+      // Lower pattern numbers take priority, and they are visited first.
+      if (nfa->accept[offset + t] == DFA_NO_PATTERN) {
+        nfa->accept[offset + t] = p;
+      }
+    }
+    offset += al_length(&patterns[p]->transitions);
+  }
+  nfa->first[nfa->nstates] = idx;
+}
+
+static void dfa_nfa_destroy(dfa_nfa *nfa)
+{
+  int t;
+  if (nfa->owns_trans) {
+    for (t = 0; t < nfa->ntrans; t++) {
+      fsm_trans_delete((fsm_trans *) nfa->trans[t]);
+    }
+  }
+  smb_free(nfa->first);
+  smb_free(nfa->trans);
+  smb_free(nfa->dest);
+  smb_free(nfa->epsilon);
+  smb_free(nfa->accept);
+  smb_free(nfa->starts);
+}
+
+/*
+  Partition the alphabet into ranges at every transition boundary, then merge
+  ranges that every transition treats identically into character classes.  On
+  return, sig[c] is the set (as a bitset over transitions) of transitions that
+  class c may take.
+ */
+static unsigned int *dfa_alphabet(dfa *obj, const dfa_nfa *nfa, int *words_out)
+{
+  int t, k, i, c, nbounds = 1, words = nfa->ntrans / 32 + 1;
+  const fsm_trans *ft;
+  wchar_t *bounds;
+  unsigned int *interval_sig, *sig;
+  smb_ht classes;
+  smb_al keys;
+  smb_status status = SMB_SUCCESS;
+  dfa_key probe, *key;
+  DATA d;
+
+  // Collect every range boundary.
+  for (t = 0; t < nfa->ntrans; t++) {
+    if (!nfa->epsilon[t]) {
+      nbounds += 2 * nfa->trans[t]->num;
+    }
+  }
+  bounds = smb_new(wchar_t, nbounds);
+  nbounds = 0;
+  bounds[nbounds++] = WCHAR_MIN;
+  for (t = 0; t < nfa->ntrans; t++) {
+    if (nfa->epsilon[t]) {
+      continue;
+    }
+    ft = nfa->trans[t];
+    for (k = 0; k < ft->num; k++) {
+      bounds[nbounds++] = ft->start[k];
+      if (ft->end[k] < WCHAR_MAX) {
+        bounds[nbounds++] = ft->end[k] + 1;
+      }
+    }
+  }
+  qsort(bounds, nbounds, sizeof(wchar_t), dfa_wchar_compare);
+  for (i = 0, k = 0; i < nbounds; i++) {
+    if (k == 0 || bounds[i] != bounds[k-1]) {
+      bounds[k++] = bounds[i];
+    }
+  }
+  nbounds = k;
+
+  // Every character in a range behaves like the range's lower bound.
+  interval_sig = smb_new(unsigned int, nbounds * words);
+  memset(interval_sig, 0, sizeof(unsigned int) * nbounds * words);
+  for (i = 0; i < nbounds; i++) {
+    for (t = 0; t < nfa->ntrans; t++) {
+      if (!nfa->epsilon[t] && fsm_trans_check(nfa->trans[t], bounds[i])) {
+        interval_sig[i * words + t / 32] |= 1u << (t % 32);
+      }
+    }
+  }
+
+  // Assign a class to each distinct signature.
+  obj->bound_class = smb_new(int, nbounds);
+  sig = smb_new(unsigned int, nbounds * words);
+  ht_init(&classes, &dfa_key_hash, &dfa_key_compare);
+  al_init(&keys);
+  obj->nclasses = 0;
+  for (i = 0; i < nbounds; i++) {
+    probe.length = words;
+    probe.data = (int *) (interval_sig + i * words);
+    d = ht_get(&classes, (DATA){.data_ptr=&probe}, &status);
+    if (status == SMB_SUCCESS) {
+      obj->bound_class[i] = (int) d.data_llint;
+    } else {
+      status = SMB_SUCCESS;
+      c = obj->nclasses++;
+      key = dfa_key_create(probe.data, words);
+      al_append(&keys, (DATA){.data_ptr=key});
+      ht_insert(&classes, (DATA){.data_ptr=key}, (DATA){.data_llint=c});
+      memcpy(sig + c * words, probe.data, sizeof(unsigned int) * words);
+      obj->bound_class[i] = c;
+    }
+  }
+  for (i = 0; i < al_length(&keys); i++) {
+    dfa_key_delete(al_get(&keys, i, &status).data_ptr);
+  }
+  al_destroy(&keys);
+  ht_destroy(&classes);
+  smb_free(interval_sig);
+
+  obj->nbounds = nbounds;
+  obj->bounds = bounds;
+  for (i = 0; i < DFA_DIRECT; i++) {
+    obj->direct[i] = dfa_class_slow(obj, (wchar_t) i);
+  }
+  *words_out = words;
+  return sig;
+}
+
+/*
+  Extend a state set with its epsilon closure, then sort it so that equal sets
+  have equal representations.  The mark array must contain no value equal to
+  stamp for states outside the set.
+ */
+static int dfa_closure(const dfa_nfa *nfa, int *set, int length, int *mark,
+                       int stamp)
+{
+  int i, t, s;
+  for (i = 0; i < length; i++) {
+    s = set[i];
+    for (t = nfa->first[s]; t < nfa->first[s + 1]; t++) {
+      if (nfa->epsilon[t] && mark[nfa->dest[t]] != stamp) {
+        mark[nfa->dest[t]] = stamp;
+        set[length++] = nfa->dest[t];
+      }
+    }
+  }
+  qsort(set, length, sizeof(int), dfa_int_compare);
+  return length;
+}
+
+/*
+  Find the DFA state for a state set, creating it if it doesn't exist yet.
+ */
+static int dfa_add_state(dfa *obj, smb_ht *index, smb_al *sets,
+                         const dfa_nfa *nfa, const int *set, int length,
+                         int *capacity)
+{
+  smb_status status = SMB_SUCCESS;
+  dfa_key probe, *key;
+  DATA d;
+  int state, i, c;
+
+  if (length == 0) {
+    return DFA_DEAD;
+  }
+
+  probe.length = length;
+  probe.data = (int *) set;
+  d = ht_get(index, (DATA){.data_ptr=&probe}, &status);
+  if (status == SMB_SUCCESS) {
+    return (int) d.data_llint;
+  }
+
+  state = obj->nstates++;
+  if (state >= *capacity) {
+    *capacity *= 2;
+    obj->trans = smb_renew(int, obj->trans, *capacity * obj->nclasses);
+    obj->accept = smb_renew(int, obj->accept, *capacity);
+  }
+  for (c = 0; c < obj->nclasses; c++) {
+    obj->trans[state * obj->nclasses + c] = DFA_DEAD;
+  }
+  obj->accept[state] = DFA_NO_PATTERN;
+  for (i = 0; i < length; i++) {
+    if (nfa->accept[set[i]] == DFA_MID_CHAR) {
+      // UTF-8 is prefix free, so such a set has only mid-character states.
+      obj->accept[state] = DFA_MID_CHAR;
+      break;
+    }
+    if (nfa->accept[set[i]] != DFA_NO_PATTERN &&
+        (obj->accept[state] == DFA_NO_PATTERN ||
+         nfa->accept[set[i]] < obj->accept[state])) {
+      obj->accept[state] = nfa->accept[set[i]];
+    }
+  }
+
+  key = dfa_key_create(set, length);
+  al_append(sets, (DATA){.data_ptr=key});
+  ht_insert(index, (DATA){.data_ptr=key}, (DATA){.data_llint=state});
+  return state;
+}
+
+/*
+  Find the closed set of NFA states reached from a DFA state's set on a
+  character class.
+ */
+static int dfa_move(const dfa_nfa *nfa, const unsigned int *sig, int words,
+                    const dfa_key *curr, int c, int *set, int *mark,
+                    int stamp)
+{
+  int length = 0, p, s, t;
+  for (p = 0; p < curr->length; p++) {
+    s = curr->data[p];
+    for (t = nfa->first[s]; t < nfa->first[s + 1]; t++) {
+      if ((sig[c * words + t / 32] & (1u << (t % 32))) &&
+          mark[nfa->dest[t]] != stamp) {
+        mark[nfa->dest[t]] = stamp;
+        set[length++] = nfa->dest[t];
+      }
+    }
+  }
+  return dfa_closure(nfa, set, length, mark, stamp);
+}
+
+/*
+  Subset construction.  Every DFA state is the epsilon closed set of NFA states
+  that the NFA could be in, and state 0 is the closure of the start states.
+ */
+static void dfa_build(dfa *obj, const dfa_nfa *nfa)
+{
+  smb_ht index;
+  smb_al sets;
+  smb_status status = SMB_SUCCESS;
+  unsigned int *sig;
+  int *set, *mark;
+  int words, capacity = 16, stamp = 0, length, p, s, c, state, next;
+  const dfa_key *curr;
+
+  sig = dfa_alphabet(obj, nfa, &words);
+
+  obj->nstates = 0;
+  obj->borrowed = false;
+  obj->trans = smb_new(int, capacity * obj->nclasses);
+  obj->accept = smb_new(int, capacity);
+  ht_init(&index, &dfa_key_hash, &dfa_key_compare);
+  al_init(&sets);
+  set = smb_new(int, nfa->nstates + 1);
+  mark = smb_new(int, nfa->nstates + 1);
+  memset(mark, 0, sizeof(int) * (nfa->nstates + 1));
+
+  stamp++;
+  length = 0;
+  for (p = 0; p < nfa->nstarts; p++) {
+    if (mark[nfa->starts[p]] != stamp) {
+      mark[nfa->starts[p]] = stamp;
+      set[length++] = nfa->starts[p];
+    }
+  }
+  length = dfa_closure(nfa, set, length, mark, stamp);
+  obj->start = dfa_add_state(obj, &index, &sets, nfa, set, length,
+                             &capacity);
+
+  // States are numbered in creation order, so the list doubles as a queue.
+  for (state = 0; state < obj->nstates; state++) {
+    for (c = 0; c < obj->nclasses; c++) {
+      curr = al_get(&sets, state, &status).data_ptr;
+      length = dfa_move(nfa, sig, words, curr, c, set, mark, ++stamp);
+      next = dfa_add_state(obj, &index, &sets, nfa, set, length, &capacity);
+      obj->trans[state * obj->nclasses + c] = next;
+    }
+  }
+
+  for (s = 0; s < al_length(&sets); s++) {
+    dfa_key_delete(al_get(&sets, s, &status).data_ptr);
+  }
+  al_destroy(&sets);
+  ht_destroy(&index);
+  smb_free(set);
+  smb_free(mark);
+  smb_free(sig);
+}
+
+/**
+   @brief Build a DFA from the union of several FSMs.
+
+   The FSMs are not modified, and they are not referenced after this call, so
+   they may be freed independently of the DFA.
+
+   @param obj Memory to initialize
+   @param patterns Array of FSMs.  Earlier FSMs take priority when several
+   accept in the same state.
+   @param npatterns Number of FSMs in the array
+ */
+void dfa_init(dfa *obj, fsm **patterns, int npatterns)
+{
+  dfa_nfa nfa;
+  dfa_nfa_init(&nfa, patterns, npatterns);
+  dfa_build(obj, &nfa);
+  dfa_nfa_destroy(&nfa);
+}
+
+/*
+  Return a fresh value for marking the scratch set of a lazy DFA.
+ */
+static int dfa_lazy_stamp(dfa_lazy *obj)
+{
+  if (obj->stamp == INT_MAX) {
+    memset(obj->mark, 0, sizeof(int) * (obj->nfa->nstates + 1));
+    obj->stamp = 0;
+  }
+  return ++obj->stamp;
+}
+
+/*
+  Find or make the lazy DFA state for the scratch set.  A new state's
+  transitions are all unknown.
+ */
+static int dfa_lazy_add(dfa_lazy *obj, int length)
+{
+  int n = obj->table.nstates, state, c;
+
+  state = dfa_add_state(&obj->table, &obj->index, &obj->sets, obj->nfa,
+                        obj->set, length, &obj->capacity);
+  if (obj->table.nstates > n) {
+    for (c = 0; c < obj->table.nclasses; c++) {
+      obj->table.trans[state * obj->table.nclasses + c] = DFA_UNKNOWN;
+    }
+    obj->memory += (obj->table.nclasses + 1 + length) * sizeof(int) +
+      sizeof(dfa_key) + 4 * sizeof(void *);
+  }
+  return state;
+}
+
+/*
+  Make a lazy DFA's start state, the closure of every pattern's start.
+ */
+static void dfa_lazy_start(dfa_lazy *obj)
+{
+  int stamp = dfa_lazy_stamp(obj), length = 0, p;
+
+  for (p = 0; p < obj->nfa->nstarts; p++) {
+    if (obj->mark[obj->nfa->starts[p]] != stamp) {
+      obj->mark[obj->nfa->starts[p]] = stamp;
+      obj->set[length++] = obj->nfa->starts[p];
+    }
+  }
+  length = dfa_closure(obj->nfa, obj->set, length, obj->mark, stamp);
+  obj->table.start = dfa_lazy_add(obj, length);
+}
+
+/*
+  Forget every state of a lazy DFA, keeping the memory of its table.
+ */
+static void dfa_lazy_clear(dfa_lazy *obj)
+{
+  smb_status status = SMB_SUCCESS;
+  int s;
+
+  for (s = 0; s < al_length(&obj->sets); s++) {
+    dfa_key_delete(al_get(&obj->sets, s, &status).data_ptr);
+  }
+  al_destroy(&obj->sets);
+  al_init(&obj->sets);
+  ht_destroy(&obj->index);
+  ht_init(&obj->index, &dfa_key_hash, &dfa_key_compare);
+  obj->table.nstates = 0;
+  obj->memory = 0;
+}
+
+/**
+   @brief Make a lazy DFA from the union of several FSMs.
+
+   Only the start state is made here.  As with dfa_init(), the FSMs are not
+   referenced after this call.
+
+   @param obj Memory to initialize
+   @param patterns Array of FSMs.  Earlier FSMs take priority when several
+   accept in the same state.
+   @param npatterns Number of FSMs in the array
+   @param limit Bytes the cached states may take before they are flushed
+ */
+void dfa_lazy_init(dfa_lazy *obj, fsm **patterns, int npatterns,
+                   size_t limit)
+{
+  obj->nfa = smb_new(dfa_nfa, 1);
+  dfa_nfa_init(obj->nfa, patterns, npatterns);
+  obj->sig = dfa_alphabet(&obj->table, obj->nfa, &obj->words);
+  obj->table.nstates = 0;
+  obj->table.borrowed = false;
+  obj->capacity = 16;
+  obj->table.trans = smb_new(int, obj->capacity * obj->table.nclasses);
+  obj->table.accept = smb_new(int, obj->capacity);
+  al_init(&obj->sets);
+  ht_init(&obj->index, &dfa_key_hash, &dfa_key_compare);
+  obj->set = smb_new(int, obj->nfa->nstates + 1);
+  obj->mark = smb_new(int, obj->nfa->nstates + 1);
+  memset(obj->mark, 0, sizeof(int) * (obj->nfa->nstates + 1));
+  obj->stamp = 0;
+  obj->memory = 0;
+  obj->limit = limit;
+  obj->flushes = 0;
+  dfa_lazy_start(obj);
+}
+
+/**
+   @brief Allocate and make a lazy DFA.
+   @param patterns Array of FSMs, in priority order
+   @param npatterns Number of FSMs in the array
+   @param limit Bytes the cached states may take before they are flushed
+   @return The new lazy DFA
+ */
+dfa_lazy *dfa_lazy_create(fsm **patterns, int npatterns, size_t limit)
+{
+  dfa_lazy *obj = smb_new(dfa_lazy, 1);
+  dfa_lazy_init(obj, patterns, npatterns, limit);
+  return obj;
+}
+
+/**
+   @brief Free the cache and tables of a lazy DFA, but not the DFA itself.
+   @param obj The lazy DFA to clean up
+ */
+void dfa_lazy_destroy(dfa_lazy *obj)
+{
+  dfa_lazy_clear(obj);
+  al_destroy(&obj->sets);
+  ht_destroy(&obj->index);
+  dfa_destroy(&obj->table);
+  dfa_nfa_destroy(obj->nfa);
+  smb_free(obj->nfa);
+  smb_free(obj->sig);
+  smb_free(obj->set);
+  smb_free(obj->mark);
+}
+
+/**
+   @brief Free a lazy DFA and its cache.
+   @param obj The lazy DFA to delete
+ */
+void dfa_lazy_delete(dfa_lazy *obj)
+{
+  dfa_lazy_destroy(obj);
+  smb_free(obj);
+}
+
+/**
+   @brief Compute a transition of a lazy DFA, the first time it is taken.
+
+   Use dfa_lazy_step(), which only calls this for unknown transitions.  If the
+   state it leads to is new and the cache is over its limit, the cache is
+   flushed, and rebuilt with only the start state and the new state.
+
+   @param obj The lazy DFA
+   @param state The current state
+   @param c The character class being read
+   @return The next state, or DFA_DEAD.
+ */
+int dfa_lazy_fill(dfa_lazy *obj, int state, int c)
+{
+  smb_status status = SMB_SUCCESS;
+  const dfa_key *curr = al_get(&obj->sets, state, &status).data_ptr;
+  int n = obj->table.nstates, length, next, *saved;
+
+  length = dfa_move(obj->nfa, obj->sig, obj->words, curr, c, obj->set,
+                    obj->mark, dfa_lazy_stamp(obj));
+  next = dfa_lazy_add(obj, length);
+  if (obj->table.nstates == n || obj->memory <= obj->limit || n <= 1) {
+    obj->table.trans[state * obj->table.nclasses + c] = next;
+    return next;
+  }
+
+  saved = smb_new(int, length);
+  memcpy(saved, obj->set, sizeof(int) * length);
+  dfa_lazy_clear(obj);
+  obj->flushes++;
+  dfa_lazy_start(obj);
+  memcpy(obj->set, saved, sizeof(int) * length);
+  smb_free(saved);
+  return dfa_lazy_add(obj, length);
+}
+
+/**
+   @brief Run a lazy DFA over a whole string.
+
+   This answers what fsm_sim_nondet() would, without recomputing each state
+   set that has been seen before.
+
+   @param obj The lazy DFA
+   @param text The NUL terminated string
+   @return The accepting pattern of the final state, or DFA_NO_PATTERN.
+ */
+int dfa_lazy_match(dfa_lazy *obj, const wchar_t *text)
+{
+  int state = obj->table.start;
+  for (; *text != L'\0' && state != DFA_DEAD; text++) {
+    state = dfa_lazy_step(obj, state, *text);
+  }
+  return state == DFA_DEAD ? DFA_NO_PATTERN : obj->table.accept[state];
+}
+
+/*
+  Byte-range edges between the states of the byte NFA built from a DFA.  Each
+  state keeps a linked list (by edge index) of its outgoing edges.
+ */
+typedef struct {
+  int from, to, next;
+  unsigned char lo, hi;
+} dfa_edge;
+
+typedef struct {
+  dfa_edge *edges;
+  int nedges, edge_cap;
+  int *accept, *head;
+  int nstates, state_cap;
+} dfa_utf8_nfa;
+
+static int dfa_utf8_add_state(dfa_utf8_nfa *b, int accept)
+{
+  if (b->nstates >= b->state_cap) {
+    b->state_cap *= 2;
+    b->accept = smb_renew(int, b->accept, b->state_cap);
+    b->head = smb_renew(int, b->head, b->state_cap);
+  }
+  b->accept[b->nstates] = accept;
+  b->head[b->nstates] = -1;
+  return b->nstates++;
+}
+
+static void dfa_utf8_add_edge(dfa_utf8_nfa *b, int from, unsigned char lo,
+                              unsigned char hi, int to)
+{
+  if (b->nedges >= b->edge_cap) {
+    b->edge_cap *= 2;
+    b->edges = smb_renew(dfa_edge, b->edges, b->edge_cap);
+  }
+  b->edges[b->nedges].from = from;
+  b->edges[b->nedges].to = to;
+  b->edges[b->nedges].lo = lo;
+  b->edges[b->nedges].hi = hi;
+  b->edges[b->nedges].next = b->head[from];
+  b->head[from] = b->nedges++;
+}
+
+/*
+  Add a path for a sequence of byte ranges.  The states between the bytes are
+  shared with earlier sequences from the same state that used the same ranges,
+  which keeps the NFA (and the subset construction) small.
+ */
+static void dfa_utf8_add_seq(dfa_utf8_nfa *b, int from, int to,
+                             const unsigned char *lo, const unsigned char *hi,
+                             int n)
+{
+  int k, e, curr = from, next;
+  for (k = 0; k < n - 1; k++) {
+    next = -1;
+    for (e = b->head[curr]; e != -1; e = b->edges[e].next) {
+      if (b->edges[e].lo == lo[k] && b->edges[e].hi == hi[k] &&
+          b->accept[b->edges[e].to] == DFA_MID_CHAR) {
+        next = b->edges[e].to;
+        break;
+      }
+    }
+    if (next == -1) {
+      next = dfa_utf8_add_state(b, DFA_MID_CHAR);
+      dfa_utf8_add_edge(b, curr, lo[k], hi[k], next);
+    }
+    curr = next;
+  }
+  dfa_utf8_add_edge(b, curr, lo[n - 1], hi[n - 1], to);
+}
+
+static int dfa_utf8_encode(wchar_t c, unsigned char *out)
+{
+  if (c < 0x80) {
+    out[0] = c;
+    return 1;
+  } else if (c < 0x800) {
+    out[0] = 0xC0 | (c >> 6);
+    out[1] = 0x80 | (c & 0x3F);
+    return 2;
+  } else if (c < 0x10000) {
+    out[0] = 0xE0 | (c >> 12);
+    out[1] = 0x80 | ((c >> 6) & 0x3F);
+    out[2] = 0x80 | (c & 0x3F);
+    return 3;
+  } else {
+    out[0] = 0xF0 | (c >> 18);
+    out[1] = 0x80 | ((c >> 12) & 0x3F);
+    out[2] = 0x80 | ((c >> 6) & 0x3F);
+    out[3] = 0x80 | (c & 0x3F);
+    return 4;
+  }
+}
+
+/*
+  Add paths accepting the UTF-8 encoding of every character in [lo, hi].  The
+  range is split until the encodings of its ends have the same length, and
+  each byte position covers a contiguous range of bytes.  Characters without a
+  valid encoding (negative, surrogates, or beyond U+10FFFF) are dropped.
+ */
+static void dfa_utf8_range(dfa_utf8_nfa *b, int from, int to, wchar_t lo,
+                           wchar_t hi)
+{
+  static const wchar_t max_len[] = {0x7F, 0x7FF, 0xFFFF};
+  unsigned char first[4], last[4];
+  wchar_t m;
+  int i, n;
+
+  if (lo < 0) {
+    lo = 0;
+  }
+  if (hi > 0x10FFFF) {
+    hi = 0x10FFFF;
+  }
+  if (lo > hi) {
+    return;
+  }
+  if (lo <= 0xDFFF && hi >= 0xD800) {
+    dfa_utf8_range(b, from, to, lo, 0xD7FF);
+    dfa_utf8_range(b, from, to, 0xE000, hi);
+    return;
+  }
+  for (i = 0; i < 3; i++) {
+    if (lo <= max_len[i] && hi > max_len[i]) {
+      dfa_utf8_range(b, from, to, lo, max_len[i]);
+      dfa_utf8_range(b, from, to, max_len[i] + 1, hi);
+      return;
+    }
+  }
+  for (i = 1; i < 4; i++) {
+    m = (1 << (6 * i)) - 1;
+    if ((lo & ~m) != (hi & ~m)) {
+      if ((lo & m) != 0) {
+        dfa_utf8_range(b, from, to, lo, lo | m);
+        dfa_utf8_range(b, from, to, (lo | m) + 1, hi);
+        return;
+      }
+      if ((hi & m) != m) {
+        dfa_utf8_range(b, from, to, lo, (hi & ~m) - 1);
+        dfa_utf8_range(b, from, to, hi & ~m, hi);
+        return;
+      }
+    }
+  }
+  n = dfa_utf8_encode(lo, first);
+  dfa_utf8_encode(hi, last);
+  dfa_utf8_add_seq(b, from, to, first, last, n);
+}
+
+/**
+   @brief Build a DFA over UTF-8 bytes which accepts what another DFA does.
+
+   Every transition of the source DFA is replaced by paths over the bytes of
+   the UTF-8 encodings of its characters, and the result is made deterministic
+   again.  The new DFA is stepped with dfa_step_byte().  Its states are tagged
+   with the same patterns as the source, except that states reached partway
+   through a character are tagged DFA_MID_CHAR.  Malformed UTF-8 leads to
+   DFA_DEAD.
+
+   @param obj Memory to initialize
+   @param src A DFA from dfa_init(), which is not modified
+ */
+void dfa_init_utf8(dfa *obj, const dfa *src)
+{
+  dfa_utf8_nfa b;
+  dfa_nfa nfa;
+  int s, i, j, e, t;
+  wchar_t lo, hi;
+
+  b.nstates = 0;
+  b.state_cap = src->nstates + 16;
+  b.accept = smb_new(int, b.state_cap);
+  b.head = smb_new(int, b.state_cap);
+  b.nedges = 0;
+  b.edge_cap = 64;
+  b.edges = smb_new(dfa_edge, b.edge_cap);
+
+  // The source states keep their numbers and tags.
+  for (s = 0; s < src->nstates; s++) {
+    dfa_utf8_add_state(&b, src->accept[s]);
+  }
+  for (s = 0; s < src->nstates; s++) {
+    for (i = 0; i < src->nbounds; i = j) {
+      // Merge neighboring ranges which lead to the same state.
+      t = src->trans[s * src->nclasses + src->bound_class[i]];
+      for (j = i + 1; j < src->nbounds; j++) {
+        if (src->trans[s * src->nclasses + src->bound_class[j]] != t) {
+          break;
+        }
+      }
+      if (t == DFA_DEAD) {
+        continue;
+      }
+      lo = src->bounds[i];
+      hi = j < src->nbounds ? src->bounds[j] - 1 : WCHAR_MAX;
+      dfa_utf8_range(&b, s, t, lo, hi);
+    }
+  }
+
+  // Turn the edge lists into a flat NFA for the subset construction.
+  nfa.nstates = b.nstates;
+  nfa.ntrans = b.nedges;
+  nfa.first = smb_new(int, nfa.nstates + 1);
+  nfa.trans = smb_new(const fsm_trans *, nfa.ntrans + 1);
+  nfa.dest = smb_new(int, nfa.ntrans + 1);
+  nfa.epsilon = smb_new(bool, nfa.ntrans + 1);
+  nfa.accept = b.accept;
+  nfa.nstarts = src->start == DFA_DEAD ? 0 : 1;
+  nfa.starts = smb_new(int, 1);
+  nfa.starts[0] = src->start;
+  nfa.owns_trans = true;
+  for (s = 0, i = 0; s < b.nstates; s++) {
+    nfa.first[s] = i;
+    for (e = b.head[s]; e != -1; e = b.edges[e].next) {
+      nfa.trans[i] = fsm_trans_create_single(b.edges[e].lo, b.edges[e].hi,
+                                             FSM_TRANS_POSITIVE,
+                                             b.edges[e].to);
+      nfa.dest[i] = b.edges[e].to;
+      nfa.epsilon[i] = false;
+      i++;
+    }
+  }
+  nfa.first[b.nstates] = i;
+
+  dfa_build(obj, &nfa);
+  dfa_nfa_destroy(&nfa); // frees b.accept
+  smb_free(b.head);
+  smb_free(b.edges);
+}
+
+/**
+   @brief Allocate and build a DFA over UTF-8 bytes from another DFA.
+   @param src A DFA from dfa_init()
+   @return The new byte DFA
+   @see dfa_init_utf8
+ */
+dfa *dfa_create_utf8(const dfa *src)
+{
+  dfa *obj = smb_new(dfa, 1);
+  dfa_init_utf8(obj, src);
+  return obj;
+}
+
+/*
+  Mark the states which are reachable from the start state and can reach an
+  accepting state.  Only paths through these states can lead to a match.
+ */
+static bool *dfa_live(const dfa *obj)
+{
+  bool *reach = smb_new(bool, obj->nstates);
+  bool *live = smb_new(bool, obj->nstates);
+  int *queue = smb_new(int, obj->nstates);
+  int head = 0, tail = 0, s, c, t;
+  bool changed = true;
+
+  memset(reach, 0, obj->nstates * sizeof(bool));
+  if (obj->start != DFA_DEAD) {
+    reach[obj->start] = true;
+    queue[tail++] = obj->start;
+  }
+  while (head < tail) {
+    s = queue[head++];
+    for (c = 0; c < obj->nclasses; c++) {
+      t = obj->trans[s * obj->nclasses + c];
+      if (t != DFA_DEAD && !reach[t]) {
+        reach[t] = true;
+        queue[tail++] = t;
+      }
+    }
+  }
+
+  for (s = 0; s < obj->nstates; s++) {
+    live[s] = reach[s] && obj->accept[s] >= 0;
+  }
+  while (changed) {
+    changed = false;
+    for (s = obj->nstates - 1; s >= 0; s--) {
+      for (c = 0; reach[s] && !live[s] && c < obj->nclasses; c++) {
+        t = obj->trans[s * obj->nclasses + c];
+        if (t != DFA_DEAD && live[t]) {
+          live[s] = changed = true;
+        }
+      }
+    }
+  }
+
+  smb_free(reach);
+  smb_free(queue);
+  return live;
+}
+
+/*
+  Return true if every path from the start state to an accepting state passes
+  through a state, by looking for one that doesn't.
+ */
+static bool dfa_dominates(const dfa *obj, const bool *live, int state,
+                          int *queue, bool *seen)
+{
+  int head = 0, tail = 0, s, c, t;
+
+  if (obj->start == state) {
+    return true;
+  }
+  memset(seen, 0, obj->nstates * sizeof(bool));
+  seen[obj->start] = seen[state] = true;
+  queue[tail++] = obj->start;
+  while (head < tail) {
+    s = queue[head++];
+    if (obj->accept[s] >= 0) {
+      return false;
+    }
+    for (c = 0; c < obj->nclasses; c++) {
+      t = obj->trans[s * obj->nclasses + c];
+      if (t != DFA_DEAD && live[t] && !seen[t]) {
+        seen[t] = true;
+        queue[tail++] = t;
+      }
+    }
+  }
+  return true;
+}
+
+/*
+  Return the length of the literal read on the way into a state: the labels
+  of the chain of single predecessors that leads to it, stored last byte
+  first in out if it isn't NULL.  Entries at nstates + s are for the first
+  entry into s, which never comes from s itself; the states before it on the
+  chain count their loops.  The chain's first state is stored in root.
+ */
+static int dfa_chain(const int *pred, const int *label, int nstates,
+                     int state, int *root, unsigned char *out)
+{
+  int length = 0, entry = nstates + state;
+
+  *root = entry;
+  while (length < DFA_LITERAL_MAX && label[entry] >= 0) {
+    if (out != NULL) {
+      out[length] = label[entry];
+    }
+    length++;
+    *root = entry;
+    if (pred[entry] < 0 || pred[entry] == state) {
+      break;
+    }
+    state = entry = pred[entry];
+  }
+  return length;
+}
+
+/*
+  Record an edge into a state, for dfa_chain().
+ */
+static void dfa_enter(int *pred, int *label, int entry, int from, int byte)
+{
+  pred[entry] = pred[entry] == -2 || pred[entry] == from ? from : -1;
+  label[entry] = label[entry] == -2 || label[entry] == byte ? byte : -1;
+}
+
+/**
+   @brief Find the first bytes and required literal of a byte DFA.
+
+   Finding the literal takes a pass over the transition table, and a search of
+   the table for each of a few candidates, so a prefilter should be made once
+   for many searches.
+
+   @param obj Memory to initialize
+   @param bytes Byte DFA, from dfa_create_utf8()
+ */
+void dfa_prefilter_init(dfa_prefilter *obj, const dfa *bytes)
+{
+  bool *live = dfa_live(bytes), *seen = smb_new(bool, bytes->nstates);
+  int *queue = smb_new(int, bytes->nstates);
+  int *pred = smb_new(int, 2 * bytes->nstates);
+  int *label = smb_new(int, 2 * bytes->nstates);
+  int *chain = smb_new(int, bytes->nstates);
+  int single[DFA_DIRECT], members[DFA_DIRECT];
+  unsigned char reversed[DFA_LITERAL_MAX];
+  int length, best = 0, tries = 0, s, c, t, b, root;
+  bool reentered = false;
+
+  // The single byte in each class, or -1 for a class of several bytes.
+  memset(members, 0, sizeof(members));
+  for (b = 0; b < DFA_DIRECT; b++) {
+    members[bytes->direct[b]]++;
+    single[bytes->direct[b]] = b;
+  }
+  for (c = 0; c < bytes->nclasses; c++) {
+    if (members[c] != 1) {
+      single[c] = -1;
+    }
+  }
+
+  obj->nfirst = 0;
+  for (b = 0; b < DFA_DIRECT; b++) {
+    t = bytes->start == DFA_DEAD ? DFA_DEAD :
+      bytes->trans[bytes->start * bytes->nclasses + bytes->direct[b]];
+    obj->first[b] = t != DFA_DEAD && live[t];
+    obj->nfirst += obj->first[b];
+  }
+
+  // Each live state's one predecessor and one incoming byte, -2 for none
+  // yet, and -1 for more than one, and then the same for the edges from other
+  // states.
+  for (s = 0; s < 2 * bytes->nstates; s++) {
+    pred[s] = label[s] = -2;
+  }
+  for (s = 0; s < bytes->nstates; s++) {
+    for (c = 0; live[s] && c < bytes->nclasses; c++) {
+      t = bytes->trans[s * bytes->nclasses + c];
+      if (t == DFA_DEAD || !live[t]) {
+        continue;
+      }
+      dfa_enter(pred, label, t, s, single[c]);
+      if (t != s) {
+        dfa_enter(pred, label, bytes->nstates + t, s, single[c]);
+      }
+    }
+  }
+
+  // The start state is also entered before the first byte, so no literal
+  // runs through it.
+  if (bytes->start != DFA_DEAD) {
+    reentered = pred[bytes->start] != -2;
+    label[bytes->start] = label[bytes->nstates + bytes->start] = -1;
+  }
+
+  // Try the states with the longest literals first.
+  obj->literal_length = 0;
+  obj->prefix = false;
+  for (s = 0; s < bytes->nstates; s++) {
+    chain[s] = live[s] ? dfa_chain(pred, label, bytes->nstates, s, &root,
+                                   NULL) : 0;
+    best = chain[s] > best ? chain[s] : best;
+  }
+  for (length = best; length > 0 && obj->literal_length == 0; length--) {
+    for (s = 0; s < bytes->nstates && tries < 32; s++) {
+      if (chain[s] != length) {
+        continue;
+      }
+      tries++;
+      if (dfa_dominates(bytes, live, s, queue, seen)) {
+        dfa_chain(pred, label, bytes->nstates, s, &root, reversed);
+        obj->literal_length = length;
+        obj->prefix = length < DFA_LITERAL_MAX && !reentered &&
+          pred[root] == bytes->start;
+        for (b = 0; b < length; b++) {
+          obj->literal[b] = reversed[length - 1 - b];
+        }
+        break;
+      }
+    }
+  }
+
+  smb_free(live);
+  smb_free(seen);
+  smb_free(queue);
+  smb_free(pred);
+  smb_free(label);
+  smb_free(chain);
+}
+
+/**
+   @brief Find the first occurrence of a prefilter's required literal.
+
+   Candidates for the literal's first byte are found with memchr(), which the
+   C library scans for a word or a vector at a time.
+
+   @param obj The prefilter, which must have a literal
+   @param text The text to search
+   @param length Number of bytes of text
+   @return The literal's first byte in the text, or NULL if it isn't there.
+ */
+const char *dfa_prefilter_find(const dfa_prefilter *obj, const char *text,
+                               size_t length)
+{
+  const char *end = text + length, *p = text;
+  size_t n = obj->literal_length;
+
+  while ((size_t) (end - p) >= n &&
+         (p = memchr(p, obj->literal[0], end - p - n + 1)) != NULL) {
+    if (memcmp(p, obj->literal, n) == 0) {
+      return p;
+    }
+    p++;
+  }
+  return NULL;
+}
+
+/**
+   @brief Find matches of a byte DFA in UTF-8 text.
+
+   This searches the same way as libstephen's fsm_search(), but over bytes:
+   matches start at each character in turn, and hit indices and lengths are in
+   bytes.  Empty matches are not reported.  The search makes a prefilter for
+   the DFA first; to search many texts, make it once and use
+   dfa_search_filtered().
+
+   @param obj Byte DFA, from dfa_create_utf8()
+   @param text The text to search
+   @param length Number of bytes of text
+   @param greedy Report the longest match at each start, not the shortest
+   @param overlap Look for the next match inside the previous one
+   @return A list of regex_hit pointers, all owned by the caller
+ */
+smb_al *dfa_search_utf8(const dfa *obj, const char *text, size_t length,
+                        bool greedy, bool overlap)
+{
+  dfa_prefilter filter;
+  dfa_prefilter_init(&filter, obj);
+  return dfa_search_filtered(obj, &filter, text, length, greedy, overlap);
+}
+
+/**
+   @brief Find matches of a byte DFA in UTF-8 text, skipping text that can't
+   begin a match.
+
+   The DFA only runs from candidate starts.  Once the required literal no
+   longer occurs, the search ends; a literal that begins every match, or a
+   single first byte, is found with memchr().  Other first bytes are checked
+   against a table.  In valid UTF-8, the hits are those of dfa_search_utf8()
+   without a prefilter; in invalid UTF-8, a candidate found with memchr() may
+   be a byte that character stepping would have skipped.
+
+   @param obj Byte DFA, from dfa_create_utf8()
+   @param filter Prefilter made from the DFA
+   @param text The text to search
+   @param length Number of bytes of text
+   @param greedy Report the longest match at each start, not the shortest
+   @param overlap Look for the next match inside the previous one
+   @return A list of regex_hit pointers, all owned by the caller
+ */
+smb_al *dfa_search_filtered(const dfa *obj, const dfa_prefilter *filter,
+                            const char *text, size_t length, bool greedy,
+                            bool overlap)
+{
+  smb_al *results = al_create();
+  const unsigned char *s = (const unsigned char *) text;
+  const unsigned char *p;
+  const char *found;
+  size_t start = 0, literal = 0, i, step, last;
+  bool searched = false;
+  int state, first = -1;
+
+  for (i = 0; filter->nfirst == 1 && i < DFA_DIRECT; i++) {
+    first = filter->first[i] ? (int) i : first;
+  }
+  while (start < length && filter->nfirst > 0) {
+    // Every match at or after start contains the next literal.
+    if (filter->literal_length > 0 && (!searched || literal < start)) {
+      found = dfa_prefilter_find(filter, text + start, length - start);
+      if (found == NULL) {
+        break;
+      }
+      literal = found - text;
+      searched = true;
+      if (filter->prefix) {
+        start = literal;
+      }
+    }
+    if (first >= 0) {
+      p = memchr(s + start, first, length - start);
+      if (p == NULL) {
+        break;
+      }
+      start = p - s;
+    } else {
+      while (start < length && !filter->first[s[start]]) {
+        start += dfa_utf8_length(s[start]);
+      }
+      if (start >= length) {
+        break;
+      }
+    }
+
+    state = obj->start;
+    last = 0;
+    for (i = start; i < length && state != DFA_DEAD; i++) {
+      state = dfa_step_byte(obj, state, s[i]);
+      if (state != DFA_DEAD && obj->accept[state] >= 0) {
+        last = i + 1 - start;
+        if (!greedy) {
+          break;
+        }
+      }
+    }
+
+    step = dfa_utf8_length(s[start]);
+    if (last > 0) {
+      al_append(results, (DATA){.data_ptr=regex_hit_create(start, last)});
+      if (!overlap) {
+        step = last;
+      }
+    }
+    start += step;
+  }
+  return results;
+}
+
+/**
+   @brief Allocate and build a DFA from the union of several FSMs.
+   @param patterns Array of FSMs, in priority order
+   @param npatterns Number of FSMs in the array
+   @return The new DFA
+ */
+dfa *dfa_create(fsm **patterns, int npatterns)
+{
+  dfa *obj = smb_new(dfa, 1);
+  dfa_init(obj, patterns, npatterns);
+  return obj;
+}
+
+/**
+   @brief Free the tables of a DFA, but not the DFA itself.
+   @param obj The DFA to clean up
+ */
+void dfa_destroy(dfa *obj)
+{
+  if (obj->borrowed) {
+    return;
+  }
+  smb_free(obj->bounds);
+  smb_free(obj->bound_class);
+  smb_free(obj->trans);
+  smb_free(obj->accept);
+}
+
+/**
+   @brief Free a DFA and its tables.
+   @param obj The DFA to delete
+ */
+void dfa_delete(dfa *obj)
+{
+  dfa_destroy(obj);
+  smb_free(obj);
+}
+
+/**
+   @brief Find the character class of any character, by binary search.
+
+   Use dfa_class() instead, which looks up common characters directly.
+
+   @param obj The DFA
+   @param c The character to classify
+   @return The class of the character
+ */
+int dfa_class_slow(const dfa *obj, wchar_t c)
+{
+  int lo = 0, hi = obj->nbounds - 1, mid;
+  // Find the last bound <= c.  bounds[0] is WCHAR_MIN, so one always exists.
+  while (lo < hi) {
+    mid = lo + (hi - lo + 1) / 2;
+    if (obj->bounds[mid] <= c) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return obj->bound_class[lo];
+}
+
+/*
+  Tables are written padded to a multiple of DFA_ALIGN bytes, so that every
+  table of a mapped image is aligned for its type.
+ */
+#define DFA_ALIGN 8
+
+static size_t dfa_padded(size_t size)
+{
+  return (size + DFA_ALIGN - 1) / DFA_ALIGN * DFA_ALIGN;
+}
+
+/**
+   @brief Write a table to an image file, padded for alignment.
+   @param data The table
+   @param size Size of the table in bytes
+   @param f File to write to
+   @return False if writing failed.
+ */
+bool dfa_write_table(const void *data, size_t size, FILE *f)
+{
+  static const char zeros[DFA_ALIGN] = {0};
+  if (size > 0 && fwrite(data, 1, size, f) != size) {
+    return false;
+  }
+  size = dfa_padded(size) - size;
+  return size == 0 || fwrite(zeros, 1, size, f) == size;
+}
+
+/**
+   @brief Return a table of an image, and move past it.
+   @param pos Pointer to the current position in the image, which is advanced
+   @param end The end of the image
+   @param size Size of the table in bytes
+   @return The table, or NULL if the image is too short to hold it.
+ */
+const void *dfa_map_table(const char **pos, const char *end, size_t size)
+{
+  const void *table = *pos;
+  if ((size_t) (end - *pos) < dfa_padded(size)) {
+    return NULL;
+  }
+  *pos += dfa_padded(size);
+  return table;
+}
+
+/**
+   @brief Write a DFA's tables to a file, in the format read by dfa_map().
+
+   The image is in the machine's native byte order and type sizes.  It is
+   meant as a cache, not an interchange format.
+
+   @param obj The DFA to write
+   @param f The file to write to
+   @return False if writing failed.
+ */
+bool dfa_write(const dfa *obj, FILE *f)
+{
+  int header[4];
+  header[0] = obj->nstates;
+  header[1] = obj->nclasses;
+  header[2] = obj->start;
+  header[3] = obj->nbounds;
+  return dfa_write_table(header, sizeof(header), f) &&
+    dfa_write_table(obj->direct, sizeof(obj->direct), f) &&
+    dfa_write_table(obj->bounds, sizeof(wchar_t) * obj->nbounds, f) &&
+    dfa_write_table(obj->bound_class, sizeof(int) * obj->nbounds, f) &&
+    dfa_write_table(obj->trans, sizeof(int) * obj->nstates * obj->nclasses,
+                    f) &&
+    dfa_write_table(obj->accept, sizeof(int) * obj->nstates, f);
+}
+
+/**
+   @brief Initialize a DFA whose tables are an image written by dfa_write().
+
+   Nothing is copied except the direct lookup table: the DFA points into the
+   image, which must stay valid (and unchanged) for as long as the DFA is
+   used.  dfa_destroy() leaves the image alone.  The image must be aligned to
+   at least eight bytes.
+
+   @param obj The DFA to initialize
+   @param image The start of the image
+   @param size Number of bytes available at image
+   @return Number of bytes of the image used, or 0 if it was truncated.
+ */
+size_t dfa_map(dfa *obj, const void *image, size_t size)
+{
+  const char *pos = image, *end = pos + size;
+  const int *header, *direct;
+
+  header = dfa_map_table(&pos, end, 4 * sizeof(int));
+  direct = dfa_map_table(&pos, end, sizeof(obj->direct));
+  if (header == NULL || direct == NULL ||
+      header[0] < 0 || header[1] < 1 || header[3] < 1) {
+    return 0;
+  }
+  obj->nstates = header[0];
+  obj->nclasses = header[1];
+  obj->start = header[2];
+  obj->nbounds = header[3];
+  memcpy(obj->direct, direct, sizeof(obj->direct));
+  obj->bounds = (wchar_t *) dfa_map_table(&pos, end,
+                                          sizeof(wchar_t) * obj->nbounds);
+  obj->bound_class = (int *) dfa_map_table(&pos, end,
+                                           sizeof(int) * obj->nbounds);
+  obj->trans = (int *) dfa_map_table(
+      &pos, end, sizeof(int) * (size_t) obj->nstates * obj->nclasses);
+  obj->accept = (int *) dfa_map_table(&pos, end, sizeof(int) * obj->nstates);
+  obj->borrowed = true;
+  if (obj->bounds == NULL || obj->bound_class == NULL || obj->trans == NULL ||
+      obj->accept == NULL) {
+    return 0;
+  }
+  return pos - (const char *) image;
+}
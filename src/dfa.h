@@ -0,0 +1,380 @@
+/***************************************************************************//**
+
+  @file         dfa.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Deterministic automata compiled from libstephen FSMs.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#ifndef SMB_DFA_H
+#define SMB_DFA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <wchar.h>
+
+#include "libstephen/al.h"
+#include "libstephen/ht.h"
+#include "libstephen/fsm.h"
+
+/**
+   @brief State number used for "no state": the automaton has rejected.
+ */
+#define DFA_DEAD -1
+
+/**
+   @brief The accept tag of a state that accepts none of the patterns.
+ */
+#define DFA_NO_PATTERN -1
+
+/**
+   @brief The accept tag of a byte DFA state in the middle of a character.
+
+   @see dfa_init_utf8
+ */
+#define DFA_MID_CHAR -2
+
+/**
+   @brief A lazy DFA transition that hasn't been computed yet.
+
+   @see dfa_lazy
+ */
+#define DFA_UNKNOWN -3
+
+/**
+   @brief Default memory limit of a lazy DFA's cache, in bytes.
+ */
+#define DFA_LAZY_LIMIT (1 << 20)
+
+/**
+   @brief Characters below this value are classified with a direct lookup.
+ */
+#define DFA_DIRECT 256
+
+/**
+   @brief A DFA built from the union of one or more FSMs.
+
+   The input alphabet is partitioned into character classes: ranges of
+   characters which every transition of every source FSM treats identically.
+   The transition table is indexed by state and class.  Each state is tagged
+   with the lowest index of a source FSM that accepts in that state, so that
+   a single DFA can stand in for a prioritized list of patterns.
+
+   A DFA may instead run over the bytes of UTF-8 text, in which case each
+   character is a byte value and states between the bytes of one character are
+   tagged DFA_MID_CHAR.
+
+   @see dfa_create
+   @see dfa_create_utf8
+   @see dfa_step
+ */
+typedef struct {
+
+  /**
+     @brief The number of states in the DFA.
+   */
+  int nstates;
+
+  /**
+     @brief The number of character classes (columns of the table).
+   */
+  int nclasses;
+
+  /**
+     @brief The starting state, or DFA_DEAD if nothing can be accepted.
+   */
+  int start;
+
+  /**
+     @brief Number of entries in dfa.bounds and dfa.bound_class.
+   */
+  int nbounds;
+
+  /**
+     @brief Sorted lower bounds of the character ranges.
+
+     Range `i` covers `bounds[i]` up to (but not including) `bounds[i+1]`.  The
+     first bound is always WCHAR_MIN.
+   */
+  wchar_t *bounds;
+
+  /**
+     @brief The character class of each range in dfa.bounds.
+   */
+  int *bound_class;
+
+  /**
+     @brief Direct character class lookup for characters below DFA_DIRECT.
+   */
+  int direct[DFA_DIRECT];
+
+  /**
+     @brief Transition table, `nstates * nclasses` entries.
+   */
+  int *trans;
+
+  /**
+     @brief For each state, the lowest accepting pattern, or DFA_NO_PATTERN.
+   */
+  int *accept;
+
+  /**
+     @brief True when the tables belong to a mapped image, not to the DFA.
+
+     @see dfa_map
+   */
+  bool borrowed;
+
+} dfa;
+
+/**
+   @brief The longest required literal a prefilter keeps.
+ */
+#define DFA_LITERAL_MAX 64
+
+/**
+   @brief What every match of a byte DFA must contain, to skip text quickly.
+
+   The first bytes are those a match can begin with.  The required literal is
+   a string of bytes that every accepted string contains.  It is found in the
+   DFA rather than the regex: a state whose every incoming edge is labelled
+   with the same single byte, from the same single state, extends the literal
+   of that state by the byte.  The literal is kept if every path to an
+   accepting state passes through its last state.
+
+   @see dfa_prefilter_init
+   @see dfa_search_filtered
+ */
+typedef struct {
+
+  /**
+     @brief Whether a match can begin with each byte.
+   */
+  bool first[256];
+
+  /**
+     @brief Number of bytes in dfa_prefilter.first.
+   */
+  int nfirst;
+
+  /**
+     @brief Bytes of the required literal.
+   */
+  unsigned char literal[DFA_LITERAL_MAX];
+
+  /**
+     @brief Number of bytes of the required literal, or 0 if there is none.
+   */
+  int literal_length;
+
+  /**
+     @brief True if every match begins with the required literal.
+   */
+  bool prefix;
+
+} dfa_prefilter;
+
+/**
+   @brief A DFA whose states and transitions are made as the input needs them.
+
+   Each state is a set of NFA states, as in dfa_init(), but a transition is
+   only computed the first time it is taken, and the state it leads to is only
+   made then.  So a pattern whose full DFA would be exponentially large only
+   costs the states some input visits, at most one per character.  The states
+   are cached until they take more than dfa_lazy.limit bytes, when the whole
+   cache is flushed and rebuilt from the state in use.
+
+   The character classes are computed up front, as they are for a full DFA.
+
+   @see dfa_lazy_init
+   @see dfa_lazy_step
+ */
+typedef struct {
+
+  /**
+     @brief The states so far, whose transitions may be DFA_UNKNOWN.
+   */
+  dfa table;
+
+  /**
+     @brief The flattened source FSMs.
+   */
+  struct dfa_nfa *nfa;
+
+  /**
+     @brief For each class, the NFA transitions it takes, as a bitset.
+   */
+  unsigned int *sig;
+
+  /**
+     @brief Words in each bitset of dfa_lazy.sig.
+   */
+  int words;
+
+  /**
+     @brief The NFA state set of each state, by the state number.
+   */
+  smb_al sets;
+
+  /**
+     @brief Maps NFA state sets to states.
+   */
+  smb_ht index;
+
+  /**
+     @brief Room for states in the table.
+   */
+  int capacity;
+
+  /**
+     @brief Scratch NFA state set, and marks of the states in it.
+   */
+  int *set, *mark;
+
+  /**
+     @brief The value marking states of the scratch set.
+   */
+  int stamp;
+
+  /**
+     @brief Bytes of cache used, estimated from the states and their sets.
+   */
+  size_t memory;
+
+  /**
+     @brief Bytes of cache allowed before it is flushed.
+   */
+  size_t limit;
+
+  /**
+     @brief Number of times the cache has been flushed.
+   */
+  int flushes;
+
+} dfa_lazy;
+
+void dfa_init(dfa *obj, fsm **patterns, int npatterns);
+dfa *dfa_create(fsm **patterns, int npatterns);
+void dfa_init_utf8(dfa *obj, const dfa *src);
+dfa *dfa_create_utf8(const dfa *src);
+void dfa_destroy(dfa *obj);
+void dfa_delete(dfa *obj);
+bool dfa_write(const dfa *obj, FILE *f);
+size_t dfa_map(dfa *obj, const void *image, size_t size);
+bool dfa_write_table(const void *data, size_t size, FILE *f);
+const void *dfa_map_table(const char **pos, const char *end, size_t size);
+
+int dfa_class_slow(const dfa *obj, wchar_t c);
+smb_al *dfa_search_utf8(const dfa *obj, const char *text, size_t length,
+                        bool greedy, bool overlap);
+void dfa_prefilter_init(dfa_prefilter *obj, const dfa *bytes);
+const char *dfa_prefilter_find(const dfa_prefilter *obj, const char *text,
+                               size_t length);
+smb_al *dfa_search_filtered(const dfa *obj, const dfa_prefilter *filter,
+                            const char *text, size_t length, bool greedy,
+                            bool overlap);
+
+void dfa_lazy_init(dfa_lazy *obj, fsm **patterns, int npatterns,
+                   size_t limit);
+dfa_lazy *dfa_lazy_create(fsm **patterns, int npatterns, size_t limit);
+void dfa_lazy_destroy(dfa_lazy *obj);
+void dfa_lazy_delete(dfa_lazy *obj);
+int dfa_lazy_fill(dfa_lazy *obj, int state, int c);
+int dfa_lazy_match(dfa_lazy *obj, const wchar_t *text);
+
+/**
+   @brief Return the character class of a character.
+   @param obj The DFA
+   @param c The character to classify
+   @return Class index, suitable for indexing a row of dfa.trans.
+ */
+static inline int dfa_class(const dfa *obj, wchar_t c)
+{
+  if (c >= 0 && c < DFA_DIRECT) {
+    return obj->direct[c];
+  }
+  return dfa_class_slow(obj, c);
+}
+
+/**
+   @brief Advance a DFA by one character.
+   @param obj The DFA
+   @param state The current state (may be DFA_DEAD)
+   @param c The input character
+   @return The next state, or DFA_DEAD.
+ */
+static inline int dfa_step(const dfa *obj, int state, wchar_t c)
+{
+  if (state == DFA_DEAD) {
+    return DFA_DEAD;
+  }
+  return obj->trans[state * obj->nclasses + dfa_class(obj, c)];
+}
+
+/**
+   @brief Return the length of a UTF-8 character from its first byte.
+
+   Bytes which can't begin a character count as a character of their own.
+
+   @param b The first byte of the character
+   @return The number of bytes in the character, from 1 to 4.
+ */
+static inline int dfa_utf8_length(unsigned char b)
+{
+  if (b >= 0xF0 && b < 0xF8) {
+    return 4;
+  } else if (b >= 0xE0 && b < 0xF0) {
+    return 3;
+  } else if (b >= 0xC0 && b < 0xE0) {
+    return 2;
+  }
+  return 1;
+}
+
+/**
+   @brief Advance a byte DFA by one byte of UTF-8 text.
+   @param obj The byte DFA, from dfa_create_utf8()
+   @param state The current state (may be DFA_DEAD)
+   @param b The input byte
+   @return The next state, or DFA_DEAD.
+ */
+static inline int dfa_step_byte(const dfa *obj, int state, unsigned char b)
+{
+  if (state == DFA_DEAD) {
+    return DFA_DEAD;
+  }
+  return obj->trans[state * obj->nclasses + obj->direct[b]];
+}
+
+/**
+   @brief Advance a lazy DFA by one character, computing the transition if
+   it hasn't been taken before.
+
+   Computing a transition may flush the cache, after which only the returned
+   state is valid.
+
+   @param obj The lazy DFA
+   @param state The current state (may be DFA_DEAD)
+   @param c The input character
+   @return The next state, or DFA_DEAD.
+ */
+static inline int dfa_lazy_step(dfa_lazy *obj, int state, wchar_t c)
+{
+  int cls, next;
+  if (state == DFA_DEAD) {
+    return DFA_DEAD;
+  }
+  cls = dfa_class(&obj->table, c);
+  next = obj->table.trans[state * obj->table.nclasses + cls];
+  return next == DFA_UNKNOWN ? dfa_lazy_fill(obj, state, cls) : next;
+}
+
+#endif//SMB_DFA_H
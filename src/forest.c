@@ -0,0 +1,447 @@
+/***************************************************************************//**
+
+  @file         forest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Packed shared parse forests from CKY charts.
+
+  The forest is read off a filled chart from the top down.  Starting from the
+  start symbol over the whole sentence, each diagonal of the chart is visited
+  from the longest spans to the shortest.  By the time a cell is reached, every
+  node which could use it has already been visited, so the cell's useful
+  nonterminals are known.  Their edges are found from the chart, and mark the
+  children they use as useful in turn.  Nonterminals which are in a cell but
+  take part in no complete parse never become nodes.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "libstephen/base.h"
+#include "cky.h"
+#include "forest.h"
+
+/*
+  State while building a forest.  Edges are first stored with the symbols of
+  their children, and resolved to node numbers once every node exists.
+ */
+typedef struct {
+
+  cky_forest *obj;
+  const cky_chart *chart;
+  cky_word *useful; // bitsets laid out like a chart with capacity length
+  int *base; // the first node of each cell
+  int *slot; // the node of each nonterminal in the current cell, or -1
+  int first; // the first node of the current cell
+  int *cursor; // the next edge to fill for each node of the current cell
+  int *edge_split; // the split of each edge, until it is resolved
+  int node_capacity;
+  int edge_capacity;
+
+} cky_forest_builder;
+
+static uint64_t cky_count_add(uint64_t a, uint64_t b)
+{
+  return a > CKY_COUNT_MAX - b ? CKY_COUNT_MAX : a + b;
+}
+
+static uint64_t cky_count_mul(uint64_t a, uint64_t b)
+{
+  if (a == 0 || b == 0) {
+    return 0;
+  }
+  return a > CKY_COUNT_MAX / b ? CKY_COUNT_MAX : a * b;
+}
+
+static size_t cky_forest_cell(const cky_forest *obj, int start, int length)
+{
+  return cky_chart_offset(obj->length, length) + start;
+}
+
+static cky_word *cky_forest_useful(cky_forest_builder *b, int start,
+                                   int length)
+{
+  return b->useful +
+    cky_forest_cell(b->obj, start, length) * b->chart->gram->nwords;
+}
+
+/*
+  Return the number of members of a bitset below a nonterminal.
+ */
+static int cky_bit_rank(const cky_word *set, int a)
+{
+  int w, rank = 0;
+  for (w = 0; w < a / CKY_WORD_BITS; w++) {
+    rank += __builtin_popcountll(set[w]);
+  }
+  return rank + __builtin_popcountll(
+      set[w] & (((cky_word) 1 << (a % CKY_WORD_BITS)) - 1));
+}
+
+static void cky_forest_add_node(cky_forest_builder *b, int symbol, int start,
+                                int length)
+{
+  cky_forest *obj = b->obj;
+  if (obj->nnodes == b->node_capacity) {
+    b->node_capacity *= 2;
+    obj->node_symbol = smb_renew(int, obj->node_symbol, b->node_capacity);
+    obj->node_start = smb_renew(int, obj->node_start, b->node_capacity);
+    obj->node_length = smb_renew(int, obj->node_length, b->node_capacity);
+    obj->node_first = smb_renew(int, obj->node_first, b->node_capacity + 1);
+  }
+  b->slot[symbol] = obj->nnodes;
+  obj->node_symbol[obj->nnodes] = symbol;
+  obj->node_start[obj->nnodes] = start;
+  obj->node_length[obj->nnodes] = length;
+  obj->nnodes++;
+}
+
+static void cky_forest_reserve_edges(cky_forest_builder *b, int count)
+{
+  cky_forest *obj = b->obj;
+  if (obj->nedges + count <= b->edge_capacity) {
+    return;
+  }
+  while (obj->nedges + count > b->edge_capacity) {
+    b->edge_capacity *= 2;
+  }
+  obj->edge_left = smb_renew(int, obj->edge_left, b->edge_capacity);
+  obj->edge_right = smb_renew(int, obj->edge_right, b->edge_capacity);
+  obj->edge_total = smb_renew(uint64_t, obj->edge_total, b->edge_capacity);
+  b->edge_split = smb_renew(int, b->edge_split, b->edge_capacity);
+}
+
+/*
+  Visit every edge A -> B C of a cell whose A is a node.  When counting, the
+  edges of each node are counted in node_first, and their children are marked
+  useful.  Otherwise, they are stored at each node's cursor.
+ */
+static void cky_forest_edges(cky_forest_builder *b, int start, int length,
+                             bool counting)
+{
+  const cky_grammar *g = b->chart->gram;
+  cky_forest *obj = b->obj;
+  const cky_word *left, *right, *mask;
+  cky_word lbits, rbits;
+  int k, w, v, e, lhs, node, one, two, at;
+
+  for (k = 1; k < length; k++) {
+    left = cky_chart_cell(b->chart, start, k);
+    right = cky_chart_cell(b->chart, start + k, length - k);
+    for (w = 0; w < g->nwords; w++) {
+      for (lbits = left[w]; lbits != 0; lbits &= lbits - 1) {
+        one = w * CKY_WORD_BITS + __builtin_ctzll(lbits);
+        for (e = g->pair_first[one]; e < g->pair_first[one + 1]; e++) {
+          lhs = g->pair_lhs[e];
+          node = b->slot[lhs];
+          if (node < 0) {
+            continue;
+          }
+          mask = g->pair_mask + e * g->nwords;
+          for (v = 0; v < g->nwords; v++) {
+            for (rbits = mask[v] & right[v]; rbits != 0;
+                 rbits &= rbits - 1) {
+              two = v * CKY_WORD_BITS + __builtin_ctzll(rbits);
+              if (counting) {
+                obj->node_first[node]++;
+                cky_bit_set(cky_forest_useful(b, start, k), one);
+                cky_bit_set(cky_forest_useful(b, start + k, length - k), two);
+              } else {
+                at = b->cursor[node - b->first]++;
+                obj->edge_left[at] = one;
+                obj->edge_right[at] = two;
+                b->edge_split[at] = k;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/*
+  Make the nodes of one cell from its useful bits, and store their edges.
+ */
+static void cky_forest_visit(cky_forest_builder *b, int start, int length)
+{
+  const cky_grammar *g = b->chart->gram;
+  cky_forest *obj = b->obj;
+  const cky_word *useful = cky_forest_useful(b, start, length);
+  int first = obj->nnodes, w, a, node, total;
+  cky_word bits;
+
+  b->base[cky_forest_cell(obj, start, length)] = first;
+  b->first = first;
+  for (w = 0; w < g->nwords; w++) {
+    for (bits = useful[w]; bits != 0; bits &= bits - 1) {
+      a = w * CKY_WORD_BITS + __builtin_ctzll(bits);
+      cky_forest_add_node(b, a, start, length);
+      obj->node_first[obj->nnodes - 1] = 0;
+    }
+  }
+
+  // Count each node's edges, then give them consecutive places.
+  cky_forest_edges(b, start, length, true);
+  total = 0;
+  for (node = first; node < obj->nnodes; node++) {
+    total += obj->node_first[node];
+  }
+  cky_forest_reserve_edges(b, total);
+  b->cursor = smb_renew(int, b->cursor, obj->nnodes - first + 1);
+  for (node = first; node < obj->nnodes; node++) {
+    b->cursor[node - first] = obj->nedges;
+    obj->nedges += obj->node_first[node];
+    obj->node_first[node] = b->cursor[node - first];
+  }
+  cky_forest_edges(b, start, length, false);
+
+  for (node = first; node < obj->nnodes; node++) {
+    b->slot[obj->node_symbol[node]] = -1;
+  }
+}
+
+/*
+  Replace the child symbols of every edge with node numbers, and count trees
+  from the bottom up.  Children always come after their parents.
+ */
+static void cky_forest_finish(cky_forest_builder *b)
+{
+  cky_forest *obj = b->obj;
+  int node, e, start, k, length;
+  uint64_t total;
+
+  obj->node_first[obj->nnodes] = obj->nedges;
+  obj->node_count = smb_new(uint64_t, obj->nnodes + 1);
+  for (node = obj->nnodes - 1; node >= 0; node--) {
+    start = obj->node_start[node];
+    length = obj->node_length[node];
+    if (length == 1) {
+      obj->node_count[node] = 1;
+      continue;
+    }
+    total = 0;
+    for (e = obj->node_first[node]; e < obj->node_first[node + 1]; e++) {
+      k = b->edge_split[e];
+      obj->edge_left[e] = b->base[cky_forest_cell(obj, start, k)] +
+        cky_bit_rank(cky_forest_useful(b, start, k), obj->edge_left[e]);
+      obj->edge_right[e] = b->base[cky_forest_cell(obj, start + k,
+                                                   length - k)] +
+        cky_bit_rank(cky_forest_useful(b, start + k, length - k),
+                     obj->edge_right[e]);
+      total = cky_count_add(total,
+                            cky_count_mul(obj->node_count[obj->edge_left[e]],
+                                          obj->node_count[obj->edge_right[e]]));
+      obj->edge_total[e] = total;
+    }
+    obj->node_count[node] = total;
+  }
+}
+
+/**
+   @brief Build the parse forest of a filled chart.
+
+   The forest doesn't refer to the chart afterwards, so the chart may be reused
+   for the next sentence.
+
+   @param obj Memory to initialize
+   @param chart A chart filled by cky_chart_fill() or similar
+ */
+void cky_forest_init(cky_forest *obj, const cky_chart *chart)
+{
+  const cky_grammar *g = chart->gram;
+  cky_forest_builder b;
+  int n = chart->length, len, i;
+  size_t ncells = n > 0 ? cky_chart_offset(n, n) + 1 : 1;
+
+  obj->length = n;
+  obj->accepts = cky_chart_accepts(chart);
+  obj->nnodes = 0;
+  obj->nedges = 0;
+  b.node_capacity = 16;
+  b.edge_capacity = 16;
+  obj->node_symbol = smb_new(int, b.node_capacity);
+  obj->node_start = smb_new(int, b.node_capacity);
+  obj->node_length = smb_new(int, b.node_capacity);
+  obj->node_first = smb_new(int, b.node_capacity + 1);
+  obj->edge_left = smb_new(int, b.edge_capacity);
+  obj->edge_right = smb_new(int, b.edge_capacity);
+  obj->edge_total = smb_new(uint64_t, b.edge_capacity);
+
+  b.obj = obj;
+  b.chart = chart;
+  b.useful = smb_new(cky_word, ncells * g->nwords + 1);
+  memset(b.useful, 0, sizeof(cky_word) * (ncells * g->nwords + 1));
+  b.base = smb_new(int, ncells);
+  b.slot = smb_new(int, g->nnonterminals + 1);
+  for (i = 0; i < g->nnonterminals; i++) {
+    b.slot[i] = -1;
+  }
+  b.cursor = NULL;
+  b.edge_split = smb_new(int, b.edge_capacity);
+
+  if (obj->accepts && n > 0) {
+    cky_bit_set(cky_forest_useful(&b, 0, n), g->start);
+    for (len = n; len >= 1; len--) {
+      for (i = 0; i + len <= n; i++) {
+        cky_forest_visit(&b, i, len);
+      }
+    }
+  }
+  cky_forest_finish(&b);
+
+  smb_free(b.useful);
+  smb_free(b.base);
+  smb_free(b.slot);
+  smb_free(b.cursor);
+  smb_free(b.edge_split);
+}
+
+/**
+   @brief Allocate and build the parse forest of a filled chart.
+   @param chart The filled chart
+   @return The new forest
+ */
+cky_forest *cky_forest_create(const cky_chart *chart)
+{
+  cky_forest *obj = smb_new(cky_forest, 1);
+  cky_forest_init(obj, chart);
+  return obj;
+}
+
+/**
+   @brief Free a forest's tables, but not the forest itself.
+   @param obj The forest to clean up
+ */
+void cky_forest_destroy(cky_forest *obj)
+{
+  smb_free(obj->node_symbol);
+  smb_free(obj->node_start);
+  smb_free(obj->node_length);
+  smb_free(obj->node_first);
+  smb_free(obj->node_count);
+  smb_free(obj->edge_left);
+  smb_free(obj->edge_right);
+  smb_free(obj->edge_total);
+}
+
+/**
+   @brief Free a forest and its tables.
+   @param obj The forest to delete
+ */
+void cky_forest_delete(cky_forest *obj)
+{
+  cky_forest_destroy(obj);
+  smb_free(obj);
+}
+
+/**
+   @brief Return the number of parse trees in a forest.
+
+   Nothing is enumerated: the count comes from the counts stored at each node.
+
+   @param obj The forest
+   @return The number of trees, or CKY_COUNT_MAX if there are at least that
+   many.  Only trees numbered below CKY_COUNT_MAX can be extracted.
+ */
+uint64_t cky_forest_count(const cky_forest *obj)
+{
+  if (!obj->accepts) {
+    return 0;
+  }
+  return obj->nnodes > 0 ? obj->node_count[0] : 1;
+}
+
+/*
+  Extract tree number index of a node into nodes, starting at *next.  Returns
+  where the node was stored.
+ */
+static int cky_forest_unrank(const cky_forest *obj, int node, uint64_t index,
+                             cky_tree_node *nodes, int *next)
+{
+  int pos = (*next)++, lo, hi, mid, left, right;
+  uint64_t right_count;
+
+  nodes[pos].symbol = obj->node_symbol[node];
+  nodes[pos].start = obj->node_start[node];
+  nodes[pos].length = obj->node_length[node];
+  nodes[pos].left = -1;
+  nodes[pos].right = -1;
+  lo = obj->node_first[node];
+  hi = obj->node_first[node + 1];
+  if (lo == hi) {
+    return pos;
+  }
+
+  // Find the first edge whose running total passes the index.
+  while (lo < hi - 1) {
+    mid = lo + (hi - lo) / 2;
+    if (obj->edge_total[mid - 1] > index) {
+      hi = mid;
+    } else {
+      lo = mid;
+    }
+  }
+  if (lo > obj->node_first[node]) {
+    index -= obj->edge_total[lo - 1];
+  }
+
+  left = obj->edge_left[lo];
+  right = obj->edge_right[lo];
+  right_count = obj->node_count[right];
+  nodes[pos].left = cky_forest_unrank(obj, left, index / right_count, nodes,
+                                      next);
+  nodes[pos].right = cky_forest_unrank(obj, right, index % right_count,
+                                       nodes, next);
+  return pos;
+}
+
+/**
+   @brief Extract one parse tree from a forest.
+
+   The nodes are stored in preorder, so the root is `nodes[0]`.  Trees are
+   numbered from zero, and different numbers give different trees.
+
+   @param obj The forest
+   @param index Number of the tree to extract
+   @param[out] nodes Room for `2 * length - 1` nodes
+   @return False if there is no tree with that number.
+ */
+bool cky_forest_tree(const cky_forest *obj, uint64_t index,
+                     cky_tree_node *nodes)
+{
+  int next = 0;
+  if (index >= cky_forest_count(obj)) {
+    return false;
+  }
+  if (obj->nnodes > 0) {
+    cky_forest_unrank(obj, 0, index, nodes, &next);
+  }
+  return true;
+}
+
+/**
+   @brief Extract the next parse tree from a forest.
+
+   Start with `*index` set to zero to get the first tree.
+
+   @param obj The forest
+   @param index Number of the tree to extract, which is then advanced
+   @param[out] nodes Room for `2 * length - 1` nodes
+   @return False once every tree has been extracted.
+ */
+bool cky_forest_next(const cky_forest *obj, uint64_t *index,
+                     cky_tree_node *nodes)
+{
+  if (!cky_forest_tree(obj, *index, nodes)) {
+    return false;
+  }
+  (*index)++;
+  return true;
+}
@@ -0,0 +1,156 @@
+/***************************************************************************//**
+
+  @file         forest.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Packed shared parse forests from CKY charts.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_FOREST_H
+#define SMB_FOREST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cky.h"
+
+/**
+   @brief The tree count that stands for "this many or more".
+
+   Counts saturate here instead of overflowing.
+ */
+#define CKY_COUNT_MAX UINT64_MAX
+
+/**
+   @brief One node of an extracted parse tree.
+ */
+typedef struct {
+
+  /**
+     @brief The nonterminal at this node.
+   */
+  int symbol;
+
+  /**
+     @brief Index of the first token the node covers.
+   */
+  int start;
+
+  /**
+     @brief Number of tokens the node covers.
+   */
+  int length;
+
+  /**
+     @brief Index of the left child in the tree's node array, or -1 at a leaf.
+   */
+  int left;
+
+  /**
+     @brief Index of the right child in the tree's node array, or -1 at a leaf.
+   */
+  int right;
+
+} cky_tree_node;
+
+/**
+   @brief Every parse of a sentence, with shared subtrees stored once.
+
+   A forest node is a nonterminal over a span that is part of at least one
+   complete parse.  Its edges are the ways to split it by a binary rule, each
+   pointing at two child nodes.  The nodes are numbered so that children come
+   after their parents, with the root as node zero.
+
+   Trees are numbered from zero up to the number of trees, and any one can be
+   extracted directly, in time proportional to its size.  So enumerating trees
+   costs only as much as the trees that are asked for.
+
+   @see cky_forest_init
+   @see cky_forest_tree
+ */
+typedef struct {
+
+  /**
+     @brief Number of tokens in the sentence.
+   */
+  int length;
+
+  /**
+     @brief True if there is a parse.  The empty sentence has no nodes.
+   */
+  bool accepts;
+
+  /**
+     @brief Number of nodes in the forest.  Zero if there is no parse.
+   */
+  int nnodes;
+
+  /**
+     @brief The nonterminal of each node.
+   */
+  int *node_symbol;
+
+  /**
+     @brief The first token of each node's span.
+   */
+  int *node_start;
+
+  /**
+     @brief The length of each node's span.
+   */
+  int *node_length;
+
+  /**
+     @brief The edges of node `i` are `node_first[i]` up to `node_first[i+1]`.
+   */
+  int *node_first;
+
+  /**
+     @brief The number of trees under each node, saturating at CKY_COUNT_MAX.
+   */
+  uint64_t *node_count;
+
+  /**
+     @brief Number of edges in the forest.
+   */
+  int nedges;
+
+  /**
+     @brief The left child node of each edge.
+   */
+  int *edge_left;
+
+  /**
+     @brief The right child node of each edge.
+   */
+  int *edge_right;
+
+  /**
+     @brief Running total of trees over a node's edges, up to this one.
+
+     The trees through edge `e` of a node are numbered from the total of the
+     edge before it, up to `edge_total[e]`.
+   */
+  uint64_t *edge_total;
+
+} cky_forest;
+
+void cky_forest_init(cky_forest *obj, const cky_chart *chart);
+cky_forest *cky_forest_create(const cky_chart *chart);
+void cky_forest_destroy(cky_forest *obj);
+void cky_forest_delete(cky_forest *obj);
+
+uint64_t cky_forest_count(const cky_forest *obj);
+bool cky_forest_tree(const cky_forest *obj, uint64_t index,
+                     cky_tree_node *nodes);
+bool cky_forest_next(const cky_forest *obj, uint64_t *index,
+                     cky_tree_node *nodes);
+
+#endif//SMB_FOREST_H
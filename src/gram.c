@@ -13,11 +13,19 @@
 
 *******************************************************************************/
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 
 #include "gram.h"
 #include "libstephen/al.h"
+#include "libstephen/ht.h"
 
 /**
    @brief Initialize a new CFG rule.
@@ -38,6 +46,7 @@ void cfg_rule_init(cfg_rule *pNewRule, int lhs, int rhs_len)
   pNewRule->lhs = lhs;
   pNewRule->rhs_len = rhs_len;
   pNewRule->rhs = smb_new(int, rhs_len);
+  pNewRule->weight = 0;
 
   // Set all items in the right hand side to none.
   for (i = 0; i < rhs_len; i++) {
@@ -99,6 +108,7 @@ void cnf_rule_init(cnf_rule *pNewRule, int lhs, int rhs_one, int rhs_two)
   pNewRule->lhs = lhs;
   pNewRule->rhs_one = rhs_one;
   pNewRule->rhs_two = rhs_two;
+  pNewRule->weight = 0;
 }
 
 /**
@@ -146,9 +156,17 @@ void cnf_rule_delete(cnf_rule *pRule)
 void cfg_init(cfg *pGram)
 {
   al_init(&pGram->symbols);
+  ht_init(&pGram->symbol_index, &ht_string_hash, &data_compare_string);
   al_init(&pGram->terminals);
   al_init(&pGram->rules);
   pGram->start = CFG_SYMBOL_NONE;
+  pGram->arena = false;
+  pGram->rule_arena = NULL;
+  pGram->nrules = 0;
+  pGram->rule_capacity = 0;
+  pGram->rhs_arena = NULL;
+  pGram->nrhs = 0;
+  pGram->rhs_capacity = 0;
 }
 
 /**
@@ -161,6 +179,38 @@ cfg *cfg_create(void)
   return pGram;
 }
 
+/**
+   @brief Initialize a CFG that stores its rules in an arena.
+
+   Rules are kept by value in one array, and their right hand sides packed into
+   another, instead of being allocated one at a time.  Adding rules only
+   allocates when an array has to grow, and destroying the grammar frees the
+   two arrays, however many rules there are.  Rules must be added with
+   cfg_new_rule() or cfg_add_rule(), and pointers to them are only valid until
+   the next rule is added.
+
+   @param pGram The grammar to initialize
+ */
+void cfg_init_arena(cfg *pGram)
+{
+  cfg_init(pGram);
+  pGram->arena = true;
+  pGram->rule_capacity = 16;
+  pGram->rule_arena = smb_new(cfg_rule, pGram->rule_capacity);
+  pGram->rhs_capacity = 64;
+  pGram->rhs_arena = smb_new(int, pGram->rhs_capacity);
+}
+
+/**
+   @brief Allocate and initialize a CFG that stores its rules in an arena.
+ */
+cfg *cfg_create_arena(void)
+{
+  cfg *pGram = smb_new(cfg, 1);
+  cfg_init_arena(pGram);
+  return pGram;
+}
+
 /**
    @brief Clean up the fields of a CFG.  Do not free.
 
@@ -185,8 +235,11 @@ void cfg_destroy(cfg *pGram, bool free_symbols)
     d = al_get(&pGram->rules, i, &status);
     cfg_rule_delete((cfg_rule *)d.data_ptr);
   }
+  smb_free(pGram->rule_arena);
+  smb_free(pGram->rhs_arena);
 
   al_destroy(&pGram->symbols);
+  ht_destroy(&pGram->symbol_index);
   al_destroy(&pGram->terminals);
   al_destroy(&pGram->rules);
 }
@@ -223,13 +276,15 @@ int cfg_add_symbol(cfg *pGram, char *symbol, bool terminal)
 {
   DATA d;
   int idx;
+  smb_status status = SMB_SUCCESS;
   d.data_ptr = symbol;
-  idx = al_index_of(&pGram->symbols, d, &data_compare_string);
-  if (idx != -1) {
+  idx = (int) ht_get(&pGram->symbol_index, d, &status).data_llint;
+  if (status == SMB_SUCCESS) {
     return idx;
   } else {
     al_append(&pGram->symbols, d);
     idx = al_length(&pGram->symbols) - 1;
+    ht_insert(&pGram->symbol_index, d, (DATA){.data_llint=idx});
     if (terminal) {
       d.data_llint = idx;
       al_append(&pGram->terminals, d);
@@ -241,16 +296,103 @@ int cfg_add_symbol(cfg *pGram, char *symbol, bool terminal)
 /**
    @brief Add a rule to the grammar.
 
+   The grammar takes ownership of the rule.  In arena mode, the rule is copied
+   into the arena and then freed.
+
    @param pGram The grammar to add to
    @param newRule The rule to add
  */
 void cfg_add_rule(cfg *pGram, cfg_rule *newRule)
 {
   DATA d;
+  cfg_rule *copy;
+  if (pGram->arena) {
+    copy = cfg_new_rule(pGram, newRule->lhs, newRule->rhs_len);
+    memcpy(copy->rhs, newRule->rhs, sizeof(int) * newRule->rhs_len);
+    copy->weight = newRule->weight;
+    cfg_rule_delete(newRule);
+    return;
+  }
   d.data_ptr = newRule;
   al_append(&pGram->rules, d);
 }
 
+/**
+   @brief Add a new rule to the grammar, and return it.
+
+   The right hand side is filled with CFG_SYMBOL_NONE, for the caller to set.
+   This works in either mode, but only allocates in arena mode when an array
+   has to grow.
+
+   @param pGram The grammar to add to
+   @param lhs The index of the lhs symbol
+   @param rhs_len The number of symbols in the rhs
+   @return The new rule.  In arena mode, it moves when another rule is added.
+ */
+cfg_rule *cfg_new_rule(cfg *pGram, int lhs, int rhs_len)
+{
+  cfg_rule *rule;
+  int i, offset;
+
+  if (!pGram->arena) {
+    rule = cfg_rule_create(lhs, rhs_len);
+    cfg_add_rule(pGram, rule);
+    return rule;
+  }
+
+  if (pGram->nrules == pGram->rule_capacity) {
+    pGram->rule_capacity *= 2;
+    pGram->rule_arena = smb_renew(cfg_rule, pGram->rule_arena,
+                                  pGram->rule_capacity);
+  }
+  if (pGram->nrhs + rhs_len > pGram->rhs_capacity) {
+    while (pGram->nrhs + rhs_len > pGram->rhs_capacity) {
+      pGram->rhs_capacity *= 2;
+    }
+    pGram->rhs_arena = smb_renew(int, pGram->rhs_arena, pGram->rhs_capacity);
+    // The right hand sides are packed in rule order, so they can be found
+    // again from their lengths.
+    for (i = 0, offset = 0; i < pGram->nrules; i++) {
+      pGram->rule_arena[i].rhs = pGram->rhs_arena + offset;
+      offset += pGram->rule_arena[i].rhs_len;
+    }
+  }
+
+  rule = &pGram->rule_arena[pGram->nrules++];
+  rule->lhs = lhs;
+  rule->rhs_len = rhs_len;
+  rule->rhs = pGram->rhs_arena + pGram->nrhs;
+  rule->weight = 0;
+  pGram->nrhs += rhs_len;
+  for (i = 0; i < rhs_len; i++) {
+    rule->rhs[i] = CFG_SYMBOL_NONE;
+  }
+  return rule;
+}
+
+/**
+   @brief Return the number of rules in the grammar.
+   @param pGram The grammar
+ */
+int cfg_num_rules(const cfg *pGram)
+{
+  return pGram->arena ? pGram->nrules : al_length(&pGram->rules);
+}
+
+/**
+   @brief Return a rule of the grammar, in either mode.
+   @param pGram The grammar
+   @param index Index of the rule, less than cfg_num_rules()
+ */
+cfg_rule *cfg_get_rule(const cfg *pGram, int index)
+{
+  smb_status status = SMB_SUCCESS;
+  if (pGram->arena) {
+    return &pGram->rule_arena[index];
+  }
+  return al_get(&pGram->rules, index, &status).data_ptr;
+}
+
 /**
    @brief Print the grammar to stdout.
 
@@ -259,12 +401,11 @@ void cfg_add_rule(cfg *pGram, cfg_rule *newRule)
 void cfg_print(cfg *pGram)
 {
   int i, j;
-  DATA d, e;
+  DATA e;
   cfg_rule *rule;
   smb_status status;
-  for (i = 0; i < al_length(&pGram->rules); i++) {
-    d = al_get(&pGram->rules, i, &status);
-    rule = d.data_ptr;
+  for (i = 0; i < cfg_num_rules(pGram); i++) {
+    rule = cfg_get_rule(pGram, i);
     e = al_get(&pGram->symbols, rule->lhs, &status);
     printf("%s --> ", (char *) e.data_ptr);
     for (j = 0; j < rule->rhs_len; j++) {
@@ -283,6 +424,160 @@ void cfg_print(cfg *pGram)
   printf("\n");
 }
 
+/*
+  Split a line into words, in place, storing a pointer to each.  Returns the
+  number of words, or -1 if there were more than max.
+ */
+static int cfg_split_words(char *line, char **words, int max)
+{
+  int n = 0;
+  while (true) {
+    while (*line == ' ' || *line == '\t' || *line == '\r') {
+      *line++ = '\0';
+    }
+    if (*line == '\0' || *line == '#') {
+      return n;
+    }
+    if (n == max) {
+      return -1;
+    }
+    words[n++] = line;
+    while (*line != '\0' && *line != ' ' && *line != '\t' && *line != '\r') {
+      line++;
+    }
+  }
+}
+
+/*
+  Return the index of a symbol, adding a copy of its name if it is new.
+ */
+static int cfg_load_symbol(cfg *pGram, const char *name, smb_ht *lhs)
+{
+  smb_status status = SMB_SUCCESS;
+  DATA d;
+  char *copy;
+  d.data_ptr = (char *) name;
+  d = ht_get(&pGram->symbol_index, d, &status);
+  if (status == SMB_SUCCESS) {
+    return (int) d.data_llint;
+  }
+  copy = smb_new(char, strlen(name) + 1);
+  strcpy(copy, name);
+  return cfg_add_symbol(pGram, copy,
+                        !ht_contains(lhs, (DATA){.data_ptr=(char *) name}));
+}
+
+/*
+  If a word is a bracketed probability, store its log in weight and return
+  true.  A bracketed word that isn't a probability is an error.
+ */
+static bool cfg_load_weight(const char *word, double *weight,
+                            smb_status *status)
+{
+  size_t length = strlen(word);
+  char *end;
+  double p;
+  if (length < 2 || word[0] != '[' || word[length - 1] != ']') {
+    return false;
+  }
+  p = strtod(word + 1, &end);
+  if (end != word + length - 1 || !(p > 0 && p <= 1)) {
+    *status = SMB_INDEX_ERROR;
+  } else {
+    *weight = log(p);
+  }
+  return true;
+}
+
+/**
+   @brief Load rules into a grammar from text.
+
+   Each line is a rule, like `A -> B c d`.  Symbols are separated by spaces,
+   and several right hand sides may be given at once, separated by `|`.  An
+   empty right hand side is an epsilon rule.  Lines that are empty, or start
+   with `#`, are ignored.  Every symbol which is the left hand side of some
+   rule is a nonterminal, and every other symbol is a terminal.  The first
+   rule's left hand side is the start symbol.
+
+   An alternative may end with a probability in brackets, as in
+   `A -> B c [0.25]`, and its rule's weight is the log of that probability.
+   A final word in brackets is always read as a probability, so it can't be a
+   symbol.
+
+   Symbol names are copied, so the grammar should be cleaned up with
+   `cfg_destroy(pGram, true)`.
+
+   @param pGram An initialized, empty grammar
+   @param str The text of the grammar
+   @param status Set to SMB_INDEX_ERROR if a line isn't a rule, or a
+   probability isn't a number in (0, 1].
+ */
+void cfg_load(cfg *pGram, const char *str, smb_status *status)
+{
+  char *bufs[2], *line, *next, **words;
+  int max = strlen(str) / 2 + 2, n, i, j, k, end, lhs, pass;
+  double weight;
+  smb_ht lhs_names;
+  cfg_rule *rule;
+
+  words = smb_new(char *, max);
+  ht_init(&lhs_names, &ht_string_hash, &data_compare_string);
+
+  // The first pass finds the nonterminals, so that the second knows which
+  // symbols are terminals as it adds them.  The keys of lhs_names point into
+  // the first pass's copy of the text, so each pass gets its own.
+  for (pass = 0; pass < 2 && *status == SMB_SUCCESS; pass++) {
+    bufs[pass] = smb_new(char, strlen(str) + 1);
+    strcpy(bufs[pass], str);
+    for (line = bufs[pass]; line != NULL; line = next) {
+      next = strchr(line, '\n');
+      if (next != NULL) {
+        *next++ = '\0';
+      }
+      n = cfg_split_words(line, words, max);
+      if (n == 0) {
+        continue;
+      }
+      if (n < 2 || strcmp(words[1], "->") != 0) {
+        *status = SMB_INDEX_ERROR;
+        break;
+      }
+
+      if (pass == 0) {
+        ht_insert(&lhs_names, (DATA){.data_ptr=words[0]},
+                  (DATA){.data_llint=0});
+        continue;
+      }
+
+      lhs = cfg_load_symbol(pGram, words[0], &lhs_names);
+      if (pGram->start == CFG_SYMBOL_NONE) {
+        pGram->start = lhs;
+      }
+      // Each alternative is words[i] up to (not including) words[j].
+      for (i = 2; i <= n; i = j + 1) {
+        for (j = i; j < n && strcmp(words[j], "|") != 0; j++);
+        end = j;
+        weight = 0;
+        if (end > i && cfg_load_weight(words[end - 1], &weight, status)) {
+          end--;
+        }
+        rule = cfg_new_rule(pGram, lhs, end - i);
+        rule->weight = weight;
+        for (k = 0; k < end - i; k++) {
+          rule->rhs[k] = cfg_load_symbol(pGram, words[i + k], &lhs_names);
+        }
+      }
+    }
+  }
+
+  ht_destroy(&lhs_names);
+  smb_free(words);
+  smb_free(bufs[0]);
+  if (pass == 2) {
+    smb_free(bufs[1]);
+  }
+}
+
 /**
    @brief Initialize a CNF grammar.
 
@@ -291,10 +586,30 @@ void cfg_print(cfg *pGram)
 void cnf_init(cnf *pGram)
 {
   al_init(&pGram->terminals);
+  ht_init(&pGram->terminal_index, &ht_string_hash, &data_compare_string);
   al_init(&pGram->nonterminals);
+  ht_init(&pGram->nonterminal_index, &ht_string_hash, &data_compare_string);
   al_init(&pGram->rules_one);
   al_init(&pGram->rules_two);
   pGram->start = CFG_SYMBOL_NONE;
+  pGram->accepts_empty = false;
+  pGram->empty_weight = 0;
+  pGram->one_first = NULL;
+  pGram->one_lhs = NULL;
+  pGram->one_weight = NULL;
+  pGram->two_first = NULL;
+  pGram->two_right = NULL;
+  pGram->two_lhs = NULL;
+  pGram->two_weight = NULL;
+  pGram->arena = false;
+  pGram->one_arena = NULL;
+  pGram->none = 0;
+  pGram->one_capacity = 0;
+  pGram->two_arena = NULL;
+  pGram->ntwo = 0;
+  pGram->two_capacity = 0;
+  pGram->image = NULL;
+  pGram->image_size = 0;
 }
 
 /**
@@ -307,6 +622,57 @@ cnf *cnf_create(void)
   return pGram;
 }
 
+/**
+   @brief Initialize a CNF grammar that stores its rules in an arena.
+
+   Like cfg_init_arena(), the rules are kept by value in two arrays (one for
+   each kind of rule), so building and freeing the grammar takes a constant
+   number of allocations.
+
+   @param pGram The grammar to initialize
+ */
+void cnf_init_arena(cnf *pGram)
+{
+  cnf_init(pGram);
+  pGram->arena = true;
+  pGram->one_capacity = 16;
+  pGram->one_arena = smb_new(cnf_rule, pGram->one_capacity);
+  pGram->two_capacity = 16;
+  pGram->two_arena = smb_new(cnf_rule, pGram->two_capacity);
+}
+
+/**
+   @brief Allocate and initialize a CNF grammar that stores its rules in an
+   arena.
+ */
+cnf *cnf_create_arena(void)
+{
+  cnf *pGram = smb_new(cnf, 1);
+  cnf_init_arena(pGram);
+  return pGram;
+}
+
+/*
+  Free the rule index, which no longer matches the rules.
+ */
+static void cnf_clear_index(cnf *pGram)
+{
+  smb_free(pGram->one_first);
+  smb_free(pGram->one_lhs);
+  smb_free(pGram->one_weight);
+  smb_free(pGram->two_first);
+  smb_free(pGram->two_right);
+  smb_free(pGram->two_lhs);
+  smb_free(pGram->two_weight);
+  pGram->one_first = NULL;
+  pGram->one_lhs = NULL;
+  pGram->one_weight = NULL;
+  pGram->two_first = NULL;
+  pGram->two_right = NULL;
+  pGram->two_lhs = NULL;
+  pGram->two_weight = NULL;
+}
+
 /**
    @brief Clean up the fields of a CNF grammar.  Do not free.
 
@@ -320,6 +686,22 @@ void cnf_destroy(cnf *pGram, bool free_symbols)
   DATA d;
   smb_status status;
 
+  // The names, rules and index of a compiled grammar file are in its mapping.
+  if (pGram->image != NULL) {
+    munmap(pGram->image, pGram->image_size);
+    pGram->image = NULL;
+    pGram->one_arena = NULL;
+    pGram->two_arena = NULL;
+    pGram->one_first = NULL;
+    pGram->one_lhs = NULL;
+    pGram->one_weight = NULL;
+    pGram->two_first = NULL;
+    pGram->two_right = NULL;
+    pGram->two_lhs = NULL;
+    pGram->two_weight = NULL;
+    free_symbols = false;
+  }
+
   if (free_symbols) {
     for (i = 0; i < al_length(&pGram->terminals); i++) {
       d = al_get(&pGram->terminals, i, &status);
@@ -339,11 +721,16 @@ void cnf_destroy(cnf *pGram, bool free_symbols)
     d = al_get(&pGram->rules_two, i, &status);
     cnf_rule_delete((cnf_rule *)d.data_ptr);
   }
+  smb_free(pGram->one_arena);
+  smb_free(pGram->two_arena);
 
   al_destroy(&pGram->terminals);
+  ht_destroy(&pGram->terminal_index);
   al_destroy(&pGram->nonterminals);
+  ht_destroy(&pGram->nonterminal_index);
   al_destroy(&pGram->rules_one);
   al_destroy(&pGram->rules_two);
+  cnf_clear_index(pGram);
 }
 
 /**
@@ -358,3 +745,217 @@ void cnf_delete(cnf *pGram, bool free_symbols)
   cnf_destroy(pGram, free_symbols);
   smb_free(pGram);
 }
+
+/**
+   @brief Add a string symbol to a CNF grammar.
+
+   Terminals and nonterminals are numbered separately, so the same string may
+   be both a terminal and a nonterminal, with different indices.  Like
+   cfg_add_symbol(), this can safely be called with a symbol that's already in
+   the grammar, and it returns the existing index.
+
+   @param pGram The grammar to add to
+   @param symbol The symbol to add
+   @param terminal Whether to add it as a terminal or a nonterminal
+   @return The index of the symbol, in cnf.terminals or cnf.nonterminals.
+ */
+int cnf_add_symbol(cnf *pGram, char *symbol, bool terminal)
+{
+  smb_al *list = terminal ? &pGram->terminals : &pGram->nonterminals;
+  smb_ht *index = terminal ? &pGram->terminal_index :
+    &pGram->nonterminal_index;
+  smb_status status = SMB_SUCCESS;
+  DATA d;
+  int idx;
+  d.data_ptr = symbol;
+  idx = (int) ht_get(index, d, &status).data_llint;
+  if (status == SMB_SUCCESS) {
+    return idx;
+  }
+  al_append(list, d);
+  idx = al_length(list) - 1;
+  ht_insert(index, d, (DATA){.data_llint=idx});
+  return idx;
+}
+
+/**
+   @brief Add a rule to a CNF grammar.
+
+   Rules with CFG_SYMBOL_NONE as their second symbol are A->a rules, and the
+   rest are A->BC rules.  Adding a rule discards the rule index.  The grammar
+   takes ownership of the rule: in arena mode, it is copied and then freed.
+
+   @param pGram The grammar to add to
+   @param newRule The rule to add
+ */
+void cnf_add_rule(cnf *pGram, cnf_rule *newRule)
+{
+  DATA d;
+  if (pGram->arena) {
+    cnf_new_rule(pGram, newRule->lhs, newRule->rhs_one,
+                 newRule->rhs_two)->weight = newRule->weight;
+    cnf_rule_delete(newRule);
+    return;
+  }
+  d.data_ptr = newRule;
+  if (newRule->rhs_two == CFG_SYMBOL_NONE) {
+    al_append(&pGram->rules_one, d);
+  } else {
+    al_append(&pGram->rules_two, d);
+  }
+  cnf_clear_index(pGram);
+}
+
+/**
+   @brief Add a new rule to a CNF grammar, and return it.
+
+   This works in either mode, but only allocates in arena mode when an array
+   has to grow.
+
+   @param pGram The grammar to add to
+   @param lhs The left hand side of the rule
+   @param rhs_one The first item in the rhs
+   @param rhs_two The second item in the rhs, or CFG_SYMBOL_NONE
+   @return The new rule.  In arena mode, it moves when another rule is added.
+ */
+cnf_rule *cnf_new_rule(cnf *pGram, int lhs, int rhs_one, int rhs_two)
+{
+  cnf_rule *rule;
+  // The rules of a loaded compiled grammar are in a read-only mapping.
+  assert(pGram->image == NULL);
+  if (!pGram->arena) {
+    rule = cnf_rule_create(lhs, rhs_one, rhs_two);
+    cnf_add_rule(pGram, rule);
+    return rule;
+  }
+  if (rhs_two == CFG_SYMBOL_NONE) {
+    if (pGram->none == pGram->one_capacity) {
+      pGram->one_capacity *= 2;
+      pGram->one_arena = smb_renew(cnf_rule, pGram->one_arena,
+                                   pGram->one_capacity);
+    }
+    rule = &pGram->one_arena[pGram->none++];
+  } else {
+    if (pGram->ntwo == pGram->two_capacity) {
+      pGram->two_capacity *= 2;
+      pGram->two_arena = smb_renew(cnf_rule, pGram->two_arena,
+                                   pGram->two_capacity);
+    }
+    rule = &pGram->two_arena[pGram->ntwo++];
+  }
+  cnf_rule_init(rule, lhs, rhs_one, rhs_two);
+  cnf_clear_index(pGram);
+  return rule;
+}
+
+/**
+   @brief Return the number of rules of one kind in a CNF grammar.
+   @param pGram The grammar
+   @param binary True for A->BC rules, false for A->a rules
+ */
+int cnf_num_rules(const cnf *pGram, bool binary)
+{
+  if (pGram->arena) {
+    return binary ? pGram->ntwo : pGram->none;
+  }
+  return al_length(binary ? &pGram->rules_two : &pGram->rules_one);
+}
+
+/**
+   @brief Return a rule of a CNF grammar, in either mode.
+   @param pGram The grammar
+   @param binary True for A->BC rules, false for A->a rules
+   @param index Index of the rule, less than cnf_num_rules()
+ */
+cnf_rule *cnf_get_rule(const cnf *pGram, bool binary, int index)
+{
+  smb_status status = SMB_SUCCESS;
+  if (pGram->arena) {
+    return binary ? &pGram->two_arena[index] : &pGram->one_arena[index];
+  }
+  return al_get(binary ? &pGram->rules_two : &pGram->rules_one, index,
+                &status).data_ptr;
+}
+
+/*
+  Sort the A->BC rules by B, then C, for the index.
+ */
+static int cnf_rule_compare(const void *a, const void *b)
+{
+  const cnf_rule *r1 = *(const cnf_rule * const *) a;
+  const cnf_rule *r2 = *(const cnf_rule * const *) b;
+  if (r1->rhs_one != r2->rhs_one) {
+    return r1->rhs_one < r2->rhs_one ? -1 : 1;
+  } else if (r1->rhs_two != r2->rhs_two) {
+    return r1->rhs_two < r2->rhs_two ? -1 : 1;
+  }
+  return r1->lhs < r2->lhs ? -1 : r1->lhs > r2->lhs;
+}
+
+/**
+   @brief Build the lookup index of a CNF grammar's rules.
+
+   After this, the LHS of every A->a rule for a terminal, and the (C, A) of
+   every A->BC rule for a B, can be found without searching the rule lists.
+
+   @param pGram The grammar to index
+   @see cnf.one_first
+   @see cnf.two_first
+ */
+void cnf_build_index(cnf *pGram)
+{
+  int nterm = al_length(&pGram->terminals);
+  int nnon = al_length(&pGram->nonterminals);
+  int none = cnf_num_rules(pGram, false);
+  int ntwo = cnf_num_rules(pGram, true);
+  cnf_rule **sorted;
+  cnf_rule *rule;
+  int *cursor;
+  int i;
+
+  assert(pGram->image == NULL);
+  cnf_clear_index(pGram);
+
+  // Counting sort of the A->a rules by terminal.
+  pGram->one_first = smb_new(int, nterm + 1);
+  pGram->one_lhs = smb_new(int, none + 1);
+  pGram->one_weight = smb_new(double, none + 1);
+  memset(pGram->one_first, 0, sizeof(int) * (nterm + 1));
+  for (i = 0; i < none; i++) {
+    rule = cnf_get_rule(pGram, false, i);
+    pGram->one_first[rule->rhs_one + 1]++;
+  }
+  for (i = 0; i < nterm; i++) {
+    pGram->one_first[i + 1] += pGram->one_first[i];
+  }
+  cursor = smb_new(int, nterm + 1);
+  memcpy(cursor, pGram->one_first, sizeof(int) * (nterm + 1));
+  for (i = 0; i < none; i++) {
+    rule = cnf_get_rule(pGram, false, i);
+    pGram->one_weight[cursor[rule->rhs_one]] = rule->weight;
+    pGram->one_lhs[cursor[rule->rhs_one]++] = rule->lhs;
+  }
+  smb_free(cursor);
+
+  // The A->BC rules are sorted by B and C.
+  sorted = smb_new(cnf_rule *, ntwo + 1);
+  for (i = 0; i < ntwo; i++) {
+    sorted[i] = cnf_get_rule(pGram, true, i);
+  }
+  qsort(sorted, ntwo, sizeof(cnf_rule *), &cnf_rule_compare);
+  pGram->two_first = smb_new(int, nnon + 1);
+  pGram->two_right = smb_new(int, ntwo + 1);
+  pGram->two_lhs = smb_new(int, ntwo + 1);
+  pGram->two_weight = smb_new(double, ntwo + 1);
+  memset(pGram->two_first, 0, sizeof(int) * (nnon + 1));
+  for (i = 0; i < ntwo; i++) {
+    pGram->two_first[sorted[i]->rhs_one + 1]++;
+    pGram->two_right[i] = sorted[i]->rhs_two;
+    pGram->two_lhs[i] = sorted[i]->lhs;
+    pGram->two_weight[i] = sorted[i]->weight;
+  }
+  for (i = 0; i < nnon; i++) {
+    pGram->two_first[i + 1] += pGram->two_first[i];
+  }
+  smb_free(sorted);
+}
@@ -18,6 +18,7 @@
 
 #include <stdbool.h>
 #include "libstephen/al.h"
+#include "libstephen/ht.h"
 
 /**
    @brief A constant to indicate that there is no symbol in a grammar slot.
@@ -52,6 +53,11 @@ typedef struct {
    */
   int rhs_len;
 
+  /**
+     @brief The rule's weight, as a natural log probability.  Zero by default.
+   */
+  double weight;
+
 } cfg_rule;
 
 /**
@@ -82,6 +88,11 @@ typedef struct {
    */
   int rhs_two;
 
+  /**
+     @brief The rule's weight, as a natural log probability.  Zero by default.
+   */
+  double weight;
+
 } cnf_rule;
 
 /**
@@ -105,6 +116,11 @@ typedef struct {
    */
   smb_al symbols;
 
+  /**
+     @brief Maps each symbol string to its index in cfg.symbols.
+   */
+  smb_ht symbol_index;
+
   /**
      @brief A list of symbols that are terminal ones.
 
@@ -113,7 +129,7 @@ typedef struct {
   smb_al terminals;
 
   /**
-     @brief A list of rules in the grammar.
+     @brief A list of rules in the grammar.  Empty in arena mode.
    */
   smb_al rules;
 
@@ -122,6 +138,45 @@ typedef struct {
    */
   int start;
 
+  /**
+     @brief True if the rules are stored in the arena, not in cfg.rules.
+
+     @see cfg_init_arena
+   */
+  bool arena;
+
+  /**
+     @brief In arena mode, the rules themselves, in the order they were added.
+   */
+  cfg_rule *rule_arena;
+
+  /**
+     @brief Number of rules in cfg.rule_arena.
+   */
+  int nrules;
+
+  /**
+     @brief Allocated length of cfg.rule_arena.
+   */
+  int rule_capacity;
+
+  /**
+     @brief In arena mode, the right hand sides of every rule, end to end.
+
+     Each rule's cfg_rule.rhs points into this buffer.
+   */
+  int *rhs_arena;
+
+  /**
+     @brief Number of symbols used in cfg.rhs_arena.
+   */
+  int nrhs;
+
+  /**
+     @brief Allocated length of cfg.rhs_arena.
+   */
+  int rhs_capacity;
+
 } cfg;
 
 /**
@@ -152,6 +207,11 @@ typedef struct {
    */
   smb_al terminals;
 
+  /**
+     @brief Maps each terminal string to its index in cnf.terminals.
+   */
+  smb_ht terminal_index;
+
   /**
      @brief The nonterminal symbols of the grammar.
 
@@ -161,20 +221,129 @@ typedef struct {
   smb_al nonterminals;
 
   /**
-     @brief The rules that have one symbol in the RHS.
+     @brief Maps each nonterminal string to its index in cnf.nonterminals.
+   */
+  smb_ht nonterminal_index;
+
+  /**
+     @brief The rules that have one symbol in the RHS.  Empty in arena mode.
    */
   smb_al rules_one;
 
   /**
-     @brief The rules that have two symbols in the RHS.
+     @brief The rules that have two symbols in the RHS.  Empty in arena mode.
    */
   smb_al rules_two;
 
+  /**
+     @brief True if the rules are stored in the arena, not in the lists.
+
+     @see cnf_init_arena
+   */
+  bool arena;
+
+  /**
+     @brief In arena mode, the A->a rules, followed by unused space.
+   */
+  cnf_rule *one_arena;
+
+  /**
+     @brief Number of rules in cnf.one_arena.
+   */
+  int none;
+
+  /**
+     @brief Allocated length of cnf.one_arena.
+   */
+  int one_capacity;
+
+  /**
+     @brief In arena mode, the A->BC rules, followed by unused space.
+   */
+  cnf_rule *two_arena;
+
+  /**
+     @brief Number of rules in cnf.two_arena.
+   */
+  int ntwo;
+
+  /**
+     @brief Allocated length of cnf.two_arena.
+   */
+  int two_capacity;
+
   /**
      @brief The start symbol.
    */
   int start;
 
+  /**
+     @brief True if the grammar generates the empty string.
+
+     CNF rules can't have an empty right hand side, so this stands in for the
+     rule `start -> epsilon`.
+   */
+  bool accepts_empty;
+
+  /**
+     @brief The weight of the empty string's best derivation, if there is one.
+   */
+  double empty_weight;
+
+  /**
+     @brief Index of the A->a rules by terminal.
+
+     The left hand sides of the rules for terminal `a` are
+     `one_lhs[one_first[a]]` up to (but not including)
+     `one_lhs[one_first[a+1]]`.  NULL until cnf_build_index() is called.
+   */
+  int *one_first;
+
+  /**
+     @brief Left hand sides of the A->a rules, in the order of cnf.one_first.
+   */
+  int *one_lhs;
+
+  /**
+     @brief Weights of the A->a rules, in the order of cnf.one_first.
+   */
+  double *one_weight;
+
+  /**
+     @brief Index of the A->BC rules by B.
+
+     The rules with `B` as their first symbol are numbers `two_first[B]` up to
+     (but not including) `two_first[B+1]` of cnf.two_right and cnf.two_lhs,
+     sorted by `C`.  NULL until cnf_build_index() is called.
+   */
+  int *two_first;
+
+  /**
+     @brief The C of each A->BC rule, in the order of cnf.two_first.
+   */
+  int *two_right;
+
+  /**
+     @brief The A of each A->BC rule, in the order of cnf.two_first.
+   */
+  int *two_lhs;
+
+  /**
+     @brief Weights of the A->BC rules, in the order of cnf.two_first.
+   */
+  double *two_weight;
+
+  /**
+     @brief A file mapped by cnf_load_compiled(), which the symbol names,
+     rules and index point into, or NULL.
+   */
+  void *image;
+
+  /**
+     @brief Size of the mapping at cnf.image.
+   */
+  size_t image_size;
+
 } cnf;
 
 void cfg_rule_init(cfg_rule *pNewRule, int lhs, int rhs_len);
@@ -189,16 +358,31 @@ void cnf_rule_delete(cnf_rule *pRule);
 
 void cfg_init(cfg *pGram);
 cfg *cfg_create(void);
+void cfg_init_arena(cfg *pGram);
+cfg *cfg_create_arena(void);
 void cfg_destroy(cfg *pGram, bool free_symbols);
 void cfg_delete(cfg *pGram, bool free_symbols);
 
 void cnf_init(cnf *pGram);
 cnf *cnf_create(void);
+void cnf_init_arena(cnf *pGram);
+cnf *cnf_create_arena(void);
 void cnf_destroy(cnf *pGram, bool free_symbols);
 void cnf_delete(cnf *pGram, bool free_symbols);
 
 int cfg_add_symbol(cfg *pGram, char *symbol, bool terminal);
 void cfg_add_rule(cfg *pGram, cfg_rule *newRule);
+cfg_rule *cfg_new_rule(cfg *pGram, int lhs, int rhs_len);
+int cfg_num_rules(const cfg *pGram);
+cfg_rule *cfg_get_rule(const cfg *pGram, int index);
 void cfg_print(cfg *pGram);
+void cfg_load(cfg *pGram, const char *str, smb_status *status);
+
+int cnf_add_symbol(cnf *pGram, char *symbol, bool terminal);
+void cnf_add_rule(cnf *pGram, cnf_rule *newRule);
+cnf_rule *cnf_new_rule(cnf *pGram, int lhs, int rhs_one, int rhs_two);
+int cnf_num_rules(const cnf *pGram, bool binary);
+cnf_rule *cnf_get_rule(const cnf *pGram, bool binary, int index);
+void cnf_build_index(cnf *pGram);
 
 #endif
@@ -0,0 +1,134 @@
+/***************************************************************************//**
+
+  @file         grep.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Search many files for lines matching a regex, in parallel.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libstephen/base.h"
+#include "dfa.h"
+#include "pgrep.h"
+
+/**
+   @brief Print the help message for the search program.
+ */
+void help(char *name)
+{
+  printf("Usage: %s [OPTIONS] PATTERN PATH...\n", name);
+  puts("Prints the lines of each file, or of every file under each directory,");
+  puts("which match PATTERN.");
+  puts("");
+  puts("Options:");
+  puts("  -n              print line numbers");
+  puts("  -c              print the number of matching lines of each file");
+  puts("  -l              print only the names of files with matching lines");
+  puts("  -H              print file names, even for a single file");
+  puts("  -t N            number of worker threads (one per core)");
+  puts("  -s SIZE         bytes searched by a thread at a time (1048576)");
+  puts("  -h              display this help message and exit");
+  puts("");
+  puts("Exits with 0 if a line matched, 1 if none did, and 2 on errors.");
+}
+
+/**
+   @brief Main entry point of the search program.
+
+   Options are read with getopt() rather than libstephen's argument parser,
+   which would take the pattern as the parameter of a flag before it.
+
+   @param argc Number of command line arguments
+   @param argv Array of command line arguments
+   @return The program's exit code.
+ */
+int main(int argc, char **argv)
+{
+  grep_search search;
+  struct stat st;
+  dfa_prefilter filter;
+  dfa *pattern;
+  bool numbers = false, count = false, names_only = false, names = false;
+  long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  long size = GREP_CHUNK_SIZE;
+  int c, i, errors;
+  size_t matches;
+
+  setlocale(LC_ALL, "");
+  while ((c = getopt(argc, argv, "nclHt:s:h")) != -1) {
+    switch (c) {
+    case 'n':
+      numbers = true;
+      break;
+    case 'c':
+      count = true;
+      break;
+    case 'l':
+      names_only = true;
+      break;
+    case 'H':
+      names = true;
+      break;
+    case 't':
+      nthreads = atol(optarg);
+      break;
+    case 's':
+      size = atol(optarg);
+      break;
+    case 'h':
+      help(argv[0]);
+      return 0;
+    default:
+      help(argv[0]);
+      return 2;
+    }
+  }
+  if (argc - optind < 2 || nthreads < 1 || size < 1) {
+    help(argv[0]);
+    return 2;
+  }
+
+  pattern = grep_compile(argv[optind], &filter);
+  if (pattern == NULL) {
+    fprintf(stderr, "error: can't convert pattern \"%s\"\n", argv[optind]);
+    return 2;
+  }
+  // Like grep, name files when there could be more than one.
+  names = names || argc - optind > 2 ||
+    (stat(argv[optind + 1], &st) == 0 && S_ISDIR(st.st_mode));
+
+  grep_init(&search, pattern, &filter, nthreads, stdout);
+  search.line_numbers = numbers;
+  search.count = count;
+  search.names_only = names_only;
+  search.names = names;
+  search.chunk_size = size;
+  for (i = optind + 1; i < argc; i++) {
+    grep_path(&search, argv[i]);
+  }
+  grep_finish(&search);
+  matches = search.matches;
+  errors = search.errors;
+  grep_destroy(&search);
+  dfa_delete(pattern);
+
+  if (errors > 0) {
+    return 2;
+  }
+  return matches > 0 ? 0 : 1;
+}
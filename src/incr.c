@@ -0,0 +1,335 @@
+/***************************************************************************//**
+
+  @file         incr.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Incremental lexing and parsing of an edited text.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "libstephen/base.h"
+#include "libstephen/ht.h"
+#include "cky.h"
+#include "gram.h"
+#include "incr.h"
+#include "lex.h"
+
+/*
+  Find the grammar terminal named like a lexer token, or -1.
+ */
+static int cky_incr_lookup(smb_lex *lex, const cnf *gram, int token)
+{
+  smb_status status = SMB_SUCCESS;
+  wchar_t *name = lex_token_name(lex, token);
+  size_t size = wcstombs(NULL, name, 0);
+  char *buf;
+  DATA d;
+
+  if (size == (size_t) -1) {
+    return -1;
+  }
+  buf = smb_new(char, size + 1);
+  wcstombs(buf, name, size + 1);
+  d.data_ptr = buf;
+  d = ht_get(&gram->terminal_index, d, &status);
+  smb_free(buf);
+  return status == SMB_SUCCESS ? (int) d.data_llint : -1;
+}
+
+/**
+   @brief Match each of a lexer's tokens with the grammar terminal of the same
+   name.
+   @param lex The lexer
+   @param gram The CNF grammar
+   @return A new array of the terminal of each token, or -1 for tokens with no
+   terminal of their name.  Free it with smb_free().
+ */
+int *cky_incr_terminals(smb_lex *lex, const cnf *gram)
+{
+  int ntokens = al_length(&lex->tokens), i;
+  int *terminal = smb_new(int, ntokens + 1);
+  for (i = 0; i < ntokens; i++) {
+    terminal[i] = cky_incr_lookup(lex, gram, i);
+  }
+  return terminal;
+}
+
+/**
+   @brief Initialize an empty text, to be lexed and parsed as it is edited.
+
+   Lexer tokens are matched with the grammar's terminals by name.  Tokens of
+   skipped patterns are left out of the sentence, and any other token with no
+   terminal of the same name makes the sentence ungrammatical.
+
+   @param obj Memory to initialize
+   @param lex The lexer, which is compiled here if it isn't already
+   @param gram The CNF grammar, which is compiled here
+ */
+void cky_incr_init(cky_incr *obj, smb_lex *lex, const cnf *gram)
+{
+  lex_compile(lex);
+  obj->lex = lex;
+  cky_grammar_init(&obj->gram, gram);
+  obj->terminal = cky_incr_terminals(lex, gram);
+  obj->capacity = 256;
+  obj->text = smb_new(char, obj->capacity);
+  obj->length = 0;
+  lex_tokens_init(&obj->tokens);
+  obj->reach = smb_new(size_t, obj->tokens.capacity);
+  obj->sentence_capacity = 64;
+  obj->sentence = smb_new(int, obj->sentence_capacity);
+  obj->nsentence = 0;
+  cky_chart_init(&obj->chart[0], &obj->gram, 64);
+  cky_chart_init(&obj->chart[1], &obj->gram, 64);
+  obj->current = 0;
+  obj->relexed = 0;
+}
+
+/**
+   @brief Allocate and initialize an empty text.
+   @param lex The lexer
+   @param gram The CNF grammar
+   @return The new text
+ */
+cky_incr *cky_incr_create(smb_lex *lex, const cnf *gram)
+{
+  cky_incr *obj = smb_new(cky_incr, 1);
+  cky_incr_init(obj, lex, gram);
+  return obj;
+}
+
+/**
+   @brief Free a text's buffers, but not the text itself.
+   @param obj The text to clean up
+ */
+void cky_incr_destroy(cky_incr *obj)
+{
+  cky_chart_destroy(&obj->chart[0]);
+  cky_chart_destroy(&obj->chart[1]);
+  smb_free(obj->sentence);
+  smb_free(obj->reach);
+  lex_tokens_destroy(&obj->tokens);
+  smb_free(obj->text);
+  smb_free(obj->terminal);
+  cky_grammar_destroy(&obj->gram);
+}
+
+/**
+   @brief Free a text and its buffers.
+   @param obj The text to delete
+ */
+void cky_incr_delete(cky_incr *obj)
+{
+  cky_incr_destroy(obj);
+  smb_free(obj);
+}
+
+/*
+  Make room for a number of tokens, keeping cky_incr.reach the same size as
+  the token arrays.
+ */
+static void cky_incr_reserve(cky_incr *obj, size_t count)
+{
+  lex_tokens *t = &obj->tokens;
+  if (count <= t->capacity) {
+    return;
+  }
+  while (count > t->capacity) {
+    t->capacity *= 2;
+  }
+  t->id = smb_renew(int, t->id, t->capacity);
+  t->start = smb_renew(size_t, t->start, t->capacity);
+  t->length = smb_renew(size_t, t->length, t->capacity);
+  obj->reach = smb_renew(size_t, obj->reach, t->capacity);
+}
+
+/*
+  Return true if a token is part of the sentence.
+ */
+static bool cky_incr_word(const cky_incr *obj, int id)
+{
+  return !lex_token_skip(obj->lex, id);
+}
+
+/*
+  Return the grammar terminal of a token, or -1.
+ */
+static int cky_incr_terminal(const cky_incr *obj, int id)
+{
+  return id == LEX_NO_TOKEN ? -1 : obj->terminal[id];
+}
+
+/*
+  Replace the tokens from first up to last with the fresh ones, and shift the
+  tokens after them by delta bytes.  Returns the index within the sentence of
+  the first token replaced, and stores the number of sentence tokens removed
+  and added.
+ */
+static int cky_incr_splice(cky_incr *obj, size_t first, size_t last,
+                           const lex_tokens *fresh, const size_t *reach,
+                           size_t delta, int *removed, int *added)
+{
+  lex_tokens *t = &obj->tokens;
+  size_t tail = t->count - last, count = t->count - (last - first) +
+    fresh->count, i;
+  int word = 0, w;
+
+  for (i = 0; i < first; i++) {
+    word += cky_incr_word(obj, t->id[i]);
+  }
+  *removed = 0;
+  for (i = first; i < last; i++) {
+    *removed += cky_incr_word(obj, t->id[i]);
+  }
+  *added = 0;
+  for (i = 0; i < fresh->count; i++) {
+    *added += cky_incr_word(obj, fresh->id[i]);
+  }
+
+  // The tokens.
+  cky_incr_reserve(obj, count);
+  memmove(t->id + first + fresh->count, t->id + last, sizeof(int) * tail);
+  memmove(t->start + first + fresh->count, t->start + last,
+          sizeof(size_t) * tail);
+  memmove(t->length + first + fresh->count, t->length + last,
+          sizeof(size_t) * tail);
+  memmove(obj->reach + first + fresh->count, obj->reach + last,
+          sizeof(size_t) * tail);
+  memcpy(t->id + first, fresh->id, sizeof(int) * fresh->count);
+  memcpy(t->start + first, fresh->start, sizeof(size_t) * fresh->count);
+  memcpy(t->length + first, fresh->length, sizeof(size_t) * fresh->count);
+  memcpy(obj->reach + first, reach, sizeof(size_t) * fresh->count);
+  t->count = count;
+  for (i = first + fresh->count; i < count; i++) {
+    t->start[i] += delta;
+    obj->reach[i] += delta;
+  }
+
+  // The sentence.
+  if (obj->nsentence - *removed + *added > obj->sentence_capacity) {
+    while (obj->nsentence - *removed + *added > obj->sentence_capacity) {
+      obj->sentence_capacity *= 2;
+    }
+    obj->sentence = smb_renew(int, obj->sentence, obj->sentence_capacity);
+  }
+  memmove(obj->sentence + word + *added, obj->sentence + word + *removed,
+          sizeof(int) * (obj->nsentence - word - *removed));
+  w = word;
+  for (i = 0; i < fresh->count; i++) {
+    if (cky_incr_word(obj, fresh->id[i])) {
+      obj->sentence[w++] = cky_incr_terminal(obj, fresh->id[i]);
+    }
+  }
+  obj->nsentence += *added - *removed;
+  return word;
+}
+
+/**
+   @brief Edit the text, and lex and parse it again.
+
+   An edit deletes some bytes and inserts others in their place.  Setting the
+   whole text is an insertion at offset zero into an empty one.
+
+   @param obj The text
+   @param offset Byte offset of the edit
+   @param deleted Number of bytes deleted from offset on
+   @param inserted Text inserted at offset
+   @param ninserted Number of bytes inserted
+   @return True if the grammar's start symbol derives the edited text.
+ */
+bool cky_incr_edit(cky_incr *obj, size_t offset, size_t deleted,
+                   const char *inserted, size_t ninserted)
+{
+  lex_tokens *t = &obj->tokens, fresh;
+  size_t *reach, nreach, stop, old_end = offset + deleted, length, pos, match;
+  size_t first, j;
+  size_t delta = ninserted - deleted; // wraps around, like the offsets do
+  int word, removed, added, next, id;
+
+  assert(old_end <= obj->length);
+
+  // Edit the text.
+  length = obj->length - deleted + ninserted;
+  if (length > obj->capacity) {
+    while (length > obj->capacity) {
+      obj->capacity *= 2;
+    }
+    obj->text = smb_renew(char, obj->text, obj->capacity);
+  }
+  memmove(obj->text + offset + ninserted, obj->text + old_end,
+          obj->length - old_end);
+  memcpy(obj->text + offset, inserted, ninserted);
+  obj->length = length;
+
+  // Tokens that never looked as far as the edit can't have changed.
+  for (first = 0; first < t->count && obj->reach[first] <= offset; first++);
+  pos = first < t->count ? t->start[first] : t->count == 0 ? 0 :
+    t->start[t->count - 1] + t->length[t->count - 1];
+
+  // Lex until a token starts where an old one after the edit did.
+  lex_tokens_init(&fresh);
+  nreach = fresh.capacity;
+  reach = smb_new(size_t, nreach);
+  j = first;
+  while (pos < length) {
+    while (j < t->count &&
+           (t->start[j] < old_end || t->start[j] + delta < pos)) {
+      j++;
+    }
+    if (j < t->count && t->start[j] + delta == pos) {
+      break;
+    }
+    id = lex_match_utf8(obj->lex, obj->text, length, pos, &match, &stop);
+    lex_tokens_append(&fresh, id, pos, match);
+    if (fresh.capacity > nreach) {
+      nreach = fresh.capacity;
+      reach = smb_renew(size_t, reach, nreach);
+    }
+    reach[fresh.count - 1] = stop;
+    pos += match;
+  }
+  if (pos >= length) {
+    j = t->count;
+  }
+  obj->relexed = fresh.count;
+
+  word = cky_incr_splice(obj, first, j, &fresh, reach, delta, &removed,
+                         &added);
+  lex_tokens_destroy(&fresh);
+  smb_free(reach);
+
+  next = 1 - obj->current;
+  cky_chart_edit(&obj->chart[next], &obj->chart[obj->current], obj->sentence,
+                 obj->nsentence, word, removed, added);
+  obj->current = next;
+  return cky_incr_accepts(obj);
+}
+
+/**
+   @brief Return the chart of the text as it is now.
+   @param obj The text
+ */
+const cky_chart *cky_incr_chart(const cky_incr *obj)
+{
+  return &obj->chart[obj->current];
+}
+
+/**
+   @brief Return true if the grammar derives the text as it is now.
+   @param obj The text
+ */
+bool cky_incr_accepts(const cky_incr *obj)
+{
+  return cky_chart_accepts(cky_incr_chart(obj));
+}
@@ -0,0 +1,136 @@
+/***************************************************************************//**
+
+  @file         incr.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Incremental lexing and parsing of an edited text.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_INCR_H
+#define SMB_INCR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cky.h"
+#include "gram.h"
+#include "lex.h"
+
+/**
+   @brief A text kept lexed and parsed as it is edited.
+
+   Every token is kept, skipped ones included, so the tokens cover the whole
+   text.  For each one, the lexer also records how far past its start it
+   looked.  An edit can only change the tokens that looked at an edited byte,
+   so lexing starts again at the first of those.  It stops as soon as a new
+   token starts where an old token after the edit did, shifted by the change
+   in length: from there on, the old tokens are the same as new ones would
+   be.
+
+   The sentence is the terminals of the tokens that aren't skipped, and the
+   chart is filled with cky_chart_edit(), so only the cells of spans that
+   overlap the re-lexed tokens are recomputed.  Two charts are kept, and swap
+   places after each edit.
+
+   @see cky_incr_init
+   @see cky_incr_edit
+ */
+typedef struct {
+
+  /**
+     @brief The lexer.
+   */
+  smb_lex *lex;
+
+  /**
+     @brief The grammar, compiled from the CNF grammar given to init.
+   */
+  cky_grammar gram;
+
+  /**
+     @brief The grammar terminal of each lexer token, or -1.
+
+     Lexer tokens are matched to terminals by name.
+   */
+  int *terminal;
+
+  /**
+     @brief The text.
+   */
+  char *text;
+
+  /**
+     @brief Number of bytes in cky_incr.text.
+   */
+  size_t length;
+
+  /**
+     @brief Allocated size of cky_incr.text.
+   */
+  size_t capacity;
+
+  /**
+     @brief Every token of the text, skipped or not.
+   */
+  lex_tokens tokens;
+
+  /**
+     @brief For each token, the offset just after the last byte lexed for it.
+
+     The same as lex_match_utf8() returns, with room for
+     cky_incr.tokens.capacity entries.
+   */
+  size_t *reach;
+
+  /**
+     @brief The terminal of each token that isn't skipped.
+   */
+  int *sentence;
+
+  /**
+     @brief Number of terminals in cky_incr.sentence.
+   */
+  int nsentence;
+
+  /**
+     @brief Allocated length of cky_incr.sentence.
+   */
+  int sentence_capacity;
+
+  /**
+     @brief The chart of the current sentence, and the one of the last.
+   */
+  cky_chart chart[2];
+
+  /**
+     @brief Which of cky_incr.chart is current.
+   */
+  int current;
+
+  /**
+     @brief Number of tokens lexed by the last edit.
+   */
+  size_t relexed;
+
+} cky_incr;
+
+int *cky_incr_terminals(smb_lex *lex, const cnf *gram);
+
+void cky_incr_init(cky_incr *obj, smb_lex *lex, const cnf *gram);
+cky_incr *cky_incr_create(smb_lex *lex, const cnf *gram);
+void cky_incr_destroy(cky_incr *obj);
+void cky_incr_delete(cky_incr *obj);
+
+bool cky_incr_edit(cky_incr *obj, size_t offset, size_t deleted,
+                   const char *inserted, size_t ninserted);
+bool cky_incr_accepts(const cky_incr *obj);
+const cky_chart *cky_incr_chart(const cky_incr *obj);
+
+#endif//SMB_INCR_H
@@ -13,12 +13,21 @@
 
 *******************************************************************************/
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wchar.h>
 #include "libstephen/al.h"
 #include "libstephen/cb.h"
 #include "libstephen/str.h"
 #include "libstephen/regex.h"
+#include "dfa.h"
 #include "lex.h"
 
 void lex_init(smb_lex *obj)
@@ -26,6 +35,11 @@ void lex_init(smb_lex *obj)
   // Initialization logic
   al_init(&obj->patterns);
   al_init(&obj->tokens);
+  obj->skip = NULL;
+  obj->compiled = NULL;
+  obj->utf8 = NULL;
+  obj->image = NULL;
+  obj->image_size = 0;
 }
 
 smb_lex *lex_create(void)
@@ -51,13 +65,28 @@ void lex_destroy(smb_lex *obj)
   }
   al_destroy(&obj->patterns);
 
+  // The names and skip flags of a compiled lexer file are in its mapping.
   it = al_get_iter(&obj->tokens);
-  while (it.has_next(&it)) {
+  while (obj->image == NULL && it.has_next(&it)) {
     s = it.next(&it, &status).data_ptr;
     assert(status == SMB_SUCCESS);
     smb_free(s); // assumes we can free the string, may change that.
   }
   al_destroy(&obj->tokens);
+  if (obj->image == NULL) {
+    smb_free(obj->skip);
+  }
+
+  if (obj->compiled != NULL) {
+    dfa_delete(obj->compiled);
+    dfa_delete(obj->utf8);
+    obj->compiled = NULL;
+    obj->utf8 = NULL;
+  }
+  if (obj->image != NULL) {
+    munmap(obj->image, obj->image_size);
+    obj->image = NULL;
+  }
 }
 
 void lex_delete(smb_lex *obj) {
@@ -67,16 +96,70 @@ void lex_delete(smb_lex *obj) {
 
 void lex_add_pattern(smb_lex *obj, wchar_t *regex, wchar_t *token)
 {
-  fsm *f = regex_parse(regex);
-  wchar_t *s = smb_new(wchar_t, wcslen(token) + 1);
+  fsm *f;
+  wchar_t *s;
+  // A loaded compiled lexer has no FSMs to rebuild its automata from.
+  assert(obj->image == NULL);
+  f = regex_parse(regex);
+  s = smb_new(wchar_t, wcslen(token) + 1);
   al_append(&obj->patterns, (DATA){.data_ptr=f});
   wcscpy(s, token);
   al_append(&obj->tokens, (DATA){.data_ptr=s});
+  obj->skip = smb_renew(bool, obj->skip, al_length(&obj->tokens));
+  obj->skip[al_length(&obj->tokens) - 1] = false;
+
+  // The combined automaton no longer matches the pattern list.
+  if (obj->compiled != NULL) {
+    dfa_delete(obj->compiled);
+    dfa_delete(obj->utf8);
+    obj->compiled = NULL;
+    obj->utf8 = NULL;
+  }
+}
+
+/*
+  Build the union of all patterns into one DFA, tagged with pattern priority,
+  so that lex_step() is a single table lookup.  A second copy runs over UTF-8
+  bytes, for lex_step_byte().  Does nothing if the DFAs are already up to date.
+ */
+void lex_compile(smb_lex *obj)
+{
+  smb_status status = SMB_SUCCESS;
+  int i, n = al_length(&obj->patterns);
+  fsm **patterns;
+
+  if (obj->compiled != NULL) {
+    return;
+  }
+
+  patterns = smb_new(fsm *, n + 1);
+  for (i = 0; i < n; i++) {
+    patterns[i] = al_get(&obj->patterns, i, &status).data_ptr;
+    assert(status == SMB_SUCCESS);
+  }
+  obj->compiled = dfa_create(patterns, n);
+  obj->utf8 = dfa_create_utf8(obj->compiled);
+  smb_free(patterns);
 }
 
+/*
+  Mark a pattern's tokens as ones to skip (like whitespace or comments), so
+  that lex_tokenize_all() leaves them out of its output.  Not for a lexer from
+  lex_load_compiled(), whose skip flags are in its read-only image.
+ */
+void lex_set_skip(smb_lex *obj, int token, bool skip)
+{
+  assert(obj->image == NULL);
+  assert(token >= 0 && token < al_length(&obj->tokens));
+  obj->skip[token] = skip;
+}
+
+/*
+  Lines are "regex<TAB>name", optionally followed by "<TAB>skip".
+ */
 static void lex_load_line(smb_lex *obj, wchar_t *line, smb_status *status)
 {
-  wchar_t *token;
+  wchar_t *token, *flags = NULL;
   int i = 0;
   while (line[i] != L'\0' && line[i] != L'\t') {
     i++;
@@ -90,7 +173,24 @@ static void lex_load_line(smb_lex *obj, wchar_t *line, smb_status *status)
   // End the string so we can parse the regular expression.
   line[i] = L'\0';
   token = line + i + 1;
+
+  // Split off the flags field, if there is one.
+  for (i = 0; token[i] != L'\0'; i++) {
+    if (token[i] == L'\t') {
+      token[i] = L'\0';
+      flags = token + i + 1;
+      break;
+    }
+  }
+  if (flags != NULL && wcscmp(flags, L"skip") != 0) {
+    *status = SMB_INDEX_ERROR;
+    return;
+  }
+
   lex_add_pattern(obj, line, token);
+  if (flags != NULL) {
+    lex_set_skip(obj, al_length(&obj->tokens) - 1, true);
+  }
 }
 
 void lex_load(smb_lex *obj, const wchar_t *str, smb_status *status)
@@ -117,62 +217,282 @@ void lex_load(smb_lex *obj, const wchar_t *str, smb_status *status)
  cleanup:
   smb_free(buf);
   ll_delete(lines);
+  if (*status == SMB_SUCCESS) {
+    lex_compile(obj);
+  }
 }
 
-smb_lex_sim *lex_start(smb_lex *obj)
+/*
+  A compiled lexer file is a lex_image_header, followed by the codepoint and
+  UTF-8 DFAs as written by dfa_write(), the skip flags, the offset of each
+  token name, and the token names.  Everything is in native byte order, so
+  the header records enough to reject a file from some other machine.
+ */
+#define LEX_IMAGE_MAGIC "CKYLEX\0"
+#define LEX_IMAGE_VERSION 1
+#define LEX_IMAGE_ORDER 0x01020304u
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t int_size;
+  uint32_t wchar_size;
+  uint32_t bool_size;
+  uint32_t npatterns;
+  uint64_t hash;   // hash of the lexer description
+  uint64_t size;   // size of the whole file
+} lex_image_header;
+
+static void lex_image_header_init(lex_image_header *h, uint32_t npatterns,
+                                  uint64_t hash)
 {
-  int i;
-  fsm_sim *fs;
-  smb_status status;
-  smb_lex_sim *sim = smb_new(smb_lex_sim, 1);
-  al_init(&sim->simulations);
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, LEX_IMAGE_MAGIC, sizeof(h->magic));
+  h->version = LEX_IMAGE_VERSION;
+  h->byte_order = LEX_IMAGE_ORDER;
+  h->int_size = sizeof(int);
+  h->wchar_size = sizeof(wchar_t);
+  h->bool_size = sizeof(bool);
+  h->npatterns = npatterns;
+  h->hash = hash;
+}
 
-  // Create simulations for each pattern.
-  for (i = 0; i < al_length(&obj->patterns); i++) {
-    fs = fsm_sim_nondet_begin(al_get(&obj->patterns, i, &status).data_ptr);
-    assert(status == SMB_SUCCESS);
-    al_append(&sim->simulations, (DATA){.data_ptr=fs});
+/*
+  The FNV-1a hash of some bytes, for recognizing out of date lexer files.
+ */
+uint64_t lex_hash(const void *data, size_t length)
+{
+  const unsigned char *bytes = data;
+  uint64_t hash = 14695981039346656037ull;
+  size_t i;
+  for (i = 0; i < length; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
   }
+  return hash;
+}
 
+/*
+  Write the compiled lexer to a file, which lex_load_compiled() can map back
+  in without parsing any regular expressions.  The hash should identify the
+  lexer description, so that loading can tell when the file is out of date.
+  Sets SMB_NOT_FOUND_ERROR if the file can't be written.
+ */
+void lex_save(smb_lex *obj, const char *filename, uint64_t hash,
+              smb_status *status)
+{
+  smb_status st = SMB_SUCCESS;
+  int i, n = al_length(&obj->tokens);
+  int *offsets = smb_new(int, n + 1);
+  wchar_t *name, *names;
+  lex_image_header h;
+  bool ok;
+  long size;
+  FILE *f;
+
+  lex_compile(obj);
+  f = fopen(filename, "wb");
+  if (f == NULL) {
+    *status = SMB_NOT_FOUND_ERROR;
+    smb_free(offsets);
+    return;
+  }
+
+  offsets[0] = 0;
+  for (i = 0; i < n; i++) {
+    name = al_get(&obj->tokens, i, &st).data_ptr;
+    offsets[i + 1] = offsets[i] + wcslen(name) + 1;
+  }
+  names = smb_new(wchar_t, offsets[n] + 1);
+  for (i = 0; i < n; i++) {
+    name = al_get(&obj->tokens, i, &st).data_ptr;
+    wcscpy(names + offsets[i], name);
+  }
+
+  // The header is written again at the end, once the size is known.
+  lex_image_header_init(&h, n, hash);
+  ok = dfa_write_table(&h, sizeof(h), f) &&
+    dfa_write(obj->compiled, f) &&
+    dfa_write(obj->utf8, f) &&
+    dfa_write_table(obj->skip, sizeof(bool) * n, f) &&
+    dfa_write_table(offsets, sizeof(int) * n, f) &&
+    dfa_write_table(names, sizeof(wchar_t) * offsets[n], f);
+  size = ftell(f);
+  h.size = size;
+  ok = ok && size >= 0 && fseek(f, 0, SEEK_SET) == 0 &&
+    fwrite(&h, sizeof(h), 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+  smb_free(offsets);
+  smb_free(names);
+
+  if (!ok) {
+    remove(filename);
+    *status = SMB_NOT_FOUND_ERROR;
+  }
+}
+
+/*
+  Load a lexer from a file written by lex_save(), by mapping the file into
+  memory and pointing the lexer's tables straight at it.  The lexer must be
+  freshly initialized, and can't have patterns added afterwards.  Sets
+  SMB_NOT_FOUND_ERROR, leaving the lexer empty, if the file is missing, was
+  written by a different version or machine, doesn't match the hash, or is
+  cut short or corrupt.
+ */
+void lex_load_compiled(smb_lex *obj, const char *filename, uint64_t hash,
+                       smb_status *status)
+{
+  lex_image_header expect;
+  const lex_image_header *h;
+  const char *pos, *end;
+  const int *offsets;
+  const wchar_t *names;
+  dfa *compiled, *utf8;
+  struct stat st;
+  size_t used, nwide;
+  void *image;
+  uint32_t i, n;
+  int fd;
+
+  assert(obj->compiled == NULL && al_length(&obj->tokens) == 0);
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    *status = SMB_NOT_FOUND_ERROR;
+    return;
+  }
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(*h)) {
+    close(fd);
+    *status = SMB_NOT_FOUND_ERROR;
+    return;
+  }
+  image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) {
+    *status = SMB_NOT_FOUND_ERROR;
+    return;
+  }
+
+  h = image;
+  n = h->npatterns;
+  lex_image_header_init(&expect, n, hash);
+  expect.size = st.st_size;
+  if (memcmp(h, &expect, sizeof(expect)) != 0) {
+    goto invalid;
+  }
+
+  pos = (const char *) image + sizeof(*h);
+  end = (const char *) image + st.st_size;
+  compiled = smb_new(dfa, 1);
+  utf8 = smb_new(dfa, 1);
+  used = dfa_map(compiled, pos, end - pos);
+  pos += used;
+  if (used == 0 || (used = dfa_map(utf8, pos, end - pos)) == 0) {
+    goto invalid_dfa;
+  }
+  pos += used;
+  obj->skip = (bool *) dfa_map_table(&pos, end, sizeof(bool) * n);
+  offsets = dfa_map_table(&pos, end, sizeof(int) * n);
+  names = (const wchar_t *) pos;
+  if (obj->skip == NULL || offsets == NULL) {
+    goto invalid_dfa;
+  }
+  // Each name must start, and end in a null, within the image.
+  nwide = (end - pos) / sizeof(wchar_t);
+  for (i = 0; i < n; i++) {
+    if (offsets[i] < 0 || nwide <= (size_t) offsets[i] ||
+        wmemchr(names + offsets[i], L'\0', nwide - offsets[i]) == NULL) {
+      goto invalid_dfa;
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    al_append(&obj->tokens, (DATA){.data_ptr=(void *) (names + offsets[i])});
+  }
+  obj->compiled = compiled;
+  obj->utf8 = utf8;
+  obj->image = image;
+  obj->image_size = st.st_size;
+  return;
+
+ invalid_dfa:
+  obj->skip = NULL;
+  smb_free(compiled);
+  smb_free(utf8);
+ invalid:
+  munmap(image, st.st_size);
+  *status = SMB_NOT_FOUND_ERROR;
+}
+
+/*
+  Put a simulation back at the start of a token.  This never allocates, so one
+  simulation (even one on the stack) can be reused for every token of an input.
+ */
+void lex_sim_reset(smb_lex *obj, smb_lex_sim *sim)
+{
+  lex_compile(obj);
+  sim->state = obj->compiled->start;
+  sim->index = 0;
   sim->last_pattern = -1;
   sim->last_index = -1;
   sim->finished = false;
+}
+
+smb_lex_sim *lex_start(smb_lex *obj)
+{
+  smb_lex_sim *sim = smb_new(smb_lex_sim, 1);
+  lex_sim_reset(obj, sim);
   return sim;
 }
 
 bool lex_step(smb_lex *obj, smb_lex_sim *sim, wchar_t input)
 {
-  smb_status status = SMB_SUCCESS;
-  fsm_sim *fs;
-  int i, state;
-  int curr_idx = sim->last_index + 1;
-  // For each simulation...
-  for (i = 0; i < al_length(&obj->patterns); i++) {
-    // Drive forward the simulation, and get its state.
-    fs = al_get(&sim->simulations, i, &status).data_ptr;
-    assert(status == SMB_SUCCESS);
-    fsm_sim_nondet_step(fs, input);
-    // Use null byte as next input, since we don't know it yet.
-    state = fsm_sim_nondet_state(fs, L'\0');
-
-    // If the simulation is in an accepting state...
-    if (state == FSM_SIM_ACCEPTING || state == FSM_SIM_ACCEPTED) {
-      // And no other simulation has been accepting at this index...
-      if (sim->last_index < curr_idx) {
-        // Record this pattern and simulation.
-        sim->last_pattern = i;
-        sim->last_index = curr_idx;
-      }
-    }
+  int curr_idx = sim->index++;
+  // Drive forward the combined automaton for all patterns.
+  sim->state = dfa_step(obj->compiled, sim->state, input);
+
+  // If some pattern is accepting after this character, the DFA state is tagged
+  // with the first such pattern.
+  if (sim->state != DFA_DEAD &&
+      obj->compiled->accept[sim->state] != DFA_NO_PATTERN) {
+    // Record this pattern, and note that we still need more input.
+    sim->last_pattern = obj->compiled->accept[sim->state];
+    sim->last_index = curr_idx;
+    sim->finished = false;
+  } else {
+    // Otherwise, we don't need any more input.
+    sim->finished = true;
   }
+  return sim->finished;
+}
 
-  // If none of the simulations were accepting after this character...
-  if (sim->last_index < curr_idx) {
-    // Then we don't need any more input.
+/*
+  Like lex_step(), but steps the UTF-8 automaton with one byte of input.  The
+  simulation only finishes at the end of a character, so that token lengths
+  (in bytes) always cover whole characters.  Don't mix calls to lex_step() and
+  lex_step_byte() on the same simulation.
+ */
+bool lex_step_byte(smb_lex *obj, smb_lex_sim *sim, unsigned char input)
+{
+  int curr_idx = sim->index++;
+  int tag;
+  sim->state = dfa_step_byte(obj->utf8, sim->state, input);
+
+  if (sim->state == DFA_DEAD) {
     sim->finished = true;
-  } else {
-    // Otherwise, we still do need more input.
+    return true;
+  }
+
+  tag = obj->utf8->accept[sim->state];
+  if (tag == DFA_MID_CHAR) {
+    // Wait for the rest of the character.
     sim->finished = false;
+  } else if (tag != DFA_NO_PATTERN) {
+    sim->last_pattern = tag;
+    sim->last_index = curr_idx;
+    sim->finished = false;
+  } else {
+    sim->finished = true;
   }
   return sim->finished;
 }
@@ -190,6 +510,26 @@ DATA lex_get_token(smb_lex *obj, smb_lex_sim *sim)
   }
 }
 
+wchar_t *lex_token_name(smb_lex *obj, int token)
+{
+  smb_status status = SMB_SUCCESS;
+  wchar_t *name;
+  if (token == LEX_NO_TOKEN) {
+    return NULL;
+  }
+  name = al_get(&obj->tokens, token, &status).data_ptr;
+  assert(status == SMB_SUCCESS);
+  return name;
+}
+
+bool lex_token_skip(smb_lex *obj, int token)
+{
+  if (token == LEX_NO_TOKEN) {
+    return false;
+  }
+  return obj->skip[token];
+}
+
 int lex_get_length(smb_lex *obj, smb_lex_sim *sim)
 {
   if (!sim->finished) {
@@ -201,51 +541,221 @@ int lex_get_length(smb_lex *obj, smb_lex_sim *sim)
 
 void lex_sim_delete(smb_lex_sim *sim)
 {
-  smb_status status = SMB_SUCCESS;
-  int i;
-  // Finally, destroy the simulations for each pattern.
-  for (i = 0; i < al_length(&sim->simulations); i++) {
-    fsm_sim_delete(al_get(&sim->simulations, i, &status).data_ptr, true);
-    assert(status == SMB_SUCCESS);
-  }
-  al_destroy(&sim->simulations);
   smb_free(sim);
 }
 
 void lex_yylex(smb_lex *obj, wchar_t *input, DATA *token, int *length,
                smb_status *status)
 {
-  smb_lex_sim *sim = lex_start(obj);
+  smb_lex_sim sim;
+  lex_sim_reset(obj, &sim);
 
-  while (!sim->finished) {
-    lex_step(obj, sim, *input++);
+  while (!sim.finished) {
+    lex_step(obj, &sim, *input++);
   }
 
-  *token = lex_get_token(obj, sim);
-  *length = lex_get_length(obj, sim);
-  lex_sim_delete(sim);
+  *token = lex_get_token(obj, &sim);
+  *length = lex_get_length(obj, &sim);
 }
 
-wchar_t *lex_fyylex(smb_lex *obj, FILE *input, DATA *token, int *length,
-                    smb_status *status)
+/*
+  Match one token at the start of a buffer of UTF-8 text, running the automata
+  over the bytes directly.  The length is in bytes, and the token is the
+  pattern index (LEX_NO_TOKEN if nothing matched, with a length of zero).
+ */
+void lex_yylex_utf8(smb_lex *obj, const char *input, size_t avail, int *token,
+                    size_t *length)
 {
-  smb_lex_sim *sim = lex_start(obj);
-  wcbuf wcb;
+  smb_lex_sim sim;
+  size_t i = 0;
+  lex_sim_reset(obj, &sim);
+
+  while (i < avail && !lex_step_byte(obj, &sim, (unsigned char) input[i++]));
+
+  *token = sim.last_pattern;
+  *length = sim.last_index + 1;
+}
+
+/*
+  Like lex_fyylex(), but the token text is written into a caller-owned buffer,
+  which is cleared first.  Reusing the same buffer for each token means that
+  the tokenizer loop doesn't allocate once the buffer has grown large enough.
+  A read error sets status to SMB_NOT_FOUND_ERROR, and ends the token as the
+  end of the file would.
+ */
+void lex_fyylex_buf(smb_lex *obj, FILE *input, wcbuf *wcb, DATA *token,
+                    int *length, smb_status *status)
+{
+  smb_lex_sim sim;
   wchar_t curr;
-  wcb_init(&wcb, 128);
+  lex_sim_reset(obj, &sim);
+  wcb->length = 0;
 
-  while (!sim->finished) {
+  while (!sim.finished) {
     curr = fgetwc(input);
-    wcb_append(&wcb, curr);
-    lex_step(obj, sim, curr);
+    wcb_append(wcb, curr);
+    lex_step(obj, &sim, curr);
   }
 
   // The last character is never part of the token, so get rid of it.
-  wcb.buf[wcb.length-1] = L'\0';
+  wcb->buf[--wcb->length] = L'\0';
   ungetwc(curr, input);
+  if (ferror(input)) {
+    *status = SMB_NOT_FOUND_ERROR;
+  }
+
+  *token = lex_get_token(obj, &sim);
+  *length = lex_get_length(obj, &sim);
+}
 
-  *token = lex_get_token(obj, sim);
-  *length = lex_get_length(obj, sim);
-  lex_sim_delete(sim);
+wchar_t *lex_fyylex(smb_lex *obj, FILE *input, DATA *token, int *length,
+                    smb_status *status)
+{
+  wcbuf wcb;
+  wcb_init(&wcb, 128);
+  lex_fyylex_buf(obj, input, &wcb, token, length, status);
   return wcb.buf;
 }
+
+void lex_tokens_init(lex_tokens *obj)
+{
+  obj->capacity = 64;
+  obj->count = 0;
+  obj->id = smb_new(int, obj->capacity);
+  obj->start = smb_new(size_t, obj->capacity);
+  obj->length = smb_new(size_t, obj->capacity);
+}
+
+void lex_tokens_destroy(lex_tokens *obj)
+{
+  smb_free(obj->id);
+  smb_free(obj->start);
+  smb_free(obj->length);
+}
+
+void lex_tokens_append(lex_tokens *obj, int id, size_t start,
+                              size_t length)
+{
+  if (obj->count == obj->capacity) {
+    obj->capacity *= 2;
+    obj->id = smb_renew(int, obj->id, obj->capacity);
+    obj->start = smb_renew(size_t, obj->start, obj->capacity);
+    obj->length = smb_renew(size_t, obj->length, obj->capacity);
+  }
+  obj->id[obj->count] = id;
+  obj->start[obj->count] = start;
+  obj->length[obj->count] = length;
+  obj->count++;
+}
+
+/*
+  Lex the tokens of input that start at or after begin but before end, and
+  append them to out.  The last token may run past end.  Starts are offsets
+  from the beginning of input, and matching is exactly as for lex_yylex_utf8()
+  at each start.  Skipped tokens are only stored when keep_skipped is true.
+  Returns the offset just after the last token.
+ */
+size_t lex_tokenize_range(smb_lex *obj, const char *input, size_t length,
+                          size_t begin, size_t end, lex_tokens *out,
+                          bool keep_skipped)
+{
+  const dfa *d;
+  size_t pos = begin, i, best_length;
+  int state, tag, best;
+
+  lex_compile(obj);
+  d = obj->utf8;
+
+  while (pos < end && pos < length) {
+    // This is lex_yylex_utf8(), with the simulation kept in registers.
+    state = d->start;
+    best = LEX_NO_TOKEN;
+    best_length = 0;
+    for (i = pos; i < length; i++) {
+      state = dfa_step_byte(d, state, (unsigned char) input[i]);
+      if (state == DFA_DEAD) {
+        break;
+      }
+      tag = d->accept[state];
+      if (tag >= 0) {
+        best = tag;
+        best_length = i + 1 - pos;
+      } else if (tag == DFA_NO_PATTERN) {
+        break;
+      }
+    }
+
+    if (best == LEX_NO_TOKEN) {
+      best_length = dfa_utf8_length((unsigned char) input[pos]);
+      if (best_length > length - pos) {
+        best_length = length - pos;
+      }
+      lex_tokens_append(out, LEX_NO_TOKEN, pos, best_length);
+    } else if (keep_skipped || !obj->skip[best]) {
+      lex_tokens_append(out, best, pos, best_length);
+    }
+    pos += best_length;
+  }
+  return pos;
+}
+
+/*
+  Match the one token that starts at pos, exactly as lex_tokenize_range()
+  would, and return its pattern (or LEX_NO_TOKEN) and its length.  The offset
+  just after the last byte the automaton looked at is stored in *reach, or
+  length + 1 if it looked for more input at the end.  It is never before the
+  end of the token.  The token can only change when input before *reach does.
+ */
+int lex_match_utf8(smb_lex *obj, const char *input, size_t length, size_t pos,
+                   size_t *match, size_t *reach)
+{
+  const dfa *d;
+  size_t i, best_length = 0;
+  int state, tag, best = LEX_NO_TOKEN;
+
+  lex_compile(obj);
+  d = obj->utf8;
+  state = d->start;
+  for (i = pos; i < length; i++) {
+    state = dfa_step_byte(d, state, (unsigned char) input[i]);
+    if (state == DFA_DEAD) {
+      break;
+    }
+    tag = d->accept[state];
+    if (tag >= 0) {
+      best = tag;
+      best_length = i + 1 - pos;
+    } else if (tag == DFA_NO_PATTERN) {
+      break;
+    }
+  }
+  *reach = i + 1;
+
+  if (best == LEX_NO_TOKEN) {
+    best_length = dfa_utf8_length((unsigned char) input[pos]);
+    if (best_length > length - pos) {
+      // A character cut short by the end could be finished by more input.
+      best_length = length - pos;
+      *reach = length + 1;
+    }
+  }
+  if (*reach < pos + best_length) {
+    *reach = pos + best_length;
+  }
+  *match = best_length;
+  return best;
+}
+
+/*
+  Lex a whole buffer of UTF-8 text into the arrays of out, replacing whatever
+  it held before.  Token ids are pattern indices, and starts and lengths are
+  in bytes.  Tokens of patterns marked skip are matched but not stored.  Where
+  no pattern matches, one character is stored with id LEX_NO_TOKEN, and
+  lexing carries on after it.
+ */
+void lex_tokenize_all(smb_lex *obj, const char *input, size_t length,
+                      lex_tokens *out)
+{
+  out->count = 0;
+  lex_tokenize_range(obj, input, length, 0, length, out, false);
+}
@@ -17,24 +17,53 @@
 #define SMB_LEX_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include "libstephen/al.h"
+#include "libstephen/cb.h"
+#include "dfa.h"
+
+// Token number used when no pattern matches.
+#define LEX_NO_TOKEN -1
 
 typedef struct {
 
   smb_al patterns;
   smb_al tokens;
+  // For each pattern, whether lex_tokenize_all() drops its tokens.
+  bool *skip;
+  // Union of all patterns, built by lex_compile().  NULL when out of date.
+  dfa *compiled;
+  // The same automaton, over the bytes of UTF-8 text.
+  dfa *utf8;
+  // A file mapped by lex_load_compiled(), which the tables point into.
+  void *image;
+  size_t image_size;
 
 } smb_lex;
 
 typedef struct {
 
-  smb_al simulations;
+  int state;
+  int index;
   int last_pattern;
   int last_index;
   bool finished;
 
 } smb_lex_sim;
 
+// Tokens of a whole buffer, as parallel arrays.
+typedef struct {
+
+  int *id;
+  size_t *start;
+  size_t *length;
+  size_t count;
+  size_t capacity;
+
+} lex_tokens;
+
 // Data structure functions.
 void lex_init(smb_lex *obj);
 smb_lex *lex_create();
@@ -42,19 +71,49 @@ void lex_destroy(smb_lex *obj);
 void lex_delete(smb_lex *obj);
 
 // Loading from a file.
+void lex_add_pattern(smb_lex *obj, wchar_t *regex, wchar_t *token);
 void lex_load(smb_lex *obj, const wchar_t *str, smb_status *status);
+void lex_compile(smb_lex *obj);
+void lex_set_skip(smb_lex *obj, int token, bool skip);
+
+// Compiled lexer files.
+uint64_t lex_hash(const void *data, size_t length);
+void lex_save(smb_lex *obj, const char *filename, uint64_t hash,
+              smb_status *status);
+void lex_load_compiled(smb_lex *obj, const char *filename, uint64_t hash,
+                       smb_status *status);
 
 // Helper functions for the tokenizer.
+void lex_sim_reset(smb_lex *obj, smb_lex_sim *sim);
 smb_lex_sim *lex_start(smb_lex *obj);
 bool lex_step(smb_lex *obj, smb_lex_sim *sim, wchar_t input);
+bool lex_step_byte(smb_lex *obj, smb_lex_sim *sim, unsigned char input);
 DATA lex_get_token(smb_lex *obj, smb_lex_sim *sim);
+wchar_t *lex_token_name(smb_lex *obj, int token);
+bool lex_token_skip(smb_lex *obj, int token);
 int lex_get_length(smb_lex *obj, smb_lex_sim *sim);
 void lex_sim_delete(smb_lex_sim *sim);
 
-// Two tokenizer functions:
+// Tokenizer functions:
 void lex_yylex(smb_lex *obj, wchar_t *input, DATA *token, int *length,
                smb_status *st);
 wchar_t *lex_fyylex(smb_lex *obj, FILE *f, DATA *token, int *length,
                     smb_status *s);
+void lex_fyylex_buf(smb_lex *obj, FILE *f, wcbuf *buf, DATA *token,
+                    int *length, smb_status *s);
+void lex_yylex_utf8(smb_lex *obj, const char *input, size_t avail, int *token,
+                    size_t *length);
+
+// Batch tokenizer:
+void lex_tokens_init(lex_tokens *obj);
+void lex_tokens_destroy(lex_tokens *obj);
+void lex_tokens_append(lex_tokens *obj, int id, size_t start, size_t length);
+size_t lex_tokenize_range(smb_lex *obj, const char *input, size_t length,
+                          size_t begin, size_t end, lex_tokens *out,
+                          bool keep_skipped);
+int lex_match_utf8(smb_lex *obj, const char *input, size_t length, size_t pos,
+                   size_t *match, size_t *reach);
+void lex_tokenize_all(smb_lex *obj, const char *input, size_t length,
+                      lex_tokens *out);
 
 #endif//SMB_LEX_H
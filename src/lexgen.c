@@ -0,0 +1,177 @@
+/***************************************************************************//**
+
+  @file         lexgen.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Scanner generator main program.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <ctype.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "libstephen/base.h"
+#include "libstephen/ad.h"
+#include "libstephen/cb.h"
+#include "libstephen/ll.h"
+#include "codegen.h"
+#include "lex.h"
+
+/**
+   @brief Print the help message for the scanner generator.
+ */
+void help(char *name)
+{
+  printf("Usage: %s [OPTIONS] FILE\n", name);
+  puts("Generates a C scanner from the lexer description in FILE.");
+  puts("");
+  puts("Options:");
+  puts("  -o, --output [BASE]     write BASE.c and BASE.h (default: lex)");
+  puts("  -p, --prefix [PREFIX]   prefix of generated names (default: lex)");
+  puts("  -h, --help              display this help message and exit");
+}
+
+/**
+   @brief Return a flag's parameter, by its short or its long name.
+ */
+static char *parameter(smb_ad *data, char flag, char *name, char *def)
+{
+  char *value = get_flag_parameter(data, flag);
+  if (value == NULL) {
+    value = get_long_flag_parameter(data, name);
+  }
+  return value == NULL ? def : value;
+}
+
+/**
+   @brief Return true if a string is a valid C identifier.
+ */
+static bool identifier(const char *s)
+{
+  if (!isalpha((unsigned char) *s) && *s != '_') {
+    return false;
+  }
+  for (s++; *s != '\0'; s++) {
+    if (!isalnum((unsigned char) *s) && *s != '_') {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+   @brief Open a file for writing, or exit with an error.
+ */
+static FILE *open_output(const char *base, const char *extension)
+{
+  char *filename = smb_new(char, strlen(base) + strlen(extension) + 1);
+  FILE *f;
+  strcpy(filename, base);
+  strcat(filename, extension);
+  f = fopen(filename, "w");
+  if (f == NULL) {
+    perror(filename);
+    exit(1);
+  }
+  smb_free(filename);
+  return f;
+}
+
+/**
+   @brief Close an output file, or exit with an error if writing it failed.
+ */
+static void close_output(FILE *f, const char *base)
+{
+  if (ferror(f) || fclose(f) != 0) {
+    fprintf(stderr, "error: can't write output %s\n", base);
+    exit(1);
+  }
+}
+
+/**
+   @brief Main entry point of the scanner generator.
+   @param argc Number of command line arguments
+   @param argv Array of command line arguments
+   @return The program's exit code.
+ */
+int main(int argc, char **argv)
+{
+  smb_ad data;
+  smb_status status = SMB_SUCCESS;
+  smb_lex lex;
+  wcbuf desc;
+  wint_t wc;
+  char *input, *base, *prefix, *header;
+  bool help_flag;
+  FILE *f;
+
+  // The description is read as wide characters, in the locale's encoding.
+  setlocale(LC_ALL, "");
+  arg_data_init(&data);
+  process_args(&data, argc - 1, argv + 1);
+
+  help_flag = check_flag(&data, 'h') || check_long_flag(&data, "help");
+  if (help_flag || ll_length(data.bare_strings) != 1) {
+    help(argv[0]);
+    arg_data_destroy(&data);
+    exit(help_flag ? 0 : 1);
+  }
+
+  input = ll_get(data.bare_strings, 0, &status).data_ptr;
+  base = parameter(&data, 'o', "output", "lex");
+  prefix = parameter(&data, 'p', "prefix", "lex");
+  if (!identifier(prefix)) {
+    fprintf(stderr, "error: prefix \"%s\" is not a C identifier\n", prefix);
+    exit(1);
+  }
+
+  f = fopen(input, "r");
+  if (f == NULL) {
+    perror(input);
+    exit(1);
+  }
+  wcb_init(&desc, 2048);
+  while ((wc = fgetwc(f)) != WEOF) {
+    wcb_append(&desc, wc);
+  }
+  // Includes bytes that aren't a character, which end the loop early.
+  if (ferror(f)) {
+    perror(input);
+    exit(1);
+  }
+  fclose(f);
+
+  lex_init(&lex);
+  lex_load(&lex, desc.buf, &status);
+  if (status != SMB_SUCCESS) {
+    fprintf(stderr, "error: bad lexer description %s\n", input);
+    exit(1);
+  }
+
+  // The source includes the header by its name relative to the source.
+  header = strrchr(base, '/') == NULL ? base : strrchr(base, '/') + 1;
+  header = strcat(strcpy(smb_new(char, strlen(header) + 3), header), ".h");
+
+  f = open_output(base, ".h");
+  lex_generate_header(&lex, f, prefix);
+  close_output(f, base);
+  f = open_output(base, ".c");
+  lex_generate_source(&lex, f, prefix, header);
+  close_output(f, base);
+
+  smb_free(header);
+  wcb_destroy(&desc);
+  lex_destroy(&lex);
+  arg_data_destroy(&data);
+  return 0;
+}
@@ -13,11 +13,16 @@
 
 *******************************************************************************/
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <locale.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <wchar.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
 
 #include "libstephen/base.h"
 #include "libstephen/ad.h"
@@ -26,14 +31,31 @@
 #include "libstephen/str.h"
 #include "libstephen/fsm.h"
 #include "libstephen/regex.h"
+#include "cky.h"
+#include "cnf.h"
+#include "dfa.h"
+#include "forest.h"
 #include "gram.h"
 #include "lex.h"
+#include "online.h"
+#include "pcky.h"
+#include "pgrep.h"
+#include "serve.h"
+#include "stats.h"
+#include "stream.h"
+#include "valiant.h"
+#include "viterbi.h"
 
 void simple_gram(void);
 void regex(void);
+void bulk(char*, int, bool);
 void search(void);
 void dot(void);
-void lex(char*);
+void lex(char*, char*, cky_stats*);
+void parse(char*, char*, int, int, bool, int, double, int, bool, bool,
+           cky_stats*);
+void serve(char*, char*, char*, char*, int, bool, char*);
+void pipeline(char*, char*, char*, char*, cky_stats*);
 
 /**
    @brief Print the help message for the main program.
@@ -46,9 +68,33 @@ void help(char *name)
   puts("Tests:");
   puts("  -g, --simple-gram       create and print a grammar");
   puts("  -e, --regex             input regex and test strings");
+  puts("  -b, --bulk [REGEX]      match each line of stdin with REGEX");
   puts("  -s, --search            regex search file");
   puts("  -d, --dot               create graphviz dot from regex");
   puts("  -l, --lex [FILE]        perform lexical analysis");
+  puts("  -p, --parse [FILE]      recognize sentences with a grammar");
+  puts("  --serve                 answer requests with the -l lexer and -p");
+  puts("                          grammar, until the input ends");
+  puts("  --pipeline              lex stdin with -l and recognize each line");
+  puts("                          with -p, on two threads");
+  puts("");
+  puts("Options:");
+  puts("  -c, --cache [FILE]      keep the compiled lexer in FILE");
+  puts("  --grammar-cache [FILE]  keep the converted grammar in FILE");
+  puts("  -t, --threads [N]       parse with N threads (default 1), or match");
+  puts("                          with N threads (default one per core)");
+  puts("  --matching              with -b, print only the matching lines");
+  puts("  --crossover [N]         recognize from N tokens by matrix products");
+  puts("  --report                print grammar sizes before and after CNF");
+  puts("  --filter                prune chart cells by the tokens around them");
+  puts("  --trees [N]             print up to N parse trees of each sentence");
+  puts("  --best                  print the most probable parse tree");
+  puts("  --beam [N]              with --best, keep N symbols per cell");
+  puts("  --threshold [X]         with --best, drop symbols X below the best");
+  puts("  --framed                with --serve, records are length delimited");
+  puts("  --socket [PATH]         with --serve, listen on a Unix socket");
+  puts("  --stats                 with -l, -p or --pipeline, print counters");
+  puts("                          and times");
   puts("");
   puts("Misc:");
   puts("  -h, --help              display this help message and exit");
@@ -68,10 +114,15 @@ void help(char *name)
 int main(int argc, char **argv)
 {
   smb_ad data;
+  cky_stats counters, *stats = NULL;
   bool executed = false;
 
   arg_data_init(&data);
   process_args(&data, argc - 1, argv + 1);
+  if (check_long_flag(&data, "stats")) {
+    cky_stats_init(&counters);
+    stats = &counters;
+  }
 
   if (check_flag(&data, 'h') || check_long_flag(&data, "help")) {
     help(argv[0]);
@@ -87,6 +138,18 @@ int main(int argc, char **argv)
     regex();
     executed = true;
   }
+  if (check_flag(&data, 'b') || check_long_flag(&data, "bulk")) {
+    char *pattern, *threads;
+    pattern = get_flag_parameter(&data, 'b');
+    if (pattern == NULL)
+      pattern = get_long_flag_parameter(&data, "bulk");
+    threads = get_flag_parameter(&data, 't');
+    if (threads == NULL)
+      threads = get_long_flag_parameter(&data, "threads");
+    bulk(pattern, threads == NULL ? 0 : atoi(threads),
+         check_long_flag(&data, "matching"));
+    executed = true;
+  }
   if (check_flag(&data, 's') || check_long_flag(&data, "search")) {
     search();
     executed = true;
@@ -96,12 +159,81 @@ int main(int argc, char **argv)
     arg_data_destroy(&data);
     return 0; // exit silently
   }
+  if (check_long_flag(&data, "serve")) {
+    char *lexer, *grammar, *cache, *threads;
+    lexer = get_flag_parameter(&data, 'l');
+    if (lexer == NULL)
+      lexer = get_long_flag_parameter(&data, "lex");
+    grammar = get_flag_parameter(&data, 'p');
+    if (grammar == NULL)
+      grammar = get_long_flag_parameter(&data, "parse");
+    cache = get_flag_parameter(&data, 'c');
+    if (cache == NULL)
+      cache = get_long_flag_parameter(&data, "cache");
+    threads = get_flag_parameter(&data, 't');
+    if (threads == NULL)
+      threads = get_long_flag_parameter(&data, "threads");
+    serve(lexer, cache, grammar,
+          get_long_flag_parameter(&data, "grammar-cache"),
+          threads == NULL ? 1 : atoi(threads),
+          check_long_flag(&data, "framed"),
+          get_long_flag_parameter(&data, "socket"));
+    arg_data_destroy(&data);
+    return 0;
+  }
+  if (check_long_flag(&data, "pipeline")) {
+    char *lexer, *grammar, *cache;
+    lexer = get_flag_parameter(&data, 'l');
+    if (lexer == NULL)
+      lexer = get_long_flag_parameter(&data, "lex");
+    grammar = get_flag_parameter(&data, 'p');
+    if (grammar == NULL)
+      grammar = get_long_flag_parameter(&data, "parse");
+    cache = get_flag_parameter(&data, 'c');
+    if (cache == NULL)
+      cache = get_long_flag_parameter(&data, "cache");
+    pipeline(lexer, cache, grammar,
+             get_long_flag_parameter(&data, "grammar-cache"), stats);
+    if (stats != NULL) {
+      cky_stats_print(stats, stderr);
+    }
+    arg_data_destroy(&data);
+    return 0;
+  }
   if (check_flag(&data, 'l') || check_long_flag(&data, "lex")) {
-    char *filename;
+    char *filename, *cache;
     filename = get_flag_parameter(&data, 'l');
     if (filename == NULL)
       filename = get_long_flag_parameter(&data, "lex");
-    lex(filename);
+    cache = get_flag_parameter(&data, 'c');
+    if (cache == NULL)
+      cache = get_long_flag_parameter(&data, "cache");
+    lex(filename, cache, stats);
+    executed = true;
+  }
+  if (check_flag(&data, 'p') || check_long_flag(&data, "parse")) {
+    char *filename, *threads, *trees, *beam, *threshold, *crossover;
+    bool best, report, filter;
+    filename = get_flag_parameter(&data, 'p');
+    if (filename == NULL)
+      filename = get_long_flag_parameter(&data, "parse");
+    threads = get_flag_parameter(&data, 't');
+    if (threads == NULL)
+      threads = get_long_flag_parameter(&data, "threads");
+    trees = get_long_flag_parameter(&data, "trees");
+    beam = get_long_flag_parameter(&data, "beam");
+    threshold = get_long_flag_parameter(&data, "threshold");
+    crossover = get_long_flag_parameter(&data, "crossover");
+    best = check_long_flag(&data, "best") || beam != NULL || threshold != NULL;
+    report = check_long_flag(&data, "report");
+    filter = check_long_flag(&data, "filter");
+    parse(filename, get_long_flag_parameter(&data, "grammar-cache"),
+          threads == NULL ? 1 : atoi(threads),
+          trees == NULL ? 0 : atoi(trees), best,
+          beam == NULL ? 0 : atoi(beam),
+          threshold == NULL ? HUGE_VAL : atof(threshold),
+          crossover == NULL ? CKY_VALIANT_MIN_LENGTH : atoi(crossover),
+          report, filter, stats);
     executed = true;
   }
 
@@ -110,6 +242,9 @@ int main(int argc, char **argv)
     arg_data_destroy(&data);
     exit(1);
   }
+  if (stats != NULL) {
+    cky_stats_print(stats, stderr);
+  }
 
   arg_data_destroy(&data);
   return 0;
@@ -133,6 +268,9 @@ void dot(void)
 
 /**
    @brief Interactively search a file for a pattern.
+
+   The file is searched as UTF-8 bytes, without converting it to UCS-4, so hit
+   indices and lengths are in bytes.
  */
 void search(void)
 {
@@ -141,8 +279,8 @@ void search(void)
   char *regex;
   wchar_t *wregex;
   fsm *regex_fsm;
+  dfa *chars, *bytes;
   char *input;
-  wchar_t *winput;
   size_t len;
   smb_al *results;
   regex_hit *hit;
@@ -167,36 +305,30 @@ void search(void)
     fprintf(stderr, "Error converting to UCS 4.\n");
     smb_free(regex);
     smb_free(wregex);
+    fclose(file);
     return;
   }
   smb_free(regex);
   regex_fsm = regex_parse(wregex);
   smb_free(wregex);
+  chars = dfa_create(&regex_fsm, 1);
+  bytes = dfa_create_utf8(chars);
+  dfa_delete(chars);
+  fsm_delete(regex_fsm, true);
 
   input = read_file(file);
   fclose(file);
-  len = mbstowcs(NULL, regex, 0);
-  winput = smb_new(wchar_t, len + 1);
-  if (mbstowcs(winput, input, len+1) != len) {
-    PRINT_ERROR_LOC;
-    fprintf(stderr, "Error converting to UCS 4.\n");
-    fsm_delete(regex_fsm, true);
-    smb_free(input);
-    smb_free(winput);
-    return;
-  }
-  smb_free(input);
 
-  results = fsm_search(regex_fsm, winput, false, false);
+  results = dfa_search_utf8(bytes, input, strlen(input), false, false);
   for (i = 0; i < al_length(results); i++) {
     hit = (regex_hit *)al_get(results, i, &status).data_ptr;
     printf("=> Hit at index %d, length %d\n", hit->start, hit->length);
-    printf("   \"%.*ls\"\n", hit->length, winput + hit->start);
+    printf("   \"%.*s\"\n", hit->length, input + hit->start);
     regex_hit_delete(hit);
   }
 
-  smb_free(winput);
-  fsm_delete(regex_fsm, true);
+  smb_free(input);
+  dfa_delete(bytes);
   al_delete(results);
 }
 
@@ -212,6 +344,8 @@ void regex(void)
   wchar_t *str;
   smb_status status = SMB_SUCCESS;
   fsm * compiled_fsm;
+  dfa_lazy lazy;
+  bool accepted;
 
   printf("Input Regex: ");
   str = smb_read_linew(stdin, &status);
@@ -229,6 +363,8 @@ void regex(void)
 
   puts("");
 
+  // Test strings share a cache of the DFA states they visit.
+  dfa_lazy_init(&lazy, &compiled_fsm, 1, DFA_LAZY_LIMIT);
   while (true) {
     printf("Input Test String: ");
     str = smb_read_linew(stdin, &status);
@@ -236,12 +372,48 @@ void regex(void)
       smb_free(str);
       break;
     }
-    printf(fsm_sim_nondet(compiled_fsm, str) ? "Accepted.\n\n" : "Rejected.\n\n");
+    accepted = dfa_lazy_match(&lazy, str) != DFA_NO_PATTERN;
+    printf(accepted ? "Accepted.\n\n" : "Rejected.\n\n");
     smb_free(str);
   }
+  dfa_lazy_destroy(&lazy);
   fsm_delete(compiled_fsm, true);
 }
 
+/**
+   @brief Match every line of stdin against a regex, without prompts.
+
+   The regex is compiled once into a DFA over UTF-8 bytes, and a line is
+   accepted when the whole line matches.  Input is read in large blocks,
+   which are matched on several threads at once when there is enough of it,
+   and the results are printed in the order of the lines: "accept" or
+   "reject" for each line, or only the lines that match.
+
+   @param pattern The regex, or NULL.
+   @param nthreads Number of threads, or zero for one per core.
+   @param matching Print only the matching lines.
+   @see grep_stream
+ */
+void bulk(char *pattern, int nthreads, bool matching)
+{
+  grep_search search;
+  dfa_prefilter filter;
+  dfa *compiled;
+
+  setlocale(LC_ALL, "");
+  compiled = pattern == NULL ? NULL : grep_compile_line(pattern, &filter);
+  if (compiled == NULL) {
+    fprintf(stderr, "error: can't convert regex\n");
+    return;
+  }
+  grep_init(&search, compiled, &filter, nthreads, stdout);
+  search.whole_lines = true;
+  search.flags = !matching;
+  grep_stream(&search, stdin, "-");
+  grep_destroy(&search);
+  dfa_delete(compiled);
+}
+
 /**
    @brief Tests creating a grammar, and printing it out.
  */
@@ -278,41 +450,510 @@ void simple_gram(void)
   cfg_delete(gram, false);
 }
 
-/**
-  @brief Open a lexer description file, and then lex from stdin.
-  @param filename Lexer description file.
+/*
+  Load a lexer from its description file.  When a cache file is given, and it
+  was compiled from the same description, the lexer is loaded from it instead
+  of from the description.  Otherwise, the lexer compiled from the description
+  is saved there.  Returns NULL if the description can't be read.
  */
-void lex(char *filename)
+static smb_lex *load_lexer(char *filename, char *cache)
 {
-  smb_lex *lex = lex_create();
+  smb_lex *lex;
   smb_status status = SMB_SUCCESS;
   wcbuf desc;
   wint_t wc;
-  int idx = 0;
+  uint64_t hash = 0;
+  char *bytes;
   FILE *f = fopen(filename, "r");
-  wcb_init(&desc, 2048);
 
+  if (f == NULL) {
+    perror(filename);
+    return NULL;
+  }
+  lex = lex_create();
+  if (cache != NULL) {
+    // Hash the raw bytes, so that a cache hit never decodes the description.
+    bytes = read_file(f);
+    hash = lex_hash(bytes, strlen(bytes));
+    smb_free(bytes);
+    lex_load_compiled(lex, cache, hash, &status);
+    if (status == SMB_SUCCESS) {
+      fclose(f);
+      return lex;
+    }
+    status = SMB_SUCCESS;
+    // The description is read again as wide characters, which a stream
+    // already read as bytes can't do.
+    fclose(f);
+    f = fopen(filename, "r");
+  }
+
+  wcb_init(&desc, 2048);
   while ((wc = fgetwc(f)) != WEOF) {
     wcb_append(&desc, wc);
   }
   fclose(f);
 
   lex_load(lex, desc.buf, &status);
+  wcb_destroy(&desc);
   assert(status == SMB_SUCCESS);
+  if (cache != NULL) {
+    lex_save(lex, cache, hash, &status);
+    if (status != SMB_SUCCESS) {
+      fprintf(stderr, "warning: can't write lexer cache %s\n", cache);
+      status = SMB_SUCCESS;
+    }
+  }
+  return lex;
+}
 
-  while (!feof(stdin)) {
-    int length;
-    DATA token;
-    wchar_t *tokstr;
-    tokstr = lex_fyylex(lex, stdin, &token, &length, &status);
-    printf("%ls: at index=%d, length=%d\n", (wchar_t*)token.data_ptr, idx,
-           length);
-    if (wcscmp(token.data_ptr, L"whitespace") != 0) {
-      printf("  => \"%ls\"\n", tokstr);
+/**
+  @brief Open a lexer description file, and then lex from stdin.
+
+  @param filename Lexer description file.
+  @param cache Compiled lexer file, or NULL.
+  @param stats Counters for the tokens and phases, or NULL.
+  @see load_lexer
+ */
+void lex(char *filename, char *cache, cky_stats *stats)
+{
+  uint64_t clock = cky_stats_clock();
+  smb_lex *lex = load_lexer(filename, cache);
+  smb_status status = SMB_SUCCESS;
+  smb_lex_stream stream;
+  lex_span span;
+  wchar_t *name;
+
+  if (lex == NULL) {
+    return;
+  }
+  lex_compile(lex);
+  cky_stats_time(stats, CKY_PHASE_LEXER, clock);
+
+  // Token positions and lengths are in bytes of the input.
+  clock = cky_stats_clock();
+  lex_stream_init(&stream, lex, stdin);
+  stream.stats = stats;
+  while (lex_stream_next(&stream, &span, &status)) {
+    if (span.token == LEX_NO_TOKEN) {
+      printf("error: no token at index=%zu\n", span.offset);
+      continue;
+    }
+    name = lex_token_name(lex, span.token);
+    printf("%ls: at index=%zu, length=%zu\n", name, span.offset, span.length);
+    if (!lex_token_skip(lex, span.token)) {
+      printf("  => \"%.*s\"\n", (int) span.length,
+             lex_stream_text(&stream, &span));
     }
-    idx += length;
-    smb_free(tokstr);
   }
-  wcb_destroy(&desc);
+  if (status != SMB_SUCCESS) {
+    perror("error: can't read input");
+  }
+  cky_stats_time(stats, CKY_PHASE_LEX, clock);
+  lex_stream_destroy(&stream);
+  lex_delete(lex);
+}
+
+/*
+  Split a sentence into whitespace separated terminals, and return how many
+  there are.  Words that aren't terminals of the grammar become -1.
+ */
+static int parse_tokens(cnf *normal, char *line, int **tokens, int *capacity)
+{
+  smb_status status = SMB_SUCCESS;
+  char *word;
+  int n = 0;
+  DATA d;
+
+  for (word = strtok(line, " \t\r"); word != NULL;
+       word = strtok(NULL, " \t\r")) {
+    if (n == *capacity) {
+      *capacity *= 2;
+      *tokens = smb_renew(int, *tokens, *capacity);
+    }
+    d.data_ptr = word;
+    d = ht_get(&normal->terminal_index, d, &status);
+    (*tokens)[n++] = status == SMB_SUCCESS ? (int) d.data_llint : -1;
+    status = SMB_SUCCESS;
+  }
+  return n;
+}
+
+/*
+  Print a parse tree in bracketed form, like (S (A a) (B b)).
+ */
+static void print_tree(cnf *normal, const int *tokens,
+                       const cky_tree_node *nodes, int i)
+{
+  smb_status status = SMB_SUCCESS;
+  const cky_tree_node *node = &nodes[i];
+  printf("(%s ", (char *) al_get(&normal->nonterminals, node->symbol,
+                                 &status).data_ptr);
+  if (node->left < 0) {
+    printf("%s", (char *) al_get(&normal->terminals, tokens[node->start],
+                                 &status).data_ptr);
+  } else {
+    print_tree(normal, tokens, nodes, node->left);
+    printf(" ");
+    print_tree(normal, tokens, nodes, node->right);
+  }
+  printf(")");
+}
+
+/*
+  Print the number of parse trees of a filled chart, and the first few.
+ */
+static void print_trees(cnf *normal, const cky_chart *chart,
+                        const int *tokens, int ntrees)
+{
+  cky_forest forest;
+  cky_tree_node *nodes = smb_new(cky_tree_node, 2 * chart->length + 1);
+  uint64_t index = 0;
+
+  cky_forest_init(&forest, chart);
+  printf("accept %llu\n", (unsigned long long) cky_forest_count(&forest));
+  while ((int) index < ntrees && cky_forest_next(&forest, &index, nodes)) {
+    if (chart->length > 0) {
+      printf("  ");
+      print_tree(normal, tokens, nodes, 0);
+    }
+    printf("\n");
+  }
+  cky_forest_destroy(&forest);
+  smb_free(nodes);
+}
+
+/*
+  Print the most probable parse of a sentence, and its log probability.
+  Returns whether the sentence was accepted.
+ */
+static bool print_best(cnf *normal, cky_viterbi *parser, const int *tokens,
+                       int n)
+{
+  cky_tree_node *nodes = smb_new(cky_tree_node, 2 * n + 1);
+  double score = cky_viterbi_fill(parser, tokens, n);
+
+  if (score == -HUGE_VAL) {
+    puts("reject");
+  } else {
+    printf("accept %g\n", score);
+    if (n > 0 && cky_viterbi_tree(parser, nodes)) {
+      printf("  ");
+      print_tree(normal, tokens, nodes, 0);
+      printf("\n");
+    }
+  }
+  smb_free(nodes);
+  return score != -HUGE_VAL;
+}
+
+/*
+  Load a grammar file into a CNF grammar, converting it, and store the sizes
+  of each stage.  When a cache file is given, and it was converted from the
+  same grammar file, the converted grammar is mapped from it instead.
+  Otherwise, the converted grammar is saved there.  The time of each step is
+  added to stats, unless it is NULL.  Returns false, with an error printed
+  and the grammar cleaned up, if the file can't be read or converted.
+ */
+static bool load_grammar(char *filename, char *cache, cnf *normal,
+                         cnf_report *size, cky_stats *stats)
+{
+  smb_status status = SMB_SUCCESS;
+  uint64_t clock = cky_stats_clock(), hash = 0;
+  cfg gram;
+  char *text;
+  FILE *f = fopen(filename, "r");
+
+  if (f == NULL) {
+    perror(filename);
+    return false;
+  }
+  text = read_file(f);
+  fclose(f);
+  cnf_init_arena(normal);
+  if (cache != NULL) {
+    hash = lex_hash(text, strlen(text));
+    cnf_load_compiled(normal, cache, hash, size, &status);
+    if (status == SMB_SUCCESS) {
+      smb_free(text);
+      cky_stats_time(stats, CKY_PHASE_GRAMMAR, clock);
+      return true;
+    }
+    status = SMB_SUCCESS;
+  }
+  cfg_init_arena(&gram);
+  cfg_load(&gram, text, &status);
+  smb_free(text);
+  if (status != SMB_SUCCESS) {
+    fprintf(stderr, "error: bad grammar %s\n", filename);
+    cfg_destroy(&gram, true);
+    cnf_destroy(normal, true);
+    return false;
+  }
+  cky_stats_time(stats, CKY_PHASE_GRAMMAR, clock);
+  clock = cky_stats_clock();
+  cfg_to_cnf_report(&gram, normal, size, &status);
+  cfg_destroy(&gram, true);
+  cky_stats_time(stats, CKY_PHASE_CONVERT, clock);
+  if (status != SMB_SUCCESS) {
+    fprintf(stderr, "error: can't convert grammar %s\n", filename);
+    cnf_destroy(normal, true);
+    return false;
+  }
+  if (cache != NULL) {
+    cnf_save(normal, cache, hash, size, &status);
+    if (status != SMB_SUCCESS) {
+      fprintf(stderr, "warning: can't write grammar cache %s\n", cache);
+    }
+  }
+  return true;
+}
+
+/**
+  @brief Load a grammar file, and then recognize sentences from stdin.
+
+  Each line of input is a sentence of terminals separated by whitespace.  For
+  each, "accept" or "reject" is printed.  When trees are asked for, "accept"
+  is followed by the number of parse trees, and then one tree per line.  With
+  best, "accept" is followed by the log probability of the best parse, and
+  then the parse itself.
+
+  @param filename Grammar file.
+  @param cache Converted grammar file, or NULL.
+  @param nthreads Number of threads to fill each chart with.
+  @param ntrees Number of parse trees to print for each sentence.
+  @param best Print the most probable parse instead.
+  @param beam Most nonterminals to keep in each cell with best, or zero.
+  @param threshold Log probability below each cell's best to prune with best.
+  @param crossover Sentences this long or longer are recognized by matrix
+  products instead of by filling a chart, unless it is zero.
+  @param report Print the size of the grammar before and after conversion.
+  @param filter Filter chart cells by the tokens on either side.
+  @param stats Counters for the grammar, charts and phases, or NULL.
+ */
+void parse(char *filename, char *cache, int nthreads, int ntrees, bool best,
+           int beam, double threshold, int crossover, bool report,
+           bool filter, cky_stats *stats)
+{
+  cnf normal;
+  cnf_report size;
+  cky_grammar compiled;
+  cky_filter context;
+  cky_chart chart;
+  cky_pool pool;
+  cky_viterbi parser;
+  cky_valiant valiant;
+  cbuf line;
+  int c, n, capacity = 64;
+  int *tokens;
+  uint64_t clock;
+  bool accepted, have_valiant = false;
+
+  if (!load_grammar(filename, cache, &normal, &size, stats)) {
+    return;
+  }
+  if (stats != NULL) {
+    stats->grammar = size;
+  }
+  if (report) {
+    fprintf(stderr, "grammar: %d nonterminals, %d rules\n",
+            size.source_nonterminals, size.source_rules);
+    fprintf(stderr, "converted: %d nonterminals, %d rules\n",
+            size.converted_nonterminals, size.converted_rules);
+    fprintf(stderr, "optimized: %d nonterminals, %d rules\n",
+            size.nonterminals, size.rules);
+  }
+  clock = cky_stats_clock();
+  // Only the tables that will be used are built, since the filter and the
+  // matrix recognizer take longer to build than the grammar's own tables.
+  cky_grammar_init(&compiled, &normal);
+  cky_chart_init(&chart, &compiled, capacity);
+  if (filter) {
+    cky_filter_init(&context, &compiled);
+    cky_chart_set_filter(&chart, &context);
+  }
+  if (best) {
+    cky_viterbi_init(&parser, &normal);
+    parser.beam = beam;
+    parser.threshold = threshold;
+  } else {
+    cky_pool_init(&pool, nthreads);
+  }
+  cky_stats_time(stats, CKY_PHASE_COMPILE, clock);
+
+  clock = cky_stats_clock();
+  tokens = smb_new(int, capacity);
+  cb_init(&line, 256);
+  while (true) {
+    c = fgetc(stdin);
+    if (c == EOF && line.length == 0) {
+      break;
+    } else if (c == EOF || c == '\n') {
+      n = parse_tokens(&normal, line.buf, &tokens, &capacity);
+      if (best) {
+        accepted = print_best(&normal, &parser, tokens, n);
+        cky_stats_viterbi(stats, &parser, accepted);
+      } else if (ntrees > 0) {
+        accepted = cky_chart_fill_parallel(&chart, &pool, tokens, n);
+        cky_stats_chart(stats, &chart, accepted);
+        if (accepted) {
+          print_trees(&normal, &chart, tokens, ntrees);
+        } else {
+          puts("reject");
+        }
+      } else if (crossover > 0 && n >= crossover) {
+        if (!have_valiant) {
+          cky_valiant_init(&valiant, &compiled);
+          have_valiant = true;
+        }
+        accepted = cky_valiant_fill(&valiant, tokens, n);
+        cky_stats_valiant(stats, &valiant, accepted);
+        puts(accepted ? "accept" : "reject");
+      } else {
+        accepted = cky_chart_fill_parallel(&chart, &pool, tokens, n);
+        cky_stats_chart(stats, &chart, accepted);
+        puts(accepted ? "accept" : "reject");
+      }
+      line.length = 0;
+      line.buf[0] = '\0';
+    } else {
+      cb_append(&line, c);
+    }
+  }
+
+  cky_stats_time(stats, CKY_PHASE_PARSE, clock);
+
+  cb_destroy(&line);
+  smb_free(tokens);
+  if (best) {
+    cky_viterbi_destroy(&parser);
+  } else {
+    cky_pool_destroy(&pool);
+  }
+  if (have_valiant) {
+    cky_valiant_destroy(&valiant);
+  }
+  cky_chart_destroy(&chart);
+  if (filter) {
+    cky_filter_destroy(&context);
+  }
+  cky_grammar_destroy(&compiled);
+  cnf_destroy(&normal, true);
+}
+
+/**
+  @brief Load a lexer and a grammar once, and answer requests until the input
+  ends.
+
+  Requests come from stdin, with replies on stdout, or from each connection to
+  a Unix socket in turn.  Either the lexer or the grammar may be left out.
+
+  @param lexer Lexer description file, or NULL.
+  @param cache Compiled lexer file, or NULL.
+  @param grammar Grammar file, or NULL.
+  @param grammar_cache Converted grammar file, or NULL.
+  @param nthreads Number of threads to answer requests with.
+  @param framed Records are length delimited instead of lines.
+  @param socket Path of a Unix socket to listen on, or NULL.
+  @see cky_server
+ */
+void serve(char *lexer, char *cache, char *grammar, char *grammar_cache,
+           int nthreads, bool framed, char *socket)
+{
+  smb_lex *lex = NULL;
+  cnf normal;
+  cnf_report size;
+  cky_server server;
+  bool ok;
+
+  if (lexer == NULL && grammar == NULL) {
+    fprintf(stderr, "error: --serve needs a lexer, a grammar, or both\n");
+    return;
+  }
+  if (lexer != NULL && (lex = load_lexer(lexer, cache)) == NULL) {
+    return;
+  }
+  if (grammar != NULL &&
+      !load_grammar(grammar, grammar_cache, &normal, &size, NULL)) {
+    if (lex != NULL) {
+      lex_delete(lex);
+    }
+    return;
+  }
+
+  cky_server_init(&server, lex, grammar == NULL ? NULL : &normal, nthreads,
+                  framed);
+  if (socket != NULL) {
+    ok = cky_server_listen(&server, socket);
+  } else {
+    ok = cky_server_run(&server, STDIN_FILENO, STDOUT_FILENO);
+  }
+  if (!ok) {
+    fprintf(stderr, "error: %s\n", socket == NULL ? "bad request stream" :
+            "can't listen on socket");
+  }
+  cky_server_destroy(&server);
+  if (grammar != NULL) {
+    cnf_destroy(&normal, true);
+  }
+  if (lex != NULL) {
+    lex_delete(lex);
+  }
+}
+
+/**
+  @brief Lex stdin on one thread, and recognize its lines on another.
+
+  Each line of input is lexed with the lexer, and its tokens, named by the
+  grammar's terminals, are recognized as they arrive.  For each line,
+  "accept" or "reject" is printed.
+
+  @param lexer Lexer description file.
+  @param cache Compiled lexer file, or NULL.
+  @param grammar Grammar file.
+  @param grammar_cache Converted grammar file, or NULL.
+  @param stats Counters for the grammar and sentences, or NULL.
+  @see cky_pipeline
+ */
+void pipeline(char *lexer, char *cache, char *grammar, char *grammar_cache,
+              cky_stats *stats)
+{
+  smb_lex *lex;
+  cnf normal;
+  cnf_report size;
+  cky_grammar compiled;
+  cky_pipeline online;
+  uint64_t clock;
+  bool accepted;
+
+  if (lexer == NULL || grammar == NULL) {
+    fprintf(stderr, "error: --pipeline needs a lexer and a grammar\n");
+    return;
+  }
+  if ((lex = load_lexer(lexer, cache)) == NULL) {
+    return;
+  }
+  if (!load_grammar(grammar, grammar_cache, &normal, &size, stats)) {
+    lex_delete(lex);
+    return;
+  }
+  if (stats != NULL) {
+    stats->grammar = size;
+  }
+  clock = cky_stats_clock();
+  cky_grammar_init(&compiled, &normal);
+  cky_stats_time(stats, CKY_PHASE_COMPILE, clock);
+
+  clock = cky_stats_clock();
+  cky_pipeline_init(&online, lex, &normal, &compiled, stdin);
+  while (cky_pipeline_next(&online, &accepted)) {
+    cky_stats_chart(stats, NULL, accepted);
+    puts(accepted ? "accept" : "reject");
+  }
+  cky_pipeline_destroy(&online);
+  cky_stats_time(stats, CKY_PHASE_PARSE, clock);
+
+  cky_grammar_destroy(&compiled);
+  cnf_destroy(&normal, true);
   lex_delete(lex);
 }
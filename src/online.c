@@ -0,0 +1,434 @@
+/***************************************************************************//**
+
+  @file         online.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Lexing and parsing a stream at once, on two threads.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libstephen/base.h"
+#include "cky.h"
+#include "incr.h"
+#include "lex.h"
+#include "online.h"
+#include "stream.h"
+
+/*
+  Number of times a side of a ring looks again before it goes to sleep.
+ */
+#define CKY_RING_SPINS 1024
+
+/**
+   @brief Initialize an empty ring.
+   @param obj Memory to initialize
+   @param capacity Number of tokens to make room for, rounded up to a power
+   of two
+ */
+void cky_ring_init(cky_ring *obj, size_t capacity)
+{
+  size_t n = 1;
+  while (n < capacity) {
+    n *= 2;
+  }
+  obj->slots = smb_new(int, n);
+  obj->mask = n - 1;
+  obj->sleeping = 0;
+  obj->spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? CKY_RING_SPINS : 0;
+  obj->tail = 0;
+  obj->head_seen = 0;
+  obj->head = 0;
+  obj->tail_seen = 0;
+  pthread_mutex_init(&obj->lock, NULL);
+  pthread_cond_init(&obj->wake, NULL);
+}
+
+/**
+   @brief Allocate and initialize an empty ring.
+   @param capacity Number of tokens to make room for
+   @return The new ring
+ */
+cky_ring *cky_ring_create(size_t capacity)
+{
+  cky_ring *obj = smb_new(cky_ring, 1);
+  cky_ring_init(obj, capacity);
+  return obj;
+}
+
+/**
+   @brief Free a ring's slots, but not the ring itself.
+   @param obj The ring to clean up
+ */
+void cky_ring_destroy(cky_ring *obj)
+{
+  smb_free(obj->slots);
+  pthread_mutex_destroy(&obj->lock);
+  pthread_cond_destroy(&obj->wake);
+}
+
+/**
+   @brief Free a ring and its slots.
+   @param obj The ring to delete
+ */
+void cky_ring_delete(cky_ring *obj)
+{
+  cky_ring_destroy(obj);
+  smb_free(obj);
+}
+
+/*
+  Sleep until the other side moves its counter on from a value.  The counter
+  is read after cky_ring.sleeping is written, and the other side reads
+  cky_ring.sleeping after it writes the counter, so one of them always sees
+  the other: either the counter has moved, or the other side wakes this one.
+ */
+static void cky_ring_sleep(cky_ring *obj, const size_t *counter, size_t seen)
+{
+  pthread_mutex_lock(&obj->lock);
+  __atomic_add_fetch(&obj->sleeping, 1, __ATOMIC_SEQ_CST);
+  while (__atomic_load_n(counter, __ATOMIC_SEQ_CST) == seen) {
+    pthread_cond_wait(&obj->wake, &obj->lock);
+  }
+  __atomic_sub_fetch(&obj->sleeping, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&obj->lock);
+}
+
+/*
+  Wake the other side, if it is asleep.
+ */
+static void cky_ring_wake(cky_ring *obj)
+{
+  pthread_mutex_lock(&obj->lock);
+  pthread_cond_broadcast(&obj->wake);
+  pthread_mutex_unlock(&obj->lock);
+}
+
+/**
+   @brief Add a token to the ring, waiting while it is full.
+
+   Only one thread may push to a ring.  A consumer that is waiting may not
+   see the token until the ring is half full, or cky_ring_flush() is called.
+
+   @param obj The ring
+   @param token The token
+ */
+void cky_ring_push(cky_ring *obj, int token)
+{
+  size_t tail = obj->tail;
+  int spins = 0;
+
+  while (tail - obj->head_seen > obj->mask) {
+    obj->head_seen = __atomic_load_n(&obj->head, __ATOMIC_ACQUIRE);
+    if (tail - obj->head_seen <= obj->mask) {
+      break;
+    } else if (spins++ == obj->spins) {
+      cky_ring_sleep(obj, &obj->head, obj->head_seen);
+      spins = 0;
+    }
+  }
+  obj->slots[tail & obj->mask] = token;
+  __atomic_store_n(&obj->tail, tail + 1, __ATOMIC_SEQ_CST);
+  // A sleeping consumer found the ring empty, so it isn't woken for each
+  // token, but once there are enough to be worth waking for.
+  if (__atomic_load_n(&obj->sleeping, __ATOMIC_SEQ_CST) > 0 &&
+      tail + 1 - __atomic_load_n(&obj->head, __ATOMIC_ACQUIRE) >
+      obj->mask / 2) {
+    cky_ring_wake(obj);
+  }
+}
+
+/**
+   @brief Wake the consumer, if it is waiting, for the tokens pushed so far.
+
+   Call this after a token the consumer should see at once, like the end of a
+   sentence, or the last token.
+
+   @param obj The ring
+ */
+void cky_ring_flush(cky_ring *obj)
+{
+  if (__atomic_load_n(&obj->sleeping, __ATOMIC_SEQ_CST) > 0) {
+    cky_ring_wake(obj);
+  }
+}
+
+/**
+   @brief Remove the oldest token from the ring, waiting while it is empty.
+
+   Only one thread may pop from a ring.
+
+   @param obj The ring
+   @return The token
+ */
+int cky_ring_pop(cky_ring *obj)
+{
+  size_t head = obj->head;
+  int spins = 0, token;
+
+  while (head == obj->tail_seen) {
+    obj->tail_seen = __atomic_load_n(&obj->tail, __ATOMIC_ACQUIRE);
+    if (head != obj->tail_seen) {
+      break;
+    } else if (spins++ == obj->spins) {
+      cky_ring_sleep(obj, &obj->tail, head);
+      spins = 0;
+    }
+  }
+  token = obj->slots[head & obj->mask];
+  __atomic_store_n(&obj->head, head + 1, __ATOMIC_SEQ_CST);
+  // Likewise, a sleeping producer found the ring full, and waits for room.
+  if (__atomic_load_n(&obj->sleeping, __ATOMIC_SEQ_CST) > 0 &&
+      __atomic_load_n(&obj->tail, __ATOMIC_ACQUIRE) - (head + 1) <=
+      obj->mask / 2) {
+    cky_ring_wake(obj);
+  }
+  return token;
+}
+
+/**
+   @brief Initialize a chart to be filled as tokens arrive.
+   @param obj Memory to initialize
+   @param gram The compiled grammar, which must outlive the chart
+ */
+void cky_online_init(cky_online *obj, const cky_grammar *gram)
+{
+  cky_chart_init(&obj->chart, gram, 64);
+  cky_online_reset(obj);
+}
+
+/**
+   @brief Allocate and initialize a chart to be filled as tokens arrive.
+   @param gram The compiled grammar
+   @return The new chart
+ */
+cky_online *cky_online_create(const cky_grammar *gram)
+{
+  cky_online *obj = smb_new(cky_online, 1);
+  cky_online_init(obj, gram);
+  return obj;
+}
+
+/**
+   @brief Free the chart's cells, but not the chart itself.
+   @param obj The chart to clean up
+ */
+void cky_online_destroy(cky_online *obj)
+{
+  cky_chart_destroy(&obj->chart);
+}
+
+/**
+   @brief Free the chart and its cells.
+   @param obj The chart to delete
+ */
+void cky_online_delete(cky_online *obj)
+{
+  cky_online_destroy(obj);
+  smb_free(obj);
+}
+
+/**
+   @brief Start a new, empty sentence.
+   @param obj The chart
+ */
+void cky_online_reset(cky_online *obj)
+{
+  obj->chart.length = 0;
+  obj->length = 0;
+  obj->rejected = false;
+}
+
+/*
+  Move the chart to one with twice the room, keeping its cells.  The layout
+  depends on the capacity, so each cell is copied to its new place.
+ */
+static void cky_online_grow(cky_online *obj)
+{
+  const cky_grammar *g = obj->chart.gram;
+  cky_chart bigger;
+  int len, start;
+
+  cky_chart_init(&bigger, g, 2 * obj->chart.capacity);
+  for (len = 1; len <= obj->chart.length; len++) {
+    for (start = 0; start + len <= obj->chart.length; start++) {
+      memcpy(cky_chart_cell(&bigger, start, len),
+             cky_chart_cell(&obj->chart, start, len),
+             sizeof(cky_word) * g->nwords);
+    }
+  }
+  bigger.length = obj->chart.length;
+  cky_chart_destroy(&obj->chart);
+  obj->chart = bigger;
+}
+
+/**
+   @brief Add a token to the end of the sentence, and fill every span that
+   ends with it.
+   @param obj The chart
+   @param token The token's terminal, or a negative number if it isn't one
+   @return False if no sentence starting with the tokens so far is accepted.
+ */
+bool cky_online_push(cky_online *obj, int token)
+{
+  cky_chart *c = &obj->chart;
+  const cky_grammar *g = c->gram;
+  int j = obj->length++, len, w;
+  cky_word *cell, any = 0;
+
+  if (obj->rejected) {
+    return false;
+  }
+  if (j == c->capacity) {
+    cky_online_grow(obj);
+  }
+  cell = cky_chart_cell(c, j, 1);
+  if (token >= 0 && token < g->nterminals) {
+    memcpy(cell, g->leaf + token * g->nwords, sizeof(cky_word) * g->nwords);
+  } else {
+    memset(cell, 0, sizeof(cky_word) * g->nwords);
+  }
+  for (w = 0; w < g->nwords; w++) {
+    any |= cell[w];
+  }
+  // Every parse has a preterminal over each token.
+  if (any == 0) {
+    obj->rejected = true;
+    return false;
+  }
+  c->length = j + 1;
+  for (len = 2; len <= j + 1; len++) {
+    cky_chart_span(c, j + 1 - len, len);
+  }
+  return true;
+}
+
+/**
+   @brief Return true if the grammar derives the sentence so far.
+   @param obj The chart
+ */
+bool cky_online_accepts(const cky_online *obj)
+{
+  return !obj->rejected && cky_chart_accepts(&obj->chart);
+}
+
+/*
+  The lexer thread: push the terminal of every token that isn't skipped, and
+  a sentence end for every newline, and then the end of the input.
+ */
+static void *cky_pipeline_lex(void *arg)
+{
+  cky_pipeline *obj = arg;
+  smb_status status = SMB_SUCCESS;
+  smb_lex_stream stream;
+  lex_span span;
+  const char *text;
+  bool pending = false;
+  size_t i;
+
+  lex_stream_init(&stream, obj->lex, obj->in);
+  while (lex_stream_next(&stream, &span, &status)) {
+    text = lex_stream_text(&stream, &span);
+    if (span.token == LEX_NO_TOKEN) {
+      if (text[0] != '\n') {
+        cky_ring_push(&obj->ring, -1);
+      }
+    } else if (!lex_token_skip(obj->lex, span.token)) {
+      cky_ring_push(&obj->ring, obj->terminal[span.token]);
+    }
+    for (i = 0; i < span.length; i++) {
+      if (text[i] == '\n') {
+        cky_ring_push(&obj->ring, CKY_ONLINE_END);
+        cky_ring_flush(&obj->ring);
+      }
+    }
+    // Like a line, the last sentence doesn't need a newline after it.
+    pending = text[span.length - 1] != '\n';
+  }
+  if (pending) {
+    cky_ring_push(&obj->ring, CKY_ONLINE_END);
+  }
+  cky_ring_push(&obj->ring, CKY_ONLINE_EOF);
+  cky_ring_flush(&obj->ring);
+  lex_stream_destroy(&stream);
+  return NULL;
+}
+
+/**
+   @brief Initialize a pipeline, and start lexing its input.
+
+   Lexer tokens are matched with the grammar's terminals by name, as for
+   cky_incr_init().
+
+   @param obj Memory to initialize
+   @param lex The lexer, which is compiled here if it isn't already
+   @param normal The CNF grammar, whose terminals the lexer's tokens name
+   @param gram The same grammar, compiled, which must outlive the pipeline
+   @param in The input, which must stay open until the pipeline is destroyed
+ */
+void cky_pipeline_init(cky_pipeline *obj, smb_lex *lex, const cnf *normal,
+                       const cky_grammar *gram, FILE *in)
+{
+  lex_compile(lex);
+  obj->lex = lex;
+  obj->terminal = cky_incr_terminals(lex, normal);
+  obj->in = in;
+  obj->done = false;
+  cky_ring_init(&obj->ring, CKY_RING_CAPACITY);
+  cky_online_init(&obj->parser, gram);
+  pthread_create(&obj->thread, NULL, &cky_pipeline_lex, obj);
+}
+
+/**
+   @brief Stop a pipeline, and free its memory, but not the pipeline itself.
+
+   The rest of the input is lexed, and its sentences skipped.
+
+   @param obj The pipeline to clean up
+ */
+void cky_pipeline_destroy(cky_pipeline *obj)
+{
+  while (!obj->done) {
+    obj->done = cky_ring_pop(&obj->ring) == CKY_ONLINE_EOF;
+  }
+  pthread_join(obj->thread, NULL);
+  cky_online_destroy(&obj->parser);
+  cky_ring_destroy(&obj->ring);
+  smb_free(obj->terminal);
+}
+
+/**
+   @brief Parse the next sentence, as its tokens are lexed.
+   @param obj The pipeline
+   @param[out] accepted Whether the grammar derives the sentence
+   @return False at the end of the input, when there was no sentence.
+ */
+bool cky_pipeline_next(cky_pipeline *obj, bool *accepted)
+{
+  int token;
+
+  if (obj->done) {
+    return false;
+  }
+  cky_online_reset(&obj->parser);
+  while ((token = cky_ring_pop(&obj->ring)) != CKY_ONLINE_END) {
+    if (token == CKY_ONLINE_EOF) {
+      obj->done = true;
+      return false;
+    }
+    cky_online_push(&obj->parser, token);
+  }
+  *accepted = cky_online_accepts(&obj->parser);
+  return true;
+}
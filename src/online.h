@@ -0,0 +1,236 @@
+/***************************************************************************//**
+
+  @file         online.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Lexing and parsing a stream at once, on two threads.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_ONLINE_H
+#define SMB_ONLINE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "cky.h"
+#include "gram.h"
+#include "lex.h"
+
+/**
+   @brief Value in a token stream that ends a sentence.
+ */
+#define CKY_ONLINE_END -2
+
+/**
+   @brief Value in a token stream that ends the input.
+ */
+#define CKY_ONLINE_EOF -3
+
+/**
+   @brief Default number of tokens a cky_ring holds.
+ */
+#define CKY_RING_CAPACITY 4096
+
+/**
+   @brief Bytes each end of a cky_ring is padded to, so that the two threads
+   don't write to the same cache line.
+ */
+#define CKY_RING_PAD 64
+
+/**
+   @brief A queue of tokens from one thread to one other thread.
+
+   The producer only ever writes cky_ring.tail, and the consumer only ever
+   writes cky_ring.head, so passing a token takes no lock: just an atomic
+   store to publish it.  Each side keeps a copy of the other's counter, and
+   only reads the real one when the copy says the ring is full or empty.  A
+   side that finds the ring full or empty spins for a while, and then sleeps
+   on a condition variable.  A sleeping side is only woken once the ring is
+   half full, or half empty, or by cky_ring_flush(), so that the two threads
+   don't take turns a token at a time on a single core.
+
+   @see cky_ring_init
+   @see cky_ring_push
+   @see cky_ring_pop
+ */
+typedef struct {
+
+  /**
+     @brief The slots: token `i` is at `i & mask`.
+   */
+  int *slots;
+
+  /**
+     @brief Number of slots minus one.  The number of slots is a power of two.
+   */
+  size_t mask;
+
+  /**
+     @brief Signalled when a sleeping side should look at the ring again.
+   */
+  pthread_cond_t wake;
+
+  /**
+     @brief Guards sleeping on cky_ring.wake.
+   */
+  pthread_mutex_t lock;
+
+  /**
+     @brief True while a side is asleep, or about to be.
+   */
+  int sleeping;
+
+  /**
+     @brief Times to look at a full or empty ring before sleeping.  Zero on a
+     single core, where the other side can't move until this one sleeps.
+   */
+  int spins;
+
+  char pad0[CKY_RING_PAD];
+
+  /**
+     @brief Number of tokens ever pushed.  Written by the producer.
+   */
+  size_t tail;
+
+  /**
+     @brief The producer's last look at cky_ring.head.
+   */
+  size_t head_seen;
+
+  char pad1[CKY_RING_PAD];
+
+  /**
+     @brief Number of tokens ever popped.  Written by the consumer.
+   */
+  size_t head;
+
+  /**
+     @brief The consumer's last look at cky_ring.tail.
+   */
+  size_t tail_seen;
+
+  char pad2[CKY_RING_PAD];
+
+} cky_ring;
+
+/**
+   @brief A chart filled a token at a time, as the tokens arrive.
+
+   When token `j` arrives, its leaf is the preterminals of its terminal, from
+   cky_grammar.leaf, and then every span ending at `j` is filled, shortest
+   first.  Each of those only needs spans ending before `j`, or shorter spans
+   ending at `j`, so the whole chart of the sentence so far is always filled,
+   and the answer is ready as soon as the sentence ends.  A token with no
+   preterminals means no longer sentence can be accepted either, so the rest
+   of the sentence is only counted.
+
+   The chart isn't filtered, since a cell's filter depends on the token after
+   it, which hasn't arrived yet.
+
+   @see cky_online_init
+   @see cky_online_push
+ */
+typedef struct {
+
+  /**
+     @brief The chart of the sentence so far.  Its length is the number of
+     tokens pushed, until the sentence is rejected.
+   */
+  cky_chart chart;
+
+  /**
+     @brief Number of tokens pushed since the sentence began.
+   */
+  int length;
+
+  /**
+     @brief True once no continuation of the sentence can be accepted.
+   */
+  bool rejected;
+
+} cky_online;
+
+/**
+   @brief A lexer thread feeding terminals to a parser through a cky_ring.
+
+   The lexer thread runs a smb_lex_stream over the input.  Each token that
+   isn't skipped is pushed as its grammar terminal, or -1 if it has none, and
+   every newline within a token ends a sentence, so that sentences are lines,
+   as in the main program's parse mode.  The thread calling
+   cky_pipeline_next() parses each sentence with a cky_online while the rest
+   of the input is still being lexed.
+
+   @see cky_pipeline_init
+   @see cky_pipeline_next
+ */
+typedef struct {
+
+  /**
+     @brief The lexer.
+   */
+  smb_lex *lex;
+
+  /**
+     @brief The grammar terminal of each lexer token, or -1.
+   */
+  int *terminal;
+
+  /**
+     @brief The input.
+   */
+  FILE *in;
+
+  /**
+     @brief The tokens lexed but not yet parsed.
+   */
+  cky_ring ring;
+
+  /**
+     @brief The chart being filled.
+   */
+  cky_online parser;
+
+  /**
+     @brief The lexer thread.
+   */
+  pthread_t thread;
+
+  /**
+     @brief True once cky_pipeline_next() has seen the end of the input.
+   */
+  bool done;
+
+} cky_pipeline;
+
+void cky_ring_init(cky_ring *obj, size_t capacity);
+cky_ring *cky_ring_create(size_t capacity);
+void cky_ring_destroy(cky_ring *obj);
+void cky_ring_delete(cky_ring *obj);
+void cky_ring_push(cky_ring *obj, int token);
+void cky_ring_flush(cky_ring *obj);
+int cky_ring_pop(cky_ring *obj);
+
+void cky_online_init(cky_online *obj, const cky_grammar *gram);
+cky_online *cky_online_create(const cky_grammar *gram);
+void cky_online_destroy(cky_online *obj);
+void cky_online_delete(cky_online *obj);
+void cky_online_reset(cky_online *obj);
+bool cky_online_push(cky_online *obj, int token);
+bool cky_online_accepts(const cky_online *obj);
+
+void cky_pipeline_init(cky_pipeline *obj, smb_lex *lex, const cnf *normal,
+                       const cky_grammar *gram, FILE *in);
+void cky_pipeline_destroy(cky_pipeline *obj);
+bool cky_pipeline_next(cky_pipeline *obj, bool *accepted);
+
+#endif//SMB_ONLINE_H
@@ -0,0 +1,200 @@
+/***************************************************************************//**
+
+  @file         pcky.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Multithreaded CKY recognition.
+
+  Every cell on one diagonal of the chart (spans of one length) depends only on
+  the shorter diagonals, so a diagonal's cells can all be filled at once.  The
+  threads sweep the diagonals together, meeting at a barrier after each one.
+  Within a diagonal, threads claim runs of cells from a shared counter, so
+  that a thread which finishes early takes more of the work.  The runs shrink
+  as the diagonals get shorter and their cells more expensive.  The threads
+  are started once, by cky_pool_init(), and sleep between fills.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+
+#include "libstephen/base.h"
+#include "cky.h"
+#include "pcky.h"
+
+static void cky_pool_sweep(cky_pool *pool)
+{
+  int n = pool->chart->length, len, ncells, run, i, end;
+
+  for (len = 2; len <= n; len++) {
+    ncells = n - len + 1;
+    run = ncells / (4 * pool->nthreads);
+    if (run < 1) {
+      run = 1;
+    }
+    while ((i = __sync_fetch_and_add(&pool->next[len], run)) < ncells) {
+      end = i + run < ncells ? i + run : ncells;
+      for (; i < end; i++) {
+        cky_chart_span(pool->chart, i, len);
+      }
+    }
+    pthread_barrier_wait(&pool->barrier);
+  }
+}
+
+/*
+  Each thread sweeps once per fill.  Nothing touches the chart or counters
+  after the last barrier, so the next fill may reset them as soon as the
+  caller's own sweep returns.
+ */
+static void *cky_pool_run(void *arg)
+{
+  cky_pool *pool = arg;
+  unsigned long seen = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->generation == seen && !pool->stop) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    seen = pool->generation;
+    if (pool->stop) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    cky_pool_sweep(pool);
+  }
+}
+
+/**
+   @brief Start the threads of a pool.
+
+   When fewer threads can be started than were asked for, the work is shared
+   among the ones that did start, and cky_pool.nthreads says how many that is.
+
+   @param obj The pool to initialize
+   @param nthreads The most threads to fill each chart with, including the
+   caller's
+ */
+void cky_pool_init(cky_pool *obj, int nthreads)
+{
+  int i, started = 0;
+
+  obj->generation = 0;
+  obj->stop = false;
+  obj->chart = NULL;
+  obj->capacity = 0;
+  obj->next = NULL;
+  obj->threads = NULL;
+  pthread_mutex_init(&obj->lock, NULL);
+  pthread_cond_init(&obj->wake, NULL);
+
+  // The threads wait for a fill under the lock, so they can't reach the
+  // barrier before its count is known.
+  pthread_mutex_lock(&obj->lock);
+  if (nthreads > 1) {
+    obj->threads = smb_new(pthread_t, nthreads - 1);
+    for (i = 0; i < nthreads - 1; i++) {
+      if (pthread_create(&obj->threads[started], NULL, cky_pool_run, obj)
+          == 0) {
+        started++;
+      }
+    }
+  }
+  obj->nthreads = started + 1;
+  pthread_barrier_init(&obj->barrier, NULL, obj->nthreads);
+  pthread_mutex_unlock(&obj->lock);
+}
+
+/**
+   @brief Allocate and start a pool.
+   @param nthreads The most threads to fill each chart with
+   @return The new pool
+ */
+cky_pool *cky_pool_create(int nthreads)
+{
+  cky_pool *obj = smb_new(cky_pool, 1);
+  cky_pool_init(obj, nthreads);
+  return obj;
+}
+
+/**
+   @brief Stop a pool's threads and free its memory, but not the pool itself.
+   @param obj The pool, which must not be filling a chart
+ */
+void cky_pool_destroy(cky_pool *obj)
+{
+  int i;
+
+  pthread_mutex_lock(&obj->lock);
+  obj->stop = true;
+  pthread_cond_broadcast(&obj->wake);
+  pthread_mutex_unlock(&obj->lock);
+  for (i = 0; i < obj->nthreads - 1; i++) {
+    pthread_join(obj->threads[i], NULL);
+  }
+
+  pthread_barrier_destroy(&obj->barrier);
+  pthread_cond_destroy(&obj->wake);
+  pthread_mutex_destroy(&obj->lock);
+  smb_free(obj->threads);
+  smb_free(obj->next);
+}
+
+/**
+   @brief Stop a pool's threads and free it.
+   @param obj The pool
+ */
+void cky_pool_delete(cky_pool *obj)
+{
+  cky_pool_destroy(obj);
+  smb_free(obj);
+}
+
+/**
+   @brief Fill a chart with the threads of a pool.
+
+   The chart is exactly the same as cky_chart_fill() would produce.  Short
+   sentences, or pools of a single thread, are filled on this thread.
+
+   @param obj The chart
+   @param pool The pool, which must not be filling another chart
+   @param tokens The terminal index of each token
+   @param length Number of tokens
+   @return True if the grammar's start symbol derives the sentence.
+ */
+bool cky_chart_fill_parallel(cky_chart *obj, cky_pool *pool,
+                             const int *tokens, int length)
+{
+  int i;
+
+  if (pool->nthreads <= 1 || length < CKY_PARALLEL_MIN_LENGTH) {
+    return cky_chart_fill(obj, tokens, length);
+  }
+
+  cky_chart_leaves(obj, tokens, length);
+  pthread_mutex_lock(&pool->lock);
+  if (pool->capacity < length + 1) {
+    pool->capacity = length + 1;
+    pool->next = smb_renew(int, pool->next, pool->capacity);
+  }
+  for (i = 0; i <= length; i++) {
+    pool->next[i] = 0;
+  }
+  pool->chart = obj;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  // Every thread passes the last barrier before this sweep returns.
+  cky_pool_sweep(pool);
+  return cky_chart_accepts(obj);
+}
@@ -0,0 +1,103 @@
+/***************************************************************************//**
+
+  @file         pcky.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Multithreaded CKY recognition.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#ifndef SMB_PCKY_H
+#define SMB_PCKY_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "cky.h"
+
+/**
+   @brief Sentences shorter than this are always filled on one thread.
+ */
+#define CKY_PARALLEL_MIN_LENGTH 32
+
+/**
+   @brief Threads that fill charts, started once and reused for every fill.
+
+   Between fills the threads sleep on cky_pool.wake.  A fill hands them the
+   chart and bumps cky_pool.generation, and then every thread, the caller
+   included, sweeps the diagonals, meeting at cky_pool.barrier after each one.
+   Only one chart can be filled with a pool at a time.
+
+   @see cky_pool_init
+   @see cky_chart_fill_parallel
+ */
+typedef struct {
+
+  /**
+     @brief Number of threads filling each chart, counting the caller.
+   */
+  int nthreads;
+
+  /**
+     @brief The threads started, one fewer than cky_pool.nthreads.
+   */
+  pthread_t *threads;
+
+  /**
+     @brief Guards the fields below, up to cky_pool.barrier.
+   */
+  pthread_mutex_t lock;
+
+  /**
+     @brief Signalled when a fill begins, or the pool stops.
+   */
+  pthread_cond_t wake;
+
+  /**
+     @brief Number of fills begun.
+   */
+  unsigned long generation;
+
+  /**
+     @brief True once the threads should exit.
+   */
+  bool stop;
+
+  /**
+     @brief The chart being filled.
+   */
+  cky_chart *chart;
+
+  /**
+     @brief The next unclaimed start of each span length, so that no counter
+     needs resetting between diagonals.
+   */
+  int *next;
+
+  /**
+     @brief Number of counters cky_pool.next has room for.
+   */
+  int capacity;
+
+  /**
+     @brief Where the threads meet after each diagonal.
+   */
+  pthread_barrier_t barrier;
+
+} cky_pool;
+
+void cky_pool_init(cky_pool *obj, int nthreads);
+cky_pool *cky_pool_create(int nthreads);
+void cky_pool_destroy(cky_pool *obj);
+void cky_pool_delete(cky_pool *obj);
+
+bool cky_chart_fill_parallel(cky_chart *obj, cky_pool *pool,
+                             const int *tokens, int length);
+
+#endif//SMB_PCKY_H
@@ -0,0 +1,627 @@
+/***************************************************************************//**
+
+  @file         pgrep.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Parallel search of files for lines matching a regex.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wchar.h>
+
+#include "libstephen/base.h"
+#include "libstephen/fsm.h"
+#include "libstephen/regex.h"
+#include "dfa.h"
+#include "pgrep.h"
+
+static void *grep_thread(void *arg);
+
+/*
+  Compile a wide regex into a byte DFA.
+ */
+static dfa *grep_bytes(const wchar_t *regex)
+{
+  fsm *f = regex_parse(regex);
+  dfa *chars = dfa_create(&f, 1);
+  dfa *bytes = dfa_create_utf8(chars);
+  dfa_delete(chars);
+  fsm_delete(f, true);
+  return bytes;
+}
+
+/**
+   @brief Compile a pattern into a byte DFA that finds it anywhere in a line.
+
+   The pattern is wrapped as `.*(pattern)`, so the DFA accepts as soon as the
+   text so far ends with a match, and a line matches when any state reached
+   on it accepts.  The prefilter is made from the pattern alone, whose DFA
+   shows its required literal more often than the wrapped one.
+
+   @param pattern The regex, in the current locale's multibyte encoding
+   @param filter Where to store the pattern's prefilter, or NULL
+   @return The byte DFA, or NULL if the pattern couldn't be converted.
+ */
+dfa *grep_compile(const char *pattern, dfa_prefilter *filter)
+{
+  size_t length = mbstowcs(NULL, pattern, 0);
+  wchar_t *wide;
+  dfa *bytes;
+
+  if (length == (size_t) -1) {
+    return NULL;
+  }
+  wide = smb_new(wchar_t, length + 5);
+  wcscpy(wide, L".*(");
+  mbstowcs(wide + 3, pattern, length + 1);
+  if (filter != NULL) {
+    bytes = grep_bytes(wide + 3);
+    dfa_prefilter_init(filter, bytes);
+    dfa_delete(bytes);
+  }
+  wcscat(wide, L")");
+  bytes = grep_bytes(wide);
+  smb_free(wide);
+  return bytes;
+}
+
+/**
+   @brief Compile a pattern into a byte DFA that matches whole lines.
+
+   This is for a search with grep_search.whole_lines set, which runs the DFA
+   over all of each line, once, and matches the line if it ends accepting.
+
+   @param pattern The regex, in the current locale's multibyte encoding
+   @param filter Where to store the pattern's prefilter, or NULL
+   @return The byte DFA, or NULL if the pattern couldn't be converted.
+ */
+dfa *grep_compile_line(const char *pattern, dfa_prefilter *filter)
+{
+  size_t length = mbstowcs(NULL, pattern, 0);
+  wchar_t *wide;
+  dfa *bytes;
+
+  if (length == (size_t) -1) {
+    return NULL;
+  }
+  wide = smb_new(wchar_t, length + 1);
+  mbstowcs(wide, pattern, length + 1);
+  bytes = grep_bytes(wide);
+  smb_free(wide);
+  if (filter != NULL) {
+    dfa_prefilter_init(filter, bytes);
+  }
+  return bytes;
+}
+
+/**
+   @brief Initialize a search, and start its worker threads.
+
+   Output options are off, and may be set in the fields before the first path
+   is added.
+
+   @param obj Memory to initialize
+   @param pattern Byte DFA from grep_compile(), which must outlive the search
+   @param filter Prefilter from grep_compile(), or NULL to make one from the
+   DFA
+   @param nthreads Number of worker threads, or zero for one per core
+   @param out Where matching lines are printed
+ */
+void grep_init(grep_search *obj, const dfa *pattern,
+               const dfa_prefilter *filter, int nthreads, FILE *out)
+{
+  size_t i;
+  int t;
+
+  obj->pattern = pattern;
+  if (filter != NULL) {
+    obj->filter = *filter;
+  } else {
+    dfa_prefilter_init(&obj->filter, pattern);
+  }
+  obj->out = out;
+  obj->line_numbers = false;
+  obj->count = false;
+  obj->names_only = false;
+  obj->names = false;
+  obj->flags = false;
+  obj->whole_lines = false;
+  obj->chunk_size = GREP_CHUNK_SIZE;
+  obj->matches = 0;
+  obj->errors = 0;
+  if (nthreads < 1) {
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  obj->nthreads = nthreads < 1 ? 1 : nthreads;
+
+  obj->capacity = 4 * obj->nthreads < 8 ? 8 : 4 * obj->nthreads;
+  obj->window = smb_new(grep_chunk, obj->capacity);
+  for (i = 0; i < obj->capacity; i++) {
+    obj->window[i].line = NULL;
+    obj->window[i].start = NULL;
+    obj->window[i].length_of = NULL;
+    obj->window[i].capacity = 0;
+  }
+  obj->added = 0;
+  obj->claimed = 0;
+  obj->printed = 0;
+  obj->quit = false;
+
+  pthread_mutex_init(&obj->lock, NULL);
+  pthread_cond_init(&obj->work, NULL);
+  pthread_cond_init(&obj->done, NULL);
+  obj->threads = smb_new(pthread_t, obj->nthreads);
+  for (t = 0; t < obj->nthreads; t++) {
+    pthread_create(&obj->threads[t], NULL, &grep_thread, obj);
+  }
+}
+
+/**
+   @brief Allocate and initialize a search.
+   @param pattern Byte DFA from grep_compile()
+   @param filter Prefilter from grep_compile(), or NULL
+   @param nthreads Number of worker threads, or zero for one per core
+   @param out Where matching lines are printed
+   @return The new search
+ */
+grep_search *grep_create(const dfa *pattern, const dfa_prefilter *filter,
+                         int nthreads, FILE *out)
+{
+  grep_search *obj = smb_new(grep_search, 1);
+  grep_init(obj, pattern, filter, nthreads, out);
+  return obj;
+}
+
+/**
+   @brief Finish a search, stop its threads, and free its memory, but not the
+   search itself, nor its pattern.
+   @param obj The search to clean up
+ */
+void grep_destroy(grep_search *obj)
+{
+  size_t i;
+  int t;
+
+  grep_finish(obj);
+  pthread_mutex_lock(&obj->lock);
+  obj->quit = true;
+  pthread_cond_broadcast(&obj->work);
+  pthread_mutex_unlock(&obj->lock);
+  for (t = 0; t < obj->nthreads; t++) {
+    pthread_join(obj->threads[t], NULL);
+  }
+  pthread_mutex_destroy(&obj->lock);
+  pthread_cond_destroy(&obj->work);
+  pthread_cond_destroy(&obj->done);
+  smb_free(obj->threads);
+
+  for (i = 0; i < obj->capacity; i++) {
+    smb_free(obj->window[i].line);
+    smb_free(obj->window[i].start);
+    smb_free(obj->window[i].length_of);
+  }
+  smb_free(obj->window);
+}
+
+/**
+   @brief Finish and free a search created with grep_create().
+   @param obj The search to delete
+ */
+void grep_delete(grep_search *obj)
+{
+  grep_destroy(obj);
+  smb_free(obj);
+}
+
+/*
+  Record a matching line of a chunk.
+ */
+static void grep_chunk_add(grep_chunk *c, size_t line, size_t start,
+                           size_t length)
+{
+  if (c->nmatches == c->capacity) {
+    c->capacity = c->capacity == 0 ? 16 : 2 * c->capacity;
+    c->line = smb_renew(size_t, c->line, c->capacity);
+    c->start = smb_renew(size_t, c->start, c->capacity);
+    c->length_of = smb_renew(size_t, c->length_of, c->capacity);
+  }
+  c->line[c->nmatches] = line;
+  c->start[c->nmatches] = start;
+  c->length_of[c->nmatches] = length;
+  c->nmatches++;
+}
+
+/*
+  Find the matching lines of a chunk.  Each line runs the DFA from its start
+  state, and stops at the first accepting state, or when the DFA dies; either
+  way the rest of the line is skipped with memchr().  With whole lines, the
+  DFA runs to the end of the line instead, unless it dies.  When the pattern
+  has a required literal, lines before its next occurrence are only counted.
+ */
+static void grep_chunk_search(const grep_search *obj, grep_chunk *c)
+{
+  const dfa *pattern = obj->pattern;
+  const unsigned char *text = (const unsigned char *) c->text;
+  const unsigned char *eol;
+  const char *found;
+  size_t pos = 0, end, i, line = 0, literal = 0;
+  bool empty, matched, searched = false;
+  int state;
+
+  empty = pattern->start != DFA_DEAD && pattern->accept[pattern->start] >= 0;
+  c->nmatches = 0;
+  while (pos < c->length) {
+    if (obj->filter.literal_length > 0 && (!searched || literal < pos)) {
+      found = dfa_prefilter_find(&obj->filter, c->text + pos,
+                                 c->length - pos);
+      literal = found == NULL ? c->length : (size_t) (found - c->text);
+      searched = true;
+    }
+    eol = memchr(text + pos, '\n', c->length - pos);
+    end = eol == NULL ? c->length : (size_t) (eol - text);
+    state = pattern->start;
+    matched = empty;
+    if (obj->filter.literal_length > 0 && literal >= end) {
+      state = DFA_DEAD;
+    }
+    if (obj->whole_lines) {
+      for (i = pos; i < end && state != DFA_DEAD; i++) {
+        state = dfa_step_byte(pattern, state, text[i]);
+      }
+      matched = state != DFA_DEAD && pattern->accept[state] >= 0;
+    } else {
+      for (i = pos; i < end && !matched && state != DFA_DEAD; i++) {
+        state = dfa_step_byte(pattern, state, text[i]);
+        matched = state != DFA_DEAD && pattern->accept[state] >= 0;
+      }
+    }
+    if (matched) {
+      grep_chunk_add(c, line, pos, end - pos);
+    }
+    line++;
+    pos = end + 1;
+  }
+  c->nlines = line;
+}
+
+/*
+  Worker threads search chunks in the order they were added.
+ */
+static void *grep_thread(void *arg)
+{
+  grep_search *obj = arg;
+  grep_chunk *c;
+
+  pthread_mutex_lock(&obj->lock);
+  for (;;) {
+    while (obj->claimed == obj->added && !obj->quit) {
+      pthread_cond_wait(&obj->work, &obj->lock);
+    }
+    if (obj->claimed == obj->added) {
+      break;
+    }
+    c = &obj->window[obj->claimed++ % obj->capacity];
+    pthread_mutex_unlock(&obj->lock);
+    grep_chunk_search(obj, c);
+    pthread_mutex_lock(&obj->lock);
+    c->done = true;
+    pthread_cond_signal(&obj->done);
+  }
+  pthread_mutex_unlock(&obj->lock);
+  return NULL;
+}
+
+/*
+  Print the path and line number that come before a line, if they are asked
+  for.  The line is numbered within the chunk, from zero.
+ */
+static void grep_print_prefix(grep_search *obj, grep_file *f, size_t line)
+{
+  if (obj->names) {
+    fprintf(obj->out, "%s:", f->path);
+  }
+  if (obj->line_numbers) {
+    fprintf(obj->out, "%lu:", (unsigned long) (f->lines + line + 1));
+  }
+}
+
+/*
+  Wait for the oldest chunk of the window to be searched, and print it.  After
+  a file's last chunk, print its count or name, and unmap it.
+ */
+static void grep_print_next(grep_search *obj)
+{
+  grep_chunk *c = &obj->window[obj->printed % obj->capacity];
+  grep_file *f = c->file;
+  size_t i, line;
+
+  pthread_mutex_lock(&obj->lock);
+  while (!c->done) {
+    pthread_cond_wait(&obj->done, &obj->lock);
+  }
+  pthread_mutex_unlock(&obj->lock);
+
+  if (obj->count || obj->names_only) {
+    // Only the totals are printed.
+  } else if (obj->flags) {
+    for (i = 0, line = 0; line < c->nlines; line++) {
+      grep_print_prefix(obj, f, line);
+      if (i < c->nmatches && c->line[i] == line) {
+        fputs("accept\n", obj->out);
+        i++;
+      } else {
+        fputs("reject\n", obj->out);
+      }
+    }
+  } else {
+    for (i = 0; i < c->nmatches; i++) {
+      grep_print_prefix(obj, f, c->line[i]);
+      fwrite(c->text + c->start[i], 1, c->length_of[i], obj->out);
+      fputc('\n', obj->out);
+    }
+  }
+  f->matches += c->nmatches;
+  f->lines += c->nlines;
+  smb_free(c->buffer);
+  c->buffer = NULL;
+
+  if (c->last) {
+    if (obj->count && obj->names) {
+      fprintf(obj->out, "%s:%lu\n", f->path, (unsigned long) f->matches);
+    } else if (obj->count) {
+      fprintf(obj->out, "%lu\n", (unsigned long) f->matches);
+    } else if (obj->names_only && f->matches > 0) {
+      fprintf(obj->out, "%s\n", f->path);
+    }
+    obj->matches += f->matches;
+    if (f->length > 0) {
+      munmap((void *) f->text, f->length);
+    }
+    smb_free(f->path);
+    smb_free(f);
+  }
+  obj->printed++;
+}
+
+/*
+  Add a chunk to the window, printing the oldest first if the window is full.
+  The chunk frees buffer once it is printed, unless it is NULL.
+ */
+static void grep_add(grep_search *obj, grep_file *f, const char *text,
+                     size_t length, bool last, char *buffer)
+{
+  grep_chunk *c;
+
+  while (obj->added - obj->printed == obj->capacity) {
+    grep_print_next(obj);
+  }
+  c = &obj->window[obj->added % obj->capacity];
+  c->file = f;
+  c->text = text;
+  c->length = length;
+  c->last = last;
+  c->buffer = buffer;
+  c->done = false;
+  c->nmatches = 0;
+  c->nlines = 0;
+
+  pthread_mutex_lock(&obj->lock);
+  obj->added++;
+  pthread_cond_signal(&obj->work);
+  pthread_mutex_unlock(&obj->lock);
+}
+
+/*
+  Report a path that couldn't be searched, from errno.
+ */
+static bool grep_error(grep_search *obj, const char *path)
+{
+  fprintf(stderr, "%s: %s\n", path, strerror(errno));
+  obj->errors++;
+  return false;
+}
+
+/*
+  Allocate the record of a file being searched.
+ */
+static grep_file *grep_file_new(const char *path, const char *text,
+                                size_t length)
+{
+  grep_file *f = smb_new(grep_file, 1);
+  f->path = smb_new(char, strlen(path) + 1);
+  strcpy(f->path, path);
+  f->text = text;
+  f->length = length;
+  f->matches = 0;
+  f->lines = 0;
+  return f;
+}
+
+/*
+  Map a file and add it to the window, in chunks that end at line ends.  An
+  empty file is one empty chunk, so that its count is still printed.
+ */
+static bool grep_file_add(grep_search *obj, const char *path)
+{
+  struct stat st;
+  grep_file *f;
+  void *text = NULL;
+  const char *eol;
+  size_t start = 0, end, size;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return grep_error(obj, path);
+  }
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return grep_error(obj, path);
+  }
+  if (st.st_size > 0) {
+    text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED) {
+      close(fd);
+      return grep_error(obj, path);
+    }
+    posix_madvise(text, st.st_size, POSIX_MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  f = grep_file_new(path, text, st.st_size);
+
+  size = obj->chunk_size < 1 ? 1 : obj->chunk_size;
+  do {
+    end = f->length - start > size ? start + size : f->length;
+    if (end < f->length) {
+      eol = memchr(f->text + end - 1, '\n', f->length - end + 1);
+      end = eol == NULL ? f->length : (size_t) (eol - f->text) + 1;
+    }
+    grep_add(obj, f, f->text + start, end - start, end == f->length, NULL);
+    start = end;
+  } while (start < f->length);
+  return true;
+}
+
+/*
+  Add every regular file under a directory, in sorted order.  Symbolic links
+  inside directories aren't followed, so a search can't loop.
+ */
+static bool grep_directory(grep_search *obj, const char *path)
+{
+  struct dirent **entries;
+  struct stat st;
+  size_t length = strlen(path);
+  char *child;
+  bool ok = true;
+  int n, i;
+
+  n = scandir(path, &entries, NULL, &alphasort);
+  if (n < 0) {
+    return grep_error(obj, path);
+  }
+  for (i = 0; i < n; i++) {
+    if (strcmp(entries[i]->d_name, ".") != 0 &&
+        strcmp(entries[i]->d_name, "..") != 0) {
+      child = smb_new(char, length + strlen(entries[i]->d_name) + 2);
+      strcpy(child, path);
+      if (length == 0 || path[length - 1] != '/') {
+        strcat(child, "/");
+      }
+      strcat(child, entries[i]->d_name);
+      if (lstat(child, &st) != 0) {
+        ok = grep_error(obj, child) && ok;
+      } else if (S_ISDIR(st.st_mode)) {
+        ok = grep_directory(obj, child) && ok;
+      } else if (S_ISREG(st.st_mode)) {
+        ok = grep_file_add(obj, child) && ok;
+      }
+      smb_free(child);
+    }
+    free(entries[i]);
+  }
+  free(entries);
+  return ok;
+}
+
+/**
+   @brief Search a file, or every file under a directory.
+
+   Output is printed as the chunks before it finish, so some of it may still
+   be waiting when this returns.  Paths that can't be searched are reported
+   on stderr, and counted in grep_search.errors.
+
+   @param obj The search
+   @param path The file or directory
+   @return True if everything under the path could be searched.
+ */
+bool grep_path(grep_search *obj, const char *path)
+{
+  struct stat st;
+
+  if (stat(path, &st) != 0) {
+    return grep_error(obj, path);
+  } else if (S_ISDIR(st.st_mode)) {
+    return grep_directory(obj, path);
+  }
+  return grep_file_add(obj, path);
+}
+
+/**
+   @brief Search a stream, such as stdin, which can't be mapped.
+
+   The stream is read in blocks of about grep_search.chunk_size bytes, ending
+   at line ends, and each block is a chunk of its own, freed once it has been
+   printed.  So the stream is searched on every core while more of it is
+   read, in no more memory than the window's chunks.  A line longer than a
+   block makes the blocks after it larger.
+
+   @param obj The search
+   @param in The stream, which is read to its end but not closed
+   @param name The name printed for the stream
+   @return True if the stream could be read.
+ */
+bool grep_stream(grep_search *obj, FILE *in, const char *name)
+{
+  grep_file *f = grep_file_new(name, NULL, 0);
+  size_t capacity = obj->chunk_size < 1 ? 1 : obj->chunk_size;
+  size_t have = 0, end;
+  char *buf = smb_new(char, capacity), *next;
+  bool eof = false;
+
+  while (!eof) {
+    have += fread(buf + have, 1, capacity - have, in);
+    // A short read means the end of the stream, or an error.
+    eof = have < capacity;
+    for (end = have; !eof && end > 0 && buf[end - 1] != '\n'; end--);
+    if (!eof && end == 0) {
+      // No line ends in the block: make room for more of the line.
+      capacity *= 2;
+      buf = smb_renew(char, buf, capacity);
+      continue;
+    }
+    next = NULL;
+    if (!eof) {
+      next = smb_new(char, capacity);
+      memcpy(next, buf + end, have - end);
+    }
+    grep_add(obj, f, buf, end, eof, buf);
+    buf = next;
+    have -= end;
+  }
+  if (ferror(in)) {
+    return grep_error(obj, name);
+  }
+  return true;
+}
+
+/**
+   @brief Wait for every path added so far to be searched, and print the rest
+   of the output.
+   @param obj The search
+ */
+void grep_finish(grep_search *obj)
+{
+  while (obj->printed < obj->added) {
+    grep_print_next(obj);
+  }
+  fflush(obj->out);
+}
@@ -0,0 +1,286 @@
+/***************************************************************************//**
+
+  @file         pgrep.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Parallel search of files for lines matching a regex.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_PGREP_H
+#define SMB_PGREP_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "dfa.h"
+
+/**
+   @brief Default number of bytes in each piece of a file searched alone.
+ */
+#define GREP_CHUNK_SIZE (1 << 20)
+
+/**
+   @brief A file being searched, mapped into memory.
+ */
+typedef struct {
+
+  /**
+     @brief The file's path, as given or found in a directory.
+   */
+  char *path;
+
+  /**
+     @brief The file's contents.
+   */
+  const char *text;
+
+  /**
+     @brief Number of bytes in the file.
+   */
+  size_t length;
+
+  /**
+     @brief Matching lines in the chunks printed so far.
+   */
+  size_t matches;
+
+  /**
+     @brief Lines in the chunks printed so far.
+   */
+  size_t lines;
+
+} grep_file;
+
+/**
+   @brief A line-aligned piece of a file, and the lines of it that match.
+ */
+typedef struct {
+
+  /**
+     @brief The file the chunk is part of.
+   */
+  grep_file *file;
+
+  /**
+     @brief The chunk's first byte, within the file's contents.
+   */
+  const char *text;
+
+  /**
+     @brief Number of bytes in the chunk.
+   */
+  size_t length;
+
+  /**
+     @brief True for the file's last chunk.
+   */
+  bool last;
+
+  /**
+     @brief True once a worker has searched the chunk.
+   */
+  bool done;
+
+  /**
+     @brief Number of lines in the chunk.
+   */
+  size_t nlines;
+
+  /**
+     @brief Line number within the chunk of each matching line, from zero.
+   */
+  size_t *line;
+
+  /**
+     @brief Offset within the chunk of each matching line.
+   */
+  size_t *start;
+
+  /**
+     @brief Length of each matching line, without its newline.
+   */
+  size_t *length_of;
+
+  /**
+     @brief Memory holding the chunk's text, freed once it is printed, or
+     NULL when the text is part of a mapped file.
+   */
+  char *buffer;
+
+  /**
+     @brief Number of matching lines.
+   */
+  size_t nmatches;
+
+  /**
+     @brief Room in the arrays of matching lines.
+   */
+  size_t capacity;
+
+} grep_chunk;
+
+/**
+   @brief A search of many files for the lines that match one pattern.
+
+   Each file is mapped into memory and split into chunks of about
+   grep_search.chunk_size bytes, ending at line ends.  A stream is read into
+   chunks like these a block at a time.  Chunks go into a
+   window, which worker threads take them from in order, so a large file is
+   searched on every core at once, and so is a stream of small ones.  The
+   thread adding files prints the oldest chunk of the window once it has been
+   searched, so output comes in the order of the files and lines, while the
+   workers search ahead.
+
+   The output options are fields, to be set after grep_init().
+
+   @see grep_init
+   @see grep_path
+   @see grep_stream
+   @see grep_finish
+ */
+typedef struct {
+
+  /**
+     @brief Byte DFA that accepts once it has seen a match, from grep_compile().
+   */
+  const dfa *pattern;
+
+  /**
+     @brief The pattern's required literal, so lines without it are skipped.
+   */
+  dfa_prefilter filter;
+
+  /**
+     @brief Where matching lines are printed.
+   */
+  FILE *out;
+
+  /**
+     @brief Print each line's number before it.
+   */
+  bool line_numbers;
+
+  /**
+     @brief Print the number of matching lines of each file instead of them.
+   */
+  bool count;
+
+  /**
+     @brief Print only the paths of files with a matching line.
+   */
+  bool names_only;
+
+  /**
+     @brief Print the path of the file before each line or count.
+   */
+  bool names;
+
+  /**
+     @brief Print "accept" or "reject" for every line, instead of the
+     matching lines.
+   */
+  bool flags;
+
+  /**
+     @brief A line matches only if all of it does, as with a DFA from
+     grep_compile_line(), rather than if any state reached on it accepts.
+   */
+  bool whole_lines;
+
+  /**
+     @brief Bytes in each chunk, rounded up to the next line end.
+   */
+  size_t chunk_size;
+
+  /**
+     @brief Matching lines found in every file printed so far.
+   */
+  size_t matches;
+
+  /**
+     @brief Number of paths that couldn't be searched.
+   */
+  int errors;
+
+  /**
+     @brief Number of worker threads.
+   */
+  int nthreads;
+
+  /**
+     @brief The worker threads.
+   */
+  pthread_t *threads;
+
+  /**
+     @brief Guards the window and its counters.
+   */
+  pthread_mutex_t lock;
+
+  /**
+     @brief Signalled when a chunk is added, or the workers should quit.
+   */
+  pthread_cond_t work;
+
+  /**
+     @brief Signalled when a worker finishes a chunk.
+   */
+  pthread_cond_t done;
+
+  /**
+     @brief Ring of chunks waiting to be printed: chunk `i` is at `i %
+     capacity`.
+   */
+  grep_chunk *window;
+
+  /**
+     @brief Number of chunks the window holds.
+   */
+  size_t capacity;
+
+  /**
+     @brief Number of chunks ever added.
+   */
+  size_t added;
+
+  /**
+     @brief Number of chunks ever taken by a worker.
+   */
+  size_t claimed;
+
+  /**
+     @brief Number of chunks ever printed.
+   */
+  size_t printed;
+
+  /**
+     @brief True once the workers should exit.
+   */
+  bool quit;
+
+} grep_search;
+
+dfa *grep_compile(const char *pattern, dfa_prefilter *filter);
+dfa *grep_compile_line(const char *pattern, dfa_prefilter *filter);
+
+void grep_init(grep_search *obj, const dfa *pattern,
+               const dfa_prefilter *filter, int nthreads, FILE *out);
+grep_search *grep_create(const dfa *pattern, const dfa_prefilter *filter,
+                         int nthreads, FILE *out);
+void grep_destroy(grep_search *obj);
+void grep_delete(grep_search *obj);
+
+bool grep_path(grep_search *obj, const char *path);
+bool grep_stream(grep_search *obj, FILE *in, const char *name);
+void grep_finish(grep_search *obj);
+
+#endif//SMB_PGREP_H
@@ -0,0 +1,162 @@
+/***************************************************************************//**
+
+  @file         plex.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Multithreaded tokenizing of large buffers.
+
+  The input is cut into one chunk per thread, and every chunk is lexed at the
+  same time, as if a token started at the beginning of the chunk.  For every
+  chunk but the first, that is only a guess.  The guesses are checked in
+  order: once the true token boundaries reach a start that the chunk's lexer
+  also found, every later token of the chunk is the same as the sequential
+  lexer would have produced, since matching only depends on where a token
+  starts.  Until then, the boundary region is lexed again sequentially.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <pthread.h>
+
+#include "libstephen/base.h"
+#include "lex.h"
+#include "plex.h"
+
+/*
+  One chunk of the input, and the tokens guessed for it.  The tokens include
+  skipped ones, because any of them may be where the true boundaries resync.
+ */
+typedef struct {
+
+  smb_lex *lex;
+  const char *input;
+  size_t length;
+  size_t begin;
+  size_t end;
+  size_t stop; // offset just after the chunk's last token
+  lex_tokens tokens;
+
+} lex_chunk;
+
+static void *lex_chunk_run(void *arg)
+{
+  lex_chunk *chunk = arg;
+  chunk->stop = lex_tokenize_range(chunk->lex, chunk->input, chunk->length,
+                                   chunk->begin, chunk->end, &chunk->tokens,
+                                   true);
+  return NULL;
+}
+
+/*
+  Move a chunk boundary forward to the start of a UTF-8 character, so that the
+  guessed tokens at least begin on a character.
+ */
+static size_t lex_chunk_align(const char *input, size_t length, size_t pos)
+{
+  while (pos < length && ((unsigned char) input[pos] & 0xC0) == 0x80) {
+    pos++;
+  }
+  return pos;
+}
+
+/*
+  Append the true tokens of a chunk to out, given the offset pos where the true
+  token boundaries enter it.  Returns the offset after the chunk's last token.
+ */
+static size_t lex_chunk_stitch(lex_chunk *chunk, size_t pos, lex_tokens *out)
+{
+  const lex_tokens *guess = &chunk->tokens;
+  size_t k = 0;
+  int id;
+
+  while (true) {
+    while (k < guess->count && guess->start[k] < pos) {
+      k++;
+    }
+    if (k < guess->count && guess->start[k] == pos) {
+      break; // resynchronized
+    }
+    if (pos >= chunk->end) {
+      return pos; // the previous chunk's last token covered this one
+    }
+    // Lex one true token.
+    pos = lex_tokenize_range(chunk->lex, chunk->input, chunk->length, pos,
+                             pos + 1, out, false);
+  }
+
+  for (; k < guess->count; k++) {
+    id = guess->id[k];
+    if (!lex_token_skip(chunk->lex, id)) {
+      lex_tokens_append(out, id, guess->start[k], guess->length[k]);
+    }
+  }
+  return chunk->stop;
+}
+
+/*
+  Like lex_tokenize_all(), but lexes with up to nthreads threads.  The result
+  is always exactly the same as lex_tokenize_all() would give.
+ */
+void lex_tokenize_parallel(smb_lex *obj, const char *input, size_t length,
+                           lex_tokens *out, int nthreads)
+{
+  lex_chunk *chunks;
+  pthread_t *threads;
+  bool *started;
+  size_t pos;
+  int i, n = nthreads;
+
+  if ((size_t) n > length / LEX_PARALLEL_MIN_CHUNK) {
+    n = length / LEX_PARALLEL_MIN_CHUNK;
+  }
+  if (n <= 1) {
+    lex_tokenize_all(obj, input, length, out);
+    return;
+  }
+
+  // The automata are only read from here on, so the threads can share them.
+  lex_compile(obj);
+
+  chunks = smb_new(lex_chunk, n);
+  threads = smb_new(pthread_t, n);
+  started = smb_new(bool, n);
+  for (i = 0; i < n; i++) {
+    chunks[i].lex = obj;
+    chunks[i].input = input;
+    chunks[i].length = length;
+    chunks[i].begin = lex_chunk_align(input, length, length / n * i);
+    chunks[i].end = i + 1 == n ? length :
+      lex_chunk_align(input, length, length / n * (i + 1));
+    lex_tokens_init(&chunks[i].tokens);
+  }
+
+  // The first chunk's tokens are lexed from the true start, straight into the
+  // output, on this thread.  A chunk whose thread can't be started is lexed
+  // here too.
+  for (i = 1; i < n; i++) {
+    started[i] = pthread_create(&threads[i], NULL, lex_chunk_run,
+                                &chunks[i]) == 0;
+  }
+  out->count = 0;
+  pos = lex_tokenize_range(obj, input, length, 0, chunks[0].end, out, false);
+
+  for (i = 1; i < n; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    } else {
+      lex_chunk_run(&chunks[i]);
+    }
+    pos = lex_chunk_stitch(&chunks[i], pos, out);
+    lex_tokens_destroy(&chunks[i].tokens);
+  }
+  lex_tokens_destroy(&chunks[0].tokens);
+
+  smb_free(chunks);
+  smb_free(threads);
+  smb_free(started);
+}
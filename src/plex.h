@@ -0,0 +1,31 @@
+/***************************************************************************//**
+
+  @file         plex.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Multithreaded tokenizing of large buffers.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#ifndef SMB_PLEX_H
+#define SMB_PLEX_H
+
+#include <stddef.h>
+
+#include "lex.h"
+
+/**
+   @brief Inputs are never split into chunks smaller than this many bytes.
+ */
+#define LEX_PARALLEL_MIN_CHUNK 4096
+
+void lex_tokenize_parallel(smb_lex *obj, const char *input, size_t length,
+                           lex_tokens *out, int nthreads);
+
+#endif//SMB_PLEX_H
@@ -0,0 +1,537 @@
+/***************************************************************************//**
+
+  @file         serve.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        A long-running server answering lex and parse requests.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "libstephen/base.h"
+#include "libstephen/cb.h"
+#include "libstephen/ht.h"
+#include "cky.h"
+#include "gram.h"
+#include "incr.h"
+#include "lex.h"
+#include "serve.h"
+
+static void *cky_server_thread(void *arg);
+
+/**
+   @brief Initialize a server, and start its worker threads.
+   @param obj Memory to initialize
+   @param lex The lexer, which is compiled here, or NULL
+   @param gram The CNF grammar, which is compiled here, or NULL
+   @param nthreads Number of workers, including the thread calling the server
+   @param framed True for length delimited records instead of lines
+ */
+void cky_server_init(cky_server *obj, smb_lex *lex, const cnf *gram,
+                     int nthreads, bool framed)
+{
+  cky_server_worker *w;
+  int i;
+
+  obj->lex = lex;
+  obj->gram = gram;
+  obj->terminal = NULL;
+  if (lex != NULL) {
+    lex_compile(lex);
+  }
+  if (gram != NULL) {
+    cky_grammar_init(&obj->compiled, gram);
+    if (lex != NULL) {
+      obj->terminal = cky_incr_terminals(lex, gram);
+    }
+  }
+  obj->framed = framed;
+  obj->nthreads = nthreads < 1 ? 1 : nthreads;
+  obj->records = smb_new(cky_server_record, CKY_SERVER_BATCH);
+  obj->nrecords = 0;
+  obj->next = 0;
+
+  obj->workers = smb_new(cky_server_worker, obj->nthreads);
+  for (i = 0; i < obj->nthreads; i++) {
+    w = &obj->workers[i];
+    w->server = obj;
+    if (gram != NULL) {
+      cky_chart_init(&w->chart, &obj->compiled, 64);
+    }
+    lex_tokens_init(&w->tokens);
+    w->capacity = 64;
+    w->sentence = smb_new(int, w->capacity);
+    w->word_capacity = 64;
+    w->word = smb_new(char, w->word_capacity);
+    cb_init(&w->reply, 256);
+  }
+
+  pthread_mutex_init(&obj->lock, NULL);
+  pthread_cond_init(&obj->start, NULL);
+  pthread_cond_init(&obj->done, NULL);
+  obj->generation = 0;
+  obj->running = 0;
+  obj->quit = false;
+  obj->threads = smb_new(pthread_t, obj->nthreads);
+  for (i = 1; i < obj->nthreads; i++) {
+    pthread_create(&obj->threads[i], NULL, &cky_server_thread,
+                   &obj->workers[i]);
+  }
+}
+
+/**
+   @brief Allocate and initialize a server.
+   @param lex The lexer, or NULL
+   @param gram The CNF grammar, or NULL
+   @param nthreads Number of workers
+   @param framed True for length delimited records instead of lines
+   @return The new server
+ */
+cky_server *cky_server_create(smb_lex *lex, const cnf *gram, int nthreads,
+                              bool framed)
+{
+  cky_server *obj = smb_new(cky_server, 1);
+  cky_server_init(obj, lex, gram, nthreads, framed);
+  return obj;
+}
+
+/**
+   @brief Stop a server's threads and free its scratch space, but not the
+   server itself, nor its lexer and grammar.
+   @param obj The server to clean up
+ */
+void cky_server_destroy(cky_server *obj)
+{
+  cky_server_worker *w;
+  int i;
+
+  pthread_mutex_lock(&obj->lock);
+  obj->quit = true;
+  pthread_cond_broadcast(&obj->start);
+  pthread_mutex_unlock(&obj->lock);
+  for (i = 1; i < obj->nthreads; i++) {
+    pthread_join(obj->threads[i], NULL);
+  }
+  pthread_mutex_destroy(&obj->lock);
+  pthread_cond_destroy(&obj->start);
+  pthread_cond_destroy(&obj->done);
+
+  for (i = 0; i < obj->nthreads; i++) {
+    w = &obj->workers[i];
+    if (obj->gram != NULL) {
+      cky_chart_destroy(&w->chart);
+    }
+    lex_tokens_destroy(&w->tokens);
+    smb_free(w->sentence);
+    smb_free(w->word);
+    cb_destroy(&w->reply);
+  }
+  if (obj->gram != NULL) {
+    cky_grammar_destroy(&obj->compiled);
+  }
+  smb_free(obj->terminal);
+  smb_free(obj->workers);
+  smb_free(obj->threads);
+  smb_free(obj->records);
+}
+
+/**
+   @brief Stop a server and free it.
+   @param obj The server to delete
+ */
+void cky_server_delete(cky_server *obj)
+{
+  cky_server_destroy(obj);
+  smb_free(obj);
+}
+
+/*
+  Append a word of the request to the sentence, as a terminal.
+ */
+static void cky_server_word(cky_server *s, cky_server_worker *w, int n,
+                            const char *word, size_t length)
+{
+  smb_status status = SMB_SUCCESS;
+  DATA d;
+
+  if (length + 1 > w->word_capacity) {
+    while (length + 1 > w->word_capacity) {
+      w->word_capacity *= 2;
+    }
+    w->word = smb_renew(char, w->word, w->word_capacity);
+  }
+  memcpy(w->word, word, length);
+  w->word[length] = '\0';
+  d.data_ptr = w->word;
+  d = ht_get(&s->gram->terminal_index, d, &status);
+  w->sentence[n] = status == SMB_SUCCESS ? (int) d.data_llint : -1;
+}
+
+/*
+  Split a request into terminals, with the lexer or at white space, and
+  return how many there are.
+ */
+static int cky_server_sentence(cky_server *s, cky_server_worker *w,
+                               const char *text, size_t length)
+{
+  size_t i, begin;
+  int n = 0;
+
+  if (s->lex != NULL) {
+    w->tokens.count = 0;
+    lex_tokenize_range(s->lex, text, length, 0, length, &w->tokens, false);
+  }
+  while (true) {
+    if (n == w->capacity) {
+      w->capacity *= 2;
+      w->sentence = smb_renew(int, w->sentence, w->capacity);
+    }
+    if (s->lex != NULL) {
+      if ((size_t) n == w->tokens.count) {
+        break;
+      }
+      w->sentence[n] = w->tokens.id[n] == LEX_NO_TOKEN ? -1 :
+        s->terminal[w->tokens.id[n]];
+      n++;
+    } else {
+      for (i = 0; i < length && strchr(" \t\r\n", text[i]) != NULL; i++);
+      if (i == length) {
+        break;
+      }
+      for (begin = i; i < length && strchr(" \t\r\n", text[i]) == NULL;
+           i++);
+      cky_server_word(s, w, n++, text + begin, i - begin);
+      text += i;
+      length -= i;
+    }
+  }
+  return n;
+}
+
+/*
+  Answer one request into the worker's reply buffer.
+ */
+static void cky_server_answer(cky_server *s, cky_server_worker *w,
+                              const char *text, size_t length)
+{
+  size_t verb, i;
+  int n;
+
+  for (verb = 0; verb < length && text[verb] != ' '; verb++);
+  if (verb == 5 && strncmp(text, "parse", 5) == 0 && s->gram != NULL) {
+    n = cky_server_sentence(s, w, text + verb + (verb < length),
+                            length - verb - (verb < length));
+    cb_concat(&w->reply, cky_chart_fill(&w->chart, w->sentence, n) ?
+              "accept" : "reject");
+  } else if (verb == 3 && strncmp(text, "lex", 3) == 0 && s->lex != NULL) {
+    text += verb + (verb < length);
+    length -= verb + (verb < length);
+    w->tokens.count = 0;
+    lex_tokenize_range(s->lex, text, length, 0, length, &w->tokens, false);
+    for (i = 0; i < w->tokens.count; i++) {
+      if (w->tokens.id[i] == LEX_NO_TOKEN) {
+        cb_printf(&w->reply, "%serror:%zu:%zu", i > 0 ? " " : "",
+                  w->tokens.start[i], w->tokens.length[i]);
+      } else {
+        cb_printf(&w->reply, "%s%ls:%zu:%zu", i > 0 ? " " : "",
+                  lex_token_name(s->lex, w->tokens.id[i]),
+                  w->tokens.start[i], w->tokens.length[i]);
+      }
+    }
+  } else {
+    cb_concat(&w->reply, "error: unknown request");
+  }
+}
+
+/*
+  Claim runs of the batch's requests and answer them, until none are left.
+ */
+static void cky_server_work(cky_server *s, cky_server_worker *w)
+{
+  int run = s->nrecords / (4 * s->nthreads), i, end;
+  cky_server_record *r;
+
+  run = run < 1 ? 1 : run;
+  while ((i = __sync_fetch_and_add(&s->next, run)) < s->nrecords) {
+    end = i + run < s->nrecords ? i + run : s->nrecords;
+    for (; i < end; i++) {
+      r = &s->records[i];
+      r->worker = w - s->workers;
+      r->offset = w->reply.length;
+      cky_server_answer(s, w, r->text, r->length);
+      r->size = w->reply.length - r->offset;
+    }
+  }
+}
+
+static void *cky_server_thread(void *arg)
+{
+  cky_server_worker *w = arg;
+  cky_server *s = w->server;
+  unsigned int seen = 0;
+
+  pthread_mutex_lock(&s->lock);
+  while (true) {
+    while (s->generation == seen && !s->quit) {
+      pthread_cond_wait(&s->start, &s->lock);
+    }
+    if (s->quit) {
+      break;
+    }
+    seen = s->generation;
+    pthread_mutex_unlock(&s->lock);
+    cky_server_work(s, w);
+    pthread_mutex_lock(&s->lock);
+    if (--s->running == 0) {
+      pthread_cond_signal(&s->done);
+    }
+  }
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+/*
+  Answer every request of the batch, on every worker.
+ */
+static void cky_server_batch(cky_server *s)
+{
+  int i;
+  for (i = 0; i < s->nthreads; i++) {
+    s->workers[i].reply.length = 0;
+    s->workers[i].reply.buf[0] = '\0';
+  }
+  s->next = 0;
+  if (s->nthreads == 1 || s->nrecords == 1) {
+    cky_server_work(s, &s->workers[0]);
+    return;
+  }
+  pthread_mutex_lock(&s->lock);
+  s->running = s->nthreads;
+  s->generation++;
+  pthread_cond_broadcast(&s->start);
+  pthread_mutex_unlock(&s->lock);
+  cky_server_work(s, &s->workers[0]);
+  pthread_mutex_lock(&s->lock);
+  if (--s->running > 0) {
+    while (s->running > 0) {
+      pthread_cond_wait(&s->done, &s->lock);
+    }
+  }
+  pthread_mutex_unlock(&s->lock);
+}
+
+/*
+  Write all of a buffer, returning false on an error.
+ */
+static bool cky_server_write(int fd, const char *data, size_t length)
+{
+  ssize_t wrote;
+  while (length > 0) {
+    wrote = write(fd, data, length);
+    if (wrote < 0 && errno == EINTR) {
+      continue;
+    } else if (wrote <= 0) {
+      return false;
+    }
+    data += wrote;
+    length -= wrote;
+  }
+  return true;
+}
+
+/*
+  Write the replies of a batch in the order of the requests.
+ */
+static bool cky_server_reply(cky_server *s, int out)
+{
+  cbuf all;
+  cky_server_record *r;
+  bool ok;
+  int i;
+
+  cb_init(&all, 4096);
+  for (i = 0; i < s->nrecords; i++) {
+    r = &s->records[i];
+    if (s->framed) {
+      cb_printf(&all, "%zu\n", r->size);
+    }
+    cb_printf(&all, "%.*s", (int) r->size,
+              s->workers[r->worker].reply.buf + r->offset);
+    if (!s->framed) {
+      cb_append(&all, '\n');
+    }
+  }
+  ok = cky_server_write(out, all.buf, all.length);
+  cb_destroy(&all);
+  return ok;
+}
+
+/*
+  Find the next whole record in a buffer from pos, and return the offset
+  after it, or pos if it isn't all there yet.  At the end of the input, a
+  line without its newline is whole.  Returns (size_t) -1 for a bad frame.
+ */
+static size_t cky_server_record_at(cky_server *s, const char *buf,
+                                   size_t length, size_t pos, bool eof,
+                                   cky_server_record *r)
+{
+  const char *nl = memchr(buf + pos, '\n', length - pos);
+  size_t size = 0, i;
+
+  if (!s->framed) {
+    if (nl == NULL && (!eof || pos == length)) {
+      return pos;
+    }
+    r->text = buf + pos;
+    r->length = (nl == NULL ? buf + length : nl) - r->text;
+    if (r->length > 0 && r->text[r->length - 1] == '\r') {
+      r->length--;
+    }
+    return nl == NULL ? length : (size_t) (nl - buf) + 1;
+  }
+
+  if (nl == NULL) {
+    return eof && pos < length ? (size_t) -1 : pos;
+  }
+  for (i = pos; buf + i < nl; i++) {
+    if (buf[i] < '0' || buf[i] > '9' || size > ((size_t) -1) / 20) {
+      return (size_t) -1;
+    }
+    size = size * 10 + buf[i] - '0';
+  }
+  if (i == pos) {
+    return (size_t) -1;
+  }
+  i++;
+  if (length - i < size) {
+    return eof ? (size_t) -1 : pos;
+  }
+  r->text = buf + i;
+  r->length = size;
+  return i + size;
+}
+
+/**
+   @brief Answer the requests of one stream, until it ends.
+
+   Requests are read as they arrive, and each batch of whole requests is
+   answered before reading more, so replies are written as soon as the
+   requests already read have been answered.
+
+   @param obj The server
+   @param in File descriptor to read requests from
+   @param out File descriptor to write replies to
+   @return False if the stream had a bad frame or couldn't be read or written.
+ */
+bool cky_server_run(cky_server *obj, int in, int out)
+{
+  size_t capacity = 65536, length = 0, pos, next;
+  char *buf = smb_new(char, capacity);
+  bool eof = false, ok = true;
+  ssize_t got;
+
+  while (ok && !eof) {
+    // Read whatever has arrived, making room for a record that doesn't fit.
+    if (length == capacity) {
+      capacity *= 2;
+      buf = smb_renew(char, buf, capacity);
+    }
+    got = read(in, buf + length, capacity - length);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    } else if (got < 0) {
+      ok = false;
+      break;
+    }
+    eof = got == 0;
+    length += got;
+
+    pos = 0;
+    while (ok) {
+      obj->nrecords = 0;
+      while (obj->nrecords < CKY_SERVER_BATCH) {
+        next = cky_server_record_at(obj, buf, length, pos, eof,
+                                    &obj->records[obj->nrecords]);
+        if (next == (size_t) -1) {
+          ok = false;
+          break;
+        } else if (next == pos) {
+          break;
+        }
+        pos = next;
+        obj->nrecords++;
+      }
+      if (obj->nrecords == 0) {
+        break;
+      }
+      cky_server_batch(obj);
+      ok = cky_server_reply(obj, out) && ok;
+    }
+    memmove(buf, buf + pos, length - pos);
+    length -= pos;
+  }
+
+  smb_free(buf);
+  return ok;
+}
+
+/**
+   @brief Listen on a Unix socket, and answer each connection in turn.
+
+   A connection is answered until the client closes it, with all of the
+   server's workers.  Any file already at the path is replaced.
+
+   @param obj The server
+   @param path The socket's path
+   @return False if the socket couldn't be made; otherwise it never returns.
+ */
+bool cky_server_listen(cky_server *obj, const char *path)
+{
+  struct sockaddr_un addr;
+  int fd, client;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return false;
+  }
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      listen(fd, 16) < 0) {
+    close(fd);
+    return false;
+  }
+  while (true) {
+    client = accept(fd, NULL, NULL);
+    if (client < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      close(fd);
+      return false;
+    }
+    cky_server_run(obj, client, client);
+    close(client);
+  }
+}
@@ -0,0 +1,231 @@
+/***************************************************************************//**
+
+  @file         serve.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        A long-running server answering lex and parse requests.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_SERVE_H
+#define SMB_SERVE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "libstephen/cb.h"
+#include "cky.h"
+#include "gram.h"
+#include "lex.h"
+
+/**
+   @brief The most requests answered together, as one batch.
+ */
+#define CKY_SERVER_BATCH 4096
+
+/**
+   @brief One request of a batch, and where its reply went.
+ */
+typedef struct {
+
+  /**
+     @brief The request, which isn't NUL terminated.
+   */
+  const char *text;
+
+  /**
+     @brief Number of bytes in the request.
+   */
+  size_t length;
+
+  /**
+     @brief The worker whose reply buffer holds the reply.
+   */
+  int worker;
+
+  /**
+     @brief Offset of the reply in that buffer.
+   */
+  size_t offset;
+
+  /**
+     @brief Number of bytes in the reply.
+   */
+  size_t size;
+
+} cky_server_record;
+
+/**
+   @brief The scratch space of one worker thread.
+ */
+typedef struct {
+
+  /**
+     @brief The server this worker belongs to.
+   */
+  struct cky_server *server;
+
+  /**
+     @brief The chart this worker parses with.
+   */
+  cky_chart chart;
+
+  /**
+     @brief Tokens of the request being lexed.
+   */
+  lex_tokens tokens;
+
+  /**
+     @brief Terminals of the sentence being parsed.
+   */
+  int *sentence;
+
+  /**
+     @brief Room in cky_server_worker.sentence.
+   */
+  int capacity;
+
+  /**
+     @brief A copy of one word of the request, to look up as a terminal.
+   */
+  char *word;
+
+  /**
+     @brief Room in cky_server_worker.word.
+   */
+  size_t word_capacity;
+
+  /**
+     @brief Replies to the requests this worker answered in the batch.
+   */
+  cbuf reply;
+
+} cky_server_worker;
+
+/**
+   @brief A lexer and grammar, loaded once, answering many requests.
+
+   Each request is one record: `lex TEXT` replies with the tokens of TEXT, as
+   `name:offset:length` separated by spaces, and `parse TEXT` replies with
+   `accept` or `reject`.  To parse, TEXT is split into tokens by the lexer if
+   there is one, and matched with terminals by name, or else split at white
+   space into the names of terminals.
+
+   Records are lines, or with cky_server.framed, a decimal byte count on a
+   line of its own followed by that many bytes, so that requests may hold
+   newlines.  Replies are framed the same way, and come in the same order as
+   the requests.  The server reads as many whole requests as have arrived, up
+   to CKY_SERVER_BATCH, and workers claim them in runs until the batch is
+   answered.  So a client that waits for each reply is answered at once, and
+   a client that streams requests keeps every worker busy.
+
+   @see cky_server_init
+   @see cky_server_run
+ */
+typedef struct cky_server {
+
+  /**
+     @brief The lexer, or NULL to answer only parse requests.
+   */
+  smb_lex *lex;
+
+  /**
+     @brief The grammar, or NULL to answer only lex requests.
+   */
+  const cnf *gram;
+
+  /**
+     @brief The compiled grammar.
+   */
+  cky_grammar compiled;
+
+  /**
+     @brief The terminal of each lexer token, or -1.
+   */
+  int *terminal;
+
+  /**
+     @brief True if records are length delimited instead of lines.
+   */
+  bool framed;
+
+  /**
+     @brief Number of workers, counting the thread that calls the server.
+   */
+  int nthreads;
+
+  /**
+     @brief Every worker's scratch space.
+   */
+  cky_server_worker *workers;
+
+  /**
+     @brief The threads of every worker but the first.
+   */
+  pthread_t *threads;
+
+  /**
+     @brief Guards the batch counters below.
+   */
+  pthread_mutex_t lock;
+
+  /**
+     @brief Signalled when a batch is ready, or the threads should quit.
+   */
+  pthread_cond_t start;
+
+  /**
+     @brief Signalled when the last worker finishes a batch.
+   */
+  pthread_cond_t done;
+
+  /**
+     @brief Incremented for each batch.
+   */
+  unsigned int generation;
+
+  /**
+     @brief Workers still answering the current batch.
+   */
+  int running;
+
+  /**
+     @brief True once the threads should exit.
+   */
+  bool quit;
+
+  /**
+     @brief The requests of the current batch.
+   */
+  cky_server_record *records;
+
+  /**
+     @brief Number of requests in the current batch.
+   */
+  int nrecords;
+
+  /**
+     @brief The first request of the batch no worker has claimed.
+   */
+  int next;
+
+} cky_server;
+
+void cky_server_init(cky_server *obj, smb_lex *lex, const cnf *gram,
+                     int nthreads, bool framed);
+cky_server *cky_server_create(smb_lex *lex, const cnf *gram, int nthreads,
+                              bool framed);
+void cky_server_destroy(cky_server *obj);
+void cky_server_delete(cky_server *obj);
+
+bool cky_server_run(cky_server *obj, int in, int out);
+bool cky_server_listen(cky_server *obj, const char *path);
+
+#endif//SMB_SERVE_H
@@ -0,0 +1,237 @@
+/***************************************************************************//**
+
+  @file         stats.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Counters and timers for the lexer, grammar and recognizer.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+// Names of the phases, as printed.
+static const char *cky_phase_name[CKY_PHASES] = {
+  "lexer", "lex", "grammar", "convert", "compile", "parse"
+};
+
+/**
+   @brief Set every counter and timer to zero.
+   @param obj The counters
+ */
+void cky_stats_init(cky_stats *obj)
+{
+  memset(obj, 0, sizeof(cky_stats));
+}
+
+/**
+   @brief Return a monotonic time in nanoseconds, for cky_stats_time().
+ */
+uint64_t cky_stats_clock(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+   @brief Add the time since an earlier cky_stats_clock() to a phase.
+   @param obj The counters, or NULL to do nothing
+   @param phase The phase to add the time to
+   @param since The clock when the phase began
+ */
+void cky_stats_time(cky_stats *obj, cky_phase phase, uint64_t since)
+{
+#if CKY_STATS
+  if (obj != NULL) {
+    obj->ns[phase] += cky_stats_clock() - since;
+  }
+#else
+  (void) obj;
+  (void) phase;
+  (void) since;
+#endif
+}
+
+#if CKY_STATS
+/*
+  Count one cell holding some number of nonterminals.
+ */
+static void cky_stats_cell(cky_stats *obj, int entries)
+{
+  obj->cells++;
+  obj->live_cells += entries > 0;
+  obj->entries += entries;
+}
+#endif
+
+/**
+   @brief Count the cells and entries of a filled chart.
+
+   The chart is read after it is filled, so the recognizer's inner loops are
+   never slowed down by counting.
+
+   @param obj The counters, or NULL to do nothing
+   @param chart A chart filled with the last sentence, or NULL if it was
+   recognized without one
+   @param accepts Whether the sentence was accepted
+ */
+void cky_stats_chart(cky_stats *obj, const cky_chart *chart, bool accepts)
+{
+#if CKY_STATS
+  const cky_word *cell;
+  int length, start, w, entries;
+
+  if (obj == NULL) {
+    return;
+  }
+  obj->sentences++;
+  obj->accepted += accepts;
+  obj->uncounted += chart == NULL;
+  for (length = 1; chart != NULL && length <= chart->length; length++) {
+    for (start = 0; start + length <= chart->length; start++) {
+      cell = cky_chart_cell(chart, start, length);
+      entries = 0;
+      for (w = 0; w < chart->gram->nwords; w++) {
+        entries += __builtin_popcountll(cell[w]);
+      }
+      cky_stats_cell(obj, entries);
+    }
+  }
+#else
+  (void) obj;
+  (void) chart;
+  (void) accepts;
+#endif
+}
+
+/**
+   @brief Count the cells and entries of a Viterbi parser's filled table.
+
+   Entries are the nonterminals left in each cell after pruning.
+
+   @param obj The counters, or NULL to do nothing
+   @param parser A parser filled with the last sentence
+   @param accepts Whether the sentence was accepted
+ */
+void cky_stats_viterbi(cky_stats *obj, const cky_viterbi *parser,
+                       bool accepts)
+{
+#if CKY_STATS
+  int c, ncells = parser->length * (parser->length + 1) / 2;
+
+  if (obj == NULL) {
+    return;
+  }
+  obj->sentences++;
+  obj->accepted += accepts;
+  for (c = 0; c < ncells; c++) {
+    cky_stats_cell(obj, parser->cell_first[c + 1] - parser->cell_first[c]);
+  }
+#else
+  (void) obj;
+  (void) parser;
+  (void) accepts;
+#endif
+}
+
+/**
+   @brief Count the spans of a product recognizer's filled table.
+
+   Each span of the sentence counts as a cell, holding the nonterminals whose
+   matrices have its bit set.
+
+   @param obj The counters, or NULL to do nothing
+   @param valiant A recognizer filled with the last sentence
+   @param accepts Whether the sentence was accepted
+ */
+void cky_stats_valiant(cky_stats *obj, const cky_valiant *valiant,
+                       bool accepts)
+{
+#if CKY_STATS
+  int length, start, a, entries, n = valiant->length;
+
+  if (obj == NULL) {
+    return;
+  }
+  obj->sentences++;
+  obj->accepted += accepts;
+  for (length = 1; length <= n; length++) {
+    for (start = 0; start + length <= n; start++) {
+      entries = 0;
+      for (a = 0; a < valiant->gram->nnonterminals; a++) {
+        entries += cky_valiant_derives(valiant, a, start, length);
+      }
+      cky_stats_cell(obj, entries);
+    }
+  }
+#else
+  (void) obj;
+  (void) valiant;
+  (void) accepts;
+#endif
+}
+
+/**
+   @brief Print the counters, with the rates derived from them.
+   @param obj The counters
+   @param out Where to print them
+ */
+void cky_stats_print(const cky_stats *obj, FILE *out)
+{
+  int i;
+
+  if (!CKY_STATS) {
+    fputs("stats: not compiled in (built with CKY_STATS=0)\n", out);
+    return;
+  }
+  if (obj->lex_tokens > 0) {
+    fprintf(out, "lex: %llu tokens, %llu bytes, %llu errors\n",
+            (unsigned long long) obj->lex_tokens,
+            (unsigned long long) obj->lex_bytes,
+            (unsigned long long) obj->lex_errors);
+    fprintf(out, "lex: %.2f bytes/token, %.2f steps/byte\n",
+            (double) obj->lex_bytes / obj->lex_tokens,
+            obj->lex_bytes == 0 ? 0.0 :
+            (double) obj->lex_steps / obj->lex_bytes);
+  }
+  if (obj->grammar.source_rules > 0) {
+    fprintf(out, "grammar: %d nonterminals, %d rules\n",
+            obj->grammar.source_nonterminals, obj->grammar.source_rules);
+    fprintf(out, "converted: %d nonterminals, %d rules\n",
+            obj->grammar.converted_nonterminals,
+            obj->grammar.converted_rules);
+    fprintf(out, "optimized: %d nonterminals, %d rules\n",
+            obj->grammar.nonterminals, obj->grammar.rules);
+  }
+  if (obj->sentences > 0) {
+    fprintf(out, "parse: %llu sentences, %llu accepted\n",
+            (unsigned long long) obj->sentences,
+            (unsigned long long) obj->accepted);
+  }
+  if (obj->cells > 0) {
+    fprintf(out, "chart: %llu cells, %llu live, %.2f entries/cell\n",
+            (unsigned long long) obj->cells,
+            (unsigned long long) obj->live_cells,
+            (double) obj->entries / obj->cells);
+  }
+  if (obj->uncounted > 0) {
+    fprintf(out, "chart: cells of %llu sentences not counted\n",
+            (unsigned long long) obj->uncounted);
+  }
+  for (i = 0; i < CKY_PHASES; i++) {
+    if (obj->ns[i] > 0) {
+      fprintf(out, "time: %s %.3f ms\n", cky_phase_name[i], obj->ns[i] / 1e6);
+    }
+  }
+}
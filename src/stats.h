@@ -0,0 +1,166 @@
+/***************************************************************************//**
+
+  @file         stats.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Counters and timers for the lexer, grammar and recognizer.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_STATS_H
+#define SMB_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cky.h"
+#include "cnf.h"
+#include "valiant.h"
+#include "viterbi.h"
+
+/**
+   @brief Whether the counters are compiled in.
+
+   They are by default, since nothing is counted unless a cky_stats is given
+   to count into, and then it costs a branch and a few additions per token or
+   sentence: so the same build can be profiled in production.  Building with
+   -DCKY_STATS=0 removes even that, and the counters then stay zero.
+ */
+#ifndef CKY_STATS
+#define CKY_STATS 1
+#endif
+
+/**
+   @brief The phases of loading and running a lexer and a grammar.
+ */
+typedef enum {
+  CKY_PHASE_LEXER,     // Loading or compiling the lexer.
+  CKY_PHASE_LEX,       // Tokenizing the input.
+  CKY_PHASE_GRAMMAR,   // Reading the grammar file.
+  CKY_PHASE_CONVERT,   // Converting the grammar to CNF.
+  CKY_PHASE_COMPILE,   // Building the recognizer's tables.
+  CKY_PHASE_PARSE,     // Recognizing sentences.
+  CKY_PHASES
+} cky_phase;
+
+/**
+   @brief Counts of the work done by the lexer and the recognizer.
+
+   Fields are totals since cky_stats_init(), so a caller can read them at any
+   time, or take the difference of two copies.  Rates like bytes per token
+   are left to whoever prints them.
+
+   @see cky_stats_init
+   @see cky_stats_print
+ */
+typedef struct {
+
+  /**
+     @brief Bytes the lexer's automaton stepped over, lookahead included.
+   */
+  uint64_t lex_steps;
+
+  /**
+     @brief Tokens returned, unmatched characters included.
+   */
+  uint64_t lex_tokens;
+
+  /**
+     @brief Bytes covered by the tokens returned.
+   */
+  uint64_t lex_bytes;
+
+  /**
+     @brief Characters no pattern matched.
+   */
+  uint64_t lex_errors;
+
+  /**
+     @brief Sizes of the grammar before, during and after conversion to CNF.
+   */
+  cnf_report grammar;
+
+  /**
+     @brief Sentences recognized.
+   */
+  uint64_t sentences;
+
+  /**
+     @brief Sentences accepted.
+   */
+  uint64_t accepted;
+
+  /**
+     @brief Sentences recognized without a table whose cells could be counted.
+   */
+  uint64_t uncounted;
+
+  /**
+     @brief Cells filled, one per span of each sentence.
+
+     Cells of a chart, of a Viterbi parser's table, or of the spans a product
+     recognizer's matrices cover are all counted alike.
+   */
+  uint64_t cells;
+
+  /**
+     @brief Cells left with at least one nonterminal.
+   */
+  uint64_t live_cells;
+
+  /**
+     @brief Nonterminals in every cell, summed.
+   */
+  uint64_t entries;
+
+  /**
+     @brief Nanoseconds spent in each phase.
+   */
+  uint64_t ns[CKY_PHASES];
+
+} cky_stats;
+
+void cky_stats_init(cky_stats *obj);
+uint64_t cky_stats_clock(void);
+void cky_stats_time(cky_stats *obj, cky_phase phase, uint64_t since);
+void cky_stats_chart(cky_stats *obj, const cky_chart *chart, bool accepts);
+void cky_stats_viterbi(cky_stats *obj, const cky_viterbi *parser,
+                       bool accepts);
+void cky_stats_valiant(cky_stats *obj, const cky_valiant *valiant,
+                       bool accepts);
+void cky_stats_print(const cky_stats *obj, FILE *out);
+
+/**
+   @brief Count one token of a lexer, if there is a cky_stats to count into.
+   @param obj The counters, or NULL
+   @param steps Bytes the automaton stepped over to find the token
+   @param length Bytes in the token
+   @param error True if no pattern matched
+ */
+static inline void cky_stats_token(cky_stats *obj, size_t steps,
+                                   size_t length, bool error)
+{
+#if CKY_STATS
+  if (obj != NULL) {
+    obj->lex_steps += steps;
+    obj->lex_tokens++;
+    obj->lex_bytes += length;
+    obj->lex_errors += error;
+  }
+#else
+  (void) obj;
+  (void) steps;
+  (void) length;
+  (void) error;
+#endif
+}
+
+#endif//SMB_STATS_H
@@ -0,0 +1,207 @@
+/***************************************************************************//**
+
+  @file         stream.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Block-buffered streaming tokenizer.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "libstephen/base.h"
+#include "dfa.h"
+#include "lex.h"
+#include "stream.h"
+
+/*
+  Make room for and read another block of input.  Bytes before obj->begin have
+  already been returned as tokens, so they are discarded.  A read error ends
+  the input, and sets status.
+ */
+static void lex_stream_fill(smb_lex_stream *obj, smb_status *status)
+{
+  size_t got;
+
+  if (obj->eof) {
+    return;
+  }
+
+  if (obj->begin > 0) {
+    memmove(obj->buf, obj->buf + obj->begin, obj->end - obj->begin);
+    obj->base += obj->begin;
+    obj->end -= obj->begin;
+    obj->begin = 0;
+  }
+  if (obj->end == obj->capacity) {
+    obj->capacity *= 2;
+    obj->buf = smb_renew(char, obj->buf, obj->capacity);
+  }
+
+  got = fread(obj->buf + obj->end, 1, obj->capacity - obj->end, obj->file);
+  obj->end += got;
+  if (got == 0) {
+    obj->eof = true;
+    if (ferror(obj->file)) {
+      *status = SMB_NOT_FOUND_ERROR;
+    }
+  }
+}
+
+/**
+   @brief Initialize a tokenizer reading from a file.
+   @param obj Memory to initialize
+   @param lex The lexer to tokenize with
+   @param file The input file, which must stay open while tokenizing
+ */
+void lex_stream_init(smb_lex_stream *obj, smb_lex *lex, FILE *file)
+{
+  obj->lex = lex;
+  obj->file = file;
+  obj->capacity = LEX_STREAM_BLOCK;
+  obj->buf = smb_new(char, obj->capacity);
+  obj->begin = 0;
+  obj->end = 0;
+  obj->base = 0;
+  obj->eof = false;
+  obj->borrowed = false;
+  obj->stats = NULL;
+}
+
+/**
+   @brief Initialize a tokenizer over a buffer already in memory.
+
+   The buffer isn't copied, so it must outlive the tokenizer.
+
+   @param obj Memory to initialize
+   @param lex The lexer to tokenize with
+   @param buf The input text
+   @param length Number of bytes of input
+ */
+void lex_stream_init_buffer(smb_lex_stream *obj, smb_lex *lex,
+                            const char *buf, size_t length)
+{
+  obj->lex = lex;
+  obj->file = NULL;
+  obj->capacity = length;
+  obj->buf = (char *) buf;
+  obj->begin = 0;
+  obj->end = length;
+  obj->base = 0;
+  obj->eof = true;
+  obj->borrowed = true;
+  obj->stats = NULL;
+}
+
+/**
+   @brief Allocate and initialize a tokenizer reading from a file.
+   @param lex The lexer to tokenize with
+   @param file The input file
+   @return The new tokenizer
+ */
+smb_lex_stream *lex_stream_create(smb_lex *lex, FILE *file)
+{
+  smb_lex_stream *obj = smb_new(smb_lex_stream, 1);
+  lex_stream_init(obj, lex, file);
+  return obj;
+}
+
+/**
+   @brief Free the tokenizer's buffer.  The file is not closed.
+   @param obj The tokenizer to clean up
+ */
+void lex_stream_destroy(smb_lex_stream *obj)
+{
+  if (!obj->borrowed) {
+    smb_free(obj->buf);
+  }
+}
+
+/**
+   @brief Free the tokenizer and its buffer.
+   @param obj The tokenizer to delete
+ */
+void lex_stream_delete(smb_lex_stream *obj)
+{
+  lex_stream_destroy(obj);
+  smb_free(obj);
+}
+
+/**
+   @brief Return the next token of the input.
+
+   Tokens are matched exactly as lex_yylex() would match them.  When no pattern
+   matches, a span with token LEX_NO_TOKEN covering one character is returned,
+   so that the caller can report it and carry on.
+
+   @param obj The tokenizer
+   @param[out] span Where to store the token
+   @param status Status variable, set to SMB_NOT_FOUND_ERROR if the file
+   can't be read.  The input then ends where the error happened.
+   @return False at the end of the input, when no token was stored.
+ */
+bool lex_stream_next(smb_lex_stream *obj, lex_span *span, smb_status *status)
+{
+  smb_lex_sim sim;
+  size_t off = 0, n; // relative to obj->begin
+
+  lex_sim_reset(obj->lex, &sim);
+
+  // The UTF-8 automaton runs straight over the bytes of the buffer.
+  while (true) {
+    if (obj->begin + off >= obj->end) {
+      if (obj->eof) {
+        break; // The end of input ends the token.
+      }
+      lex_stream_fill(obj, status);
+      continue;
+    }
+    if (lex_step_byte(obj->lex, &sim,
+                      (unsigned char) obj->buf[obj->begin + off++])) {
+      break;
+    }
+  }
+
+  if (obj->begin >= obj->end) {
+    return false;
+  }
+
+  if (sim.last_pattern < 0) {
+    // Skip one character of input, which may not all be in the buffer yet.
+    span->token = LEX_NO_TOKEN;
+    n = dfa_utf8_length((unsigned char) obj->buf[obj->begin]);
+    while (!obj->eof && obj->end - obj->begin < n) {
+      lex_stream_fill(obj, status);
+    }
+    span->length = n < obj->end - obj->begin ? n : obj->end - obj->begin;
+  } else {
+    span->token = sim.last_pattern;
+    span->length = sim.last_index + 1;
+  }
+  span->offset = obj->base + obj->begin;
+  cky_stats_token(obj->stats, off, span->length,
+                  span->token == LEX_NO_TOKEN);
+  obj->begin += span->length;
+  return true;
+}
+
+/**
+   @brief Return a pointer to the text of a token.
+
+   The text is not null terminated: use lex_span.length.  It remains valid
+   until the next call to lex_stream_next().
+
+   @param obj The tokenizer that returned the span
+   @param span The most recently returned token
+   @return Pointer to the first byte of the token
+ */
+const char *lex_stream_text(const smb_lex_stream *obj, const lex_span *span)
+{
+  return obj->buf + (span->offset - obj->base);
+}
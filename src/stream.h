@@ -0,0 +1,133 @@
+/***************************************************************************//**
+
+  @file         stream.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Block-buffered streaming tokenizer.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#ifndef SMB_STREAM_H
+#define SMB_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "lex.h"
+#include "stats.h"
+
+/**
+   @brief Default number of bytes read from the input at a time.
+ */
+#define LEX_STREAM_BLOCK 65536
+
+/**
+   @brief A token, as a span of bytes within the input.
+ */
+typedef struct {
+
+  /**
+     @brief The pattern index of the token, or LEX_NO_TOKEN.
+
+     LEX_NO_TOKEN means no pattern matched at this offset.  The span then
+     covers the single character that was skipped.
+   */
+  int token;
+
+  /**
+     @brief Byte offset of the token from the beginning of the input.
+   */
+  size_t offset;
+
+  /**
+     @brief Length of the token in bytes.
+   */
+  size_t length;
+
+} lex_span;
+
+/**
+   @brief A tokenizer over a file or a buffer of UTF-8 text.
+
+   Input is read into a buffer a block at a time, and tokens are returned as
+   spans of that buffer, so no token text is ever copied.  The lexer's UTF-8
+   automaton runs directly over the bytes, so the text is never decoded.  When
+   a token runs off the end of the buffer, the unread part is moved to the
+   front and the next block is read after it.  The buffer only grows when a
+   single token is longer than the whole buffer.
+
+   @see lex_stream_init
+   @see lex_stream_next
+ */
+typedef struct {
+
+  /**
+     @brief The lexer used to tokenize the input.
+   */
+  smb_lex *lex;
+
+  /**
+     @brief The input file, or NULL when tokenizing a buffer.
+   */
+  FILE *file;
+
+  /**
+     @brief The input buffer.
+   */
+  char *buf;
+
+  /**
+     @brief Allocated size of stream.buf.
+   */
+  size_t capacity;
+
+  /**
+     @brief Index within stream.buf of the first byte not yet tokenized.
+   */
+  size_t begin;
+
+  /**
+     @brief Number of valid bytes in stream.buf.
+   */
+  size_t end;
+
+  /**
+     @brief The input offset of stream.buf[0].
+   */
+  size_t base;
+
+  /**
+     @brief True when there is no more input to read into the buffer.
+   */
+  bool eof;
+
+  /**
+     @brief True when stream.buf belongs to the caller.
+   */
+  bool borrowed;
+
+  /**
+     @brief Counters for every token returned, or NULL.  Set after init.
+   */
+  cky_stats *stats;
+
+} smb_lex_stream;
+
+void lex_stream_init(smb_lex_stream *obj, smb_lex *lex, FILE *file);
+void lex_stream_init_buffer(smb_lex_stream *obj, smb_lex *lex,
+                            const char *buf, size_t length);
+smb_lex_stream *lex_stream_create(smb_lex *lex, FILE *file);
+void lex_stream_destroy(smb_lex_stream *obj);
+void lex_stream_delete(smb_lex_stream *obj);
+
+bool lex_stream_next(smb_lex_stream *obj, lex_span *span, smb_status *status);
+const char *lex_stream_text(const smb_lex_stream *obj, const lex_span *span);
+
+#endif//SMB_STREAM_H
@@ -0,0 +1,281 @@
+/***************************************************************************//**
+
+  @file         valiant.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Recognition of long sentences by boolean matrix products.
+
+  Positions run from 0 to n for a sentence of n tokens, and the cell (i, j)
+  holds the nonterminals deriving the tokens from i up to j.  With the rows
+  split into ranges [l, m) and the columns into [l2, m2), completing a
+  rectangle means finishing every cell in it, given that the cells within the
+  row range and within the column range are done, and that the products
+  through every position from m up to l2 have been added into it.  A
+  rectangle is completed by splitting it into four, and completing them from
+  the one nearest the diagonal outwards, adding in the products through each
+  finished piece along the way.  For context-free grammars the products can
+  go straight into the cells, because a cell is only ever added to before it
+  is complete, and only ever read after.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "libstephen/base.h"
+#include "cky.h"
+#include "valiant.h"
+
+/**
+   @brief Initialize a recognizer for a compiled grammar.
+   @param obj Memory to initialize
+   @param gram The compiled grammar to recognize with
+ */
+void cky_valiant_init(cky_valiant *obj, const cky_grammar *gram)
+{
+  int nnon = gram->nnonterminals, b, e, w, n = 0;
+  cky_word bits;
+
+  obj->gram = gram;
+  obj->rule_first = smb_new(int, nnon + 1);
+  for (b = 0; b < nnon; b++) {
+    for (e = gram->pair_first[b]; e < gram->pair_first[b + 1]; e++) {
+      for (w = 0; w < gram->nwords; w++) {
+        n += __builtin_popcountll(gram->pair_mask[e * gram->nwords + w]);
+      }
+    }
+  }
+  obj->rule_lhs = smb_new(int, n + 1);
+  obj->rule_right = smb_new(int, n + 1);
+  n = 0;
+  for (b = 0; b < nnon; b++) {
+    obj->rule_first[b] = n;
+    for (e = gram->pair_first[b]; e < gram->pair_first[b + 1]; e++) {
+      for (w = 0; w < gram->nwords; w++) {
+        for (bits = gram->pair_mask[e * gram->nwords + w]; bits != 0;
+             bits &= bits - 1) {
+          obj->rule_lhs[n] = gram->pair_lhs[e];
+          obj->rule_right[n] = w * CKY_WORD_BITS + __builtin_ctzll(bits);
+          n++;
+        }
+      }
+    }
+  }
+  obj->rule_first[nnon] = n;
+
+  obj->length = 0;
+  obj->capacity = 0;
+  obj->nwords = 0;
+  obj->rows = NULL;
+}
+
+/**
+   @brief Allocate and initialize a recognizer.
+   @param gram The compiled grammar to recognize with
+   @return The new recognizer
+ */
+cky_valiant *cky_valiant_create(const cky_grammar *gram)
+{
+  cky_valiant *obj = smb_new(cky_valiant, 1);
+  cky_valiant_init(obj, gram);
+  return obj;
+}
+
+/**
+   @brief Free a recognizer's tables, but not the recognizer itself.
+   @param obj The recognizer to clean up
+ */
+void cky_valiant_destroy(cky_valiant *obj)
+{
+  smb_free(obj->rule_first);
+  smb_free(obj->rule_lhs);
+  smb_free(obj->rule_right);
+  smb_free(obj->rows);
+}
+
+/**
+   @brief Free a recognizer and its tables.
+   @param obj The recognizer to delete
+ */
+void cky_valiant_delete(cky_valiant *obj)
+{
+  cky_valiant_destroy(obj);
+  smb_free(obj);
+}
+
+/*
+  Return row i of a nonterminal's matrix.
+ */
+static inline cky_word *cky_valiant_row(const cky_valiant *obj, int symbol,
+                                        int i)
+{
+  return obj->rows + ((size_t) symbol * obj->capacity + i) * obj->nwords;
+}
+
+/*
+  Mask of the bits of word w that fall within [lo, hi).
+ */
+static inline cky_word cky_valiant_mask(int w, int lo, int hi)
+{
+  cky_word mask = ~(cky_word) 0;
+  if (w == lo / CKY_WORD_BITS) {
+    mask &= mask << (lo % CKY_WORD_BITS);
+  }
+  if (w == (hi - 1) / CKY_WORD_BITS) {
+    mask &= ~(cky_word) 0 >> (CKY_WORD_BITS - 1 - (hi - 1) % CKY_WORD_BITS);
+  }
+  return mask;
+}
+
+/*
+  Add to the cells (i, j) for i in [li, mi) and j in [lj, mj) the products
+  through every k in [lk, mk): each A with a rule A -> B C, where (i, k)
+  derives B and (k, j) derives C.
+ */
+static void cky_valiant_product(cky_valiant *obj, int li, int mi, int lk,
+                                int mk, int lj, int mj)
+{
+  int nnon = obj->gram->nnonterminals, wk0 = lk / CKY_WORD_BITS,
+    wk1 = (mk - 1) / CKY_WORD_BITS, wj0 = lj / CKY_WORD_BITS,
+    wj1 = (mj - 1) / CKY_WORD_BITS, b, i, w, k, r, x;
+  cky_word head = cky_valiant_mask(wj0, lj, mj),
+    tail = cky_valiant_mask(wj1, lj, mj), bits, *out;
+  const cky_word *row, *in;
+
+  for (b = 0; b < nnon; b++) {
+    if (obj->rule_first[b] == obj->rule_first[b + 1]) {
+      continue;
+    }
+    for (i = li; i < mi; i++) {
+      row = cky_valiant_row(obj, b, i);
+      for (w = wk0; w <= wk1; w++) {
+        for (bits = row[w] & cky_valiant_mask(w, lk, mk); bits != 0;
+             bits &= bits - 1) {
+          k = w * CKY_WORD_BITS + __builtin_ctzll(bits);
+          for (r = obj->rule_first[b]; r < obj->rule_first[b + 1]; r++) {
+            out = cky_valiant_row(obj, obj->rule_lhs[r], i);
+            in = cky_valiant_row(obj, obj->rule_right[r], k);
+            if (wj0 == wj1) {
+              out[wj0] |= in[wj0] & head & tail;
+              continue;
+            }
+            out[wj0] |= in[wj0] & head;
+            for (x = wj0 + 1; x < wj1; x++) {
+              out[x] |= in[x];
+            }
+            out[wj1] |= in[wj1] & tail;
+          }
+        }
+      }
+    }
+  }
+}
+
+/*
+  Complete the rectangle of cells (i, j) for i in [l, m) and j in [l2, m2).
+ */
+static void cky_valiant_complete(cky_valiant *obj, const int *tokens, int l,
+                                 int m, int l2, int m2)
+{
+  const cky_grammar *g = obj->gram;
+  int a = (l + m) / 2, b = (l2 + m2) / 2, w;
+  cky_word bits;
+
+  if (m - l == 1 && m2 - l2 == 1) {
+    // Cells of one token are the leaves, and others are already complete.
+    if (m == l2 && tokens[l] >= 0 && tokens[l] < g->nterminals) {
+      for (w = 0; w < g->nwords; w++) {
+        for (bits = g->leaf[tokens[l] * g->nwords + w]; bits != 0;
+             bits &= bits - 1) {
+          cky_bit_set(cky_valiant_row(obj, w * CKY_WORD_BITS +
+                                      __builtin_ctzll(bits), l), l2);
+        }
+      }
+    }
+  } else if (m - l == 1) {
+    cky_valiant_complete(obj, tokens, l, m, l2, b);
+    cky_valiant_product(obj, l, m, l2, b, b, m2);
+    cky_valiant_complete(obj, tokens, l, m, b, m2);
+  } else if (m2 - l2 == 1) {
+    cky_valiant_complete(obj, tokens, a, m, l2, m2);
+    cky_valiant_product(obj, l, a, a, m, l2, m2);
+    cky_valiant_complete(obj, tokens, l, a, l2, m2);
+  } else {
+    cky_valiant_complete(obj, tokens, a, m, l2, b);
+    cky_valiant_product(obj, l, a, a, m, l2, b);
+    cky_valiant_complete(obj, tokens, l, a, l2, b);
+    cky_valiant_product(obj, a, m, l2, b, b, m2);
+    cky_valiant_complete(obj, tokens, a, m, b, m2);
+    cky_valiant_product(obj, l, a, a, m, b, m2);
+    cky_valiant_product(obj, l, a, l2, b, b, m2);
+    cky_valiant_complete(obj, tokens, l, a, b, m2);
+  }
+}
+
+/*
+  Fill every cell (i, j) with l <= i < j < m.
+ */
+static void cky_valiant_compute(cky_valiant *obj, const int *tokens, int l,
+                                int m)
+{
+  int mid = (l + m) / 2;
+  if (m - l < 2) {
+    return;
+  }
+  cky_valiant_compute(obj, tokens, l, mid);
+  cky_valiant_compute(obj, tokens, mid, m);
+  cky_valiant_complete(obj, tokens, l, mid, mid, m);
+}
+
+/**
+   @brief Fill the table from a sentence of terminals.
+
+   The matrices are only reallocated for a sentence longer than any before.
+
+   @param obj The recognizer
+   @param tokens The terminal index of each token.  Negative values stand for
+   tokens that aren't terminals of the grammar, which nothing derives.
+   @param length Number of tokens
+   @return True if the grammar's start symbol derives the sentence.
+ */
+bool cky_valiant_fill(cky_valiant *obj, const int *tokens, int length)
+{
+  const cky_grammar *g = obj->gram;
+  size_t size;
+
+  if (length + 1 > obj->capacity) {
+    obj->capacity = length + 1 > 2 * obj->capacity ? length + 1 :
+      2 * obj->capacity;
+    obj->nwords = (obj->capacity + CKY_WORD_BITS - 1) / CKY_WORD_BITS;
+    smb_free(obj->rows);
+    obj->rows = smb_new(cky_word, (size_t) g->nnonterminals * obj->capacity *
+                        obj->nwords + 1);
+  }
+  size = (size_t) g->nnonterminals * obj->capacity * obj->nwords;
+  memset(obj->rows, 0, sizeof(cky_word) * size);
+  obj->length = length;
+
+  cky_valiant_compute(obj, tokens, 0, length + 1);
+  if (length == 0) {
+    return g->accepts_empty;
+  }
+  return g->start >= 0 && cky_valiant_derives(obj, g->start, 0, length);
+}
+
+/**
+   @brief Return true if a nonterminal derives a span of a filled table.
+   @param obj The filled recognizer
+   @param symbol The nonterminal
+   @param start Index of the first token of the span
+   @param length Number of tokens in the span, at least one
+ */
+bool cky_valiant_derives(const cky_valiant *obj, int symbol, int start,
+                         int length)
+{
+  return cky_bit_test(cky_valiant_row(obj, symbol, start), start + length);
+}
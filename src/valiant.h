@@ -0,0 +1,104 @@
+/***************************************************************************//**
+
+  @file         valiant.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Recognition of long sentences by boolean matrix products.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_VALIANT_H
+#define SMB_VALIANT_H
+
+#include <stdbool.h>
+
+#include "cky.h"
+
+/**
+   @brief Sentences at least this long are faster to recognize by products.
+
+   Where the two recognizers cross over depends on the machine, the build and
+   the grammar, with larger grammars crossing over sooner.  To re-derive it,
+   run "bench -s crossover -n N -m M", which times both on a random grammar of
+   N nonterminals over sentences of up to M tokens, and take the shortest
+   length at which the product recognizer wins.  The default was taken with a
+   grammar of eight nonterminals, and can be overridden with --crossover.
+ */
+#define CKY_VALIANT_MIN_LENGTH 64
+
+/**
+   @brief A recognizer which fills its table with boolean matrix products.
+
+   Each nonterminal has a bit matrix over the positions between tokens: bit
+   `j` of row `i` is set when the nonterminal derives the tokens from `i` up
+   to `j`.  The table is filled by Valiant's divide and conquer, in the form
+   given by Okhotin: the upper triangle is split into rectangles of spans,
+   and each rectangle is completed once the products of the blocks between
+   its rows and columns have been added into it.  Each product is done for
+   every rule `A -> B C` at once over whole rows, 64 positions to a word, so
+   the work per cell is a fraction of a word operation instead of a loop over
+   split points.
+
+   @see cky_valiant_init
+   @see cky_valiant_fill
+ */
+typedef struct {
+
+  /**
+     @brief The grammar the table is filled with.
+   */
+  const cky_grammar *gram;
+
+  /**
+     @brief Rules for `B` are `rule_first[B]` up to `rule_first[B+1]`.
+   */
+  int *rule_first;
+
+  /**
+     @brief The left hand side `A` of each rule `A -> B C`.
+   */
+  int *rule_lhs;
+
+  /**
+     @brief The right symbol `C` of each rule `A -> B C`.
+   */
+  int *rule_right;
+
+  /**
+     @brief Number of tokens of the sentence most recently filled in.
+   */
+  int length;
+
+  /**
+     @brief The most positions the matrices have room for.
+   */
+  int capacity;
+
+  /**
+     @brief Words in each row of a matrix.
+   */
+  int nwords;
+
+  /**
+     @brief Every nonterminal's matrix, one after another.
+   */
+  cky_word *rows;
+
+} cky_valiant;
+
+void cky_valiant_init(cky_valiant *obj, const cky_grammar *gram);
+cky_valiant *cky_valiant_create(const cky_grammar *gram);
+void cky_valiant_destroy(cky_valiant *obj);
+void cky_valiant_delete(cky_valiant *obj);
+
+bool cky_valiant_fill(cky_valiant *obj, const int *tokens, int length);
+bool cky_valiant_derives(const cky_valiant *obj, int symbol, int start,
+                         int length);
+
+#endif//SMB_VALIANT_H
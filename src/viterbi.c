@@ -0,0 +1,302 @@
+/***************************************************************************//**
+
+  @file         viterbi.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Best parses of weighted CNF grammars, with pruning.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "libstephen/base.h"
+#include "cky.h"
+#include "gram.h"
+#include "viterbi.h"
+
+/**
+   @brief Initialize a Viterbi parser for a weighted CNF grammar.
+
+   No pruning is done until cky_viterbi.beam or cky_viterbi.threshold is set.
+
+   @param obj Memory to initialize
+   @param gram The grammar, with its rule index built
+ */
+void cky_viterbi_init(cky_viterbi *obj, const cnf *gram)
+{
+  int nnon = al_length(&gram->nonterminals), a;
+
+  obj->gram = gram;
+  obj->beam = 0;
+  obj->threshold = HUGE_VAL;
+  obj->length = 0;
+  obj->cell_capacity = 16;
+  obj->cell_first = smb_new(int, obj->cell_capacity);
+  obj->entry_capacity = 64;
+  obj->entries = smb_new(cky_viterbi_entry, obj->entry_capacity);
+  obj->nentries = 0;
+  obj->root = -1;
+  obj->best = smb_new(cky_viterbi_entry, nnon + 1);
+  obj->touched = smb_new(int, nnon + 1);
+  obj->where = smb_new(int, nnon + 1);
+  for (a = 0; a < nnon; a++) {
+    obj->best[a].split = -1;
+    obj->where[a] = -1;
+  }
+}
+
+/**
+   @brief Allocate and initialize a Viterbi parser.
+   @param gram The grammar, with its rule index built
+   @return The new parser
+ */
+cky_viterbi *cky_viterbi_create(const cnf *gram)
+{
+  cky_viterbi *obj = smb_new(cky_viterbi, 1);
+  cky_viterbi_init(obj, gram);
+  return obj;
+}
+
+/**
+   @brief Free a Viterbi parser's tables, but not the parser itself.
+   @param obj The parser to clean up
+ */
+void cky_viterbi_destroy(cky_viterbi *obj)
+{
+  smb_free(obj->cell_first);
+  smb_free(obj->entries);
+  smb_free(obj->best);
+  smb_free(obj->touched);
+  smb_free(obj->where);
+}
+
+/**
+   @brief Free a Viterbi parser and its tables.
+   @param obj The parser to delete
+ */
+void cky_viterbi_delete(cky_viterbi *obj)
+{
+  cky_viterbi_destroy(obj);
+  smb_free(obj);
+}
+
+/*
+  Order entries from the best score down.  Ties go to the lower symbol, so
+  that pruning doesn't depend on the order candidates were found in.
+ */
+static int cky_viterbi_compare(const void *a, const void *b)
+{
+  const cky_viterbi_entry *e1 = a, *e2 = b;
+  if (e1->score != e2->score) {
+    return e1->score > e2->score ? -1 : 1;
+  }
+  return e1->symbol < e2->symbol ? -1 : e1->symbol > e2->symbol;
+}
+
+/*
+  Offer a derivation of a nonterminal to the cell being filled.
+ */
+static void cky_viterbi_offer(cky_viterbi *obj, int *ntouched, int symbol,
+                              double score, int split, int left, int right)
+{
+  cky_viterbi_entry *best = &obj->best[symbol];
+  if (best->split < 0) {
+    obj->touched[(*ntouched)++] = symbol;
+  } else if (score <= best->score) {
+    return;
+  }
+  best->symbol = symbol;
+  best->score = score;
+  best->split = split;
+  best->left = left;
+  best->right = right;
+}
+
+/*
+  Move the candidates of the cell being filled into the entries, keeping only
+  those that survive pruning.
+ */
+static void cky_viterbi_keep(cky_viterbi *obj, int ntouched)
+{
+  cky_viterbi_entry *cell;
+  double top = -HUGE_VAL;
+  int i, n = 0;
+
+  if (obj->nentries + ntouched > obj->entry_capacity) {
+    while (obj->nentries + ntouched > obj->entry_capacity) {
+      obj->entry_capacity *= 2;
+    }
+    obj->entries = smb_renew(cky_viterbi_entry, obj->entries,
+                             obj->entry_capacity);
+  }
+  cell = obj->entries + obj->nentries;
+
+  for (i = 0; i < ntouched; i++) {
+    if (obj->best[obj->touched[i]].score > top) {
+      top = obj->best[obj->touched[i]].score;
+    }
+  }
+  for (i = 0; i < ntouched; i++) {
+    if (obj->best[obj->touched[i]].score >= top - obj->threshold) {
+      cell[n++] = obj->best[obj->touched[i]];
+    }
+    obj->best[obj->touched[i]].split = -1;
+  }
+
+  qsort(cell, n, sizeof(cky_viterbi_entry), &cky_viterbi_compare);
+  if (obj->beam > 0 && n > obj->beam) {
+    n = obj->beam;
+  }
+  obj->nentries += n;
+}
+
+/*
+  Fill one cell of length two or more from the shorter cells within it.
+ */
+static void cky_viterbi_span(cky_viterbi *obj, int start, int length)
+{
+  const cnf *g = obj->gram;
+  const cky_viterbi_entry *left, *right;
+  int k, l, e, r, lc, rc, ntouched = 0;
+
+  for (k = 1; k < length; k++) {
+    lc = cky_chart_offset(obj->length, k) + start;
+    rc = cky_chart_offset(obj->length, length - k) + start + k;
+    if (obj->cell_first[lc] == obj->cell_first[lc + 1] ||
+        obj->cell_first[rc] == obj->cell_first[rc + 1]) {
+      continue;
+    }
+    for (e = obj->cell_first[rc]; e < obj->cell_first[rc + 1]; e++) {
+      obj->where[obj->entries[e].symbol] = e;
+    }
+    for (l = obj->cell_first[lc]; l < obj->cell_first[lc + 1]; l++) {
+      left = &obj->entries[l];
+      for (r = g->two_first[left->symbol];
+           r < g->two_first[left->symbol + 1]; r++) {
+        e = obj->where[g->two_right[r]];
+        if (e < 0) {
+          continue;
+        }
+        right = &obj->entries[e];
+        cky_viterbi_offer(obj, &ntouched, g->two_lhs[r],
+                          left->score + right->score + g->two_weight[r],
+                          k, l, e);
+      }
+    }
+    for (e = obj->cell_first[rc]; e < obj->cell_first[rc + 1]; e++) {
+      obj->where[obj->entries[e].symbol] = -1;
+    }
+  }
+  cky_viterbi_keep(obj, ntouched);
+}
+
+/**
+   @brief Find the best parse of a sentence of terminals.
+
+   @param obj The parser
+   @param tokens The terminal index of each token.  Negative values stand for
+   tokens that aren't terminals of the grammar, which nothing derives.
+   @param length Number of tokens
+   @return The weight of the best parse, or -HUGE_VAL if none was found.
+ */
+double cky_viterbi_fill(cky_viterbi *obj, const int *tokens, int length)
+{
+  const cnf *g = obj->gram;
+  int nterm = al_length(&g->terminals);
+  int ncells = length > 0 ? cky_chart_offset(length, length) + 1 : 0;
+  int len, i, r, cell, ntouched, t;
+
+  obj->length = length;
+  obj->nentries = 0;
+  obj->root = -1;
+  if (length == 0) {
+    return g->accepts_empty ? g->empty_weight : -HUGE_VAL;
+  }
+  if (ncells + 1 > obj->cell_capacity) {
+    obj->cell_capacity = ncells + 1;
+    obj->cell_first = smb_renew(int, obj->cell_first, obj->cell_capacity);
+  }
+
+  // Cells are filled in the order they are numbered, so each one's entries
+  // follow the last one's.
+  cell = 0;
+  for (i = 0; i < length; i++) {
+    obj->cell_first[cell++] = obj->nentries;
+    ntouched = 0;
+    t = tokens[i];
+    if (t >= 0 && t < nterm) {
+      for (r = g->one_first[t]; r < g->one_first[t + 1]; r++) {
+        cky_viterbi_offer(obj, &ntouched, g->one_lhs[r], g->one_weight[r],
+                          0, -1, -1);
+      }
+    }
+    cky_viterbi_keep(obj, ntouched);
+  }
+  for (len = 2; len <= length; len++) {
+    for (i = 0; i + len <= length; i++) {
+      obj->cell_first[cell] = obj->nentries;
+      cky_viterbi_span(obj, i, len);
+      cell++;
+    }
+  }
+  obj->cell_first[cell] = obj->nentries;
+
+  cell = cky_chart_offset(length, length);
+  for (i = obj->cell_first[cell]; i < obj->cell_first[cell + 1]; i++) {
+    if (obj->entries[i].symbol == g->start) {
+      obj->root = i;
+      return obj->entries[i].score;
+    }
+  }
+  return -HUGE_VAL;
+}
+
+/*
+  Store the tree under an entry in preorder, starting at *next.  Returns where
+  the entry's node was stored.
+ */
+static int cky_viterbi_node(const cky_viterbi *obj, int entry, int start,
+                            int length, cky_tree_node *nodes, int *next)
+{
+  const cky_viterbi_entry *e = &obj->entries[entry];
+  int pos = (*next)++;
+  nodes[pos].symbol = e->symbol;
+  nodes[pos].start = start;
+  nodes[pos].length = length;
+  nodes[pos].left = -1;
+  nodes[pos].right = -1;
+  if (e->left >= 0) {
+    nodes[pos].left = cky_viterbi_node(obj, e->left, start, e->split, nodes,
+                                       next);
+    nodes[pos].right = cky_viterbi_node(obj, e->right, start + e->split,
+                                        length - e->split, nodes, next);
+  }
+  return pos;
+}
+
+/**
+   @brief Extract the best parse found by cky_viterbi_fill().
+
+   @param obj The parser
+   @param[out] nodes Room for `2 * length - 1` nodes, stored in preorder
+   @return False if no parse was found.
+ */
+bool cky_viterbi_tree(const cky_viterbi *obj, cky_tree_node *nodes)
+{
+  int next = 0;
+  if (obj->length == 0) {
+    return obj->gram->accepts_empty;
+  }
+  if (obj->root < 0) {
+    return false;
+  }
+  cky_viterbi_node(obj, obj->root, 0, obj->length, nodes, &next);
+  return true;
+}
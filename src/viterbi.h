@@ -0,0 +1,154 @@
+/***************************************************************************//**
+
+  @file         viterbi.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Best parses of weighted CNF grammars, with pruning.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See the LICENSE.txt file for details.
+
+*******************************************************************************/
+
+#ifndef SMB_VITERBI_H
+#define SMB_VITERBI_H
+
+#include <stdbool.h>
+
+#include "forest.h"
+#include "gram.h"
+
+/**
+   @brief A nonterminal kept in a cell, with its best derivation.
+ */
+typedef struct {
+
+  /**
+     @brief The nonterminal.
+   */
+  int symbol;
+
+  /**
+     @brief The weight of the best derivation, as a log probability.
+   */
+  double score;
+
+  /**
+     @brief Length of the left child's span, or zero at a leaf.
+   */
+  int split;
+
+  /**
+     @brief The entry of the left child, or -1 at a leaf.
+   */
+  int left;
+
+  /**
+     @brief The entry of the right child, or -1 at a leaf.
+   */
+  int right;
+
+} cky_viterbi_entry;
+
+/**
+   @brief A Viterbi CKY parser, which finds the best parse of a sentence.
+
+   Each cell keeps only its surviving nonterminals, as a list of entries with
+   their best score and a back-pointer to the children it came from.  After a
+   cell is filled, entries scoring more than cky_viterbi.threshold below the
+   cell's best are dropped, and then all but the best cky_viterbi.beam.  Pruned
+   cells are small, so the cost of filling a cell depends on the beam rather
+   than on the size of the grammar.  Pruning can lose the best parse, or every
+   parse; without it the result is exact.
+
+   The tables grow as needed, and are reused from one sentence to the next.
+
+   @see cky_viterbi_init
+   @see cky_viterbi_fill
+ */
+typedef struct {
+
+  /**
+     @brief The grammar, whose rule index must have been built.
+   */
+  const cnf *gram;
+
+  /**
+     @brief Most entries kept per cell, or zero for no limit.
+   */
+  int beam;
+
+  /**
+     @brief Entries further than this below the cell's best are dropped.
+
+     HUGE_VAL by default, which keeps every entry.
+   */
+  double threshold;
+
+  /**
+     @brief Number of tokens in the sentence most recently filled in.
+   */
+  int length;
+
+  /**
+     @brief The entries of cell `c` are `cell_first[c]` to `cell_first[c+1]`.
+
+     Cells are numbered like those of a cky_chart with capacity
+     cky_viterbi.length.
+   */
+  int *cell_first;
+
+  /**
+     @brief Allocated length of cky_viterbi.cell_first.
+   */
+  int cell_capacity;
+
+  /**
+     @brief Every cell's entries, one cell after another.
+   */
+  cky_viterbi_entry *entries;
+
+  /**
+     @brief Number of entries in cky_viterbi.entries.
+   */
+  int nentries;
+
+  /**
+     @brief Allocated length of cky_viterbi.entries.
+   */
+  int entry_capacity;
+
+  /**
+     @brief The entry of the start symbol over the sentence, or -1.
+   */
+  int root;
+
+  /**
+     @brief Best candidate for each nonterminal, while filling a cell.
+   */
+  cky_viterbi_entry *best;
+
+  /**
+     @brief Nonterminals with a candidate in the cell being filled.
+   */
+  int *touched;
+
+  /**
+     @brief Entry of each nonterminal in the right child cell, or -1.
+   */
+  int *where;
+
+} cky_viterbi;
+
+void cky_viterbi_init(cky_viterbi *obj, const cnf *gram);
+cky_viterbi *cky_viterbi_create(const cnf *gram);
+void cky_viterbi_destroy(cky_viterbi *obj);
+void cky_viterbi_delete(cky_viterbi *obj);
+
+double cky_viterbi_fill(cky_viterbi *obj, const int *tokens, int length);
+bool cky_viterbi_tree(const cky_viterbi *obj, cky_tree_node *nodes);
+
+#endif//SMB_VITERBI_H
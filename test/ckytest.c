@@ -0,0 +1,480 @@
+/***************************************************************************//**
+
+  @file         ckytest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the CKY recognizer.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libstephen/ut.h"
+#include "cky.h"
+#include "cnf.h"
+#include "gram.h"
+#include "pcky.h"
+#include "stats.h"
+#include "valiant.h"
+#include "viterbi.h"
+
+static unsigned int next_random(unsigned int *seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 16) & 0x7FFF;
+}
+
+/*
+  Make a random CNF grammar, with enough nonterminals to need several words
+  per bitset.
+ */
+static cnf *random_grammar(int nnon, int nterm, unsigned int seed)
+{
+  static char names[520][8];
+  cnf *gram = cnf_create_arena();
+  int i, a;
+  for (i = 0; i < nnon; i++) {
+    sprintf(names[i], "N%d", i);
+    cnf_add_symbol(gram, names[i], false);
+  }
+  for (i = 0; i < nterm; i++) {
+    sprintf(names[nnon + i], "t%d", i);
+    cnf_add_symbol(gram, names[nnon + i], true);
+  }
+  for (a = 0; a < nnon; a++) {
+    for (i = 0; i < 3; i++) {
+      cnf_new_rule(gram, a, next_random(&seed) % nnon,
+                   next_random(&seed) % nnon);
+    }
+    if (next_random(&seed) % 4 == 0) {
+      cnf_new_rule(gram, a, next_random(&seed) % nterm, CFG_SYMBOL_NONE);
+    }
+  }
+  gram->start = 0;
+  cnf_build_index(gram);
+  return gram;
+}
+
+/*
+  Check every cell of a filled chart against a straightforward CKY over the
+  rule lists.
+ */
+static bool check_chart(cnf *gram, cky_chart *chart, const int *tokens, int n)
+{
+  int nn = al_length(&gram->nonterminals), len, i, k, r, a;
+  bool *table = smb_new(bool, n * n * nn), ok = true;
+  cnf_rule *rule;
+#define AT(i, len, a) table[((len - 1) * n + (i)) * nn + (a)]
+
+  memset(table, 0, sizeof(bool) * n * n * nn);
+  for (i = 0; i < n; i++) {
+    for (r = 0; r < cnf_num_rules(gram, false); r++) {
+      rule = cnf_get_rule(gram, false, r);
+      if (rule->rhs_one == tokens[i]) {
+        AT(i, 1, rule->lhs) = true;
+      }
+    }
+  }
+  for (len = 2; len <= n; len++) {
+    for (i = 0; i + len <= n; i++) {
+      for (k = 1; k < len; k++) {
+        for (r = 0; r < cnf_num_rules(gram, true); r++) {
+          rule = cnf_get_rule(gram, true, r);
+          if (AT(i, k, rule->rhs_one) && AT(i + k, len - k, rule->rhs_two)) {
+            AT(i, len, rule->lhs) = true;
+          }
+        }
+      }
+    }
+  }
+  for (len = 1; len <= n; len++) {
+    for (i = 0; i + len <= n; i++) {
+      for (a = 0; a < nn; a++) {
+        ok = ok &&
+          AT(i, len, a) == cky_bit_test(cky_chart_cell(chart, i, len), a);
+      }
+    }
+  }
+  smb_free(table);
+  return ok;
+#undef AT
+}
+
+static int test_random_charts(void)
+{
+  unsigned int seed = 42;
+  // One of each width with a kernel of its own, and one without.
+  int sizes[] = {5, 64, 130, 128, 256, 512};
+  int tokens[12];
+  cky_grammar compiled;
+  cky_chart chart;
+  cnf *gram;
+  int s, trial, i, n;
+
+  for (s = 0; s < 6; s++) {
+    gram = random_grammar(sizes[s], 3, s + 1);
+    cky_grammar_init(&compiled, gram);
+    TEST_ASSERT(compiled.nwords == (sizes[s] + 63) / 64);
+    // One chart, starting too small, is reused for inputs of every length.
+    cky_chart_init(&chart, &compiled, 2);
+    for (trial = 0; trial < 20; trial++) {
+      n = 1 + next_random(&seed) % 12;
+      for (i = 0; i < n; i++) {
+        tokens[i] = next_random(&seed) % 3;
+      }
+      TEST_ASSERT(cky_chart_fill(&chart, tokens, n) ==
+                  cky_bit_test(cky_chart_cell(&chart, 0, n), 0));
+      TEST_ASSERT(chart.capacity >= n && chart.length == n);
+      TEST_ASSERT(check_chart(gram, &chart, tokens, n));
+    }
+    cky_chart_destroy(&chart);
+    cky_grammar_destroy(&compiled);
+    cnf_delete(gram, false);
+  }
+  return 0;
+}
+
+static int test_fill_parallel(void)
+{
+  unsigned int seed = 7;
+  int threads[] = {1, 2, 4, 7};
+  // The same pool fills each of these, growing and shrinking the sentence.
+  int lengths[] = {80, 40, 5, 80};
+  int tokens[80];
+  cky_grammar compiled;
+  cky_chart serial, parallel;
+  cky_pool pool;
+  cnf *gram = random_grammar(64, 3, 5);
+  int t, s, i, len, n;
+  bool result;
+
+  cky_grammar_init(&compiled, gram);
+  for (i = 0; i < 80; i++) {
+    tokens[i] = next_random(&seed) % 3;
+  }
+  cky_chart_init(&serial, &compiled, 80);
+  cky_chart_init(&parallel, &compiled, 1);
+  for (t = 0; t < 4; t++) {
+    cky_pool_init(&pool, threads[t]);
+    TEST_ASSERT(1 <= pool.nthreads && pool.nthreads <= threads[t]);
+    for (s = 0; s < 4; s++) {
+      n = lengths[s];
+      result = cky_chart_fill(&serial, tokens, n);
+      TEST_ASSERT(cky_chart_fill_parallel(&parallel, &pool, tokens, n) ==
+                  result);
+      for (len = 1; len <= n; len++) {
+        for (i = 0; i + len <= n; i++) {
+          TEST_ASSERT(memcmp(cky_chart_cell(&serial, i, len),
+                             cky_chart_cell(&parallel, i, len),
+                             sizeof(cky_word) * compiled.nwords) == 0);
+        }
+      }
+    }
+    cky_pool_destroy(&pool);
+  }
+
+  cky_chart_destroy(&serial);
+  cky_chart_destroy(&parallel);
+  cky_grammar_destroy(&compiled);
+  cnf_delete(gram, false);
+  return 0;
+}
+
+static int test_valiant(void)
+{
+  unsigned int seed = 11;
+  int sizes[] = {5, 40, 70}, lengths[] = {0, 1, 2, 3, 17, 64, 65, 130};
+  int tokens[130];
+  cky_grammar compiled;
+  cky_chart chart;
+  cky_valiant valiant;
+  cnf *gram;
+  int s, t, n, i, len, a;
+  bool ok;
+
+  for (s = 0; s < 3; s++) {
+    gram = random_grammar(sizes[s], 3, s + 20);
+    cky_grammar_init(&compiled, gram);
+    cky_chart_init(&chart, &compiled, 1);
+    // Filled from short to long and back, so the table is reused.
+    cky_valiant_init(&valiant, &compiled);
+    for (t = 0; t < 16; t++) {
+      n = lengths[t < 8 ? t : 15 - t];
+      for (i = 0; i < n; i++) {
+        tokens[i] = next_random(&seed) % 4 - (s == 2);
+      }
+      TEST_ASSERT(cky_valiant_fill(&valiant, tokens, n) ==
+                  cky_chart_fill(&chart, tokens, n));
+      ok = true;
+      for (len = 1; len <= n; len++) {
+        for (i = 0; i + len <= n; i++) {
+          for (a = 0; a < compiled.nnonterminals; a++) {
+            ok = ok && cky_valiant_derives(&valiant, a, i, len) ==
+              cky_bit_test(cky_chart_cell(&chart, i, len), a);
+          }
+        }
+      }
+      TEST_ASSERT(ok);
+    }
+    cky_valiant_destroy(&valiant);
+    cky_chart_destroy(&chart);
+    cky_grammar_destroy(&compiled);
+    cnf_delete(gram, false);
+  }
+  return 0;
+}
+
+/*
+  Return the filter row of the token at position i, or of the sentence's end.
+ */
+static int filter_row(const cky_filter *filter, const int *tokens, int n,
+                      int i)
+{
+  if (i < 0 || i >= n) {
+    return filter->nterminals;
+  }
+  return tokens[i] >= 0 && tokens[i] < filter->nterminals ? tokens[i] :
+    filter->nterminals + 1;
+}
+
+/*
+  Check that each cell of a filtered chart is the unfiltered cell, masked by
+  the filter rows of its neighbours.  Adds the number of nonterminals
+  filtered out to dropped.
+ */
+static bool check_filtered(const cky_filter *filter, const cky_chart *plain,
+                           const cky_chart *filtered, const int *tokens,
+                           int n, int *dropped)
+{
+  int nw = filter->nwords, len, i, w;
+  const cky_word *begin, *end, *cell, *expect;
+  bool ok = plain->length == n && filtered->length == n;
+  for (len = 1; ok && len <= n; len++) {
+    for (i = 0; ok && i + len <= n; i++) {
+      begin = filter->begin + filter_row(filter, tokens, n, i - 1) * nw;
+      end = filter->end + filter_row(filter, tokens, n, i + len) * nw;
+      cell = cky_chart_cell(filtered, i, len);
+      expect = cky_chart_cell(plain, i, len);
+      for (w = 0; w < nw; w++) {
+        ok = ok && cell[w] == (expect[w] & begin[w] & end[w]);
+        *dropped += __builtin_popcountll(expect[w] & ~cell[w]);
+      }
+    }
+  }
+  return ok;
+}
+
+static int test_filter(void)
+{
+  unsigned int seed = 99;
+  int sizes[] = {5, 64, 130};
+  int tokens[24], edited[24];
+  cky_grammar compiled;
+  cky_filter filter;
+  cky_chart plain, filtered, fresh;
+  cnf *gram;
+  int s, trial, i, n, m, first, removed, added, dropped = 0;
+
+  for (s = 0; s < 3; s++) {
+    gram = random_grammar(sizes[s], 3, s + 30);
+    cky_grammar_init(&compiled, gram);
+    cky_filter_init(&filter, &compiled);
+    cky_chart_init(&plain, &compiled, 1);
+    cky_chart_init(&filtered, &compiled, 1);
+    cky_chart_init(&fresh, &compiled, 1);
+    cky_chart_set_filter(&filtered, &filter);
+    cky_chart_set_filter(&fresh, &filter);
+    for (trial = 0; trial < 20; trial++) {
+      n = next_random(&seed) % 20;
+      for (i = 0; i < n; i++) {
+        tokens[i] = next_random(&seed) % 3 - (trial % 5 == 4);
+      }
+      TEST_ASSERT(cky_chart_fill(&plain, tokens, n) ==
+                  cky_chart_fill(&filtered, tokens, n));
+      TEST_ASSERT(check_filtered(&filter, &plain, &filtered, tokens, n,
+                                 &dropped));
+
+      // Edits of a filtered chart refill the spans next to the edit too.
+      first = n == 0 ? 0 : next_random(&seed) % n;
+      removed = next_random(&seed) % 3;
+      removed = first + removed > n ? n - first : removed;
+      added = next_random(&seed) % 3;
+      memcpy(edited, tokens, sizeof(int) * first);
+      for (i = 0; i < added; i++) {
+        edited[first + i] = next_random(&seed) % 3;
+      }
+      memcpy(edited + first + added, tokens + first + removed,
+             sizeof(int) * (n - first - removed));
+      m = n - removed + added;
+      TEST_ASSERT(cky_chart_edit(&fresh, &filtered, edited, m, first, removed,
+                                 added) == cky_chart_fill(&plain, edited, m));
+      TEST_ASSERT(check_filtered(&filter, &plain, &fresh, edited, m,
+                                 &dropped));
+    }
+    cky_chart_destroy(&plain);
+    cky_chart_destroy(&filtered);
+    cky_chart_destroy(&fresh);
+    cky_filter_destroy(&filter);
+    cky_grammar_destroy(&compiled);
+    cnf_delete(gram, false);
+  }
+  TEST_ASSERT(dropped > 0);
+  return 0;
+}
+
+static int test_expression(void)
+{
+  smb_status status = SMB_SUCCESS;
+  char *text =
+    "expr -> expr ADD term | term\n"
+    "term -> ( expr ) | x\n";
+  cfg gram;
+  cnf normal;
+  cky_grammar compiled;
+  int x, add, open, close;
+
+  cfg_init(&gram);
+  cfg_load(&gram, text, &status);
+  cnf_init(&normal);
+  cfg_to_cnf(&gram, &normal, &status);
+  cfg_destroy(&gram, true);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  cky_grammar_init(&compiled, &normal);
+
+  x = cnf_add_symbol(&normal, "x", true);
+  add = cnf_add_symbol(&normal, "ADD", true);
+  open = cnf_add_symbol(&normal, "(", true);
+  close = cnf_add_symbol(&normal, ")", true);
+  TEST_ASSERT(al_length(&normal.terminals) == 4);
+  {
+    int good[] = {open, x, add, x, close, add, x};
+    int bad[] = {open, x, add, x, add, x};
+    int unknown[] = {x, add, -1};
+    TEST_ASSERT(cky_recognize(&compiled, good, 7));
+    TEST_ASSERT(cky_recognize(&compiled, good + 1, 1));
+    TEST_ASSERT(!cky_recognize(&compiled, bad, 6));
+    TEST_ASSERT(!cky_recognize(&compiled, unknown, 3));
+    TEST_ASSERT(!cky_recognize(&compiled, good, 0));
+  }
+
+  cky_grammar_destroy(&compiled);
+  cnf_destroy(&normal, true);
+  return 0;
+}
+
+static int test_stats(void)
+{
+  smb_status status = SMB_SUCCESS;
+  char *text =
+    "expr -> expr ADD term | term\n"
+    "term -> ( expr ) | x\n";
+  cfg gram;
+  cnf normal;
+  cky_grammar compiled;
+  cky_chart chart;
+  cky_viterbi parser;
+  cky_valiant valiant;
+  cky_stats stats, viterbi, product;
+  int x, add, open, close, length, start, a;
+  uint64_t entries = 0, live = 0, here;
+
+  cfg_init(&gram);
+  cfg_load(&gram, text, &status);
+  cnf_init(&normal);
+  cfg_to_cnf(&gram, &normal, &status);
+  cfg_destroy(&gram, true);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  cky_grammar_init(&compiled, &normal);
+  cky_chart_init(&chart, &compiled, 8);
+  cky_stats_init(&stats);
+
+  x = cnf_add_symbol(&normal, "x", true);
+  add = cnf_add_symbol(&normal, "ADD", true);
+  open = cnf_add_symbol(&normal, "(", true);
+  close = cnf_add_symbol(&normal, ")", true);
+  int good[] = {open, x, add, x, close, add, x};
+  TEST_ASSERT(cky_chart_fill(&chart, good, 7));
+  cky_stats_chart(&stats, &chart, true);
+  // The same counts, the slow way.
+  for (length = 1; length <= 7; length++) {
+    for (start = 0; start + length <= 7; start++) {
+      here = 0;
+      for (a = 0; a < compiled.nnonterminals; a++) {
+        here += cky_bit_test(cky_chart_cell(&chart, start, length), a);
+      }
+      entries += here;
+      live += here > 0;
+    }
+  }
+  TEST_ASSERT(stats.sentences == 1 && stats.accepted == 1);
+  TEST_ASSERT(stats.cells == 28);
+  TEST_ASSERT(stats.live_cells == live && stats.entries == entries);
+
+  TEST_ASSERT(stats.uncounted == 0);
+
+  // The other recognizers count the same cells, since nothing is pruned.
+  cky_stats_init(&viterbi);
+  cky_viterbi_init(&parser, &normal);
+  cky_stats_viterbi(&viterbi, &parser,
+                    cky_viterbi_fill(&parser, good, 7) != -HUGE_VAL);
+  TEST_ASSERT(viterbi.sentences == 1 && viterbi.accepted == 1);
+  TEST_ASSERT(viterbi.cells == 28 && viterbi.live_cells == live &&
+              viterbi.entries == entries);
+  cky_viterbi_destroy(&parser);
+  cky_stats_init(&product);
+  cky_valiant_init(&valiant, &compiled);
+  cky_stats_valiant(&product, &valiant, cky_valiant_fill(&valiant, good, 7));
+  TEST_ASSERT(product.sentences == 1 && product.accepted == 1);
+  TEST_ASSERT(product.cells == 28 && product.live_cells == live &&
+              product.entries == entries);
+  cky_valiant_destroy(&valiant);
+
+  // A sentence recognized without a chart only counts as a sentence.
+  cky_stats_chart(&stats, NULL, false);
+  TEST_ASSERT(stats.sentences == 2 && stats.accepted == 1);
+  TEST_ASSERT(stats.cells == 28 && stats.uncounted == 1);
+
+  cky_chart_destroy(&chart);
+  cky_grammar_destroy(&compiled);
+  cnf_destroy(&normal, true);
+  return 0;
+}
+
+void cky_test(void)
+{
+  smb_ut_group *group = su_create_test_group("cky");
+
+  smb_ut_test *random_charts = su_create_test("random_charts",
+                                              test_random_charts);
+  su_add_test(group, random_charts);
+
+  smb_ut_test *fill_parallel = su_create_test("fill_parallel",
+                                              test_fill_parallel);
+  su_add_test(group, fill_parallel);
+
+  smb_ut_test *valiant = su_create_test("valiant", test_valiant);
+  su_add_test(group, valiant);
+
+  smb_ut_test *filter = su_create_test("filter", test_filter);
+  su_add_test(group, filter);
+
+  smb_ut_test *expression = su_create_test("expression", test_expression);
+  su_add_test(group, expression);
+
+  smb_ut_test *stats = su_create_test("stats", test_stats);
+  su_add_test(group, stats);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
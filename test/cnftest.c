@@ -0,0 +1,329 @@
+/***************************************************************************//**
+
+  @file         cnftest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for conversion to Chomsky normal form.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libstephen/ut.h"
+#include "cnf.h"
+#include "gram.h"
+
+/*
+  Add a rule to a grammar, given its symbols as a string of single character
+  names.  Upper case letters are nonterminals.
+ */
+static void add(cfg *gram, char lhs, const char *rhs)
+{
+  static char names[128][2];
+  int i, n = strlen(rhs);
+  cfg_rule *rule;
+  names[(int) lhs][0] = lhs;
+  rule = cfg_rule_create(cfg_add_symbol(gram, names[(int) lhs], false), n);
+  for (i = 0; i < n; i++) {
+    names[(int) rhs[i]][0] = rhs[i];
+    rule->rhs[i] = cfg_add_symbol(gram, names[(int) rhs[i]],
+                                  !(rhs[i] >= 'A' && rhs[i] <= 'Z'));
+  }
+  cfg_add_rule(gram, rule);
+}
+
+/*
+  Look up the terminal for a character, or -1.
+ */
+static int terminal(cnf *gram, char c)
+{
+  smb_status status = SMB_SUCCESS;
+  int i;
+  for (i = 0; i < al_length(&gram->terminals); i++) {
+    if (((char *) al_get(&gram->terminals, i, &status).data_ptr)[0] == c) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*
+  A simple CKY recognizer, using the rule index.
+ */
+static bool recognize(cnf *gram, const char *s)
+{
+  int n = strlen(s), nn = al_length(&gram->nonterminals);
+  int len, i, k, b, c, r, t;
+  bool *table, result;
+#define AT(i, len, a) table[((i) * (n + 1) + (len)) * nn + (a)]
+
+  if (n == 0) {
+    return gram->accepts_empty;
+  }
+  table = smb_new(bool, (n + 1) * (n + 1) * nn);
+  memset(table, 0, sizeof(bool) * (n + 1) * (n + 1) * nn);
+  for (i = 0; i < n; i++) {
+    t = terminal(gram, s[i]);
+    if (t < 0) {
+      smb_free(table);
+      return false;
+    }
+    for (r = gram->one_first[t]; r < gram->one_first[t + 1]; r++) {
+      AT(i, 1, gram->one_lhs[r]) = true;
+    }
+  }
+  for (len = 2; len <= n; len++) {
+    for (i = 0; i + len <= n; i++) {
+      for (k = 1; k < len; k++) {
+        for (b = 0; b < nn; b++) {
+          if (!AT(i, k, b)) {
+            continue;
+          }
+          for (r = gram->two_first[b]; r < gram->two_first[b + 1]; r++) {
+            c = gram->two_right[r];
+            if (AT(i + k, len - k, c)) {
+              AT(i, len, gram->two_lhs[r]) = true;
+            }
+          }
+        }
+      }
+    }
+  }
+  result = AT(0, n, gram->start);
+  smb_free(table);
+  return result;
+#undef AT
+}
+
+static int test_balanced(void)
+{
+  smb_status status = SMB_SUCCESS;
+  cfg *gram = cfg_create();
+  cnf *normal = cnf_create();
+
+  // S -> a S b | epsilon
+  add(gram, 'S', "aSb");
+  add(gram, 'S', "");
+  gram->start = 0;
+  cfg_to_cnf(gram, normal, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  TEST_ASSERT(normal->accepts_empty);
+  TEST_ASSERT(recognize(normal, ""));
+  TEST_ASSERT(recognize(normal, "ab"));
+  TEST_ASSERT(recognize(normal, "aaabbb"));
+  TEST_ASSERT(!recognize(normal, "a"));
+  TEST_ASSERT(!recognize(normal, "abab"));
+  TEST_ASSERT(!recognize(normal, "aabbb"));
+
+  cnf_delete(normal, true);
+  cfg_delete(gram, false);
+  return 0;
+}
+
+static int test_units_and_long_rules(void)
+{
+  smb_status status = SMB_SUCCESS;
+  cfg *gram = cfg_create();
+  cnf *normal = cnf_create();
+
+  // E -> E + T | T,  T -> T * F | F,  F -> ( E ) | x
+  add(gram, 'E', "E+T");
+  add(gram, 'E', "T");
+  add(gram, 'T', "T*F");
+  add(gram, 'T', "F");
+  add(gram, 'F', "(E)");
+  add(gram, 'F', "x");
+  gram->start = 0;
+  cfg_to_cnf(gram, normal, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  TEST_ASSERT(!normal->accepts_empty);
+  TEST_ASSERT(recognize(normal, "x"));
+  TEST_ASSERT(recognize(normal, "x+x*x"));
+  TEST_ASSERT(recognize(normal, "(x+x)*x"));
+  TEST_ASSERT(recognize(normal, "((x))"));
+  TEST_ASSERT(!recognize(normal, "x+"));
+  TEST_ASSERT(!recognize(normal, "(x"));
+  TEST_ASSERT(!recognize(normal, "xx"));
+
+  cnf_delete(normal, true);
+  cfg_delete(gram, false);
+  return 0;
+}
+
+static int test_optimize(void)
+{
+  smb_status status = SMB_SUCCESS;
+  cfg *gram = cfg_create();
+  cnf *normal = cnf_create();
+  cnf_report report;
+  int i;
+
+  // C and D are the same, and so are the symbols binarization adds for the
+  // tails "BC" and "BD".  U is unreachable and N derives no string.
+  add(gram, 'S', "ABC");
+  add(gram, 'S', "ABD");
+  add(gram, 'S', "Nx");
+  add(gram, 'A', "a");
+  add(gram, 'B', "b");
+  add(gram, 'C', "c");
+  add(gram, 'D', "c");
+  add(gram, 'N', "Ny");
+  add(gram, 'U', "u");
+  gram->start = 0;
+  cfg_to_cnf_report(gram, normal, &report, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  TEST_ASSERT(report.source_nonterminals == 7);
+  TEST_ASSERT(report.source_rules == 9);
+  TEST_ASSERT(report.nonterminals < report.converted_nonterminals);
+  TEST_ASSERT(report.rules < report.converted_rules);
+  // S, A, B, one of C and D, and one tail.
+  TEST_ASSERT(report.nonterminals == 5);
+  TEST_ASSERT(report.rules == 5);
+  TEST_ASSERT(al_length(&normal->rules_one) + al_length(&normal->rules_two) ==
+              report.rules);
+  TEST_ASSERT(al_length(&normal->nonterminals) == report.nonterminals);
+  for (i = 0; i < al_length(&normal->nonterminals); i++) {
+    char *name = al_get(&normal->nonterminals, i, &status).data_ptr;
+    TEST_ASSERT(strcmp(name, "U") != 0 && strcmp(name, "N") != 0);
+  }
+
+  TEST_ASSERT(recognize(normal, "abc"));
+  TEST_ASSERT(!recognize(normal, "ab"));
+  TEST_ASSERT(!recognize(normal, "abcc"));
+  TEST_ASSERT(!recognize(normal, "u"));
+
+  cnf_delete(normal, true);
+  cfg_delete(gram, false);
+  return 0;
+}
+
+static int test_index(void)
+{
+  cnf *gram = cnf_create();
+  int s = cnf_add_symbol(gram, "S", false);
+  int a = cnf_add_symbol(gram, "A", false);
+  int b = cnf_add_symbol(gram, "B", false);
+  int x = cnf_add_symbol(gram, "x", true);
+  int y = cnf_add_symbol(gram, "y", true);
+
+  cnf_add_rule(gram, cnf_rule_create(s, b, a));
+  cnf_add_rule(gram, cnf_rule_create(s, a, b));
+  cnf_add_rule(gram, cnf_rule_create(a, a, a));
+  cnf_add_rule(gram, cnf_rule_create(a, x, CFG_SYMBOL_NONE));
+  cnf_add_rule(gram, cnf_rule_create(b, x, CFG_SYMBOL_NONE));
+  cnf_build_index(gram);
+
+  TEST_ASSERT(al_length(&gram->rules_one) == 2);
+  TEST_ASSERT(al_length(&gram->rules_two) == 3);
+  TEST_ASSERT(gram->one_first[x + 1] - gram->one_first[x] == 2);
+  TEST_ASSERT(gram->one_first[y + 1] == gram->one_first[y]);
+  // Rules starting with A are sorted by their second symbol.
+  TEST_ASSERT(gram->two_first[a + 1] - gram->two_first[a] == 2);
+  TEST_ASSERT(gram->two_right[gram->two_first[a]] == a);
+  TEST_ASSERT(gram->two_lhs[gram->two_first[a]] == a);
+  TEST_ASSERT(gram->two_right[gram->two_first[a] + 1] == b);
+  TEST_ASSERT(gram->two_lhs[gram->two_first[a] + 1] == s);
+  TEST_ASSERT(gram->two_first[s + 1] == gram->two_first[s]);
+
+  // Adding a rule discards the index.
+  cnf_add_rule(gram, cnf_rule_create(b, y, CFG_SYMBOL_NONE));
+  TEST_ASSERT(gram->one_first == NULL);
+
+  cnf_delete(gram, false);
+  return 0;
+}
+
+static int test_save_load(void)
+{
+  smb_status status = SMB_SUCCESS;
+  const char *filename = "cnftest.cnfc";
+  const char *sentences[] = {"x", "x+x*x", "(x+x)*x", "x+", "(x", "xx"};
+  cfg *gram = cfg_create();
+  cnf *normal = cnf_create(), *loaded = cnf_create_arena();
+  cnf_report report, stored;
+  char *name;
+  int i;
+
+  add(gram, 'E', "E+T");
+  add(gram, 'E', "T");
+  add(gram, 'T', "T*F");
+  add(gram, 'T', "F");
+  add(gram, 'F', "(E)");
+  add(gram, 'F', "x");
+  gram->start = 0;
+  cfg_to_cnf_report(gram, normal, &report, &status);
+  cnf_save(normal, filename, 42, &report, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  cnf_load_compiled(loaded, filename, 42, &stored, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+
+  TEST_ASSERT(memcmp(&report, &stored, sizeof(report)) == 0);
+  TEST_ASSERT(loaded->start == normal->start);
+  TEST_ASSERT(loaded->accepts_empty == normal->accepts_empty);
+  TEST_ASSERT(cnf_num_rules(loaded, false) == cnf_num_rules(normal, false));
+  TEST_ASSERT(cnf_num_rules(loaded, true) == cnf_num_rules(normal, true));
+  TEST_ASSERT(al_length(&loaded->nonterminals) ==
+              al_length(&normal->nonterminals));
+  for (i = 0; i < al_length(&normal->nonterminals); i++) {
+    name = al_get(&normal->nonterminals, i, &status).data_ptr;
+    TEST_ASSERT(strcmp(name, al_get(&loaded->nonterminals, i,
+                                    &status).data_ptr) == 0);
+    // The names are indexed too.
+    TEST_ASSERT(cnf_add_symbol(loaded, name, false) == i);
+  }
+  for (i = 0; i < 6; i++) {
+    TEST_ASSERT(recognize(loaded, sentences[i]) ==
+                recognize(normal, sentences[i]));
+  }
+  cnf_delete(loaded, true);
+
+  // A file made from some other grammar is rejected.
+  loaded = cnf_create();
+  cnf_load_compiled(loaded, filename, 43, NULL, &status);
+  TEST_ASSERT(status == SMB_NOT_FOUND_ERROR);
+  TEST_ASSERT(loaded->image == NULL && al_length(&loaded->terminals) == 0);
+  cnf_delete(loaded, true);
+
+  status = SMB_SUCCESS;
+  remove(filename);
+  loaded = cnf_create();
+  cnf_load_compiled(loaded, filename, 42, NULL, &status);
+  TEST_ASSERT(status == SMB_NOT_FOUND_ERROR);
+  cnf_delete(loaded, true);
+
+  cnf_delete(normal, true);
+  cfg_delete(gram, false);
+  return 0;
+}
+
+void cnf_test(void)
+{
+  smb_ut_group *group = su_create_test_group("cnf");
+
+  smb_ut_test *balanced = su_create_test("balanced", test_balanced);
+  su_add_test(group, balanced);
+
+  smb_ut_test *units_and_long_rules = su_create_test(
+      "units_and_long_rules", test_units_and_long_rules);
+  su_add_test(group, units_and_long_rules);
+
+  smb_ut_test *optimize = su_create_test("optimize", test_optimize);
+  su_add_test(group, optimize);
+
+  smb_ut_test *index = su_create_test("index", test_index);
+  su_add_test(group, index);
+
+  smb_ut_test *save_load = su_create_test("save_load", test_save_load);
+  su_add_test(group, save_load);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
@@ -0,0 +1,101 @@
+/***************************************************************************//**
+
+  @file         codegentest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the scanner generator.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libstephen/ut.h"
+#include "codegen.h"
+#include "lex.h"
+
+/*
+  Read everything written to a temporary file into a new string.
+ */
+static char *contents(FILE *f)
+{
+  long size = ftell(f);
+  char *text = smb_new(char, size + 1);
+  rewind(f);
+  text[fread(text, 1, size, f)] = '\0';
+  return text;
+}
+
+static int test_header_names(void)
+{
+  smb_status status = SMB_SUCCESS;
+  wchar_t *config =
+    L"a-b\ta-b\n"
+    L"a_b\ta_b\n"
+    L"x\tno token\n"
+    L"\\s+\tspace\tskip\n";
+  smb_lex *lex = lex_create();
+  FILE *f = tmpfile();
+  char *text;
+
+  lex_load(lex, config, &status);
+  lex_generate_header(lex, f, "expr");
+  text = contents(f);
+  TEST_ASSERT(strstr(text, "  EXPR_A_B = 0,\n") != NULL);
+  TEST_ASSERT(strstr(text, "  EXPR_A_B_1 = 1,\n") != NULL);
+  TEST_ASSERT(strstr(text, "  EXPR_NO_TOKEN_2 = 2,\n") != NULL);
+  TEST_ASSERT(strstr(text, "  EXPR_NUM_TOKENS = 4\n") != NULL);
+  TEST_ASSERT(strstr(text, "int expr_next(") != NULL);
+
+  smb_free(text);
+  fclose(f);
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_source_tables(void)
+{
+  smb_status status = SMB_SUCCESS;
+  wchar_t *config =
+    L"\\d+\tinteger\n"
+    L"\\s+\twhitespace\tskip\n"
+    L"\u00e9\t\u00e9t\u00e9\n";
+  smb_lex *lex = lex_create();
+  FILE *f = tmpfile();
+  char *text;
+
+  lex_load(lex, config, &status);
+  lex_generate_source(lex, f, "num", "num.h");
+  text = contents(f);
+  TEST_ASSERT(strstr(text, "#include \"num.h\"\n") != NULL);
+  TEST_ASSERT(strstr(text, "  \"\\303\\251t\\303\\251\",\n") != NULL);
+  TEST_ASSERT(strstr(text, "num_skip[] = {\n  0, 1, 0, 0,\n};") != NULL);
+  TEST_ASSERT(strstr(text, "static const signed char num_trans[") != NULL);
+
+  smb_free(text);
+  fclose(f);
+  lex_delete(lex);
+  return 0;
+}
+
+void codegen_test(void)
+{
+  smb_ut_group *group = su_create_test_group("codegen");
+
+  smb_ut_test *header_names = su_create_test("header_names",
+                                             test_header_names);
+  su_add_test(group, header_names);
+
+  smb_ut_test *source_tables = su_create_test("source_tables",
+                                              test_source_tables);
+  su_add_test(group, source_tables);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
@@ -0,0 +1,320 @@
+/***************************************************************************//**
+
+  @file         dfatest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for compiled DFAs.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <string.h>
+#include <wchar.h>
+
+#include "libstephen/ut.h"
+#include "libstephen/regex.h"
+#include "dfa.h"
+
+static dfa *compile_utf8(wchar_t *regex)
+{
+  fsm *f = regex_parse(regex);
+  dfa *chars = dfa_create(&f, 1);
+  dfa *bytes = dfa_create_utf8(chars);
+  dfa_delete(chars);
+  fsm_delete(f, true);
+  return bytes;
+}
+
+/*
+  Run a byte DFA over a whole string, returning its final accept tag.
+ */
+static int run_bytes(const dfa *d, const char *s, size_t n)
+{
+  int state = d->start;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    state = dfa_step_byte(d, state, (unsigned char) s[i]);
+  }
+  return state == DFA_DEAD ? DFA_NO_PATTERN : d->accept[state];
+}
+
+static int test_union_priority(void)
+{
+  fsm *f[2];
+  dfa *d;
+  int state;
+  f[0] = regex_parse(L"if");
+  f[1] = regex_parse(L"[a-z]+");
+  d = dfa_create(f, 2);
+
+  state = dfa_step(d, d->start, L'i');
+  TEST_ASSERT(d->accept[state] == 1);
+  state = dfa_step(d, state, L'f');
+  TEST_ASSERT(d->accept[state] == 0);
+  state = dfa_step(d, state, L'f');
+  TEST_ASSERT(d->accept[state] == 1);
+  TEST_ASSERT(dfa_step(d, state, L'0') == DFA_DEAD);
+
+  dfa_delete(d);
+  fsm_delete(f[0], true);
+  fsm_delete(f[1], true);
+  return 0;
+}
+
+static int test_utf8_mid_char(void)
+{
+  dfa *d = compile_utf8(L"[α-ω]+");
+  const char *greek = "\xce\xb1\xce\xb2\xcf\x89";
+  int state = dfa_step_byte(d, d->start, 0xce);
+
+  TEST_ASSERT(state != DFA_DEAD);
+  TEST_ASSERT(d->accept[state] == DFA_MID_CHAR);
+  TEST_ASSERT(run_bytes(d, greek, 6) == 0);
+  TEST_ASSERT(run_bytes(d, greek, 5) == DFA_MID_CHAR);
+  // U+0391 is capital alpha, outside the class.
+  TEST_ASSERT(run_bytes(d, "\xce\x91", 2) == DFA_NO_PATTERN);
+
+  dfa_delete(d);
+  return 0;
+}
+
+static int test_utf8_negated(void)
+{
+  fsm *f = regex_parse(L"[^x]");
+  dfa *chars = dfa_create(&f, 1);
+  dfa *bytes = dfa_create_utf8(chars);
+  unsigned char buf[4];
+  wchar_t c;
+  int n, expected, state;
+
+  // Compare the byte DFA with the character DFA across the code space.
+  for (c = 0; c <= 0x10FFFF; c += (c < 0x1000 ? 1 : 97)) {
+    if (c >= 0xD800 && c <= 0xDFFF) {
+      continue;
+    }
+    if (c < 0x80) {
+      buf[0] = c; n = 1;
+    } else if (c < 0x800) {
+      buf[0] = 0xC0 | (c >> 6); buf[1] = 0x80 | (c & 0x3F); n = 2;
+    } else if (c < 0x10000) {
+      buf[0] = 0xE0 | (c >> 12); buf[1] = 0x80 | ((c >> 6) & 0x3F);
+      buf[2] = 0x80 | (c & 0x3F); n = 3;
+    } else {
+      buf[0] = 0xF0 | (c >> 18); buf[1] = 0x80 | ((c >> 12) & 0x3F);
+      buf[2] = 0x80 | ((c >> 6) & 0x3F); buf[3] = 0x80 | (c & 0x3F); n = 4;
+    }
+    state = dfa_step(chars, chars->start, c);
+    expected = state == DFA_DEAD ? DFA_NO_PATTERN : chars->accept[state];
+    TEST_ASSERT(run_bytes(bytes, (char *) buf, n) == expected);
+  }
+
+  // A lone continuation byte is not a character.
+  TEST_ASSERT(dfa_step_byte(bytes, bytes->start, 0x80) == DFA_DEAD);
+
+  dfa_delete(chars);
+  dfa_delete(bytes);
+  fsm_delete(f, true);
+  return 0;
+}
+
+static int test_search_utf8(void)
+{
+  smb_status status = SMB_SUCCESS;
+  dfa *d = compile_utf8(L"ab+");
+  const char *text = "\xc3\xa9xabbyab";
+  smb_al *hits = dfa_search_utf8(d, text, strlen(text), true, false);
+  regex_hit *hit;
+
+  TEST_ASSERT(al_length(hits) == 2);
+  hit = al_get(hits, 0, &status).data_ptr;
+  TEST_ASSERT(hit->start == 3 && hit->length == 3);
+  regex_hit_delete(hit);
+  hit = al_get(hits, 1, &status).data_ptr;
+  TEST_ASSERT(hit->start == 7 && hit->length == 2);
+  regex_hit_delete(hit);
+  al_delete(hits);
+
+  // Non-greedy search stops at the first accepting state.
+  hits = dfa_search_utf8(d, text, strlen(text), false, false);
+  TEST_ASSERT(al_length(hits) == 2);
+  hit = al_get(hits, 0, &status).data_ptr;
+  TEST_ASSERT(hit->start == 3 && hit->length == 2);
+  regex_hit_delete(hit);
+  regex_hit_delete(al_get(hits, 1, &status).data_ptr);
+  al_delete(hits);
+
+  dfa_delete(d);
+  return 0;
+}
+
+/*
+  Return true if a prefilter has the given literal.
+ */
+static bool has_literal(const dfa_prefilter *f, const char *literal)
+{
+  return f->literal_length == (int) strlen(literal) &&
+    memcmp(f->literal, literal, f->literal_length) == 0;
+}
+
+/*
+  Return true if filtered search finds the same hits as trying every start.
+ */
+static bool same_hits(const dfa *d, const dfa_prefilter *f, const char *text,
+                      bool greedy, bool overlap)
+{
+  smb_status status = SMB_SUCCESS;
+  dfa_prefilter none;
+  smb_al *expect, *found;
+  regex_hit *a, *b;
+  bool same;
+  int i;
+
+  memset(&none, 0, sizeof(none));
+  memset(none.first, true, sizeof(none.first));
+  none.nfirst = 256;
+  expect = dfa_search_filtered(d, &none, text, strlen(text), greedy, overlap);
+  found = dfa_search_filtered(d, f, text, strlen(text), greedy, overlap);
+  same = al_length(expect) == al_length(found);
+  for (i = 0; i < al_length(expect); i++) {
+    a = al_get(expect, i, &status).data_ptr;
+    if (same) {
+      b = al_get(found, i, &status).data_ptr;
+      same = a->start == b->start && a->length == b->length;
+    }
+    regex_hit_delete(a);
+  }
+  for (i = 0; i < al_length(found); i++) {
+    regex_hit_delete(al_get(found, i, &status).data_ptr);
+  }
+  al_delete(expect);
+  al_delete(found);
+  return same;
+}
+
+static int test_prefilter(void)
+{
+  const char *text = "xyabc abd xyxabcd xabdy \xc3\xa9" "abcxaby xabcy ab";
+  wchar_t *patterns[] = {L"x(abc|abd)y", L"(xy)*abc", L"ab+", L"[0-9]+",
+                         L"a|b"};
+  const char *literals[] = {"xab", "abc", "ab", "", ""};
+  dfa_prefilter f;
+  dfa *d;
+  int i;
+
+  for (i = 0; i < 5; i++) {
+    d = compile_utf8(patterns[i]);
+    dfa_prefilter_init(&f, d);
+    TEST_ASSERT(has_literal(&f, literals[i]));
+    TEST_ASSERT(same_hits(d, &f, text, false, false));
+    TEST_ASSERT(same_hits(d, &f, text, true, true));
+    dfa_delete(d);
+  }
+
+  // Only the first and third begin every match with their literal.
+  d = compile_utf8(L"x(abc|abd)y");
+  dfa_prefilter_init(&f, d);
+  TEST_ASSERT(f.prefix && f.nfirst == 1 && f.first['x']);
+  TEST_ASSERT(dfa_prefilter_find(&f, text, strlen(text)) == text + 12);
+  TEST_ASSERT(dfa_prefilter_find(&f, text, 14) == NULL);
+  dfa_delete(d);
+  d = compile_utf8(L"(xy)*abc");
+  dfa_prefilter_init(&f, d);
+  TEST_ASSERT(!f.prefix && f.nfirst == 2 && f.first['x'] && f.first['a']);
+  dfa_delete(d);
+  d = compile_utf8(L"[0-9]+");
+  dfa_prefilter_init(&f, d);
+  TEST_ASSERT(f.nfirst == 10 && f.first['0'] && !f.first['a']);
+  dfa_delete(d);
+  return 0;
+}
+
+/*
+  Run a DFA over a whole wide string, returning its final accept tag.
+ */
+static int run_chars(const dfa *d, const wchar_t *s)
+{
+  int state = d->start;
+  for (; *s != L'\0'; s++) {
+    state = dfa_step(d, state, *s);
+  }
+  return state == DFA_DEAD ? DFA_NO_PATTERN : d->accept[state];
+}
+
+static int test_lazy(void)
+{
+  wchar_t *patterns[] = {L"a+b", L"(ab|cd)*e", L"[0-9]+(\\.[0-9]+)?"};
+  wchar_t *strings[] = {L"ab", L"aaab", L"b", L"ababcde", L"abcd", L"e",
+                        L"12.5", L"12.", L"7", L"\u00e9", L""};
+  size_t limits[] = {DFA_LAZY_LIMIT, 1};
+  fsm *f[3];
+  dfa *eager;
+  dfa_lazy lazy;
+  int i, l, s;
+
+  for (i = 0; i < 3; i++) {
+    f[i] = regex_parse(patterns[i]);
+  }
+  eager = dfa_create(f, 3);
+  // A tiny cache is flushed all the time, and still gives the same answers.
+  for (l = 0; l < 2; l++) {
+    dfa_lazy_init(&lazy, f, 3, limits[l]);
+    for (i = 0; i < 2; i++) {
+      for (s = 0; s < 11; s++) {
+        TEST_ASSERT(dfa_lazy_match(&lazy, strings[s]) ==
+                    run_chars(eager, strings[s]));
+      }
+    }
+    TEST_ASSERT(l == 0 ? lazy.flushes == 0 : lazy.flushes > 0);
+    TEST_ASSERT(l == 0 ? lazy.memory <= lazy.limit : lazy.table.nstates <= 2);
+    dfa_lazy_destroy(&lazy);
+  }
+  dfa_delete(eager);
+  for (i = 0; i < 3; i++) {
+    fsm_delete(f[i], true);
+  }
+
+  // The full DFA would have 2^12 states, but a string only visits a few.
+  f[0] = regex_parse(L"(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)"
+                     L"(a|b)(a|b)(a|b)");
+  dfa_lazy_init(&lazy, f, 1, DFA_LAZY_LIMIT);
+  TEST_ASSERT(dfa_lazy_match(&lazy, L"ababbbbbbbbbbb") == 0);
+  TEST_ASSERT(dfa_lazy_match(&lazy, L"babbbbbbbbbbbb") == DFA_NO_PATTERN);
+  TEST_ASSERT(lazy.table.nstates <= 30);
+  dfa_lazy_destroy(&lazy);
+  fsm_delete(f[0], true);
+  return 0;
+}
+
+void dfa_test(void)
+{
+  smb_ut_group *group = su_create_test_group("dfa");
+
+  smb_ut_test *union_priority = su_create_test("union_priority",
+                                               test_union_priority);
+  su_add_test(group, union_priority);
+
+  smb_ut_test *utf8_mid_char = su_create_test("utf8_mid_char",
+                                              test_utf8_mid_char);
+  su_add_test(group, utf8_mid_char);
+
+  smb_ut_test *utf8_negated = su_create_test("utf8_negated",
+                                             test_utf8_negated);
+  su_add_test(group, utf8_negated);
+
+  smb_ut_test *search_utf8 = su_create_test("search_utf8", test_search_utf8);
+  su_add_test(group, search_utf8);
+
+  smb_ut_test *prefilter = su_create_test("prefilter", test_prefilter);
+  su_add_test(group, prefilter);
+
+  smb_ut_test *lazy = su_create_test("lazy", test_lazy);
+  su_add_test(group, lazy);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
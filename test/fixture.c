@@ -0,0 +1,66 @@
+/***************************************************************************//**
+
+  @file         fixture.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        An expression lexer and grammar shared by several tests.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <stdbool.h>
+
+#include "cnf.h"
+#include "gram.h"
+#include "lex.h"
+#include "fixture.h"
+
+static const wchar_t *lexer =
+  L"[a-z]+\tid\n"
+  L"\\+\t+\n"
+  L"\\*\t*\n"
+  L"\\(\t(\n"
+  L"\\)\t)\n"
+  L"\\s+\tspace\tskip\n";
+
+static const char *grammar =
+  "E -> E + T | T\n"
+  "T -> T * F | F\n"
+  "F -> ( E ) | id\n";
+
+/**
+   @brief Load the lexer and the grammar of sums and products of identifiers.
+
+   Stops at the first step that fails, leaving anything not yet loaded
+   uninitialized, since the test fails there anyway.
+
+   @param lex The lexer to initialize and load
+   @param normal The grammar to initialize, in Chomsky normal form
+   @return True if every step succeeded.
+ */
+bool fixture_load(smb_lex *lex, cnf *normal)
+{
+  smb_status status = SMB_SUCCESS;
+  cfg gram;
+
+  lex_init(lex);
+  lex_load(lex, lexer, &status);
+  if (status != SMB_SUCCESS) {
+    return false;
+  }
+  cfg_init(&gram);
+  cfg_load(&gram, grammar, &status);
+  if (status != SMB_SUCCESS) {
+    cfg_destroy(&gram, true);
+    return false;
+  }
+  cnf_init(normal);
+  cfg_to_cnf(&gram, normal, &status);
+  cfg_destroy(&gram, true);
+  return status == SMB_SUCCESS;
+}
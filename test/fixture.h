@@ -0,0 +1,31 @@
+/***************************************************************************//**
+
+  @file         fixture.h
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        An expression lexer and grammar shared by several tests.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#ifndef SMB_FIXTURE_H
+#define SMB_FIXTURE_H
+
+#include <stdbool.h>
+
+#include "cnf.h"
+#include "lex.h"
+
+/**
+   @brief Lexer tokens, in the order the fixture's lexer lists them.
+ */
+enum { ID, PLUS, TIMES, OPEN, CLOSE };
+
+bool fixture_load(smb_lex *lex, cnf *normal);
+
+#endif//SMB_FIXTURE_H
@@ -0,0 +1,178 @@
+/***************************************************************************//**
+
+  @file         foresttest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for parse forests.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "libstephen/ut.h"
+#include "cky.h"
+#include "cnf.h"
+#include "forest.h"
+#include "gram.h"
+
+/*
+  Load a grammar from text, and compile it.
+ */
+static void load(const char *text, cnf *normal, cky_grammar *compiled)
+{
+  smb_status status = SMB_SUCCESS;
+  cfg gram;
+  cfg_init(&gram);
+  cfg_load(&gram, text, &status);
+  cnf_init(normal);
+  cfg_to_cnf(&gram, normal, &status);
+  cfg_destroy(&gram, true);
+  cky_grammar_init(compiled, normal);
+}
+
+/*
+  Check that the subtree at nodes[i] covers the span it claims, with children
+  splitting it in two.
+ */
+static bool check_tree(const cky_tree_node *nodes, int i)
+{
+  const cky_tree_node *node = &nodes[i], *left, *right;
+  if (node->left < 0 || node->right < 0) {
+    return node->left < 0 && node->right < 0 && node->length == 1;
+  }
+  left = &nodes[node->left];
+  right = &nodes[node->right];
+  return left->start == node->start &&
+    right->start == node->start + left->length &&
+    left->length + right->length == node->length &&
+    check_tree(nodes, node->left) && check_tree(nodes, node->right);
+}
+
+static int test_ambiguous(void)
+{
+  // S -> S S | a has Catalan(n - 1) trees over n tokens.
+  uint64_t catalan[] = {1, 1, 2, 5, 14, 42, 132, 429};
+  int tokens[40], shapes[429][15];
+  cky_tree_node nodes[79];
+  cky_grammar compiled;
+  cky_chart chart;
+  cky_forest forest;
+  cnf normal;
+  uint64_t index;
+  int n, i, t;
+
+  load("S -> S S | a\n", &normal, &compiled);
+  memset(tokens, 0, sizeof(tokens));
+  cky_chart_init(&chart, &compiled, 8);
+
+  for (n = 1; n <= 8; n++) {
+    cky_chart_fill(&chart, tokens, n);
+    cky_forest_init(&forest, &chart);
+    TEST_ASSERT(cky_forest_count(&forest) == catalan[n - 1]);
+    index = 0;
+    t = 0;
+    while (cky_forest_next(&forest, &index, nodes)) {
+      TEST_ASSERT(nodes[0].start == 0 && nodes[0].length == n);
+      TEST_ASSERT(check_tree(nodes, 0));
+      // The preorder span lengths identify the shape of a binary tree.
+      for (i = 0; i < 2 * n - 1; i++) {
+        shapes[t][i] = nodes[i].length;
+      }
+      for (i = 0; i < t; i++) {
+        TEST_ASSERT(memcmp(shapes[i], shapes[t],
+                           sizeof(int) * (2 * n - 1)) != 0);
+      }
+      t++;
+    }
+    TEST_ASSERT((uint64_t) t == catalan[n - 1]);
+    TEST_ASSERT(!cky_forest_tree(&forest, index, nodes));
+    cky_forest_destroy(&forest);
+  }
+
+  // Catalan(39) doesn't fit, but the trees can still be had.
+  cky_chart_fill(&chart, tokens, 40);
+  cky_forest_init(&forest, &chart);
+  TEST_ASSERT(cky_forest_count(&forest) == CKY_COUNT_MAX);
+  TEST_ASSERT(cky_forest_tree(&forest, 0, nodes) && check_tree(nodes, 0));
+  TEST_ASSERT(cky_forest_tree(&forest, CKY_COUNT_MAX - 1, nodes) &&
+              check_tree(nodes, 0));
+  cky_forest_destroy(&forest);
+
+  cky_chart_destroy(&chart);
+  cky_grammar_destroy(&compiled);
+  cnf_destroy(&normal, true);
+  return 0;
+}
+
+static int test_unambiguous(void)
+{
+  cky_tree_node nodes[9];
+  cky_grammar compiled;
+  cky_chart chart;
+  cky_forest forest;
+  cnf normal;
+  int x, add, i;
+
+  load("E -> E + x | x |\n", &normal, &compiled);
+  x = cnf_add_symbol(&normal, "x", true);
+  add = cnf_add_symbol(&normal, "+", true);
+  {
+    int good[] = {x, add, x, add, x};
+    int bad[] = {x, add};
+
+    cky_chart_init(&chart, &compiled, 5);
+    cky_chart_fill(&chart, good, 5);
+    cky_forest_init(&forest, &chart);
+    TEST_ASSERT(cky_forest_count(&forest) == 1);
+    TEST_ASSERT(cky_forest_tree(&forest, 0, nodes));
+    TEST_ASSERT(check_tree(nodes, 0));
+    // Left recursion: the root splits off the last "+ x".
+    TEST_ASSERT(nodes[nodes[0].left].length == 3);
+    for (i = 0; i < 9; i++) {
+      TEST_ASSERT(nodes[i].symbol >= 0 &&
+                  nodes[i].symbol < al_length(&normal.nonterminals));
+    }
+    TEST_ASSERT(!cky_forest_tree(&forest, 1, nodes));
+    cky_forest_destroy(&forest);
+
+    cky_chart_fill(&chart, bad, 2);
+    cky_forest_init(&forest, &chart);
+    TEST_ASSERT(cky_forest_count(&forest) == 0);
+    TEST_ASSERT(forest.nnodes == 0);
+    TEST_ASSERT(!cky_forest_tree(&forest, 0, nodes));
+    cky_forest_destroy(&forest);
+
+    // The empty sentence has one tree, with no nodes.
+    cky_chart_fill(&chart, bad, 0);
+    cky_forest_init(&forest, &chart);
+    TEST_ASSERT(cky_forest_count(&forest) == 1);
+    TEST_ASSERT(cky_forest_tree(&forest, 0, nodes));
+    cky_forest_destroy(&forest);
+    cky_chart_destroy(&chart);
+  }
+
+  cky_grammar_destroy(&compiled);
+  cnf_destroy(&normal, true);
+  return 0;
+}
+
+void forest_test(void)
+{
+  smb_ut_group *group = su_create_test_group("forest");
+
+  smb_ut_test *ambiguous = su_create_test("ambiguous", test_ambiguous);
+  su_add_test(group, ambiguous);
+
+  smb_ut_test *unambiguous = su_create_test("unambiguous", test_unambiguous);
+  su_add_test(group, unambiguous);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
@@ -0,0 +1,211 @@
+/***************************************************************************//**
+
+  @file         gramtest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for grammar data structures.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libstephen/ut.h"
+#include "gram.h"
+
+static int test_cfg_symbols(void)
+{
+  smb_status status = SMB_SUCCESS;
+  cfg *gram = cfg_create();
+  char copy[] = "start";
+  TEST_ASSERT(cfg_add_symbol(gram, "start", false) == 0);
+  TEST_ASSERT(cfg_add_symbol(gram, "+", true) == 1);
+  // Symbols are found by their contents, not their address.
+  TEST_ASSERT(cfg_add_symbol(gram, copy, false) == 0);
+  TEST_ASSERT(cfg_add_symbol(gram, "+", false) == 1);
+  TEST_ASSERT(al_length(&gram->symbols) == 2);
+  TEST_ASSERT(al_length(&gram->terminals) == 1);
+  TEST_ASSERT(al_get(&gram->terminals, 0, &status).data_llint == 1);
+  cfg_delete(gram, false);
+  return 0;
+}
+
+static int test_cfg_many_symbols(void)
+{
+  smb_status status = SMB_SUCCESS;
+  cfg *gram = cfg_create();
+  char buf[16];
+  char *symbol;
+  int i, n = 20000;
+
+  for (i = 0; i < n; i++) {
+    sprintf(buf, "S%d", i);
+    symbol = smb_new(char, strlen(buf) + 1);
+    strcpy(symbol, buf);
+    TEST_ASSERT(cfg_add_symbol(gram, symbol, i % 2 == 0) == i);
+  }
+  for (i = 0; i < n; i++) {
+    sprintf(buf, "S%d", i);
+    TEST_ASSERT(cfg_add_symbol(gram, buf, false) == i);
+    TEST_ASSERT(strcmp(al_get(&gram->symbols, i, &status).data_ptr, buf) == 0);
+  }
+  TEST_ASSERT(al_length(&gram->symbols) == n);
+  TEST_ASSERT(al_length(&gram->terminals) == n / 2);
+  cfg_delete(gram, true);
+  return 0;
+}
+
+static int test_cnf_symbols(void)
+{
+  cnf *gram = cnf_create();
+  TEST_ASSERT(cnf_add_symbol(gram, "S", false) == 0);
+  TEST_ASSERT(cnf_add_symbol(gram, "A", false) == 1);
+  // Terminals are numbered separately from nonterminals.
+  TEST_ASSERT(cnf_add_symbol(gram, "a", true) == 0);
+  TEST_ASSERT(cnf_add_symbol(gram, "A", true) == 1);
+  TEST_ASSERT(cnf_add_symbol(gram, "A", false) == 1);
+  TEST_ASSERT(cnf_add_symbol(gram, "a", true) == 0);
+  TEST_ASSERT(al_length(&gram->terminals) == 2);
+  TEST_ASSERT(al_length(&gram->nonterminals) == 2);
+  cnf_delete(gram, false);
+  return 0;
+}
+
+static int test_cfg_load(void)
+{
+  smb_status status = SMB_SUCCESS;
+  char *text =
+    "# a comment\n"
+    "S -> A b | \n"
+    "\n"
+    "A -> a A\tb c\n"
+    "A -> S\n";
+  cfg gram;
+  cfg_rule *rule;
+
+  cfg_init(&gram);
+  cfg_load(&gram, text, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  TEST_ASSERT(gram.start == 0);
+  TEST_ASSERT(al_length(&gram.rules) == 4);
+  // S A b a c: b, a and c are terminals.
+  TEST_ASSERT(al_length(&gram.symbols) == 5);
+  TEST_ASSERT(al_length(&gram.terminals) == 3);
+  TEST_ASSERT(strcmp(al_get(&gram.symbols, 2, &status).data_ptr, "b") == 0);
+  TEST_ASSERT(al_get(&gram.terminals, 0, &status).data_llint == 2);
+  rule = al_get(&gram.rules, 1, &status).data_ptr;
+  TEST_ASSERT(rule->lhs == 0 && rule->rhs_len == 0);
+  rule = al_get(&gram.rules, 2, &status).data_ptr;
+  TEST_ASSERT(rule->lhs == 1 && rule->rhs_len == 4);
+  TEST_ASSERT(rule->rhs[3] == 4);
+  cfg_destroy(&gram, true);
+
+  cfg_init(&gram);
+  cfg_load(&gram, "S -> a S [0.25] | [1]\n", &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  TEST_ASSERT(al_length(&gram.symbols) == 2);
+  rule = al_get(&gram.rules, 0, &status).data_ptr;
+  TEST_ASSERT(rule->rhs_len == 2 && rule->weight == log(0.25));
+  rule = al_get(&gram.rules, 1, &status).data_ptr;
+  TEST_ASSERT(rule->rhs_len == 0 && rule->weight == 0);
+  cfg_destroy(&gram, true);
+
+  cfg_init(&gram);
+  cfg_load(&gram, "S -> a [2]\n", &status);
+  TEST_ASSERT(status == SMB_INDEX_ERROR);
+  cfg_destroy(&gram, true);
+
+  status = SMB_SUCCESS;
+  cfg_init(&gram);
+  cfg_load(&gram, "S -> a\nS a\n", &status);
+  TEST_ASSERT(status == SMB_INDEX_ERROR);
+  cfg_destroy(&gram, true);
+  return 0;
+}
+
+static int test_arena(void)
+{
+  smb_status status = SMB_SUCCESS;
+  char text[4096], *pos = text;
+  cfg heap, arena;
+  cnf *normal = cnf_create_arena();
+  cfg_rule *expected, *actual;
+  cnf_rule *rule;
+  int i, j;
+
+  // Enough rules, of varying lengths, for the arena to grow several times.
+  for (i = 0; i < 100; i++) {
+    pos += sprintf(pos, "S%d ->", i % 7);
+    for (j = 0; j < i % 5; j++) {
+      pos += sprintf(pos, " S%d x%d", (i + j) % 7, j);
+    }
+    pos += sprintf(pos, "\n");
+  }
+  cfg_init(&heap);
+  cfg_load(&heap, text, &status);
+  cfg_init_arena(&arena);
+  cfg_load(&arena, text, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  TEST_ASSERT(arena.arena && al_length(&arena.rules) == 0);
+  TEST_ASSERT(cfg_num_rules(&arena) == 100);
+  TEST_ASSERT(cfg_num_rules(&heap) == 100);
+  for (i = 0; i < 100; i++) {
+    expected = cfg_get_rule(&heap, i);
+    actual = cfg_get_rule(&arena, i);
+    TEST_ASSERT(actual->lhs == expected->lhs);
+    TEST_ASSERT(actual->rhs_len == expected->rhs_len);
+    for (j = 0; j < actual->rhs_len; j++) {
+      TEST_ASSERT(actual->rhs[j] == expected->rhs[j]);
+    }
+  }
+  // Rules built elsewhere are copied in.
+  expected = cfg_rule_create(0, 2);
+  expected->rhs[0] = expected->rhs[1] = 1;
+  cfg_add_rule(&arena, expected);
+  actual = cfg_get_rule(&arena, 100);
+  TEST_ASSERT(actual->rhs_len == 2 && actual->rhs[1] == 1);
+  cfg_destroy(&heap, true);
+  cfg_destroy(&arena, true);
+
+  for (i = 0; i < 50; i++) {
+    cnf_new_rule(normal, i % 3, i % 4, i % 2 ? CFG_SYMBOL_NONE : i % 5);
+  }
+  cnf_add_rule(normal, cnf_rule_create(1, 2, 3));
+  TEST_ASSERT(cnf_num_rules(normal, false) == 25);
+  TEST_ASSERT(cnf_num_rules(normal, true) == 26);
+  rule = cnf_get_rule(normal, true, 25);
+  TEST_ASSERT(rule->lhs == 1 && rule->rhs_one == 2 && rule->rhs_two == 3);
+  cnf_delete(normal, false);
+  return 0;
+}
+
+void gram_test(void)
+{
+  smb_ut_group *group = su_create_test_group("gram");
+
+  smb_ut_test *cfg_symbols = su_create_test("cfg_symbols", test_cfg_symbols);
+  su_add_test(group, cfg_symbols);
+
+  smb_ut_test *cfg_many_symbols = su_create_test("cfg_many_symbols",
+                                                 test_cfg_many_symbols);
+  su_add_test(group, cfg_many_symbols);
+
+  smb_ut_test *cnf_symbols = su_create_test("cnf_symbols", test_cnf_symbols);
+  su_add_test(group, cnf_symbols);
+
+  smb_ut_test *cfg_load = su_create_test("cfg_load", test_cfg_load);
+  su_add_test(group, cfg_load);
+
+  smb_ut_test *arena = su_create_test("arena", test_arena);
+  su_add_test(group, arena);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
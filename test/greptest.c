@@ -0,0 +1,278 @@
+/***************************************************************************//**
+
+  @file         greptest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the parallel file search.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libstephen/ut.h"
+#include "libstephen/cb.h"
+#include "dfa.h"
+#include "pgrep.h"
+
+/*
+  Write a file under a directory, returning its path, which the caller frees.
+ */
+static char *put(const char *dir, const char *name, const char *text)
+{
+  char *path = smb_new(char, strlen(dir) + strlen(name) + 2);
+  FILE *f;
+  sprintf(path, "%s/%s", dir, name);
+  f = fopen(path, "w");
+  fputs(text, f);
+  fclose(f);
+  return path;
+}
+
+/*
+  Return the text written to a temporary file, which the caller frees.
+ */
+static char *contents(FILE *out)
+{
+  long size = ftell(out);
+  char *text = smb_new(char, size + 1);
+  rewind(out);
+  text[fread(text, 1, size, out)] = '\0';
+  return text;
+}
+
+/*
+  Search paths and return the output.  The options are the letters of the
+  grep program's flags: n, c, l and H.
+ */
+static char *run(const char *pattern, char **paths, int npaths, int nthreads,
+                 size_t chunk_size, const char *options)
+{
+  dfa_prefilter filter;
+  dfa *compiled = grep_compile(pattern, &filter);
+  FILE *out = tmpfile();
+  grep_search search;
+  char *text;
+  int i;
+
+  grep_init(&search, compiled, &filter, nthreads, out);
+  search.chunk_size = chunk_size;
+  search.line_numbers = strchr(options, 'n') != NULL;
+  search.count = strchr(options, 'c') != NULL;
+  search.names_only = strchr(options, 'l') != NULL;
+  search.names = strchr(options, 'H') != NULL;
+  for (i = 0; i < npaths; i++) {
+    grep_path(&search, paths[i]);
+  }
+  grep_finish(&search);
+  text = contents(out);
+  grep_destroy(&search);
+  dfa_delete(compiled);
+  fclose(out);
+  return text;
+}
+
+static int test_chunks(void)
+{
+  char dir[] = "/tmp/greptestXXXXXX";
+  cbuf text, expect;
+  char line[32], *path, *found;
+  int i, t, threads[] = {1, 4}, matches = 1;
+  size_t sizes[] = {1, 100, GREP_CHUNK_SIZE}, s;
+
+  TEST_ASSERT(mkdtemp(dir) != NULL);
+  cb_init(&text, 1024);
+  cb_init(&expect, 1024);
+  for (i = 0; i < 3000; i++) {
+    sprintf(line, "line %d", i * 7);
+    cb_concat(&text, line);
+    cb_append(&text, '\n');
+    // The serial answer, found the slow way.
+    if (strstr(line, "77") != NULL) {
+      sprintf(line, "%d:line %d\n", i + 1, i * 7);
+      cb_concat(&expect, line);
+      matches++;
+    }
+  }
+  // The last line has no newline.
+  cb_concat(&text, "last 77");
+  cb_concat(&expect, "3001:last 77\n");
+  path = put(dir, "a", text.buf);
+
+  // Chunks of every size give the same lines, in the same order.
+  for (t = 0; t < 2; t++) {
+    for (s = 0; s < 3; s++) {
+      found = run("77", &path, 1, threads[t], sizes[s], "n");
+      TEST_ASSERT(strcmp(found, expect.buf) == 0);
+      smb_free(found);
+    }
+  }
+  found = run("77", &path, 1, 4, 100, "c");
+  sprintf(line, "%d\n", matches);
+  TEST_ASSERT(strcmp(found, line) == 0);
+  smb_free(found);
+
+  unlink(path);
+  rmdir(dir);
+  smb_free(path);
+  cb_destroy(&text);
+  cb_destroy(&expect);
+  return 0;
+}
+
+static int test_tree(void)
+{
+  char dir[] = "/tmp/greptestXXXXXX";
+  char *sub, *files[4], *found, *expect, *paths[] = {dir};
+  int i;
+
+  TEST_ASSERT(mkdtemp(dir) != NULL);
+  files[0] = put(dir, "b", "cat\ndog\ncow\n");
+  files[1] = put(dir, "a", "");
+  sub = smb_new(char, strlen(dir) + 3);
+  sprintf(sub, "%s/c", dir);
+  mkdir(sub, 0700);
+  files[2] = put(sub, "d", "ocelot\nemu\n");
+  files[3] = put(sub, "e", "c");
+
+  // Files come in sorted order, directories included.
+  expect = smb_new(char, 4 * strlen(dir) + 64);
+  found = run("c[ao]", paths, 1, 2, 4, "H");
+  sprintf(expect, "%s/b:cat\n%s/b:cow\n", dir, dir);
+  TEST_ASSERT(strcmp(found, expect) == 0);
+  smb_free(found);
+
+  found = run("c", paths, 1, 3, 4, "cH");
+  sprintf(expect, "%s/a:0\n%s/b:2\n%s/c/d:1\n%s/c/e:1\n", dir, dir, dir,
+          dir);
+  TEST_ASSERT(strcmp(found, expect) == 0);
+  smb_free(found);
+
+  found = run("o", paths, 1, 3, 4, "l");
+  sprintf(expect, "%s/b\n%s/c/d\n", dir, dir);
+  TEST_ASSERT(strcmp(found, expect) == 0);
+  smb_free(found);
+  smb_free(expect);
+
+  for (i = 0; i < 4; i++) {
+    unlink(files[i]);
+    smb_free(files[i]);
+  }
+  rmdir(sub);
+  rmdir(dir);
+  smb_free(sub);
+  return 0;
+}
+
+/*
+  Match each line of a stream as a whole, and return the output.  The options
+  are as for run(), with f to print a flag for every line.
+ */
+static char *run_stream(const char *pattern, const char *input, int nthreads,
+                        size_t chunk_size, const char *options)
+{
+  dfa_prefilter filter;
+  dfa *compiled = grep_compile_line(pattern, &filter);
+  FILE *in = tmpfile(), *out = tmpfile();
+  grep_search search;
+  char *text;
+
+  fputs(input, in);
+  rewind(in);
+  grep_init(&search, compiled, &filter, nthreads, out);
+  search.chunk_size = chunk_size;
+  search.whole_lines = true;
+  search.line_numbers = strchr(options, 'n') != NULL;
+  search.flags = strchr(options, 'f') != NULL;
+  search.count = strchr(options, 'c') != NULL;
+  grep_stream(&search, in, "-");
+  grep_finish(&search);
+  text = contents(out);
+  grep_destroy(&search);
+  dfa_delete(compiled);
+  fclose(in);
+  fclose(out);
+  return text;
+}
+
+static int test_stream(void)
+{
+  cbuf text, flags, lines;
+  char line[32], *found;
+  int i, t, threads[] = {1, 4};
+  size_t sizes[] = {1, 10, GREP_CHUNK_SIZE}, s;
+
+  cb_init(&text, 1024);
+  cb_init(&flags, 1024);
+  cb_init(&lines, 1024);
+  for (i = 0; i < 2000; i++) {
+    // Only the identifiers match, and never just part of a line.
+    sprintf(line, i % 3 == 0 ? "x%d" : i % 3 == 1 ? "%d" : "x%d-", i);
+    cb_concat(&text, line);
+    cb_append(&text, '\n');
+    cb_concat(&flags, i % 3 == 0 ? "accept\n" : "reject\n");
+    if (i % 3 == 0) {
+      cb_concat(&lines, line);
+      cb_append(&lines, '\n');
+    }
+  }
+  // The last line has no newline, and the one before it is long.
+  for (i = 0; i < 100; i++) {
+    cb_concat(&text, "y1");
+    cb_concat(&lines, "y1");
+  }
+  cb_concat(&text, "\nz");
+  cb_concat(&flags, "accept\naccept\n");
+  cb_concat(&lines, "\nz\n");
+
+  for (t = 0; t < 2; t++) {
+    for (s = 0; s < 3; s++) {
+      found = run_stream("[a-z_]\\w*", text.buf, threads[t], sizes[s], "f");
+      TEST_ASSERT(strcmp(found, flags.buf) == 0);
+      smb_free(found);
+      found = run_stream("[a-z_]\\w*", text.buf, threads[t], sizes[s], "");
+      TEST_ASSERT(strcmp(found, lines.buf) == 0);
+      smb_free(found);
+    }
+  }
+  found = run_stream("\\d+", "12\n1a\n\n3", 2, 1, "nf");
+  TEST_ASSERT(strcmp(found, "1:accept\n2:reject\n3:reject\n4:accept\n") == 0);
+  smb_free(found);
+  found = run_stream("a*", "", 2, 4, "c");
+  TEST_ASSERT(strcmp(found, "0\n") == 0);
+  smb_free(found);
+
+  cb_destroy(&text);
+  cb_destroy(&flags);
+  cb_destroy(&lines);
+  return 0;
+}
+
+void grep_test(void)
+{
+  smb_ut_group *group = su_create_test_group("grep");
+
+  smb_ut_test *chunks = su_create_test("chunks", test_chunks);
+  su_add_test(group, chunks);
+
+  smb_ut_test *tree = su_create_test("tree", test_tree);
+  su_add_test(group, tree);
+
+  smb_ut_test *stream = su_create_test("stream", test_stream);
+  su_add_test(group, stream);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
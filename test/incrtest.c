@@ -0,0 +1,170 @@
+/***************************************************************************//**
+
+  @file         incrtest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for incremental lexing and parsing.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "libstephen/ut.h"
+#include "cky.h"
+#include "cnf.h"
+#include "fixture.h"
+#include "incr.h"
+#include "lex.h"
+
+/*
+  Check an edited text against lexing and parsing it from scratch.
+ */
+static bool check(cky_incr *obj)
+{
+  const cky_chart *chart = cky_incr_chart(obj);
+  const cky_word *cell, *expect;
+  size_t nwords = obj->gram.nwords, i;
+  lex_tokens all;
+  cky_chart fresh;
+  bool ok = true;
+  int len, start;
+
+  lex_tokens_init(&all);
+  lex_tokenize_range(obj->lex, obj->text, obj->length, 0, obj->length, &all,
+                     true);
+  ok = all.count == obj->tokens.count;
+  for (i = 0; ok && i < all.count; i++) {
+    ok = all.id[i] == obj->tokens.id[i] &&
+      all.start[i] == obj->tokens.start[i] &&
+      all.length[i] == obj->tokens.length[i];
+  }
+  lex_tokens_destroy(&all);
+
+  cky_chart_init(&fresh, &obj->gram, obj->nsentence);
+  ok = ok && cky_chart_fill(&fresh, obj->sentence, obj->nsentence) ==
+    cky_incr_accepts(obj) && chart->length == obj->nsentence;
+  for (len = 1; ok && len <= obj->nsentence; len++) {
+    for (start = 0; ok && start + len <= obj->nsentence; start++) {
+      cell = cky_chart_cell(chart, start, len);
+      expect = cky_chart_cell(&fresh, start, len);
+      ok = memcmp(cell, expect, sizeof(cky_word) * nwords) == 0;
+    }
+  }
+  cky_chart_destroy(&fresh);
+  return ok;
+}
+
+static int test_local(void)
+{
+  const char *text = "a + b * (c + d) + e";
+  smb_lex lex;
+  cnf normal;
+  cky_incr incr;
+
+  TEST_ASSERT(fixture_load(&lex, &normal));
+  cky_incr_init(&incr, &lex, &normal);
+  TEST_ASSERT(cky_incr_edit(&incr, 0, 0, text, strlen(text)));
+  TEST_ASSERT(incr.nsentence == 11);
+  TEST_ASSERT(check(&incr));
+
+  // Growing an identifier relexes only that token.
+  TEST_ASSERT(cky_incr_edit(&incr, 5, 0, "bb", 2));
+  TEST_ASSERT(incr.relexed == 1);
+  TEST_ASSERT(check(&incr));
+
+  // Deleting the closing parenthesis breaks the sentence.
+  TEST_ASSERT(!cky_incr_edit(&incr, 16, 1, "", 0));
+  TEST_ASSERT(check(&incr));
+  TEST_ASSERT(cky_incr_edit(&incr, 16, 0, ")", 1));
+  TEST_ASSERT(check(&incr));
+
+  // Deleting an operator joins two identifiers into one token.
+  TEST_ASSERT(cky_incr_edit(&incr, 1, 3, "", 0));
+  TEST_ASSERT(incr.relexed == 1);
+  TEST_ASSERT(incr.nsentence == 9);
+  TEST_ASSERT(check(&incr));
+
+  // Appending at the end relexes the last token, which looked for more.
+  TEST_ASSERT(!cky_incr_edit(&incr, incr.length, 0, " *", 2));
+  TEST_ASSERT(check(&incr));
+  TEST_ASSERT(cky_incr_edit(&incr, incr.length, 0, "f", 1));
+  TEST_ASSERT(check(&incr));
+
+  // A character cut short by the end is finished by appending the rest.
+  TEST_ASSERT(!cky_incr_edit(&incr, incr.length, 0, "\xc3", 1));
+  TEST_ASSERT(check(&incr));
+  TEST_ASSERT(!cky_incr_edit(&incr, incr.length, 0, "\xa9", 1));
+  TEST_ASSERT(check(&incr));
+  TEST_ASSERT(incr.tokens.length[incr.tokens.count - 1] == 2);
+
+  // Deleting everything.
+  TEST_ASSERT(!cky_incr_edit(&incr, 0, incr.length, "", 0));
+  TEST_ASSERT(incr.tokens.count == 0 && incr.nsentence == 0);
+  TEST_ASSERT(check(&incr));
+
+  cky_incr_destroy(&incr);
+  cnf_destroy(&normal, true);
+  lex_destroy(&lex);
+  return 0;
+}
+
+static int test_random(void)
+{
+  static const char *pieces[] = {
+    "a", "bc", " ", "  ", "+", "*", "(", ")", "x + y", "\xc3\xa9",
+  };
+  size_t npieces = sizeof(pieces) / sizeof(pieces[0]);
+  unsigned int seed = 12345;
+  size_t offset, deleted;
+  const char *piece;
+  smb_lex lex;
+  cnf normal;
+  cky_incr incr;
+  int i;
+
+  TEST_ASSERT(fixture_load(&lex, &normal));
+  cky_incr_init(&incr, &lex, &normal);
+  for (i = 0; i < 1000; i++) {
+    seed = seed * 1103515245 + 12345;
+    offset = (seed >> 8) % (incr.length + 1);
+    seed = seed * 1103515245 + 12345;
+    deleted = (seed >> 8) % 4;
+    if (offset + deleted > incr.length || i % 3 == 0) {
+      deleted = 0;
+    }
+    seed = seed * 1103515245 + 12345;
+    piece = pieces[(seed >> 8) % npieces];
+    // Keep the text short, so that checking it from scratch stays cheap.
+    if (incr.length > 60) {
+      deleted = incr.length - offset < 12 ? incr.length - offset : 12;
+      piece = "";
+    }
+    cky_incr_edit(&incr, offset, deleted, piece, strlen(piece));
+    TEST_ASSERT(check(&incr));
+  }
+  cky_incr_destroy(&incr);
+  cnf_destroy(&normal, true);
+  lex_destroy(&lex);
+  return 0;
+}
+
+void incr_test(void)
+{
+  smb_ut_group *group = su_create_test_group("incr");
+
+  smb_ut_test *local = su_create_test("local", test_local);
+  su_add_test(group, local);
+
+  smb_ut_test *random = su_create_test("random", test_random);
+  su_add_test(group, random);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
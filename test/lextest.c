@@ -13,10 +13,16 @@
 
 *******************************************************************************/
 
+#include <stdio.h>
+#include <string.h>
 #include <wchar.h>
 
 #include "libstephen/ut.h"
+#include "libstephen/cb.h"
 #include "lex.h"
+#include "plex.h"
+#include "stats.h"
+#include "stream.h"
 
 static int test_load_single(void)
 {
@@ -111,6 +117,477 @@ static int test_simple_lex(void)
   return 0;
 }
 
+static int test_priority(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int length;
+  DATA token;
+  wchar_t *config =
+    L"if\tIF\n"
+    L"[a-zA-Z_]\\w*\tidentifier\n"
+    L"\\s+\twhitespace\n";
+  smb_lex *lex = lex_create();
+  lex_load(lex, config, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+
+  // Both patterns accept "if", so the first one wins.
+  lex_yylex(lex, L"if x", &token, &length, &status);
+  TEST_ASSERT(length == 2);
+  TEST_ASSERT(wcscmp(token.data_ptr, L"IF") == 0);
+
+  // Only identifier accepts the longer match.
+  lex_yylex(lex, L"iffy x", &token, &length, &status);
+  TEST_ASSERT(length == 4);
+  TEST_ASSERT(wcscmp(token.data_ptr, L"identifier") == 0);
+
+  // Nothing accepts the first character.
+  lex_yylex(lex, L"+", &token, &length, &status);
+  TEST_ASSERT(length == 0);
+  TEST_ASSERT(token.data_ptr == NULL);
+
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_add_after_compile(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int length;
+  DATA token;
+  smb_lex *lex = lex_create();
+  lex_load(lex, L"\\d+\tinteger", &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  TEST_ASSERT(lex->compiled != NULL);
+
+  // Adding a pattern invalidates the compiled automaton.
+  lex_add_pattern(lex, L"\\+", L"ADD");
+  TEST_ASSERT(lex->compiled == NULL);
+
+  lex_yylex(lex, L"+1", &token, &length, &status);
+  TEST_ASSERT(length == 1);
+  TEST_ASSERT(wcscmp(token.data_ptr, L"ADD") == 0);
+
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_sim_reuse(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_lex_sim sim;
+  wchar_t *config =
+    L"[a-zA-Z_]\\w*\tidentifier\n"
+    L"\\d+\tinteger\n"
+    L"\\-\tSUBTRACT\n";
+  wchar_t *test = L"var-12";
+  int expected[] = {3, 1, 2};
+  int i, idx = 0;
+  smb_lex *lex = lex_create();
+  lex_load(lex, config, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+
+  // The same simulation is reset for every token.
+  for (i = 0; i < 3; i++) {
+    lex_sim_reset(lex, &sim);
+    while (!lex_step(lex, &sim, test[idx + sim.last_index + 1]));
+    TEST_ASSERT(lex_get_length(lex, &sim) == expected[i]);
+    idx += lex_get_length(lex, &sim);
+  }
+  TEST_ASSERT(wcscmp(lex_get_token(lex, &sim).data_ptr, L"integer") == 0);
+
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_fyylex_error(void)
+{
+  smb_status status = SMB_SUCCESS;
+  wchar_t *config = L"\\d+\tinteger\n";
+  smb_lex *lex = lex_create();
+  FILE *f = fopen("/dev/null", "w");
+  DATA token;
+  wcbuf wcb;
+  int length;
+  lex_load(lex, config, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+
+  // A file opened only for writing can't be read.
+  wcb_init(&wcb, 16);
+  lex_fyylex_buf(lex, f, &wcb, &token, &length, &status);
+  TEST_ASSERT(status == SMB_NOT_FOUND_ERROR);
+  TEST_ASSERT(wcb.length == 0);
+
+  wcb_destroy(&wcb);
+  fclose(f);
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_stream_buffer(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_lex_stream stream;
+  lex_span span;
+  wchar_t *config =
+    L"[a-zA-Z_]\\w*\tidentifier\n"
+    L"\\d+\tinteger\n"
+    L"\\s+\twhitespace\n";
+  char *text = "ab 12\xc3\xa9 c";
+  smb_lex *lex = lex_create();
+  lex_load(lex, config, &status);
+  lex_stream_init_buffer(&stream, lex, text, strlen(text));
+
+  TEST_ASSERT(lex_stream_next(&stream, &span, &status));
+  TEST_ASSERT(span.token == 0 && span.offset == 0 && span.length == 2);
+  TEST_ASSERT(strncmp(lex_stream_text(&stream, &span), "ab", 2) == 0);
+  TEST_ASSERT(lex_stream_next(&stream, &span, &status));
+  TEST_ASSERT(span.token == 2 && span.offset == 2 && span.length == 1);
+  TEST_ASSERT(lex_stream_next(&stream, &span, &status));
+  TEST_ASSERT(span.token == 1 && span.offset == 3 && span.length == 2);
+
+  // The two byte character matches nothing, and is skipped whole.
+  TEST_ASSERT(lex_stream_next(&stream, &span, &status));
+  TEST_ASSERT(span.token == LEX_NO_TOKEN);
+  TEST_ASSERT(span.offset == 5 && span.length == 2);
+
+  TEST_ASSERT(lex_stream_next(&stream, &span, &status));
+  TEST_ASSERT(span.token == 2 && span.offset == 7);
+  TEST_ASSERT(lex_stream_next(&stream, &span, &status));
+  TEST_ASSERT(span.token == 0 && span.offset == 8 && span.length == 1);
+  TEST_ASSERT(!lex_stream_next(&stream, &span, &status));
+
+  lex_stream_destroy(&stream);
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_stream_error(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_lex_stream stream;
+  lex_span span;
+  wchar_t *config = L"\\d+\tinteger\n";
+  smb_lex *lex = lex_create();
+  FILE *f = fopen("/dev/null", "w");
+  lex_load(lex, config, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+
+  // A file opened only for writing can't be read.
+  lex_stream_init(&stream, lex, f);
+  TEST_ASSERT(!lex_stream_next(&stream, &span, &status));
+  TEST_ASSERT(status == SMB_NOT_FOUND_ERROR);
+
+  lex_stream_destroy(&stream);
+  fclose(f);
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_stream_stats(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_lex_stream stream;
+  cky_stats stats;
+  lex_span span;
+  wchar_t *config =
+    L"[a-zA-Z_]\\w*\tidentifier\n"
+    L"\\d+\tinteger\n"
+    L"\\s+\twhitespace\n";
+  char *text = "ab 12\xc3\xa9 c";
+  smb_lex *lex = lex_create();
+  lex_load(lex, config, &status);
+  cky_stats_init(&stats);
+  lex_stream_init_buffer(&stream, lex, text, strlen(text));
+  stream.stats = &stats;
+
+  while (lex_stream_next(&stream, &span, &status));
+  TEST_ASSERT(stats.lex_tokens == 6);
+  TEST_ASSERT(stats.lex_bytes == strlen(text));
+  TEST_ASSERT(stats.lex_errors == 1);
+  // Finding where each token ends takes a step past it.
+  TEST_ASSERT(stats.lex_steps > stats.lex_bytes);
+
+  lex_stream_destroy(&stream);
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_stream_blocks(void)
+{
+  smb_status status = SMB_SUCCESS;
+  smb_lex_stream stream;
+  lex_span span;
+  wchar_t *config =
+    L"[a-zA-Z_]\\w*\tidentifier\n"
+    L"\\s+\twhitespace\n";
+  // Enough words that tokens straddle several block boundaries.
+  int i, words = 3 * LEX_STREAM_BLOCK / 8, count = 0;
+  size_t expected = 0;
+  FILE *f = tmpfile();
+  smb_lex *lex = lex_create();
+  lex_load(lex, config, &status);
+  for (i = 0; i < words; i++) {
+    fputs("abcdefg ", f);
+  }
+  rewind(f);
+
+  lex_stream_init(&stream, lex, f);
+  while (lex_stream_next(&stream, &span, &status)) {
+    TEST_ASSERT(span.offset == expected);
+    TEST_ASSERT(span.length == (count % 2 == 0 ? 7 : 1));
+    TEST_ASSERT(*lex_stream_text(&stream, &span) ==
+                (count % 2 == 0 ? 'a' : ' '));
+    expected += span.length;
+    count++;
+  }
+  TEST_ASSERT(count == 2 * words);
+  lex_stream_destroy(&stream);
+
+  // A character no pattern matches, straddling a boundary, stays whole.
+  fclose(f);
+  f = tmpfile();
+  for (i = 0; i < LEX_STREAM_BLOCK - 1; i++) {
+    fputc('+', f);
+  }
+  fputs("\xc3\xa9", f);
+  rewind(f);
+  lex_stream_init(&stream, lex, f);
+  for (i = 0; lex_stream_next(&stream, &span, &status); i++) {
+    TEST_ASSERT(span.token == LEX_NO_TOKEN && span.offset == (size_t) i);
+    TEST_ASSERT(span.length == (i < LEX_STREAM_BLOCK - 1 ? 1 : 2));
+  }
+  TEST_ASSERT(i == LEX_STREAM_BLOCK);
+
+  lex_stream_destroy(&stream);
+  fclose(f);
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_yylex_utf8(void)
+{
+  smb_status status = SMB_SUCCESS;
+  int token;
+  size_t length;
+  wchar_t *config =
+    L"[a-z\u00e0-\u00ff]+\tword\n"
+    L"\\s+\twhitespace\n";
+  const char *text = "caf\xc3\xa9 au lait";
+  smb_lex *lex = lex_create();
+  lex_load(lex, config, &status);
+
+  lex_yylex_utf8(lex, text, strlen(text), &token, &length);
+  TEST_ASSERT(token == 0 && length == 5);
+  lex_yylex_utf8(lex, text + 5, strlen(text + 5), &token, &length);
+  TEST_ASSERT(token == 1 && length == 1);
+  // The end of the buffer ends the token.
+  lex_yylex_utf8(lex, text + 9, 4, &token, &length);
+  TEST_ASSERT(token == 0 && length == 4);
+
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_skip_flag(void)
+{
+  smb_status status = SMB_SUCCESS;
+  wchar_t *config =
+    L"[a-z]+\tword\n"
+    L"\\s+\twhitespace\tskip\n";
+  smb_lex *lex = lex_create();
+  lex_load(lex, config, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  TEST_ASSERT(!lex_token_skip(lex, 0));
+  TEST_ASSERT(lex_token_skip(lex, 1));
+  TEST_ASSERT(wcscmp(lex_token_name(lex, 1), L"whitespace") == 0);
+  lex_delete(lex);
+
+  // Anything else in the flags field is an error.
+  lex = lex_create();
+  lex_load(lex, L"[a-z]+\tword\tbogus\n", &status);
+  TEST_ASSERT(status == SMB_INDEX_ERROR);
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_tokenize_all(void)
+{
+  smb_status status = SMB_SUCCESS;
+  wchar_t *config =
+    L"[a-zA-Z_]\\w*\tidentifier\n"
+    L"\\d+\tinteger\n"
+    L"\\+\tADD\n"
+    L"\\s+\twhitespace\tskip\n";
+  const char *text = "var+12  +\xc3\xa9 id3 ";
+  int ids[] = {0, 2, 1, 2, LEX_NO_TOKEN, 0};
+  size_t starts[] = {0, 3, 4, 8, 9, 12};
+  size_t lengths[] = {3, 1, 2, 1, 2, 3};
+  smb_lex *lex = lex_create();
+  lex_tokens toks;
+  size_t i;
+
+  lex_load(lex, config, &status);
+  lex_tokens_init(&toks);
+  lex_tokenize_all(lex, text, strlen(text), &toks);
+  TEST_ASSERT(toks.count == 6);
+  for (i = 0; i < toks.count; i++) {
+    TEST_ASSERT(toks.id[i] == ids[i]);
+    TEST_ASSERT(toks.start[i] == starts[i]);
+    TEST_ASSERT(toks.length[i] == lengths[i]);
+  }
+
+  // Tokenizing again reuses the arrays, growing them as needed.
+  for (i = 0; i < 100; i++) {
+    lex_tokenize_all(lex, "a b c d e f g h i j", 19, &toks);
+  }
+  TEST_ASSERT(toks.count == 10);
+  TEST_ASSERT(toks.start[9] == 18);
+
+  lex_tokens_destroy(&toks);
+  lex_delete(lex);
+  return 0;
+}
+
+/*
+  Fill a buffer with pseudo-random text, of words, numbers, runs of spaces,
+  quotes (which match nothing) and non-ASCII characters, so that chunk
+  boundaries land in every sort of token.
+ */
+static void random_text(char *buf, size_t length, unsigned int seed)
+{
+  static const char *pieces[] = {
+    "abc", " ", "  ", "42", "+", "\"", "\"a b + c\"", "\xc3\xa9", "\n",
+    "identifier_of_some_length", "          ", "x1",
+  };
+  size_t i = 0, n;
+  const char *piece;
+  while (i < length) {
+    seed = seed * 1103515245 + 12345;
+    piece = pieces[(seed >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+    n = strlen(piece);
+    memcpy(buf + i, piece, n < length - i ? n : length - i);
+    i += n;
+  }
+}
+
+static int test_tokenize_parallel(void)
+{
+  smb_status status = SMB_SUCCESS;
+  wchar_t *config =
+    L"[a-zA-Z_]\\w*\tidentifier\n"
+    L"\\d+\tinteger\n"
+    L"\\+\tADD\n"
+    L"\\s+\twhitespace\tskip\n";
+  size_t length = 40 * LEX_PARALLEL_MIN_CHUNK + 17;
+  char *text = smb_new(char, length);
+  int threads[] = {1, 2, 3, 8, 33};
+  smb_lex *lex = lex_create();
+  lex_tokens expected, actual;
+  size_t i, j;
+
+  lex_load(lex, config, &status);
+  lex_tokens_init(&expected);
+  lex_tokens_init(&actual);
+  random_text(text, length, 7);
+  lex_tokenize_all(lex, text, length, &expected);
+
+  for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+    lex_tokenize_parallel(lex, text, length, &actual, threads[i]);
+    TEST_ASSERT(actual.count == expected.count);
+    for (j = 0; j < expected.count; j++) {
+      TEST_ASSERT(actual.id[j] == expected.id[j]);
+      TEST_ASSERT(actual.start[j] == expected.start[j]);
+      TEST_ASSERT(actual.length[j] == expected.length[j]);
+    }
+  }
+
+  // One identifier spanning every chunk.
+  memset(text, 'a', length);
+  lex_tokenize_parallel(lex, text, length, &actual, 4);
+  TEST_ASSERT(actual.count == 1);
+  TEST_ASSERT(actual.id[0] == 0 && actual.length[0] == length);
+
+  lex_tokens_destroy(&expected);
+  lex_tokens_destroy(&actual);
+  smb_free(text);
+  lex_delete(lex);
+  return 0;
+}
+
+static int test_save_load(void)
+{
+  smb_status status = SMB_SUCCESS;
+  wchar_t *config =
+    L"[a-zA-Z_]\\w*\tidentifier\n"
+    L"\\d+\tinteger\n"
+    L"[\u00e0-\u00ff]\taccented\n"
+    L"\\s+\twhitespace\tskip\n";
+  const char *text = "x1 42 \xc3\xa9 + y";
+  const char *filename = "lextest.lexc";
+  uint64_t hash = lex_hash(config, wcslen(config) * sizeof(wchar_t));
+  smb_lex *lex = lex_create(), *loaded = lex_create();
+  lex_tokens expected, actual;
+  DATA token;
+  int length;
+  size_t i;
+  FILE *f;
+
+  lex_load(lex, config, &status);
+  lex_save(lex, filename, hash, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+  lex_load_compiled(loaded, filename, hash, &status);
+  TEST_ASSERT(status == SMB_SUCCESS);
+
+  lex_tokens_init(&expected);
+  lex_tokens_init(&actual);
+  lex_tokenize_all(lex, text, strlen(text), &expected);
+  lex_tokenize_all(loaded, text, strlen(text), &actual);
+  TEST_ASSERT(actual.count == expected.count);
+  for (i = 0; i < expected.count; i++) {
+    TEST_ASSERT(actual.id[i] == expected.id[i]);
+    TEST_ASSERT(actual.start[i] == expected.start[i]);
+    TEST_ASSERT(actual.length[i] == expected.length[i]);
+  }
+  lex_yylex(loaded, L"\u00e9x", &token, &length, &status);
+  TEST_ASSERT(wcscmp(token.data_ptr, L"accented") == 0 && length == 1);
+  TEST_ASSERT(lex_token_skip(loaded, 3));
+  lex_tokens_destroy(&expected);
+  lex_tokens_destroy(&actual);
+  lex_delete(loaded);
+
+  // A file made from some other description is rejected.
+  loaded = lex_create();
+  lex_load_compiled(loaded, filename, hash + 1, &status);
+  TEST_ASSERT(status == SMB_NOT_FOUND_ERROR);
+  TEST_ASSERT(loaded->compiled == NULL);
+  lex_delete(loaded);
+
+  // So is one whose last names have lost their terminating nulls, which
+  // come at the end of the file.
+  status = SMB_SUCCESS;
+  f = fopen(filename, "r+b");
+  fseek(f, -16 * (long) sizeof(wchar_t), SEEK_END);
+  for (i = 0; i < 16; i++) {
+    fwrite(L"x", sizeof(wchar_t), 1, f);
+  }
+  fclose(f);
+  loaded = lex_create();
+  lex_load_compiled(loaded, filename, hash, &status);
+  TEST_ASSERT(status == SMB_NOT_FOUND_ERROR);
+  TEST_ASSERT(loaded->compiled == NULL);
+  lex_delete(loaded);
+
+  status = SMB_SUCCESS;
+  remove(filename);
+  loaded = lex_create();
+  lex_load_compiled(loaded, filename, hash, &status);
+  TEST_ASSERT(status == SMB_NOT_FOUND_ERROR);
+  lex_delete(loaded);
+
+  lex_delete(lex);
+  return 0;
+}
+
 void lex_test(void)
 {
   smb_ut_group *group = su_create_test_group("lex");
@@ -127,6 +604,53 @@ void lex_test(void)
   smb_ut_test *simple_lex = su_create_test("simple_lex", test_simple_lex);
   su_add_test(group, simple_lex);
 
+  smb_ut_test *priority = su_create_test("priority", test_priority);
+  su_add_test(group, priority);
+
+  smb_ut_test *add_after_compile = su_create_test("add_after_compile",
+                                                  test_add_after_compile);
+  su_add_test(group, add_after_compile);
+
+  smb_ut_test *sim_reuse = su_create_test("sim_reuse", test_sim_reuse);
+  su_add_test(group, sim_reuse);
+
+  smb_ut_test *fyylex_error = su_create_test("fyylex_error",
+                                             test_fyylex_error);
+  su_add_test(group, fyylex_error);
+
+  smb_ut_test *stream_buffer = su_create_test("stream_buffer",
+                                              test_stream_buffer);
+  su_add_test(group, stream_buffer);
+
+  smb_ut_test *stream_blocks = su_create_test("stream_blocks",
+                                              test_stream_blocks);
+  su_add_test(group, stream_blocks);
+
+  smb_ut_test *stream_error = su_create_test("stream_error",
+                                             test_stream_error);
+  su_add_test(group, stream_error);
+
+  smb_ut_test *stream_stats = su_create_test("stream_stats",
+                                             test_stream_stats);
+  su_add_test(group, stream_stats);
+
+  smb_ut_test *yylex_utf8 = su_create_test("yylex_utf8", test_yylex_utf8);
+  su_add_test(group, yylex_utf8);
+
+  smb_ut_test *skip_flag = su_create_test("skip_flag", test_skip_flag);
+  su_add_test(group, skip_flag);
+
+  smb_ut_test *tokenize_all = su_create_test("tokenize_all",
+                                             test_tokenize_all);
+  su_add_test(group, tokenize_all);
+
+  smb_ut_test *tokenize_parallel = su_create_test("tokenize_parallel",
+                                                  test_tokenize_parallel);
+  su_add_test(group, tokenize_parallel);
+
+  smb_ut_test *save_load = su_create_test("save_load", test_save_load);
+  su_add_test(group, save_load);
+
   su_run_group(group);
   su_delete_group(group);
 }
@@ -18,4 +18,15 @@
 int main(int argc, char **argv)
 {
   lex_test();
+  dfa_test();
+  codegen_test();
+  gram_test();
+  cnf_test();
+  cky_test();
+  forest_test();
+  viterbi_test();
+  incr_test();
+  serve_test();
+  grep_test();
+  online_test();
 }
@@ -0,0 +1,208 @@
+/***************************************************************************//**
+
+  @file         onlinetest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the lexer to parser pipeline.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libstephen/ut.h"
+#include "cky.h"
+#include "cnf.h"
+#include "fixture.h"
+#include "incr.h"
+#include "lex.h"
+#include "online.h"
+
+#define RING_COUNT 100000
+
+static void *produce(void *arg)
+{
+  cky_ring *ring = arg;
+  int i;
+  for (i = 0; i < RING_COUNT; i++) {
+    cky_ring_push(ring, i);
+  }
+  cky_ring_flush(ring);
+  return NULL;
+}
+
+static int test_ring(void)
+{
+  cky_ring ring;
+  pthread_t thread;
+  int i, bad = 0;
+
+  // A tiny ring, so that both sides find it full or empty often.
+  cky_ring_init(&ring, 5);
+  TEST_ASSERT(ring.mask == 7);
+  pthread_create(&thread, NULL, produce, &ring);
+  for (i = 0; i < RING_COUNT; i++) {
+    bad += cky_ring_pop(&ring) != i;
+  }
+  pthread_join(thread, NULL);
+  TEST_ASSERT(bad == 0);
+  cky_ring_destroy(&ring);
+  return 0;
+}
+
+/*
+  Check each prefix of a sentence, pushed a token at a time, against filling
+  a chart of the prefix from scratch.
+ */
+static bool check(const cky_grammar *g, const int *sentence, int length)
+{
+  cky_online online;
+  cky_chart fresh;
+  bool ok = true;
+  int n, len, start;
+
+  cky_online_init(&online, g);
+  cky_chart_init(&fresh, g, length);
+  for (n = 1; ok && n <= length; n++) {
+    ok = cky_online_push(&online, sentence[n - 1]) &&
+      cky_chart_fill(&fresh, sentence, n) == cky_online_accepts(&online) &&
+      online.chart.length == n;
+    for (len = 1; ok && len <= n; len++) {
+      for (start = 0; ok && start + len <= n; start++) {
+        ok = memcmp(cky_chart_cell(&online.chart, start, len),
+                    cky_chart_cell(&fresh, start, len),
+                    sizeof(cky_word) * g->nwords) == 0;
+      }
+    }
+  }
+  cky_chart_destroy(&fresh);
+  cky_online_destroy(&online);
+  return ok;
+}
+
+static int test_chart(void)
+{
+  static const int tokens[][7] = {
+    {ID},
+    {ID, PLUS, ID, TIMES, ID},
+    {OPEN, ID, PLUS, ID, CLOSE, TIMES, ID},
+    {ID, PLUS},
+    {CLOSE, ID, OPEN},
+  };
+  static const int lengths[] = {1, 5, 7, 2, 3};
+  int sentence[201], i, j, *terminal;
+  smb_lex lex;
+  cnf normal;
+  cky_grammar g;
+  cky_online online;
+
+  TEST_ASSERT(fixture_load(&lex, &normal));
+  cky_grammar_init(&g, &normal);
+  terminal = cky_incr_terminals(&lex, &normal);
+  for (i = 0; i < (int) (sizeof(lengths) / sizeof(int)); i++) {
+    for (j = 0; j < lengths[i]; j++) {
+      sentence[j] = terminal[tokens[i][j]];
+    }
+    TEST_ASSERT(check(&g, sentence, lengths[i]));
+  }
+
+  // Deep enough to grow the chart past its first capacity, twice.
+  for (j = 0; j < 100; j++) {
+    sentence[j] = terminal[OPEN];
+    sentence[j + 101] = terminal[CLOSE];
+  }
+  sentence[100] = terminal[ID];
+  TEST_ASSERT(check(&g, sentence, 201));
+
+  // A token that isn't a terminal rejects the sentence for good.
+  cky_online_init(&online, &g);
+  TEST_ASSERT(cky_online_push(&online, terminal[ID]));
+  TEST_ASSERT(cky_online_accepts(&online));
+  TEST_ASSERT(!cky_online_push(&online, -1));
+  TEST_ASSERT(!cky_online_push(&online, terminal[PLUS]));
+  TEST_ASSERT(!cky_online_push(&online, terminal[ID]));
+  TEST_ASSERT(!cky_online_accepts(&online));
+  TEST_ASSERT(online.length == 4 && online.chart.length == 1);
+  cky_online_reset(&online);
+  TEST_ASSERT(cky_online_push(&online, terminal[ID]));
+  TEST_ASSERT(cky_online_accepts(&online));
+  cky_online_destroy(&online);
+
+  smb_free(terminal);
+  cky_grammar_destroy(&g);
+  cnf_destroy(&normal, true);
+  lex_destroy(&lex);
+  return 0;
+}
+
+static int test_pipeline(void)
+{
+  static const char *text =
+    "a + b\n"
+    "( a\n"
+    "\n"
+    "a * (b +\tc)  \n"
+    "x ) y\n"
+    "a ? b\n"
+    "c";
+  static const bool expect[] = {true, false, false, true, false, false, true};
+  int count = 0, bad = 0;
+  cky_pipeline pipeline;
+  cky_grammar g;
+  bool accepted;
+  smb_lex lex;
+  cnf normal;
+  FILE *in;
+
+  TEST_ASSERT(fixture_load(&lex, &normal));
+  cky_grammar_init(&g, &normal);
+  in = tmpfile();
+  fputs(text, in);
+  rewind(in);
+  cky_pipeline_init(&pipeline, &lex, &normal, &g, in);
+  while (cky_pipeline_next(&pipeline, &accepted)) {
+    bad += count >= 7 || accepted != expect[count];
+    count++;
+  }
+  TEST_ASSERT(count == 7);
+  TEST_ASSERT(bad == 0);
+  TEST_ASSERT(!cky_pipeline_next(&pipeline, &accepted));
+  cky_pipeline_destroy(&pipeline);
+
+  // Stopping early still lets the lexer thread finish.
+  rewind(in);
+  cky_pipeline_init(&pipeline, &lex, &normal, &g, in);
+  TEST_ASSERT(cky_pipeline_next(&pipeline, &accepted) && accepted);
+  cky_pipeline_destroy(&pipeline);
+
+  fclose(in);
+  cky_grammar_destroy(&g);
+  cnf_destroy(&normal, true);
+  lex_destroy(&lex);
+  return 0;
+}
+
+void online_test(void)
+{
+  smb_ut_group *group = su_create_test_group("online");
+
+  smb_ut_test *ring = su_create_test("ring", test_ring);
+  su_add_test(group, ring);
+
+  smb_ut_test *chart = su_create_test("chart", test_chart);
+  su_add_test(group, chart);
+
+  smb_ut_test *pipeline = su_create_test("pipeline", test_pipeline);
+  su_add_test(group, pipeline);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
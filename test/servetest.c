@@ -0,0 +1,174 @@
+/***************************************************************************//**
+
+  @file         servetest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the request server.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libstephen/ut.h"
+#include "cnf.h"
+#include "fixture.h"
+#include "lex.h"
+#include "serve.h"
+
+/*
+  Run a server over the requests, and return its replies, which the caller
+  frees.  Returns NULL if the server reports an error.
+ */
+static char *run(cky_server *server, const char *requests)
+{
+  FILE *out = tmpfile();
+  int fds[2];
+  long size;
+  char *replies;
+  bool ok;
+
+  // Small enough to fit in the pipe, so it can be written all at once.
+  if (pipe(fds) != 0 ||
+      write(fds[1], requests, strlen(requests)) != (ssize_t) strlen(requests)) {
+    return NULL;
+  }
+  close(fds[1]);
+  ok = cky_server_run(server, fds[0], fileno(out));
+  close(fds[0]);
+  size = lseek(fileno(out), 0, SEEK_END);
+  replies = smb_new(char, size + 1);
+  lseek(fileno(out), 0, SEEK_SET);
+  replies[read(fileno(out), replies, size) == size ? size : 0] = '\0';
+  fclose(out);
+  if (!ok) {
+    smb_free(replies);
+    return NULL;
+  }
+  return replies;
+}
+
+static int test_lines(void)
+{
+  smb_lex lex;
+  cnf normal;
+  cky_server server;
+  char *replies;
+  int threads[] = {1, 4}, t;
+
+  TEST_ASSERT(fixture_load(&lex, &normal));
+  for (t = 0; t < 2; t++) {
+    cky_server_init(&server, &lex, &normal, threads[t], false);
+    replies = run(&server,
+                  "parse a + b * (c + d)\n"
+                  "parse a +\r\n"
+                  "lex ab+c\n"
+                  "lex a ? b\n"
+                  "what\n"
+                  "parse (a)");
+    TEST_ASSERT(replies != NULL);
+    TEST_ASSERT(strcmp(replies,
+                       "accept\n"
+                       "reject\n"
+                       "id:0:2 +:2:1 id:3:1\n"
+                       "id:0:1 error:2:1 id:4:1\n"
+                       "error: unknown request\n"
+                       "accept\n") == 0);
+    smb_free(replies);
+    cky_server_destroy(&server);
+  }
+
+  // Without a lexer, words are the names of terminals.
+  cky_server_init(&server, NULL, &normal, 2, false);
+  replies = run(&server, "parse id + id\nparse id id\nlex id\n");
+  TEST_ASSERT(replies != NULL);
+  TEST_ASSERT(strcmp(replies, "accept\nreject\nerror: unknown request\n") ==
+              0);
+  smb_free(replies);
+  cky_server_destroy(&server);
+
+  cnf_destroy(&normal, true);
+  lex_destroy(&lex);
+  return 0;
+}
+
+static int test_framed(void)
+{
+  smb_lex lex;
+  cnf normal;
+  cky_server server;
+  char *replies;
+
+  TEST_ASSERT(fixture_load(&lex, &normal));
+  cky_server_init(&server, &lex, &normal, 3, true);
+  // Frames follow each other with nothing in between.
+  replies = run(&server, "11\nparse a\n+ b6\nlex a0");
+  TEST_ASSERT(replies != NULL);
+  TEST_ASSERT(strcmp(replies, "6\naccept16\nid:0:1 error:1:1") == 0);
+  smb_free(replies);
+
+  // A frame that is cut short is an error.
+  TEST_ASSERT(run(&server, "20\nparse a") == NULL);
+  TEST_ASSERT(run(&server, "x\n") == NULL);
+  cky_server_destroy(&server);
+
+  cnf_destroy(&normal, true);
+  lex_destroy(&lex);
+  return 0;
+}
+
+static int test_many(void)
+{
+  smb_lex lex;
+  cnf normal;
+  cky_server server;
+  char *requests, *replies, *expect;
+  int i, n = 3000;
+
+  // More than a pipe holds would block, so the requests are kept short.
+  requests = smb_new(char, 8 * n + 1);
+  expect = smb_new(char, 8 * n + 1);
+  requests[0] = expect[0] = '\0';
+  for (i = 0; i < n; i++) {
+    strcat(requests, i % 3 == 0 ? "parse +\n" : "parse a\n");
+    strcat(expect, i % 3 == 0 ? "reject\n" : "accept\n");
+  }
+  TEST_ASSERT(fixture_load(&lex, &normal));
+  cky_server_init(&server, &lex, &normal, 4, false);
+  replies = run(&server, requests);
+  TEST_ASSERT(replies != NULL && strcmp(replies, expect) == 0);
+  smb_free(replies);
+  cky_server_destroy(&server);
+  cnf_destroy(&normal, true);
+  lex_destroy(&lex);
+  smb_free(requests);
+  smb_free(expect);
+  return 0;
+}
+
+void serve_test(void)
+{
+  smb_ut_group *group = su_create_test_group("serve");
+
+  smb_ut_test *lines = su_create_test("lines", test_lines);
+  su_add_test(group, lines);
+
+  smb_ut_test *framed = su_create_test("framed", test_framed);
+  su_add_test(group, framed);
+
+  smb_ut_test *many = su_create_test("many", test_many);
+  su_add_test(group, many);
+
+  su_run_group(group);
+  su_delete_group(group);
+}
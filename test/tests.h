@@ -14,3 +14,14 @@
 *******************************************************************************/
 
 void lex_test(void);
+void dfa_test(void);
+void codegen_test(void);
+void gram_test(void);
+void cnf_test(void);
+void cky_test(void);
+void forest_test(void);
+void viterbi_test(void);
+void incr_test(void);
+void serve_test(void);
+void grep_test(void);
+void online_test(void);
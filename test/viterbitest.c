@@ -0,0 +1,212 @@
+/***************************************************************************//**
+
+  @file         viterbitest.c
+
+  @author       Stephen Brennan
+
+  @date         Created Wednesday, 14 October 2026
+
+  @brief        Tests for the Viterbi parser.
+
+  @copyright    Copyright (c) 2015, Stephen Brennan.  Released under the Revised
+                BSD License.  See LICENSE.txt for details.
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "libstephen/ut.h"
+#include "cky.h"
+#include "cnf.h"
+#include "forest.h"
+#include "gram.h"
+#include "viterbi.h"
+
+static void load(const char *text, cnf *normal)
+{
+  smb_status status = SMB_SUCCESS;
+  cfg gram;
+  cfg_init(&gram);
+  cfg_load(&gram, text, &status);
+  cnf_init(normal);
+  cfg_to_cnf(&gram, normal, &status);
+  cfg_destroy(&gram, true);
+}
+
+static bool close_to(double a, double b)
+{
+  return fabs(a - b) < 1e-9;
+}
+
+/*
+  Add up the weights of the rules used by a tree.
+ */
+static double tree_weight(const cnf *gram, const int *tokens,
+                          const cky_tree_node *nodes, int i)
+{
+  const cky_tree_node *node = &nodes[i];
+  const cnf_rule *rule;
+  int r;
+  if (node->left < 0) {
+    for (r = 0; r < cnf_num_rules(gram, false); r++) {
+      rule = cnf_get_rule(gram, false, r);
+      if (rule->lhs == node->symbol && rule->rhs_one == tokens[node->start]) {
+        return rule->weight;
+      }
+    }
+    return -HUGE_VAL;
+  }
+  for (r = 0; r < cnf_num_rules(gram, true); r++) {
+    rule = cnf_get_rule(gram, true, r);
+    if (rule->lhs == node->symbol &&
+        rule->rhs_one == nodes[node->left].symbol &&
+        rule->rhs_two == nodes[node->right].symbol) {
+      return rule->weight + tree_weight(gram, tokens, nodes, node->left) +
+        tree_weight(gram, tokens, nodes, node->right);
+    }
+  }
+  return -HUGE_VAL;
+}
+
+static int test_conversion(void)
+{
+  cnf normal;
+  cky_viterbi parser;
+  int b;
+
+  // S => A => b is better than S => b.
+  load("S -> A [0.5] | b [0.25]\nA -> b [0.8]\n", &normal);
+  b = cnf_add_symbol(&normal, "b", true);
+  cky_viterbi_init(&parser, &normal);
+  TEST_ASSERT(close_to(cky_viterbi_fill(&parser, &b, 1), log(0.4)));
+  cky_viterbi_destroy(&parser);
+  cnf_destroy(&normal, true);
+
+  load("S -> a S [0.5] | [0.5]\n", &normal);
+  b = cnf_add_symbol(&normal, "a", true);
+  cky_viterbi_init(&parser, &normal);
+  TEST_ASSERT(close_to(normal.empty_weight, log(0.5)));
+  TEST_ASSERT(close_to(cky_viterbi_fill(&parser, &b, 0), log(0.5)));
+  TEST_ASSERT(close_to(cky_viterbi_fill(&parser, &b, 1), log(0.25)));
+  cky_viterbi_destroy(&parser);
+  cnf_destroy(&normal, true);
+  return 0;
+}
+
+static int test_best_tree(void)
+{
+  // Attachment ambiguity: every bracketing of "x + x + ... x" parses.
+  const char *text =
+    "E -> E + E [0.3] | E * E [0.2] | x [0.5]\n";
+  int pattern[] = {0, 1, 0, 2, 0, 1, 0, 2, 0, 1, 0};
+  int tokens[11], sym[3];
+  cky_tree_node nodes[21];
+  cky_grammar compiled;
+  cky_chart chart;
+  cky_forest forest;
+  cky_viterbi parser;
+  cnf normal;
+  uint64_t index;
+  double score, best, w;
+  int i;
+
+  load(text, &normal);
+  sym[0] = cnf_add_symbol(&normal, "x", true);
+  sym[1] = cnf_add_symbol(&normal, "+", true);
+  sym[2] = cnf_add_symbol(&normal, "*", true);
+  for (i = 0; i < 11; i++) {
+    tokens[i] = sym[pattern[i]];
+  }
+  cky_grammar_init(&compiled, &normal);
+  cky_chart_init(&chart, &compiled, 11);
+  cky_viterbi_init(&parser, &normal);
+
+  // The best of every tree in the forest is the Viterbi parse.
+  cky_chart_fill(&chart, tokens, 11);
+  cky_forest_init(&forest, &chart);
+  TEST_ASSERT(cky_forest_count(&forest) == 42);
+  best = -HUGE_VAL;
+  index = 0;
+  while (cky_forest_next(&forest, &index, nodes)) {
+    w = tree_weight(&normal, tokens, nodes, 0);
+    best = w > best ? w : best;
+  }
+  score = cky_viterbi_fill(&parser, tokens, 11);
+  TEST_ASSERT(close_to(score, best));
+  TEST_ASSERT(cky_viterbi_tree(&parser, nodes));
+  TEST_ASSERT(close_to(tree_weight(&normal, tokens, nodes, 0), score));
+  TEST_ASSERT(nodes[0].length == 11 && nodes[0].symbol == normal.start);
+
+  // Ungrammatical sentences have no parse.
+  TEST_ASSERT(cky_viterbi_fill(&parser, tokens, 2) == -HUGE_VAL);
+  TEST_ASSERT(!cky_viterbi_tree(&parser, nodes));
+
+  cky_forest_destroy(&forest);
+  cky_viterbi_destroy(&parser);
+  cky_chart_destroy(&chart);
+  cky_grammar_destroy(&compiled);
+  cnf_destroy(&normal, true);
+  return 0;
+}
+
+static int test_pruning(void)
+{
+  const char *text =
+    "S -> S S [0.4] | A [0.3] | B [0.3]\n"
+    "A -> a [0.9] | A A [0.1]\n"
+    "B -> a [0.1] | B B [0.9]\n";
+  int tokens[12];
+  cky_viterbi parser;
+  cnf normal;
+  double exact;
+  int i, full;
+
+  load(text, &normal);
+  for (i = 0; i < 12; i++) {
+    tokens[i] = cnf_add_symbol(&normal, "a", true);
+  }
+  cky_viterbi_init(&parser, &normal);
+  exact = cky_viterbi_fill(&parser, tokens, 12);
+  full = parser.nentries;
+  TEST_ASSERT(exact > -HUGE_VAL);
+
+  // A beam of one keeps a single nonterminal per cell, and still parses.
+  parser.beam = 1;
+  TEST_ASSERT(cky_viterbi_fill(&parser, tokens, 12) <= exact);
+  TEST_ASSERT(parser.nentries <= 78);
+  TEST_ASSERT(parser.nentries < full);
+
+  // A wide beam and threshold prune nothing.
+  parser.beam = 1000;
+  parser.threshold = 1000;
+  TEST_ASSERT(close_to(cky_viterbi_fill(&parser, tokens, 12), exact));
+  TEST_ASSERT(parser.nentries == full);
+
+  // A threshold of zero keeps only each cell's best.
+  parser.beam = 0;
+  parser.threshold = 0;
+  cky_viterbi_fill(&parser, tokens, 12);
+  TEST_ASSERT(parser.nentries < full);
+
+  cky_viterbi_destroy(&parser);
+  cnf_destroy(&normal, true);
+  return 0;
+}
+
+void viterbi_test(void)
+{
+  smb_ut_group *group = su_create_test_group("viterbi");
+
+  smb_ut_test *conversion = su_create_test("conversion", test_conversion);
+  su_add_test(group, conversion);
+
+  smb_ut_test *best_tree = su_create_test("best_tree", test_best_tree);
+  su_add_test(group, best_tree);
+
+  smb_ut_test *pruning = su_create_test("pruning", test_pruning);
+  su_add_test(group, pruning);
+
+  su_run_group(group);
+  su_delete_group(group);
+}